@@ -7,12 +7,27 @@
 #include <iostream>
 #include <strstream>
 #include <Windows.h>
+#include <winhttp.h>
+#pragma comment(lib, "winhttp.lib")
 #include <locale>
 #include <codecvt>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <string>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include <cpprest/http_client.h>
 #include <cpprest/filestream.h>
+#include <cpprest/interopstream.h>
 #include <nlohmann/json.hpp>
 
 using namespace std;
@@ -28,7 +43,12 @@ const string_t subscriptionKey = U("YourSubscriptionKey");
 const string name = "Simple transcription";
 const string description = "Simple transcription description";
 const string myLocale = "en-US";
-const string recordingsBlobUri = "YourFileUrl";
+// Replace with the urls of your audio files, all of them are transcribed concurrently.
+const vector<string> recordingsBlobUris = { "YourFileUrl" };
+// Parses the results while they are downloaded, one segment at a time. Set to false to load every result document at once.
+const bool streamResults = true;
+// Words of your domain in lexical form, e.g. product names. Alternatives that contain them are preferred when the results are streamed.
+const vector<string> domainTerms = {};
 
 class TranscriptionDefinition {
 private:
@@ -151,8 +171,8 @@ class SegmentResult
 {
 public:
     string RecognitionStatus;
-    ULONG Offset;
-    ULONG Duration;
+    uint64_t Offset;
+    uint64_t Duration;
     std::list<NBest> NBest;
 };
 void from_json(const nlohmann::json& j, SegmentResult& sr) {
@@ -162,141 +182,1145 @@ void from_json(const nlohmann::json& j, SegmentResult& sr) {
     sr.NBest = j.at("NBest").get<list<NBest>>();
 }
 
-class AudioFileResult
+// Parses a transcription result document with nlohmann::json::sax_parse and hands out one SegmentResult
+// at a time, so that only a single segment is held in memory no matter how large the document is.
+// The segment is built into a small DOM and then converted with from_json like the full document.
+class SegmentResultSaxParser : public nlohmann::json_sax<nlohmann::json>
 {
 public:
-    string AudioFileName;
-    std::list<SegmentResult> SegmentResults;
-    std::list<Result> CombinedResults;
+    // Called for every segment with the name of the audio file it belongs to.
+    using SegmentHandler = std::function<void(const std::string& audioFileName, const SegmentResult& segment)>;
+
+    explicit SegmentResultSaxParser(SegmentHandler onSegment)
+        : m_onSegment(std::move(onSegment))
+    {
+    }
+
+    // Parses the document read from 'input', throws on malformed json.
+    void Parse(std::istream& input)
+    {
+        nlohmann::json::sax_parse(input, this);
+    }
+
+    bool null() override { return Value(nullptr); }
+    bool boolean(bool val) override { return Value(val); }
+    bool number_integer(number_integer_t val) override { return Value(val); }
+    bool number_unsigned(number_unsigned_t val) override { return Value(val); }
+    bool number_float(number_float_t val, const string_t&) override { return Value(val); }
+
+#if NLOHMANN_JSON_VERSION_MAJOR > 3 || (NLOHMANN_JSON_VERSION_MAJOR == 3 && NLOHMANN_JSON_VERSION_MINOR >= 8)
+    bool binary(binary_t& val) override { return Value(val); }
+#endif
+
+    bool string(string_t& val) override
+    {
+        // "AudioFileName" of an element of "AudioFileResults", it is expected before the segments of the file.
+        if (m_segmentStack.empty() && m_keys.size() == audioFileDepth && m_keys[1] == "AudioFileResults" && m_key == "AudioFileName")
+        {
+            m_audioFileName = val;
+        }
+        return Value(val);
+    }
+
+    bool start_object(std::size_t) override
+    {
+        // An element of "SegmentResults" of an element of "AudioFileResults" starts a new segment.
+        if (m_segmentStack.empty() && m_keys.size() == segmentDepth && m_keys[1] == "AudioFileResults" && m_keys[3] == "SegmentResults")
+        {
+            m_segment = nlohmann::json::object();
+            m_segmentStack.push_back(&m_segment);
+        }
+        else if (!m_segmentStack.empty())
+        {
+            m_segmentStack.push_back(Add(nlohmann::json::object()));
+        }
+        m_keys.push_back(m_key);
+        return true;
+    }
+
+    bool end_object() override
+    {
+        m_keys.pop_back();
+        if (!m_segmentStack.empty())
+        {
+            m_segmentStack.pop_back();
+            if (m_segmentStack.empty())
+            {
+                SegmentResult segment = m_segment;
+                m_onSegment(m_audioFileName, segment);
+                m_segment = nullptr;
+            }
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        if (!m_segmentStack.empty())
+        {
+            m_segmentStack.push_back(Add(nlohmann::json::array()));
+        }
+        m_keys.push_back(m_key);
+        return true;
+    }
+
+    bool end_array() override
+    {
+        m_keys.pop_back();
+        if (!m_segmentStack.empty())
+        {
+            m_segmentStack.pop_back();
+        }
+        return true;
+    }
+
+    bool key(string_t& val) override
+    {
+        m_key = val;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override
+    {
+        throw runtime_error(std::string("Invalid transcription result: ") + ex.what());
+    }
+
+private:
+    // Number of containers around the AudioFileName value and a segment object.
+    static constexpr size_t audioFileDepth = 3;
+    static constexpr size_t segmentDepth = 4;
+
+    // Adds a value to the segment being built, returns a pointer to it so that containers can be filled.
+    nlohmann::json* Add(nlohmann::json&& value)
+    {
+        nlohmann::json& parent = *m_segmentStack.back();
+        if (parent.is_array())
+        {
+            parent.push_back(std::move(value));
+            return &parent.back();
+        }
+        return &(parent[m_key] = std::move(value));
+    }
+
+    template<typename T>
+    bool Value(T&& val)
+    {
+        if (!m_segmentStack.empty())
+        {
+            Add(nlohmann::json(std::forward<T>(val)));
+        }
+        return true;
+    }
+
+    SegmentHandler m_onSegment;
+    std::string m_audioFileName;
+    std::string m_key;
+    // Keys under which each enclosing container was opened, m_keys[1] is the key of the top level member.
+    vector<std::string> m_keys;
+    nlohmann::json m_segment;
+    vector<nlohmann::json*> m_segmentStack;
+};
+
+
+// Read-only view of characters owned by a ResultStringArena, std::string_view is not available in C++14.
+struct TextView
+{
+    const char* Data = nullptr;
+    size_t Size = 0;
+
+    std::string ToString() const
+    {
+        return std::string(Data, Size);
+    }
+
+    bool operator==(const TextView& other) const
+    {
+        return Size == other.Size && (Size == 0 || memcmp(Data, other.Data, Size) == 0);
+    }
+
+    bool EqualsIgnoreCase(const char* text) const
+    {
+        const size_t length = strlen(text);
+        return Size == length && (Size == 0 || _strnicmp(Data, text, Size) == 0);
+    }
 };
-void from_json(const nlohmann::json& j, AudioFileResult& arf) {
-    j.at("AudioFileName").get_to(arf.AudioFileName);
-    arf.SegmentResults = j.at("SegmentResults").get<list<SegmentResult>>();
-    arf.CombinedResults = j.at("CombinedResults").get<list<Result>>();
+
+inline ostream& operator<<(ostream& os, const TextView& text)
+{
+    return os.write(text.Data, text.Size);
 }
 
-class RootObject {
+// Stores the strings of one audio file result back to back in large blocks, and stores identical strings once.
+// Both are common in results: Lexical, ITN, MaskedITN and Display often match, and RecognitionStatus has few values.
+// Blocks never move, so views stay valid for as long as the arena exists, also when it is moved.
+class ResultStringArena
+{
 public:
-    std::list<AudioFileResult> AudioFileResults;
+    ResultStringArena() = default;
+    ResultStringArena(ResultStringArena&&) = default;
+    ResultStringArena& operator=(ResultStringArena&&) = default;
+    ResultStringArena(const ResultStringArena&) = delete;
+    ResultStringArena& operator=(const ResultStringArena&) = delete;
+
+    TextView Intern(const std::string& value)
+    {
+        auto it = m_interned.find(TextView{ value.data(), value.size() });
+        if (it != m_interned.end())
+        {
+            return *it;
+        }
+        TextView stored = Store(value);
+        m_interned.insert(stored);
+        return stored;
+    }
+
+    // Returns the number of bytes of string data held, without duplicates.
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+
+    struct TextViewHash
+    {
+        size_t operator()(const TextView& text) const
+        {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ULL;
+            for (size_t i = 0; i < text.Size; i++)
+            {
+                hash = (hash ^ (unsigned char)text.Data[i]) * 1099511628211ULL;
+            }
+            return (size_t)hash;
+        }
+    };
+
+    TextView Store(const std::string& value)
+    {
+        char* destination;
+        if (value.size() > blockSize / 4)
+        {
+            // Long strings get a block of their own, so that they do not waste the rest of the current block.
+            m_largeBlocks.emplace_back(new char[value.size()]);
+            destination = m_largeBlocks.back().get();
+        }
+        else
+        {
+            if (m_blocks.empty() || m_blockUsed + value.size() > blockSize)
+            {
+                m_blocks.emplace_back(new char[blockSize]);
+                m_blockUsed = 0;
+            }
+            destination = m_blocks.back().get() + m_blockUsed;
+            m_blockUsed += value.size();
+        }
+        memcpy(destination, value.data(), value.size());
+        m_size += value.size();
+        return TextView{ destination, value.size() };
+    }
+
+    vector<unique_ptr<char[]>> m_blocks;
+    vector<unique_ptr<char[]>> m_largeBlocks;
+    size_t m_blockUsed = 0;
+    size_t m_size = 0;
+    unordered_set<TextView, TextViewHash> m_interned;
+};
+
+class CompactResult
+{
+public:
+    TextView Lexical;
+    TextView ITN;
+    TextView MaskedITN;
+    TextView Display;
 };
-void from_json(const nlohmann::json& j, RootObject& r) {
-    r.AudioFileResults = j.at("AudioFileResults").get<list<AudioFileResult>>();
-}
 
+class CompactNBest : public CompactResult
+{
+public:
+    double Confidence;
+};
 
-void recognizeSpeech()
+// A segment refers to its alternatives by position in CompactAudioFileResult::NBests.
+class CompactSegmentResult
 {
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t >> converter;
+public:
+    TextView RecognitionStatus;
+    uint64_t Offset;
+    uint64_t Duration;
+    uint32_t FirstNBest;
+    uint32_t NBestCount;
+};
+
+// The result of one audio file, as downloaded by BatchTranscriptionClient::Run(): segments and alternatives are
+// stored in contiguous vectors, and all strings live in one arena owned by the file result.
+// Move-only, as the views point into the arena.
+class CompactAudioFileResult
+{
+public:
+    // Range of the alternatives of one segment.
+    struct NBestRange
+    {
+        const CompactNBest* First;
+        const CompactNBest* Last;
 
-    utility::string_t service_url = U("https://") + region + U(".cris.ai/api/speechtotext/v2.0/Transcriptions/");
-    uri u(service_url);
+        const CompactNBest* begin() const { return First; }
+        const CompactNBest* end() const { return Last; }
+        size_t size() const { return Last - First; }
+        bool empty() const { return First == Last; }
+    };
 
-    http_client c(u);
-    http_request msg(methods::POST);
-    msg.headers().add(U("Content-Type"), U("application/json"));
-    msg.headers().add(U("Ocp-Apim-Subscription-Key"), subscriptionKey);
+    TextView AudioFileName;
+    vector<CompactSegmentResult> SegmentResults;
+    // Alternatives of all segments, in segment order.
+    vector<CompactNBest> NBests;
+    vector<CompactResult> CombinedResults;
 
-    auto transportdef = TranscriptionDefinition::Create(name, description, myLocale, recordingsBlobUri);
+    CompactAudioFileResult() = default;
+    CompactAudioFileResult(CompactAudioFileResult&&) = default;
+    CompactAudioFileResult& operator=(CompactAudioFileResult&&) = default;
 
-    nlohmann::json transportdefJSON = transportdef;
+    // Returns the alternatives of 'segment', which must belong to this file result.
+    NBestRange NBestOf(const CompactSegmentResult& segment) const
+    {
+        const CompactNBest* first = NBests.data() + segment.FirstNBest;
+        return NBestRange{ first, first + segment.NBestCount };
+    }
 
-    msg.set_body(transportdefJSON.dump());
+    // Returns the number of bytes of text held by the result, identical strings counted once.
+    size_t TextBytes() const
+    {
+        return m_strings.Size();
+    }
 
-    auto response = c.request(msg).get();
-    auto statusCode = response.status_code();
+    friend void from_json(const nlohmann::json& j, CompactAudioFileResult& arf);
 
-    if (statusCode != status_codes::Accepted)
+private:
+    // Reads the fields of a Result or NBest straight from the json, without building the std::string based model.
+    void InternResult(const nlohmann::json& j, CompactResult& compact)
     {
-        cout << "Unexpected status code " << statusCode << endl;
-        return;
+        compact.Lexical = m_strings.Intern(j.at("Lexical").get_ref<const string&>());
+        compact.ITN = m_strings.Intern(j.at("ITN").get_ref<const string&>());
+        compact.MaskedITN = m_strings.Intern(j.at("MaskedITN").get_ref<const string&>());
+        compact.Display = m_strings.Intern(j.at("Display").get_ref<const string&>());
     }
 
-    string_t transcriptionLocation = response.headers()[U("location")];
+    ResultStringArena m_strings;
+};
+
+void from_json(const nlohmann::json& j, CompactAudioFileResult& arf) {
+    arf.AudioFileName = arf.m_strings.Intern(j.at("AudioFileName").get_ref<const string&>());
+
+    const auto& segments = j.at("SegmentResults");
+    arf.SegmentResults.reserve(segments.size());
+    for (const auto& segment : segments)
+    {
+        CompactSegmentResult compact;
+        compact.RecognitionStatus = arf.m_strings.Intern(segment.at("RecognitionStatus").get_ref<const string&>());
+        segment.at("Offset").get_to(compact.Offset);
+        segment.at("Duration").get_to(compact.Duration);
+        compact.FirstNBest = (uint32_t)arf.NBests.size();
+
+        const auto& nbests = segment.at("NBest");
+        compact.NBestCount = (uint32_t)nbests.size();
+        for (const auto& nbest : nbests)
+        {
+            CompactNBest compactNBest;
+            arf.InternResult(nbest, compactNBest);
+            nbest.at("Confidence").get_to(compactNBest.Confidence);
+            arf.NBests.push_back(compactNBest);
+        }
+        arf.SegmentResults.push_back(compact);
+    }
 
-    cout << "Transcription status is located at " << converter.to_bytes(transcriptionLocation) << endl;
+    for (const auto& combined : j.at("CombinedResults"))
+    {
+        CompactResult compact;
+        arf.InternResult(combined, compact);
+        arf.CombinedResults.push_back(compact);
+    }
+}
 
-    http_client statusCheckClient(transcriptionLocation);
-    http_request statusCheckMessage(methods::GET);
-    statusCheckMessage.headers().add(U("Ocp-Apim-Subscription-Key"), subscriptionKey);
+class CompactRootObject {
+public:
+    vector<CompactAudioFileResult> AudioFileResults;
+};
+void from_json(const nlohmann::json& j, CompactRootObject& r) {
+    const auto& files = j.at("AudioFileResults");
+    r.AudioFileResults.resize(files.size());
+    size_t i = 0;
+    for (const auto& file : files)
+    {
+        from_json(file, r.AudioFileResults[i++]);
+    }
+}
 
-    bool completed = false;
+// Re-ranks the NBest alternatives of transcribed segments on a pool of worker threads, e.g. with a language model of
+// the application, and merges the chosen alternatives of each channel into a combined result like CombinedResults.
+// Segments are passed in as they are parsed, by SegmentResultSaxParser or from a whole document, and are handed out
+// again in their order within the channel. Only a bounded number of segments is held at once: Submit() waits while
+// the workers are behind, so memory use does not grow with the length of the recording.
+class NBestPostProcessor
+{
+public:
+    // Returns the score of an alternative of a segment, higher is better. Called from the worker threads at the same time.
+    using Rescorer = std::function<double(const SegmentResult& segment, const NBest& alternative)>;
 
-    while (!completed)
+    // A segment with the alternative the rescorer preferred.
+    struct Selection
     {
-        auto statusResponse = statusCheckClient.request(statusCheckMessage).get();
-        auto statusResponseCode = statusResponse.status_code();
+        string RecordingsUrl;
+        string Channel;
+        string AudioFileName;
+        SegmentResult Segment;
+        // False for segments that were not recognized, or that have no alternatives.
+        bool HasBest = false;
+        NBest Best;
+        double Score = 0;
+        // The position of Best in the service's ranking, 0 if the rescorer agreed with the service.
+        size_t ServiceRank = 0;
+    };
+
+    // Called for every segment in the order it was submitted within its channel, one call at a time.
+    using SelectionHandler = std::function<void(const Selection& selection)>;
 
-        if (statusResponseCode != status_codes::OK)
+    NBestPostProcessor(Rescorer rescore, SelectionHandler onSelection, size_t threadCount, size_t maxSegmentsInFlight)
+        : m_rescore(std::move(rescore)), m_onSelection(std::move(onSelection)), m_maxInFlight(maxSegmentsInFlight)
+    {
+        if (!m_rescore)
+        {
+            throw invalid_argument("Rescorer must be set");
+        }
+        if (threadCount == 0 || maxSegmentsInFlight == 0)
+        {
+            throw invalid_argument("Thread count and segments in flight must be at least 1");
+        }
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_threads.emplace_back(&NBestPostProcessor::Run, this);
+        }
+    }
+
+    ~NBestPostProcessor()
+    {
+        Stop();
+    }
+
+    NBestPostProcessor(const NBestPostProcessor&) = delete;
+    NBestPostProcessor& operator=(const NBestPostProcessor&) = delete;
+
+    // Queues a segment for rescoring, waits while maxSegmentsInFlight segments have not been handed out yet.
+    void Submit(const string& recordingsUrl, const string& channel, const string& audioFileName, const SegmentResult& segment)
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_capacity.wait(lock, [this]() { return m_inFlight < m_maxInFlight; });
+        Work work;
+        work.Key = ChannelKey(recordingsUrl, channel);
+        work.Sequence = m_channels[work.Key].NextSequence++;
+        work.Selected.RecordingsUrl = recordingsUrl;
+        work.Selected.Channel = channel;
+        work.Selected.AudioFileName = audioFileName;
+        work.Selected.Segment = segment;
+        m_queue.push_back(std::move(work));
+        m_inFlight++;
+        m_ready.notify_one();
+    }
+
+    // Waits until all submitted segments have been handed out, stops the workers, and returns the combined result of
+    // each channel, keyed by recordings url and channel name. Rethrows the first exception of the rescorer.
+    map<pair<string, string>, Result> Finish()
+    {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_capacity.wait(lock, [this]() { return m_inFlight == 0; });
+        }
+        Stop();
+        if (m_error)
+        {
+            rethrow_exception(m_error);
+        }
+        map<pair<string, string>, Result> combined;
+        for (auto& channel : m_channels)
+        {
+            combined[channel.first] = std::move(channel.second.Combined);
+        }
+        return combined;
+    }
+
+private:
+    using ChannelKey = pair<string, string>;
+
+    struct Work
+    {
+        ChannelKey Key;
+        uint64_t Sequence = 0;
+        Selection Selected;
+    };
+
+    struct ChannelState
+    {
+        uint64_t NextSequence = 0;
+        uint64_t NextHandedOut = 0;
+        // Segments that were rescored before the ones submitted ahead of them.
+        map<uint64_t, Selection> Waiting;
+        Result Combined;
+    };
+
+    void Run()
+    {
+        while (true)
+        {
+            Work work;
+            {
+                unique_lock<mutex> lock(m_mutex);
+                m_ready.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty())
+                {
+                    return;
+                }
+                work = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            try
+            {
+                Select(work.Selected);
+            }
+            catch (...)
+            {
+                // The segment is still handed out, without a selection, so that the segments after it are not held up.
+                work.Selected.HasBest = false;
+                lock_guard<mutex> lock(m_mutex);
+                if (!m_error)
+                {
+                    m_error = current_exception();
+                }
+            }
+            HandOut(std::move(work));
+        }
+    }
+
+    void Select(Selection& selection)
+    {
+        const SegmentResult& segment = selection.Segment;
+        if (_stricmp(segment.RecognitionStatus.c_str(), "success") || segment.NBest.empty())
         {
-            cout << "Fetching the transcription returned unexpected http code " << statusResponseCode << endl;
             return;
         }
+        size_t rank = 0;
+        for (const auto& alternative : segment.NBest)
+        {
+            const double score = m_rescore(segment, alternative);
+            if (!selection.HasBest || score > selection.Score)
+            {
+                selection.HasBest = true;
+                selection.Best = alternative;
+                selection.Score = score;
+                selection.ServiceRank = rank;
+            }
+            rank++;
+        }
+    }
 
-        auto body = statusResponse.extract_string().get();
-        auto statusJSON = nlohmann::json::parse(body);
-        Transcription transcriptionStatus = statusJSON;
+    // Hands out the segments of the channel that are next in order, and appends them to its combined result.
+    void HandOut(Work&& work)
+    {
+        lock_guard<mutex> outputLock(m_outputMutex);
+        ChannelState* channel = nullptr;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            channel = &m_channels[work.Key];
+        }
+        channel->Waiting.emplace(work.Sequence, std::move(work.Selected));
+        size_t handedOut = 0;
+        for (auto it = channel->Waiting.begin(); it != channel->Waiting.end() && it->first == channel->NextHandedOut; it = channel->Waiting.erase(it))
+        {
+            const Selection& selection = it->second;
+            if (selection.HasBest)
+            {
+                AppendText(channel->Combined.Lexical, selection.Best.Lexical);
+                AppendText(channel->Combined.ITN, selection.Best.ITN);
+                AppendText(channel->Combined.MaskedITN, selection.Best.MaskedITN);
+                AppendText(channel->Combined.Display, selection.Best.Display);
+            }
+            m_onSelection(selection);
+            channel->NextHandedOut++;
+            handedOut++;
+        }
+        if (handedOut > 0)
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_inFlight -= handedOut;
+            }
+            m_capacity.notify_all();
+        }
+    }
 
-        if (!_stricmp(transcriptionStatus.status.c_str(), "Failed"))
+    static void AppendText(string& combined, const string& text)
+    {
+        if (!combined.empty() && !text.empty())
         {
-            completed = true;
-            cout << "Transcription has failed " << transcriptionStatus.statusMessage << endl;
+            combined += ' ';
         }
-        else if (!_stricmp(transcriptionStatus.status.c_str(), "Succeeded"))
+        combined += text;
+    }
+
+    void Stop()
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+        for (auto& thread : m_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+    }
+
+    Rescorer m_rescore;
+    SelectionHandler m_onSelection;
+    const size_t m_maxInFlight;
+    mutex m_mutex;
+    condition_variable m_ready;
+    condition_variable m_capacity;
+    deque<Work> m_queue;
+    // Entries are only added under m_mutex, and their contents only changed under m_outputMutex, std::map keeps them in place.
+    map<ChannelKey, ChannelState> m_channels;
+    size_t m_inFlight = 0;
+    bool m_stopping = false;
+    exception_ptr m_error;
+    // Serializes handing out, so that the handler sees one segment at a time.
+    mutex m_outputMutex;
+    vector<thread> m_threads;
+};
+
+// The HTTP layer of all transcription REST calls. Requests to a host go through one http_client, whose WinHTTP session
+// keeps a pool of keep-alive connections to it and negotiates HTTP/2 where Windows supports it, so that the polls and
+// result downloads of thousands of jobs share a handful of connections. Responses are requested with gzip encoding and
+// decoded by the client. At most 'maxConcurrentRequests' requests are in flight at once, further ones wait in order
+// for a free slot without holding a thread.
+class SharedHttpClient
+{
+public:
+    explicit SharedHttpClient(size_t maxConcurrentRequests)
+        : m_maxConcurrentRequests(maxConcurrentRequests == 0 ? 1 : maxConcurrentRequests)
+    {
+    }
+
+    // Sends a request to the host of 'host' once a slot is free. The slot is released when the response headers
+    // have arrived, so this is meant for responses with small bodies.
+    pplx::task<http_response> Request(const uri& host, http_request request)
+    {
+        http_client& client = ClientFor(host);
+        return Acquire().then([&client, request]()
         {
-            completed = true;
-            cout << "Success!" << endl;
-            string result = transcriptionStatus.resultsUrls["channel_0"];
-            cout << "Transcription has completed. Results are at " << result << endl;
-            cout << "Fetching results" << endl;
+            return client.request(request);
+        }).then([this](pplx::task<http_response> response)
+        {
+            Release();
+            return response;
+        });
+    }
 
-            http_client result_client(converter.from_bytes(result));
-            http_request resultMessage(methods::GET);
-            resultMessage.headers().add(U("Ocp-Apim-Subscription-Key"), subscriptionKey);
+    // Sends a request to the host of 'host' once a slot is free, and passes the response to 'consume' on a thread
+    // pool thread. The slot is held until 'consume' returns, so that reading a large body counts against the limit.
+    pplx::task<void> Download(const uri& host, http_request request, function<void(pplx::task<http_response>)> consume)
+    {
+        http_client& client = ClientFor(host);
+        return Acquire().then([&client, request]()
+        {
+            return client.request(request);
+        }).then([this, consume](pplx::task<http_response> response)
+        {
+            try
+            {
+                consume(response);
+            }
+            catch (...)
+            {
+                Release();
+                throw;
+            }
+            Release();
+        });
+    }
+
+private:
+    http_client& ClientFor(const uri& host)
+    {
+        auto authority = host.authority().to_string();
+        lock_guard<mutex> lock(m_clientsMutex);
+        auto it = m_clients.find(authority);
+        if (it == m_clients.end())
+        {
+            it = m_clients.emplace(authority, make_unique<http_client>(host.authority(), Config())).first;
+        }
+        return *it->second;
+    }
 
-            auto resultResponse = result_client.request(resultMessage).get();
+    static http_client_config Config()
+    {
+        http_client_config config;
+        // Sends Accept-Encoding and decodes gzip or deflate bodies, result documents compress about tenfold.
+        config.set_request_compressed_response(true);
+        config.set_nativesessionhandle_options([](native_handle session)
+        {
+#ifdef WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL
+            // Multiplexes the requests to a host over one connection where WinHTTP supports HTTP/2, i.e. Windows 10
+            // 1607 and later. Older versions fail the option and keep using HTTP/1.1 connections.
+            DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+            WinHttpSetOption(session, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols));
+#endif
+        });
+        return config;
+    }
 
-            auto responseCode = resultResponse.status_code();
+    pplx::task<void> Acquire()
+    {
+        lock_guard<mutex> lock(m_slotsMutex);
+        if (m_inFlight < m_maxConcurrentRequests)
+        {
+            m_inFlight++;
+            return pplx::task_from_result();
+        }
+        pplx::task_completion_event<void> slot;
+        m_waiting.push_back(slot);
+        return pplx::create_task(slot);
+    }
 
-            if (responseCode != status_codes::OK)
+    void Release()
+    {
+        pplx::task_completion_event<void> next;
+        {
+            lock_guard<mutex> lock(m_slotsMutex);
+            if (m_waiting.empty())
             {
-                cout << "Fetching the transcription returned unexpected http code " << responseCode << endl;
+                m_inFlight--;
                 return;
             }
+            next = m_waiting.front();
+            m_waiting.pop_front();
+        }
+        // The slot passes to the oldest waiting request.
+        next.set();
+    }
 
-            auto resultBody = resultResponse.extract_string().get();
+    const size_t m_maxConcurrentRequests;
+    mutex m_clientsMutex;
+    map<string_t, unique_ptr<http_client>> m_clients;
+    mutex m_slotsMutex;
+    size_t m_inFlight = 0;
+    deque<pplx::task_completion_event<void>> m_waiting;
+};
 
-            nlohmann::json resultJSON = nlohmann::json::parse(resultBody);
-            RootObject root = resultJSON;
+// Submits many transcriptions at once, polls all of them from a single scheduler loop and downloads the results of every channel.
+// All HTTP requests are asynchronous pplx tasks, no thread blocks on a single job.
+class BatchTranscriptionClient
+{
+public:
+    // Called for every downloaded result, with the recordings url of the transcription and the channel name (e.g. "channel_0").
+    using ResultHandler = std::function<void(const string& recordingsUrl, const string& channel, const CompactRootObject& result)>;
+    // Called for every segment of a downloaded result when the results are streamed. Unlike the other handlers, it is
+    // called from the downloads at the same time, in order within a download, and may block to apply back pressure.
+    using SegmentHandler = std::function<void(const string& recordingsUrl, const string& channel, const string& audioFileName, const SegmentResult& segment)>;
+    // Called when a transcription cannot be completed.
+    using ErrorHandler = std::function<void(const string& recordingsUrl, const string& message)>;
+
+    BatchTranscriptionClient(const string_t& region, const string_t& subscriptionKey, size_t maxConcurrentRequests)
+        : m_subscriptionKey(subscriptionKey),
+          m_maxConcurrentRequests(maxConcurrentRequests),
+          m_serviceHost(U("https://") + region + U(".cris.ai")),
+          m_http(maxConcurrentRequests)
+    {
+    }
 
-            for (AudioFileResult af : root.AudioFileResults)
+    // Runs all transcriptions to completion and returns once every result has been downloaded.
+    // Each result document is parsed as a whole before it is passed to 'onResult'.
+    void Run(const vector<TranscriptionDefinition>& definitions, ResultHandler onResult, ErrorHandler onError)
+    {
+        RunJobs(definitions, [this, onResult](const string& recordingsUrl, const string& channel, http_response& response)
+        {
+            nlohmann::json resultJSON = nlohmann::json::parse(response.extract_string().get());
+            CompactRootObject root;
+            from_json(resultJSON, root);
+            // The document is released before the handler runs, only the compact result is kept.
+            resultJSON = nullptr;
+            lock_guard<mutex> lock(m_handlerMutex);
+            onResult(recordingsUrl, channel, root);
+        }, onError);
+    }
+
+    // Same as Run(), but parses the result documents while they are downloaded and passes one segment at a time
+    // to 'onSegment'. Memory use does not grow with the size of the results, use this for long recordings.
+    // 'onSegment' is not serialized with m_handlerMutex: a handler that waits, e.g. NBestPostProcessor::Submit(),
+    // only holds up the download it is called from, not the parsers of the other downloads or the error handler.
+    void RunStreaming(const vector<TranscriptionDefinition>& definitions, SegmentHandler onSegment, ErrorHandler onError)
+    {
+        RunJobs(definitions, [onSegment](const string& recordingsUrl, const string& channel, http_response& response)
+        {
+            SegmentResultSaxParser parser([&](const string& audioFileName, const SegmentResult& segment)
             {
-                cout << "There were " << af.SegmentResults.size() << " results in " << af.AudioFileName << endl;
+                onSegment(recordingsUrl, channel, audioFileName, segment);
+            });
+            // Reads the response body as it arrives instead of extracting it into a string.
+            concurrency::streams::async_istream<char> body(concurrency::streams::basic_istream<char>(response.body()));
+            parser.Parse(body);
+        }, onError);
+    }
+
+private:
+    // Consumes the body of a successful result download. Called on a thread pool thread.
+    using ResultConsumer = std::function<void(const string& recordingsUrl, const string& channel, http_response& response)>;
 
-                for (SegmentResult segResult : af.SegmentResults)
+    void RunJobs(const vector<TranscriptionDefinition>& definitions, ResultConsumer consume, ErrorHandler onError)
+    {
+        // Errors are reported from the scheduler loop and from downloads, they are serialized like results.
+        ErrorHandler reportError = [this, onError](const string& recordingsUrl, const string& message)
+        {
+            lock_guard<mutex> lock(m_handlerMutex);
+            onError(recordingsUrl, message);
+        };
+
+        vector<Job> jobs;
+        for (const auto& definition : definitions)
+        {
+            jobs.push_back(Job{ definition });
+        }
+
+        vector<pplx::task<void>> downloads;
+        size_t outstanding = jobs.size();
+        while (outstanding > 0)
+        {
+            // Issues the requests of all jobs that are due, bounded by the number of concurrent requests.
+            auto now = chrono::steady_clock::now();
+            vector<pair<Job*, pplx::task<http_response>>> requests;
+            for (auto& job : jobs)
+            {
+                if (job.State != JobState::Done && job.NextAttempt <= now && requests.size() < m_maxConcurrentRequests)
                 {
-                    cout << "Status: " << segResult.RecognitionStatus << endl;
+                    requests.emplace_back(&job, job.State == JobState::Submitting ? Submit(job) : GetStatus(job));
+                }
+            }
 
-                    if (!_stricmp(segResult.RecognitionStatus.c_str(), "success") && segResult.NBest.size() > 0)
+            for (auto& request : requests)
+            {
+                Job& job = *request.first;
+                try
+                {
+                    auto response = request.second.get();
+                    if (job.State == JobState::Submitting)
                     {
-                        cout << "Best text result was: '" << segResult.NBest.front().Display << "'" << endl;
+                        OnSubmitResponse(job, response, reportError);
                     }
+                    else
+                    {
+                        OnStatusResponse(job, response, downloads, consume, reportError);
+                    }
+                }
+                catch (const exception& e)
+                {
+                    if (job.State == JobState::Submitting)
+                    {
+                        // The service may have created the transcription before the response was lost, a second
+                        // POST would create another one. The job is given up rather than risk a duplicate.
+                        job.State = JobState::Done;
+                        reportError(job.Definition.RecordingsUrl, string("Submitting the transcription failed, it may have been created anyway: ") + e.what());
+                    }
+                    else
+                    {
+                        // Network errors of status polls are retried with backoff like a busy service.
+                        cout << "Request for " << job.Definition.RecordingsUrl << " failed: " << e.what() << endl;
+                        Backoff(job, noRetryAfter);
+                    }
+                }
+                if (job.State == JobState::Done)
+                {
+                    outstanding--;
+                }
+            }
+
+            // Sleeps until the next job is due.
+            auto next = (chrono::steady_clock::time_point::max)();
+            for (const auto& job : jobs)
+            {
+                if (job.State != JobState::Done && job.NextAttempt < next)
+                {
+                    next = job.NextAttempt;
+                }
+            }
+            if (outstanding > 0 && next > chrono::steady_clock::now())
+            {
+                this_thread::sleep_until(next);
+            }
+        }
+
+        pplx::when_all(downloads.begin(), downloads.end()).wait();
+    }
+
+    // Backoff of status polling, the delay doubles after every poll of a job that is not finished.
+    static constexpr chrono::milliseconds initialDelay{ 1000 };
+    static constexpr chrono::milliseconds maxDelay{ 60000 };
+    static constexpr int noRetryAfter = -1;
+
+    enum class JobState { Submitting, Polling, Done };
+
+    struct Job
+    {
+        TranscriptionDefinition Definition;
+        JobState State = JobState::Submitting;
+        string_t Location;
+        chrono::steady_clock::time_point NextAttempt = chrono::steady_clock::now();
+        chrono::milliseconds Delay = initialDelay;
+    };
+
+    pplx::task<http_response> Submit(const Job& job)
+    {
+        http_request msg(methods::POST);
+        msg.set_request_uri(U("/api/speechtotext/v2.0/Transcriptions/"));
+        msg.headers().add(U("Content-Type"), U("application/json"));
+        msg.headers().add(U("Ocp-Apim-Subscription-Key"), m_subscriptionKey);
+        nlohmann::json definitionJSON = job.Definition;
+        msg.set_body(definitionJSON.dump());
+        return m_http.Request(m_serviceHost, msg);
+    }
+
+    pplx::task<http_response> GetStatus(const Job& job)
+    {
+        // The location is on the service host, so the request goes through the shared client and its connections.
+        http_request msg(methods::GET);
+        msg.set_request_uri(uri(job.Location).resource());
+        msg.headers().add(U("Ocp-Apim-Subscription-Key"), m_subscriptionKey);
+        return m_http.Request(m_serviceHost, msg);
+    }
+
+    void OnSubmitResponse(Job& job, http_response& response, const ErrorHandler& onError)
+    {
+        auto statusCode = response.status_code();
+        if (statusCode == status_codes::Accepted)
+        {
+            job.Location = response.headers()[U("location")];
+            job.State = JobState::Polling;
+            job.Delay = initialDelay;
+            job.NextAttempt = chrono::steady_clock::now() + job.Delay;
+            cout << "Transcription status is located at " << m_converter.to_bytes(job.Location) << endl;
+        }
+        else if (IsRetryable(statusCode))
+        {
+            Backoff(job, RetryAfterSeconds(response));
+        }
+        else
+        {
+            job.State = JobState::Done;
+            onError(job.Definition.RecordingsUrl, "Unexpected status code " + to_string(statusCode));
+        }
+    }
+
+    void OnStatusResponse(Job& job, http_response& response, vector<pplx::task<void>>& downloads, const ResultConsumer& consume, const ErrorHandler& onError)
+    {
+        auto statusCode = response.status_code();
+        if (IsRetryable(statusCode))
+        {
+            Backoff(job, RetryAfterSeconds(response));
+            return;
+        }
+        if (statusCode != status_codes::OK)
+        {
+            job.State = JobState::Done;
+            onError(job.Definition.RecordingsUrl, "Fetching the transcription returned unexpected http code " + to_string(statusCode));
+            return;
+        }
+
+        auto statusJSON = nlohmann::json::parse(response.extract_string().get());
+        Transcription transcriptionStatus = statusJSON;
+
+        if (!_stricmp(transcriptionStatus.status.c_str(), "Failed"))
+        {
+            job.State = JobState::Done;
+            onError(job.Definition.RecordingsUrl, "Transcription has failed " + transcriptionStatus.statusMessage);
+        }
+        else if (!_stricmp(transcriptionStatus.status.c_str(), "Succeeded"))
+        {
+            job.State = JobState::Done;
+            for (const auto& channel : transcriptionStatus.resultsUrls)
+            {
+                downloads.push_back(Download(job.Definition.RecordingsUrl, channel.first, channel.second, consume, onError));
+            }
+        }
+        else
+        {
+            // Still NotStarted or Running.
+            Backoff(job, RetryAfterSeconds(response));
+        }
+    }
+
+    // Downloads the result of one channel and passes the response to 'consume'.
+    pplx::task<void> Download(const string& recordingsUrl, const string& channel, const string& resultUrl, const ResultConsumer& consume, const ErrorHandler& onError)
+    {
+        uri resultUri(m_converter.from_bytes(resultUrl));
+        http_request msg(methods::GET);
+        msg.set_request_uri(resultUri.resource());
+        msg.headers().add(U("Ocp-Apim-Subscription-Key"), m_subscriptionKey);
+
+        // Downloads from the same storage account share its connections, and count against the limit until consumed.
+        return m_http.Download(resultUri, msg, [recordingsUrl, channel, consume, onError](pplx::task<http_response> request)
+        {
+            try
+            {
+                auto response = request.get();
+                if (response.status_code() != status_codes::OK)
+                {
+                    throw runtime_error("Fetching the transcription returned unexpected http code " + to_string(response.status_code()));
                 }
+                consume(recordingsUrl, channel, response);
+            }
+            catch (const exception& e)
+            {
+                onError(recordingsUrl, channel + ": " + e.what());
             }
+        });
+    }
+
+    static bool IsRetryable(status_code statusCode)
+    {
+        // 429 Too Many Requests or 503 Service Unavailable.
+        return statusCode == 429 || statusCode == status_codes::ServiceUnavailable;
+    }
+
+    // Returns the delay requested by a Retry-After header in seconds, or noRetryAfter.
+    static int RetryAfterSeconds(http_response& response)
+    {
+        auto header = response.headers().find(U("Retry-After"));
+        if (header == response.headers().end())
+        {
+            return noRetryAfter;
         }
-        else if (!_stricmp(transcriptionStatus.status.c_str(), "Running"))
+        try
         {
-            cout << "Transcription is running." << endl;
+            return stoi(header->second);
         }
-        else if (!_stricmp(transcriptionStatus.status.c_str(), "NotStarted"))
+        catch (const exception&)
         {
-            cout << "Transcription has not started." << endl;
+            // An HTTP date instead of seconds, falls back to the exponential backoff.
+            return noRetryAfter;
         }
+    }
+
+    // Schedules the next attempt, honoring Retry-After if given, otherwise doubling the delay up to maxDelay.
+    static void Backoff(Job& job, int retryAfterSeconds)
+    {
+        auto now = chrono::steady_clock::now();
+        if (retryAfterSeconds >= 0)
+        {
+            job.NextAttempt = now + chrono::seconds(retryAfterSeconds);
+        }
+        else
+        {
+            job.NextAttempt = now + job.Delay;
+            job.Delay = (std::min)(job.Delay * 2, maxDelay);
+        }
+    }
 
-        if (!completed) {
-            Sleep(5000);
+    string_t m_subscriptionKey;
+    size_t m_maxConcurrentRequests;
+    uri m_serviceHost;
+    SharedHttpClient m_http;
+    mutex m_handlerMutex;
+    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> m_converter;
+};
+
+constexpr chrono::milliseconds BatchTranscriptionClient::initialDelay;
+constexpr chrono::milliseconds BatchTranscriptionClient::maxDelay;
+
+// Scores an alternative of a segment when the results are post-processed. Replace with the score of your own language
+// model, this one prefers alternatives that contain the words of 'domainTerms', and otherwise keeps the service's ranking.
+double rescoreAlternative(const SegmentResult&, const NBest& alternative)
+{
+    double score = alternative.Confidence;
+    for (const auto& term : domainTerms)
+    {
+        if (alternative.Lexical.find(term) != string::npos)
+        {
+            score += 1;
         }
+    }
+    return score;
+}
 
+void recognizeSpeech()
+{
+    vector<TranscriptionDefinition> definitions;
+    for (const auto& recordingsBlobUri : recordingsBlobUris)
+    {
+        definitions.push_back(TranscriptionDefinition::Create(name, description, myLocale, recordingsBlobUri));
     }
+
+    auto onError = [](const string& recordingsUrl, const string& message)
+    {
+        cout << "Transcription of " << recordingsUrl << " did not complete: " << message << endl;
+    };
+
+    BatchTranscriptionClient client(region, subscriptionKey, 16);
+    if (streamResults)
+    {
+        // Re-ranks the alternatives of each segment on 4 threads while the results are downloaded. Submit() is called
+        // from all downloads at once, and waits while 256 segments are being processed.
+        NBestPostProcessor postProcessor(rescoreAlternative,
+            [](const NBestPostProcessor::Selection& selection)
+            {
+                cout << "Result of " << selection.AudioFileName << " (" << selection.Channel << "), status: " << selection.Segment.RecognitionStatus << endl;
+
+                if (selection.HasBest)
+                {
+                    cout << "Best text result was: '" << selection.Best.Display << "'";
+                    if (selection.ServiceRank > 0)
+                    {
+                        cout << " (alternative " << selection.ServiceRank + 1 << " of the service)";
+                    }
+                    cout << endl;
+                }
+            },
+            4, 256);
+        client.RunStreaming(definitions,
+            [&postProcessor](const string& recordingsUrl, const string& channel, const string& audioFileName, const SegmentResult& segResult)
+            {
+                postProcessor.Submit(recordingsUrl, channel, audioFileName, segResult);
+            },
+            onError);
+        for (const auto& combined : postProcessor.Finish())
+        {
+            cout << "Combined result of " << combined.first.first << " (" << combined.first.second << "): '" << combined.second.Display << "'" << endl;
+        }
+        return;
+    }
+
+    client.Run(definitions,
+        [](const string& recordingsUrl, const string& channel, const CompactRootObject& root)
+        {
+            cout << "Transcription of " << recordingsUrl << " has completed, results of " << channel << ":" << endl;
+            for (const CompactAudioFileResult& af : root.AudioFileResults)
+            {
+                cout << "There were " << af.SegmentResults.size() << " results in " << af.AudioFileName << " (" << af.TextBytes() << " bytes of text)" << endl;
+
+                for (const CompactSegmentResult& segResult : af.SegmentResults)
+                {
+                    cout << "Status: " << segResult.RecognitionStatus << endl;
+
+                    auto alternatives = af.NBestOf(segResult);
+                    if (segResult.RecognitionStatus.EqualsIgnoreCase("success") && !alternatives.empty())
+                    {
+                        cout << "Best text result was: '" << alternatives.begin()->Display << "'" << endl;
+                    }
+                }
+            }
+        },
+        onError);
 }
 
 int wmain()
@@ -4,93 +4,180 @@
 //
 
 #include <iostream> // cin, cout
+#include <future>
+#include <vector>
 #include <speechapi_cxx.h>
+#include "compressed_decoder_pool.h"
+#include "container_sniffer.h"
+#include "prefetching_file_reader.h"
 
 using namespace Microsoft::CognitiveServices::Speech;
 using namespace Microsoft::CognitiveServices::Speech::Audio;
 
-static void* OpenCompressedFile(const std::string& compressedFileName)
+// Compressed files are read ahead in 1 MB blocks, so that the small reads of the SDK do not wait for the file system.
+static PrefetchingFileReader* OpenCompressedFile(const std::string& compressedFileName)
 {
-    FILE *filep = NULL;
-    filep = fopen(compressedFileName.c_str(), "rb");
-    return filep;
+    try
+    {
+        return new PrefetchingFileReader(compressedFileName, 1 << 20, 4);
+    }
+    catch (const std::runtime_error&)
+    {
+        return NULL;
+    }
 }
 
 static void closeStream(void* fp)
 {
-    if (fp != NULL)
-    {
-        fclose((FILE*)fp);
-    }
+    delete (PrefetchingFileReader*)fp;
 }
 
 static int ReadCompressedBinaryData(void *stream, uint8_t *ptr, uint32_t bufSize)
 {
-    FILE* compressedStreamfptr = (FILE*)stream;
-    if (compressedStreamfptr != NULL && !feof(compressedStreamfptr))
+    PrefetchingFileReader* compressedStream = (PrefetchingFileReader*)stream;
+    return compressedStream != NULL ? compressedStream->Read(ptr, bufSize) : 0;
+}
+
+// Returns the format implied by the file extension, false if the extension is not known.
+static bool FormatFromExtension(const std::string& compressedFileName, AudioStreamContainerFormat& format)
+{
+    auto endsWith = [&compressedFileName](const std::string& extension)
+    {
+        return compressedFileName.size() >= extension.size()
+            && compressedFileName.compare(compressedFileName.size() - extension.size(), extension.size(), extension) == 0;
+    };
+
+    if (endsWith(".mp3"))
+    {
+        format = AudioStreamContainerFormat::MP3;
+    }
+    else if (endsWith(".opus"))
+    {
+        format = AudioStreamContainerFormat::OGG_OPUS;
+    }
+    else if (endsWith(".alaw"))
     {
-        return fread(ptr, 1, bufSize, compressedStreamfptr);
+        format = AudioStreamContainerFormat::ALAW;
+    }
+    else if (endsWith(".mulaw"))
+    {
+        format = AudioStreamContainerFormat::MULAW;
+    }
+    else if (endsWith(".flac"))
+    {
+        format = AudioStreamContainerFormat::FLAC;
     }
     else
     {
-        return 0;
+        return false;
+    }
+    return true;
+}
+
+// Picks the format from the content of the file. Only headerless G.711 is taken by its extension, content with
+// no known signature is rejected otherwise, as the service would only fail on it after the session was set up.
+// 'samplesPerSec' and 'channels' are those of a G.711 wav header, 0 if the content does not state them.
+static bool DetectFormat(const std::string& compressedFileName, PrefetchingFileReader& compressedFile, AudioStreamContainerFormat& format,
+    uint32_t& samplesPerSec, uint16_t& channels)
+{
+    AudioStreamContainerFormat extensionFormat;
+    const bool hasExtension = FormatFromExtension(compressedFileName, extensionFormat);
+
+    // The first bytes are looked at in the prefetched block, and are not consumed unless they are a wav header.
+    size_t headerSize = 0;
+    const uint8_t* header = compressedFile.Peek(512, headerSize);
+    size_t payloadOffset = 0;
+    try
+    {
+        if (!SniffContainerFormat(header, headerSize, format, payloadOffset, samplesPerSec, channels))
+        {
+            if (!hasExtension || (extensionFormat != AudioStreamContainerFormat::ALAW && extensionFormat != AudioStreamContainerFormat::MULAW))
+            {
+                std::cout << "Error: " << compressedFileName << " is not an Opus, MP3, FLAC, ALAW or MULAW file" << std::endl;
+                return false;
+            }
+            format = extensionFormat;
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << "Error: " << compressedFileName << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    if (hasExtension && extensionFormat != format)
+    {
+        std::cout << "Note: the content of " << compressedFileName << " does not match its extension, using the format of the content." << std::endl;
     }
+    compressedFile.Skip(payloadOffset);
+    return true;
+}
+
+// Decodes G.711 streams inside the process, shared by all recognitions. Other formats are decoded by the Speech SDK.
+static CompressedDecoderPool& DecoderPool()
+{
+    static CompressedDecoderPool pool(2);
+    return pool;
 }
 
-void recognizeSpeech(const std::string& compressedFileName)
+// Starts recognizing a compressed file. Returns the future of the result, or an invalid future if the file cannot be used.
+std::future<std::shared_ptr<SpeechRecognitionResult>> startRecognizeSpeech(const std::string& compressedFileName, std::shared_ptr<SpeechRecognizer>& recognizer)
 {
-    std::shared_ptr<SpeechRecognizer> recognizer;
     std::shared_ptr<PullAudioInputStream> pullAudioStream;
 
-    void *compressedFilePtr = OpenCompressedFile(compressedFileName);
+    PrefetchingFileReader* compressedFilePtr = OpenCompressedFile(compressedFileName);
 
     if (compressedFilePtr == NULL)
     {
         std::cout << "Error: Input file doesn't exist" << std::endl;
-        return;
+        return {};
+    }
+
+    AudioStreamContainerFormat inputFormat;
+    uint32_t samplesPerSec = 0;
+    uint16_t channels = 0;
+    if (!DetectFormat(compressedFileName, *compressedFilePtr, inputFormat, samplesPerSec, channels))
+    {
+        closeStream(compressedFilePtr);
+        return {};
     }
 
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-    AudioStreamContainerFormat inputFormat;
-
-    if (compressedFileName.find(".mp3") == (compressedFileName.size() - 4))
-    {
-        inputFormat = AudioStreamContainerFormat::MP3;
-    }
-    else if (compressedFileName.find(".opus") == (compressedFileName.size() - 5))
-    {
-        inputFormat = AudioStreamContainerFormat::OGG_OPUS;
-    }
-    else if (compressedFileName.find(".alaw") == (compressedFileName.size() - 5))
-    {
-        inputFormat = AudioStreamContainerFormat::ALAW;
-    }
-    else if (compressedFileName.find(".mulaw") == (compressedFileName.size() - 6))
-    {
-        inputFormat = AudioStreamContainerFormat::MULAW;
-    }
-    else if (compressedFileName.find(".flac") == (compressedFileName.size() - 5))
+    if (DecoderPool().Supports(inputFormat))
     {
-        inputFormat = AudioStreamContainerFormat::FLAC;
+        // Decodes on the shared worker pool and streams PCM to the recognizer, no decoding pipeline is created for this stream.
+        // The PCM has the sample rate and channels of the wav header, if there is one.
+        std::shared_ptr<PushAudioInputStream> pushAudioStream;
+        try
+        {
+            pushAudioStream = DecoderPool().Start(inputFormat,
+                [compressedFilePtr](uint8_t* buffer, uint32_t size) { return ReadCompressedBinaryData(compressedFilePtr, buffer, size); },
+                [compressedFilePtr]() { closeStream(compressedFilePtr); },
+                samplesPerSec, channels);
+        }
+        catch (const std::invalid_argument& e)
+        {
+            std::cout << "Error: " << compressedFileName << ": " << e.what() << std::endl;
+            closeStream(compressedFilePtr);
+            return {};
+        }
+        recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushAudioStream));
     }
     else
     {
-        std::cout << "Only Opus and MP3 input files are currently supported" << std::endl;
-        return;
+        pullAudioStream = AudioInputStream::CreatePullStream(
+            AudioStreamFormat::GetCompressedFormat(inputFormat),
+            compressedFilePtr,
+            ReadCompressedBinaryData,
+            closeStream
+        );
+        recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
     }
 
-    pullAudioStream = AudioInputStream::CreatePullStream(
-        AudioStreamFormat::GetCompressedFormat(inputFormat),
-        compressedFilePtr,
-        ReadCompressedBinaryData,
-        closeStream
-    );
-    recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
-
-    std::cout << "Recognizing ..." << std::endl;
+    std::cout << "Recognizing " << compressedFileName << " ..." << std::endl;
 
     // Starts speech recognition, and returns after a single utterance is recognized. The end of a
     // single utterance is determined by listening for silence at the end or until a maximum of 15
@@ -98,7 +185,12 @@ void recognizeSpeech(const std::string& compressedFileName)
     // Note: Since RecognizeOnceAsync() returns only a single utterance, it is suitable only for single
     // shot recognition like command or query. 
     // For long-running multi-utterance recognition, use StartContinuousRecognitionAsync() instead.
-    auto result = recognizer->RecognizeOnceAsync().get();
+    return recognizer->RecognizeOnceAsync();
+}
+
+void printResult(const std::string& compressedFileName, const std::shared_ptr<SpeechRecognitionResult>& result)
+{
+    std::cout << compressedFileName << ": ";
 
     // Checks result.
     if (result->Reason == ResultReason::RecognizedSpeech) {
@@ -120,12 +212,27 @@ void recognizeSpeech(const std::string& compressedFileName)
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2)
+    if (argc < 2)
     {
-        std::cout << "Usage: ./compressed-audio-input <filename>" << std::endl;
+        std::cout << "Usage: ./compressed-audio-input <filename> [<filename> ...]" << std::endl;
         return 0;
     }
     setlocale(LC_ALL, "");
-    recognizeSpeech(argv[1]);
+
+    // Recognizes all files at the same time.
+    std::vector<std::string> fileNames(argv + 1, argv + argc);
+    std::vector<std::shared_ptr<SpeechRecognizer>> recognizers(fileNames.size());
+    std::vector<std::future<std::shared_ptr<SpeechRecognitionResult>>> results;
+    for (size_t i = 0; i < fileNames.size(); i++)
+    {
+        results.push_back(startRecognizeSpeech(fileNames[i], recognizers[i]));
+    }
+    for (size_t i = 0; i < fileNames.size(); i++)
+    {
+        if (results[i].valid())
+        {
+            printResult(fileNames[i], results[i].get());
+        }
+    }
     return 0;
 }
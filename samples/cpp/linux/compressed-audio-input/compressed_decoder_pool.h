@@ -0,0 +1,352 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Decodes one compressed format to 16-bit PCM, with the channels interleaved. Instances keep state between calls,
+// e.g. partial frames, and are reused for another stream after Reset().
+class CompressedDecoder
+{
+public:
+    virtual ~CompressedDecoder() = default;
+    // Sets up the decoder for a stream, with the sample rate and channel count stated by its container, 0 for
+    // those the container does not state. Throws std::invalid_argument for a layout the decoder cannot decode.
+    virtual void Open(uint32_t samplesPerSec, uint16_t channels) = 0;
+    // The layout of the PCM of the stream opened.
+    virtual uint32_t SampleRate() const = 0;
+    virtual uint16_t Channels() const = 0;
+    // Decodes 'size' bytes and appends the PCM samples to 'pcm'.
+    virtual void Decode(const uint8_t* data, size_t size, std::vector<uint8_t>& pcm) = 0;
+    // Clears the state of the previous stream.
+    virtual void Reset() = 0;
+};
+
+// G.711 a-law or mu-law, expanded through a lookup table. A byte is a sample of one channel, so the PCM keeps
+// the rate and the interleaving of the stream, 8 kHz mono unless the container states otherwise.
+class G711Decoder final : public CompressedDecoder
+{
+public:
+    explicit G711Decoder(bool muLaw)
+        : m_table(muLaw ? MuLawTable() : ALawTable())
+    {
+    }
+
+    void Open(uint32_t samplesPerSec, uint16_t channels) override
+    {
+        m_samplesPerSec = samplesPerSec == 0 ? 8000 : samplesPerSec;
+        m_channels = channels == 0 ? 1 : channels;
+        if (m_samplesPerSec > 48000 || m_channels > 8)
+        {
+            throw std::invalid_argument("G.711 stream with " + std::to_string(m_samplesPerSec) + " Hz and " + std::to_string(m_channels) + " channels is not supported");
+        }
+    }
+
+    uint32_t SampleRate() const override
+    {
+        return m_samplesPerSec;
+    }
+
+    uint16_t Channels() const override
+    {
+        return m_channels;
+    }
+
+    void Decode(const uint8_t* data, size_t size, std::vector<uint8_t>& pcm) override
+    {
+        const size_t start = pcm.size();
+        pcm.resize(start + size * 2);
+        uint8_t* out = pcm.data() + start;
+        for (size_t i = 0; i < size; i++)
+        {
+            const int16_t sample = m_table[data[i]];
+            out[2 * i] = (uint8_t)(sample & 0xFF);
+            out[2 * i + 1] = (uint8_t)((sample >> 8) & 0xFF);
+        }
+    }
+
+    void Reset() override
+    {
+    }
+
+private:
+    using Table = std::array<int16_t, 256>;
+
+    static const Table& ALawTable()
+    {
+        static const Table table = []()
+        {
+            Table t;
+            for (int i = 0; i < 256; i++)
+            {
+                int value = i ^ 0x55;
+                int magnitude = (value & 0x0F) << 4;
+                const int segment = (value & 0x70) >> 4;
+                magnitude += segment == 0 ? 8 : 0x108;
+                if (segment > 1)
+                {
+                    magnitude <<= segment - 1;
+                }
+                t[i] = (int16_t)((value & 0x80) ? magnitude : -magnitude);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    static const Table& MuLawTable()
+    {
+        static const Table table = []()
+        {
+            Table t;
+            for (int i = 0; i < 256; i++)
+            {
+                int value = ~i & 0xFF;
+                int magnitude = (((value & 0x0F) << 3) + 0x84) << ((value & 0x70) >> 4);
+                t[i] = (int16_t)((value & 0x80) ? 0x84 - magnitude : magnitude - 0x84);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    const Table& m_table;
+    uint32_t m_samplesPerSec = 8000;
+    uint16_t m_channels = 1;
+};
+
+// Decodes compressed streams inside the process on a fixed pool of worker threads, and feeds the PCM to
+// push streams. Decoder instances are kept when a stream ends and reused for the next stream of the same
+// format, so starting a stream neither creates a decoder nor a thread.
+// Workers take turns between streams, decoding one chunk of a stream at a time.
+class CompressedDecoderPool final
+{
+public:
+    using Format = Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat;
+    using DecoderFactory = std::function<std::unique_ptr<CompressedDecoder>()>;
+    // Reads up to 'size' bytes of compressed audio into 'buffer', returns 0 at the end of the stream.
+    using Reader = std::function<int(uint8_t* buffer, uint32_t size)>;
+    using CompletionHandler = std::function<void()>;
+
+    // Starts 'threadCount' decoder workers. ALAW and MULAW decoders are registered.
+    explicit CompressedDecoderPool(size_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            throw std::invalid_argument("Thread count must be at least 1");
+        }
+        Register(Format::ALAW, []() { return std::unique_ptr<CompressedDecoder>(new G711Decoder(false)); });
+        Register(Format::MULAW, []() { return std::unique_ptr<CompressedDecoder>(new G711Decoder(true)); });
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_threads.emplace_back(&CompressedDecoderPool::Run, this);
+        }
+    }
+
+    ~CompressedDecoderPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+        for (auto& t : m_threads)
+        {
+            t.join();
+        }
+    }
+
+    CompressedDecoderPool(const CompressedDecoderPool&) = delete;
+    CompressedDecoderPool& operator=(const CompressedDecoderPool&) = delete;
+
+    // Adds a decoder for a format, e.g. one wrapping libopus or libFLAC.
+    void Register(Format format, DecoderFactory factory)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_formats[format].Factory = std::move(factory);
+    }
+
+    // Returns true if streams of this format can be decoded by the pool.
+    bool Supports(Format format) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_formats.count(format) != 0;
+    }
+
+    // Starts decoding a stream. Returns a push stream that receives the PCM and is closed at the end of
+    // the compressed stream, after which 'onCompleted' is called. 'samplesPerSec' and 'channels' are the layout
+    // stated by the container, e.g. the header of a G.711 wav file, 0 if it does not state it.
+    // Throws std::invalid_argument if the decoder of the format cannot decode that layout.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> Start(Format format, Reader reader, CompletionHandler onCompleted = nullptr,
+        uint32_t samplesPerSec = 0, uint16_t channels = 0)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        if (!reader)
+        {
+            throw std::invalid_argument("Reader is empty");
+        }
+        auto stream = std::make_shared<Stream>();
+        stream->ContainerFormat = format;
+        stream->Decoder = AcquireDecoder(format);
+        try
+        {
+            stream->Decoder->Open(samplesPerSec, channels);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_formats[format].Idle.push_back(std::move(stream->Decoder));
+            throw;
+        }
+        stream->Source = std::move(reader);
+        stream->OnCompleted = std::move(onCompleted);
+        stream->PushStream = AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(stream->Decoder->SampleRate(), 16, (uint8_t)stream->Decoder->Channels()));
+        auto pushStream = stream->PushStream;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(stream);
+        }
+        m_ready.notify_one();
+        return pushStream;
+    }
+
+    // Returns the number of decoders that are kept for reuse.
+    size_t IdleDecoderCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = 0;
+        for (const auto& entry : m_formats)
+        {
+            count += entry.second.Idle.size();
+        }
+        return count;
+    }
+
+private:
+    // Compressed bytes decoded per turn of a stream, 4 KB is half a second of G.711.
+    static constexpr uint32_t chunkSize = 4096;
+
+    struct FormatEntry
+    {
+        DecoderFactory Factory;
+        std::vector<std::unique_ptr<CompressedDecoder>> Idle;
+    };
+
+    struct Stream
+    {
+        Format ContainerFormat;
+        std::unique_ptr<CompressedDecoder> Decoder;
+        Reader Source;
+        CompletionHandler OnCompleted;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> PushStream;
+    };
+
+    std::unique_ptr<CompressedDecoder> AcquireDecoder(Format format)
+    {
+        DecoderFactory factory;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_formats.find(format);
+            if (it == m_formats.end())
+            {
+                throw std::invalid_argument("No decoder registered for format " + std::to_string((int)format));
+            }
+            auto& idle = it->second.Idle;
+            if (!idle.empty())
+            {
+                auto decoder = std::move(idle.back());
+                idle.pop_back();
+                return decoder;
+            }
+            factory = it->second.Factory;
+        }
+        // Creates the decoder outside of the lock, codec setup may take a while.
+        auto decoder = factory();
+        if (decoder == nullptr)
+        {
+            throw std::runtime_error("Decoder factory returned null");
+        }
+        return decoder;
+    }
+
+    void Run()
+    {
+        std::vector<uint8_t> compressed(chunkSize);
+        std::vector<uint8_t> pcm;
+        while (true)
+        {
+            std::shared_ptr<Stream> stream;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_ready.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+                if (m_stopping)
+                {
+                    return;
+                }
+                stream = m_queue.front();
+                m_queue.pop_front();
+            }
+
+            int read = 0;
+            try
+            {
+                read = stream->Source(compressed.data(), chunkSize);
+                if (read > 0)
+                {
+                    pcm.clear();
+                    stream->Decoder->Decode(compressed.data(), (size_t)read, pcm);
+                    if (!pcm.empty())
+                    {
+                        stream->PushStream->Write(pcm.data(), (uint32_t)pcm.size());
+                    }
+                }
+            }
+            catch (const std::exception&)
+            {
+                // A broken stream ends early, it must not stop the worker.
+                read = 0;
+            }
+
+            if (read > 0)
+            {
+                // Goes to the back of the queue, so that all streams make progress.
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queue.push_back(stream);
+                m_ready.notify_one();
+                continue;
+            }
+
+            stream->PushStream->Close();
+            stream->Decoder->Reset();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_formats[stream->ContainerFormat].Idle.push_back(std::move(stream->Decoder));
+            }
+            if (stream->OnCompleted)
+            {
+                stream->OnCompleted();
+            }
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::map<Format, FormatEntry> m_formats;
+    std::deque<std::shared_ptr<Stream>> m_queue;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Detects the container format of compressed audio from its first bytes, so that a file with a wrong or
+// missing extension is either recognized with the right format or rejected before a session is started.
+// Returns false if the bytes have no known signature, which is the case for headerless G.711.
+// Throws std::runtime_error for content that is recognized, but cannot be used, e.g. Ogg Vorbis.
+// 'payloadOffset' is set to the number of bytes to skip before the audio, the header of a G.711 wav file.
+// 'samplesPerSec' and 'channels' are set from the header of a G.711 wav file, and to 0 for other content.
+inline bool SniffContainerFormat(const uint8_t* data, size_t size, Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat& format, size_t& payloadOffset,
+    uint32_t& samplesPerSec, uint16_t& channels)
+{
+    using Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat;
+
+    auto startsWith = [data, size](size_t offset, const char* tag)
+    {
+        const size_t length = strlen(tag);
+        return offset + length <= size && memcmp(data + offset, tag, length) == 0;
+    };
+    auto readUInt16 = [data](size_t offset) { return (uint32_t)data[offset] | ((uint32_t)data[offset + 1] << 8); };
+    auto readUInt32 = [data, &readUInt16](size_t offset) { return readUInt16(offset) | (readUInt16(offset + 2) << 16); };
+
+    payloadOffset = 0;
+    samplesPerSec = 0;
+    channels = 0;
+
+    // An ID3v2 tag, or an MPEG audio frame header with a valid version, layer, bitrate and sample rate.
+    // ADTS AAC has the same sync word, but layer 0, and is not taken for MP3.
+    const bool mpegFrame = size >= 4 && data[0] == 0xFF && (data[1] & 0xE0) == 0xE0
+        && (data[1] & 0x18) != 0x08 && (data[1] & 0x06) != 0 && (data[2] & 0xF0) != 0xF0 && (data[2] & 0x0C) != 0x0C;
+    if (startsWith(0, "ID3") || mpegFrame)
+    {
+        format = AudioStreamContainerFormat::MP3;
+        return true;
+    }
+
+    // The first Ogg page holds the codec header, right after the page header and its segment table.
+    if (startsWith(0, "OggS"))
+    {
+        const size_t codecHeader = size > 26 ? 27 + data[26] : size;
+        if (!startsWith(codecHeader, "OpusHead"))
+        {
+            throw std::runtime_error("Ogg stream does not contain Opus audio");
+        }
+        format = AudioStreamContainerFormat::OGG_OPUS;
+        return true;
+    }
+
+    if (startsWith(0, "fLaC"))
+    {
+        format = AudioStreamContainerFormat::FLAC;
+        return true;
+    }
+
+    // Wav files are accepted if they hold G.711, the audio then starts after the data chunk header.
+    if (startsWith(0, "RIFF") && startsWith(8, "WAVE"))
+    {
+        uint32_t formatTag = 0;
+        uint32_t fmtSamplesPerSec = 0;
+        uint16_t fmtChannels = 0;
+        size_t offset = 12;
+        while (offset + 8 <= size)
+        {
+            const uint32_t chunkSize = readUInt32(offset + 4);
+            if (startsWith(offset, "fmt ") && offset + 16 <= size)
+            {
+                formatTag = readUInt16(offset + 8);
+                fmtChannels = (uint16_t)readUInt16(offset + 10);
+                fmtSamplesPerSec = readUInt32(offset + 12);
+            }
+            else if (startsWith(offset, "data"))
+            {
+                if (formatTag != 6 && formatTag != 7)
+                {
+                    throw std::runtime_error("Wav file with format tag " + std::to_string(formatTag) + " is not G.711, use AudioConfig::FromWavFileInput() for PCM");
+                }
+                if (fmtSamplesPerSec == 0 || fmtChannels == 0)
+                {
+                    throw std::runtime_error("Wav file header states no sample rate or no channels");
+                }
+                format = formatTag == 6 ? AudioStreamContainerFormat::ALAW : AudioStreamContainerFormat::MULAW;
+                payloadOffset = offset + 8;
+                samplesPerSec = fmtSamplesPerSec;
+                channels = fmtChannels;
+                return true;
+            }
+            // Chunks are padded to an even size.
+            offset += 8 + (size_t)chunkSize + (chunkSize & 1);
+        }
+        throw std::runtime_error("Wav file header is too long or broken, no data chunk found");
+    }
+
+    return false;
+}
@@ -0,0 +1,226 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Reads a file ahead of its consumer on a background thread, in large blocks, so that the small reads of
+// a pull stream callback are served from memory. On network file systems this turns every few KB read by
+// the Speech SDK into one round trip per block, and the file is read while the SDK is still busy with the
+// previous block. Up to 'blockCount' blocks are held, and the kernel is asked to read those ahead as well.
+// Peek() looks at the data in place, e.g. to detect the format of the file before any of it is consumed.
+class PrefetchingFileReader final
+{
+public:
+    explicit PrefetchingFileReader(const std::string& fileName, size_t blockSize = 1 << 20, size_t blockCount = 4)
+        : m_blockSize(blockSize), m_blockCount(blockCount)
+    {
+        if (blockSize == 0 || blockCount == 0)
+        {
+            throw std::invalid_argument("Block size and count must be at least 1");
+        }
+        m_file = open(fileName.c_str(), O_RDONLY);
+        if (m_file < 0)
+        {
+            throw std::runtime_error("Cannot open " + fileName);
+        }
+        posix_fadvise(m_file, 0, 0, POSIX_FADV_SEQUENTIAL);
+        m_thread = std::thread(&PrefetchingFileReader::Run, this);
+    }
+
+    ~PrefetchingFileReader()
+    {
+        Close();
+    }
+
+    PrefetchingFileReader(const PrefetchingFileReader&) = delete;
+    PrefetchingFileReader& operator=(const PrefetchingFileReader&) = delete;
+
+    // Returns the next bytes without consuming them, up to 'size' bytes, but no more than are left in the
+    // current block. Waits for the first block to be read. Returns nullptr at the end of the file.
+    const uint8_t* Peek(size_t size, size_t& available)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!WaitForBlock(lock))
+        {
+            available = 0;
+            return nullptr;
+        }
+        const auto& block = m_blocks.front();
+        available = std::min(size, block.size() - m_position);
+        return block.data() + m_position;
+    }
+
+    // Consumes 'size' bytes that were peeked.
+    void Skip(size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_blocks.empty() || size > m_blocks.front().size() - m_position)
+        {
+            throw std::invalid_argument("Cannot skip beyond the peeked bytes");
+        }
+        m_position += size;
+        ReleaseConsumedBlock();
+    }
+
+    // Reads up to 'size' bytes, waiting only if no prefetched data is left. Returns 0 at the end of the file,
+    // or if the file cannot be read, see Error().
+    int Read(uint8_t* buffer, uint32_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t read = 0;
+        while (read < size && (read == 0 ? WaitForBlock(lock) : !m_blocks.empty()))
+        {
+            const auto& block = m_blocks.front();
+            const size_t count = std::min<size_t>(size - read, block.size() - m_position);
+            memcpy(buffer + read, block.data() + m_position, count);
+            m_position += count;
+            read += count;
+            ReleaseConsumedBlock();
+        }
+        return (int)read;
+    }
+
+    // Returns the error that ended reading early, or an empty string.
+    std::string Error() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    // Stops prefetching and closes the file.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_file < 0)
+            {
+                return;
+            }
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+        close(m_file);
+        m_file = -1;
+    }
+
+private:
+    // Waits until a block is available or the file has been read completely. Returns false at the end.
+    bool WaitForBlock(std::unique_lock<std::mutex>& lock)
+    {
+        m_changed.wait(lock, [this]() { return !m_blocks.empty() || m_endOfFile || m_stopping; });
+        return !m_blocks.empty();
+    }
+
+    // Hands a block that has been read completely back to the prefetching thread.
+    void ReleaseConsumedBlock()
+    {
+        if (m_position < m_blocks.front().size())
+        {
+            return;
+        }
+        m_free.push_back(std::move(m_blocks.front()));
+        m_blocks.pop_front();
+        m_position = 0;
+        m_changed.notify_all();
+    }
+
+    void Run()
+    {
+        off_t offset = 0;
+        while (true)
+        {
+            std::vector<uint8_t> block;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this]() { return m_stopping || m_blocks.size() < m_blockCount; });
+                if (m_stopping)
+                {
+                    return;
+                }
+                if (!m_free.empty())
+                {
+                    block = std::move(m_free.back());
+                    m_free.pop_back();
+                }
+            }
+
+            // The blocks after this one are requested as well, so the kernel reads them while this one is consumed.
+            posix_fadvise(m_file, offset + (off_t)m_blockSize, (off_t)(m_blockSize * (m_blockCount - 1)), POSIX_FADV_WILLNEED);
+            block.resize(m_blockSize);
+            size_t filled = 0;
+            std::string error;
+            while (filled < m_blockSize)
+            {
+                const ssize_t count = read(m_file, block.data() + filled, m_blockSize - filled);
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (count < 0)
+                {
+                    error = std::string("Read failed: ") + strerror(errno);
+                }
+                if (count <= 0)
+                {
+                    break;
+                }
+                filled += (size_t)count;
+            }
+            block.resize(filled);
+            offset += (off_t)filled;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (filled > 0)
+                {
+                    m_blocks.push_back(std::move(block));
+                }
+                if (filled < m_blockSize)
+                {
+                    m_endOfFile = true;
+                    m_error = error;
+                }
+            }
+            m_changed.notify_all();
+            if (filled < m_blockSize)
+            {
+                return;
+            }
+        }
+    }
+
+    const size_t m_blockSize;
+    const size_t m_blockCount;
+    int m_file = -1;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // Blocks that have been read ahead, the first one is read from at m_position.
+    std::deque<std::vector<uint8_t>> m_blocks;
+    size_t m_position = 0;
+    // Blocks that have been consumed, kept so that their memory is reused.
+    std::vector<std::vector<uint8_t>> m_free;
+    bool m_endOfFile = false;
+    bool m_stopping = false;
+    std::string m_error;
+    std::thread m_thread;
+};
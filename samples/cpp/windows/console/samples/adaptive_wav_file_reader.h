@@ -0,0 +1,261 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Reads a wav file for a pull stream from a background thread into two buffers: while the stream's Read() drains
+// one, the other is filled. Read() waits only when both are empty, and a file read serves several of the SDK's
+// requests instead of one each. The buffer size is a whole number of audio frames, e.g. of 10 ms, and adapts to
+// the requests the SDK makes: each fill reads enough for a few of the largest recent requests, within the limits
+// of the options. Larger buffers mean fewer file reads, smaller ones less audio read ahead.
+//
+// GetStatistics() reports a histogram of the request sizes and of the fill sizes, to tune the options against the
+// number of file reads.
+class AdaptiveWavFileReader final
+{
+public:
+    struct Options
+    {
+        // The unit of the buffer size.
+        uint32_t FrameMilliseconds = 10;
+        // The smallest and the largest buffer, in frames.
+        uint32_t MinFrames = 1;
+        uint32_t MaxFrames = 10;
+        // How many requests one fill serves.
+        uint32_t RequestsPerFill = 4;
+    };
+
+    struct Statistics
+    {
+        // Request sizes of Read() and the number of requests of each size.
+        std::map<uint32_t, uint64_t> RequestSizes;
+        // Bytes read from the file per fill, and the number of fills of each size.
+        std::map<uint32_t, uint64_t> FillSizes;
+        // Times Read() found both buffers empty and waited for a fill.
+        uint64_t Waits = 0;
+
+        void Write(std::ostream& os) const
+        {
+            uint64_t requests = 0;
+            uint64_t fills = 0;
+            for (const auto& size : RequestSizes)
+            {
+                requests += size.second;
+            }
+            for (const auto& size : FillSizes)
+            {
+                fills += size.second;
+            }
+            os << "Requests: " << requests << ", file reads: " << fills << ", waits: " << Waits << "\n";
+            for (const auto& size : RequestSizes)
+            {
+                os << "  request " << size.first << " bytes: " << size.second << "\n";
+            }
+            for (const auto& size : FillSizes)
+            {
+                os << "  fill " << size.first << " bytes: " << size.second << "\n";
+            }
+        }
+    };
+
+    explicit AdaptiveWavFileReader(const std::string& audioFileName)
+        : AdaptiveWavFileReader(audioFileName, Options())
+    {
+    }
+
+    // Throws std::invalid_argument if the file cannot be opened or the options are invalid.
+    AdaptiveWavFileReader(const std::string& audioFileName, const Options& options)
+        : m_reader(audioFileName), m_options(options)
+    {
+        if (options.FrameMilliseconds == 0 || options.MinFrames == 0 || options.MaxFrames < options.MinFrames || options.RequestsPerFill == 0)
+        {
+            throw std::invalid_argument("Invalid buffer options");
+        }
+        const auto& format = m_reader.Format();
+        const uint64_t samples = std::max<uint64_t>(1, (uint64_t)format.SamplesPerSec * options.FrameMilliseconds / 1000);
+        m_frameSize = (uint32_t)(samples * std::max<uint16_t>(1, format.BlockAlign));
+        for (auto& buffer : m_buffers)
+        {
+            buffer.Data.resize((size_t)m_frameSize * options.MaxFrames);
+        }
+        m_thread = std::thread(&AdaptiveWavFileReader::Fill, this);
+    }
+
+    ~AdaptiveWavFileReader()
+    {
+        Close();
+    }
+
+    AdaptiveWavFileReader(const AdaptiveWavFileReader&) = delete;
+    AdaptiveWavFileReader& operator=(const AdaptiveWavFileReader&) = delete;
+
+    const WavFileReader::WAVEFORMAT& Format() const
+    {
+        return m_reader.Format();
+    }
+
+    // Copies up to 'size' bytes of the buffered audio, waits only if none is buffered. Returns 0 at the end of
+    // the audio or after Close().
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_closing)
+        {
+            return 0;
+        }
+        m_statistics.RequestSizes[size]++;
+        m_recentRequests[m_requests++ % recentRequestCount] = size;
+
+        Buffer* front = &m_buffers[m_front];
+        if (front->Position == front->Size)
+        {
+            if (m_buffers[1 - m_front].Size == 0 && !m_ended && !m_closing)
+            {
+                m_statistics.Waits++;
+                m_changed.wait(lock, [this]() { return m_buffers[1 - m_front].Size != 0 || m_ended || m_closing; });
+            }
+            if (m_closing || m_buffers[1 - m_front].Size == 0)
+            {
+                return 0;
+            }
+            // Hands the drained buffer to the fill thread and continues with the filled one.
+            front->Size = 0;
+            front->Position = 0;
+            m_front = 1 - m_front;
+            front = &m_buffers[m_front];
+            m_changed.notify_all();
+        }
+
+        // The fill thread does not touch the front buffer, but the copy is small enough to keep under the lock.
+        const uint32_t count = std::min(size, front->Size - front->Position);
+        memcpy(dataBuffer, front->Data.data() + front->Position, count);
+        front->Position += count;
+        return (int)count;
+    }
+
+    // Stops the fill thread and closes the file. Read() returns 0 afterwards.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closing = true;
+        }
+        m_changed.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+            m_reader.Close();
+        }
+    }
+
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    static constexpr size_t recentRequestCount = 16;
+
+    struct Buffer
+    {
+        std::vector<uint8_t> Data;
+        // Bytes filled, 0 if the buffer is free for the fill thread, and bytes already read.
+        uint32_t Size = 0;
+        uint32_t Position = 0;
+    };
+
+    // The size of the next fill: enough for a few of the largest recent requests, in whole frames.
+    uint32_t FillSize() const
+    {
+        const size_t count = (size_t)std::min<uint64_t>(m_requests, (uint64_t)recentRequestCount);
+        const uint32_t largest = count == 0 ? 0 : *std::max_element(m_recentRequests, m_recentRequests + count);
+        const uint64_t wanted = (uint64_t)largest * m_options.RequestsPerFill;
+        const uint64_t frames = (wanted + m_frameSize - 1) / m_frameSize;
+        return (uint32_t)std::min<uint64_t>(std::max<uint64_t>(frames, m_options.MinFrames), m_options.MaxFrames) * m_frameSize;
+    }
+
+    // Fills the back buffer whenever Read() has handed it back, until the end of the audio.
+    void Fill()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_changed.wait(lock, [this]() { return m_closing || m_buffers[1 - m_front].Size == 0; });
+            if (m_closing)
+            {
+                return;
+            }
+            // Read() only swaps to a filled buffer, so the back buffer stays the same while the file is read.
+            Buffer& back = m_buffers[1 - m_front];
+            const uint32_t size = FillSize();
+            lock.unlock();
+            uint32_t filled = 0;
+            // Reads until the buffer is full or the audio ends, so that a short read is one at the end.
+            while (filled < size)
+            {
+                int read = 0;
+                try
+                {
+                    read = m_reader.Read(back.Data.data() + filled, size - filled);
+                }
+                catch (const std::exception&)
+                {
+                    // Ends the stream on a read error, as WavFileReader does.
+                }
+                if (read <= 0)
+                {
+                    break;
+                }
+                filled += (uint32_t)read;
+            }
+            lock.lock();
+
+            if (filled > 0)
+            {
+                m_statistics.FillSizes[filled]++;
+                back.Size = filled;
+                back.Position = 0;
+            }
+            if (filled < size)
+            {
+                m_ended = true;
+            }
+            m_changed.notify_all();
+            if (m_ended)
+            {
+                return;
+            }
+        }
+    }
+
+    WavFileReader m_reader;
+    const Options m_options;
+    uint32_t m_frameSize = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // The buffer Read() copies from, the other one is filled.
+    Buffer m_buffers[2];
+    size_t m_front = 0;
+    bool m_ended = false;
+    bool m_closing = false;
+    uint32_t m_recentRequests[recentRequestCount] = {};
+    uint64_t m_requests = 0;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
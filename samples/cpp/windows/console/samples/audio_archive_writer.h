@@ -0,0 +1,334 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc_ring_buffer.h"
+#include "trace_recorder.h"
+#include "wav_file_reader.h"
+
+// Archives the audio of a call to a wav file while it is being recognized. The audio is copied into a lock-free
+// ring buffer on the recognizer's input path, and a writer thread writes it to disk in large blocks, so that a
+// slow disk never holds up the recognizer: Write() does not wait for the disk, and if the buffer is full the audio
+// that does not fit is counted as dropped instead of waited for. The writer thread sleeps on a condition variable
+// until a block is queued, Write() only takes the lock to wake it when it is actually waiting. The RIFF and data chunk sizes are written when the file
+// is closed, the file can be read back with WavFileReader.
+//
+// 16-bit PCM can be stored as G.711 mu-law, which halves the size of the archive at telephone quality.
+class AudioArchiveWriter final
+{
+public:
+    enum class Encoding { Pcm, MuLaw };
+
+    struct Options
+    {
+        Encoding FileEncoding = Encoding::Pcm;
+        // Bounds the audio queued between the recognizer's input and the disk.
+        size_t BufferSize = 4 * 1024 * 1024;
+        // The size of each write to the file, except the last one.
+        size_t BlockSize = 256 * 1024;
+    };
+
+    // 'format' is the format of the audio passed to Write().
+    AudioArchiveWriter(const std::string& fileName, const WavFileReader::WAVEFORMAT& format)
+        : AudioArchiveWriter(fileName, format, Options())
+    {
+    }
+
+    AudioArchiveWriter(const std::string& fileName, const WavFileReader::WAVEFORMAT& format, const Options& options)
+        : m_format(format), m_encoding(options.FileEncoding), m_blockSize(options.BlockSize), m_ring(options.BufferSize),
+          m_file(fileName, std::ios::binary | std::ios::trunc)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot open archive file " + fileName);
+        }
+        if (format.BlockAlign == 0 || format.Channels == 0)
+        {
+            throw std::invalid_argument("Audio format has no sample frames");
+        }
+        if (m_encoding == Encoding::MuLaw && format.BitsPerSample != 16)
+        {
+            throw std::invalid_argument("Only 16-bit PCM can be archived as mu-law");
+        }
+        if (options.BlockSize == 0 || options.BlockSize > m_ring.Capacity())
+        {
+            throw std::invalid_argument("Block size must be between 1 byte and the buffer size");
+        }
+        WriteHeader(0);
+        m_thread = std::thread(&AudioArchiveWriter::Run, this);
+    }
+
+    ~AudioArchiveWriter()
+    {
+        try
+        {
+            Close();
+        }
+        catch (const std::exception&)
+        {
+            // Errors are reported by an explicit Close().
+        }
+    }
+
+    AudioArchiveWriter(const AudioArchiveWriter&) = delete;
+    AudioArchiveWriter& operator=(const AudioArchiveWriter&) = delete;
+
+    // Queues audio for the file without blocking. Only one thread may call Write(), e.g. the SDK's thread that
+    // reads a pull stream, or the thread that feeds a push stream.
+    void Write(const uint8_t* data, size_t size)
+    {
+        const size_t written = m_ring.Write(data, size);
+        if (written < size)
+        {
+            m_droppedBytes.fetch_add(size - written, std::memory_order_relaxed);
+        }
+        if (m_ring.Size() >= m_blockSize)
+        {
+            NotifyWriter();
+        }
+    }
+
+    // Writes the queued audio, fixes up the chunk sizes and closes the file. Throws std::runtime_error if the
+    // file could not be written.
+    void Close()
+    {
+        if (m_thread.joinable())
+        {
+            m_closing.store(true, std::memory_order_release);
+            NotifyWriter();
+            m_thread.join();
+            WriteHeader(m_dataBytes);
+            m_file.close();
+        }
+        if (m_failed)
+        {
+            throw std::runtime_error("Cannot write to the archive file");
+        }
+    }
+
+    // Returns the audio that did not fit into the buffer, in bytes of the input format.
+    uint64_t DroppedBytes() const
+    {
+        return m_droppedBytes.load(std::memory_order_relaxed);
+    }
+
+    // Returns the largest amount of audio that was queued at once, useful to size the buffer.
+    size_t HighWaterMark() const
+    {
+        return m_ring.HighWaterMark();
+    }
+
+private:
+    static constexpr uint16_t formatPcm = 1;
+    static constexpr uint16_t formatMuLaw = 7;
+
+    // Blocks the writer thread until a block is queued or the file is closed.
+    void WaitForData()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_writerWaiting.store(true);
+        // Orders the store above before the loads of the predicate, paired with the fence in NotifyWriter(): either
+        // the writer sees the queued audio or the closing flag, or the other side sees it waiting and wakes it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_dataReady.wait(lock, [this]()
+        {
+            return m_ring.Size() >= m_blockSize || m_closing.load(std::memory_order_acquire);
+        });
+        m_writerWaiting.store(false);
+    }
+
+    // Wakes the writer thread if it is blocked in WaitForData().
+    void NotifyWriter()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_writerWaiting.load())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_dataReady.notify_one();
+        }
+    }
+
+    void Run()
+    {
+        std::vector<uint8_t> block(m_blockSize);
+        std::vector<uint8_t> encoded;
+        while (true)
+        {
+            // Reads the closing flag before the buffer size, so that all audio written before Close() is seen.
+            const bool closing = m_closing.load(std::memory_order_acquire);
+            if (m_ring.Size() < m_blockSize && !closing)
+            {
+                WaitForData();
+                continue;
+            }
+            size_t read = m_ring.Read(block.data(), block.size());
+            if (read == 0)
+            {
+                if (closing)
+                {
+                    break;
+                }
+                continue;
+            }
+            if (m_encoding == Encoding::MuLaw)
+            {
+                // A sample split between two reads is completed by the next one.
+                m_pending.insert(m_pending.end(), block.data(), block.data() + read);
+                const size_t samples = m_pending.size() / 2;
+                encoded.resize(samples);
+                for (size_t i = 0; i < samples; i++)
+                {
+                    encoded[i] = EncodeMuLaw((int16_t)(m_pending[2 * i] | (m_pending[2 * i + 1] << 8)));
+                }
+                m_pending.erase(m_pending.begin(), m_pending.begin() + samples * 2);
+                WriteData(encoded.data(), encoded.size());
+            }
+            else
+            {
+                WriteData(block.data(), read);
+            }
+        }
+        m_file.flush();
+        m_failed = m_failed || !m_file;
+    }
+
+    void WriteData(const uint8_t* data, size_t size)
+    {
+        m_file.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+        m_dataBytes += size;
+        m_failed = m_failed || !m_file;
+    }
+
+    // Writes the canonical 44-byte header, or 46 bytes for mu-law whose format chunk has a size field. Written with
+    // a data size of 0 first, and again with the final sizes when the file is closed.
+    void WriteHeader(uint64_t dataBytes)
+    {
+        const bool muLaw = m_encoding == Encoding::MuLaw;
+        const uint16_t bitsPerSample = muLaw ? 8 : m_format.BitsPerSample;
+        const uint16_t blockAlign = muLaw ? m_format.Channels : m_format.BlockAlign;
+        const uint32_t formatChunkSize = muLaw ? 18 : 16;
+        // Sizes are 32-bit, an archive of more than 4 GB keeps the largest size that fits.
+        const uint32_t dataSize = dataBytes > 0xffffffffull - 64 ? 0xffffffffu - 64 : (uint32_t)dataBytes;
+
+        std::string header;
+        header += "RIFF";
+        Append(header, (uint32_t)(4 + 8 + formatChunkSize + 8 + dataSize));
+        header += "WAVEfmt ";
+        Append(header, formatChunkSize);
+        Append(header, muLaw ? formatMuLaw : formatPcm);
+        Append(header, m_format.Channels);
+        Append(header, m_format.SamplesPerSec);
+        Append(header, (uint32_t)(m_format.SamplesPerSec * blockAlign));
+        Append(header, blockAlign);
+        Append(header, bitsPerSample);
+        if (muLaw)
+        {
+            Append(header, (uint16_t)0);
+        }
+        header += "data";
+        Append(header, dataSize);
+
+        m_file.seekp(0, std::ios::beg);
+        m_file.write(header.data(), (std::streamsize)header.size());
+        m_file.seekp(0, std::ios::end);
+        m_failed = m_failed || !m_file;
+    }
+
+    // Appends the little-endian bytes of a number. Windows targets are little-endian, so they are copied.
+    template <class T>
+    static void Append(std::string& header, T value)
+    {
+        header.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Encodes a 16-bit sample as G.711 mu-law.
+    static uint8_t EncodeMuLaw(int16_t sample)
+    {
+        const int bias = 0x84;
+        const int clip = 32635;
+        int value = sample;
+        const uint8_t sign = value < 0 ? 0x80 : 0;
+        if (value < 0)
+        {
+            value = -value;
+        }
+        if (value > clip)
+        {
+            value = clip;
+        }
+        value += bias;
+        int exponent = 7;
+        for (int mask = 0x4000; (value & mask) == 0 && exponent > 0; mask >>= 1)
+        {
+            exponent--;
+        }
+        const int mantissa = (value >> (exponent + 3)) & 0x0f;
+        return (uint8_t)~(sign | (exponent << 4) | mantissa);
+    }
+
+    const WavFileReader::WAVEFORMAT m_format;
+    const Encoding m_encoding;
+    const size_t m_blockSize;
+    SpscRingBuffer m_ring;
+    std::ofstream m_file;
+    // Owned by the writer thread until it is joined.
+    uint64_t m_dataBytes = 0;
+    std::vector<uint8_t> m_pending;
+    bool m_failed = false;
+    std::atomic<bool> m_closing{ false };
+    std::atomic<uint64_t> m_droppedBytes{ 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_dataReady;
+    std::atomic<bool> m_writerWaiting{ false };
+    std::thread m_thread;
+};
+
+// Passes the audio of a pull stream callback to the recognizer, and a copy of it to an archive.
+class ArchivingPullStreamCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    // The archive must outlive the callback, or be closed after the recognizer has finished reading.
+    ArchivingPullStreamCallback(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback> source,
+        AudioArchiveWriter& archive)
+        : m_source(std::move(source)), m_archive(archive)
+    {
+        if (m_source == nullptr)
+        {
+            throw std::invalid_argument("Source callback must be set");
+        }
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        TraceSpan span("pull", "ArchivingPullStreamCallback::Read", "size", size);
+        const int read = m_source->Read(dataBuffer, size);
+        if (read > 0)
+        {
+            m_archive.Write(dataBuffer, (size_t)read);
+        }
+        return read;
+    }
+
+    void Close() override
+    {
+        m_source->Close();
+    }
+
+private:
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback> m_source;
+    AudioArchiveWriter& m_archive;
+};
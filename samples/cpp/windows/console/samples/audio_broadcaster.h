@@ -0,0 +1,214 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Feeds the same audio to several PushAudioInputStreams, e.g. of a speech recognizer, a translation recognizer and
+// a language detector that all work on one call. The audio is read once and cut into chunks, and every chunk
+// is queued to all streams as one shared, reference-counted buffer. Each stream has its own writer thread, and a
+// chunk's buffer is reused once the last stream has written it. Write() waits while the slowest stream has
+// 'maxQueuedChunks' chunks queued, so that stream sets the pace and memory stays bounded.
+class AudioBroadcaster final
+{
+public:
+    // 'chunkSize' should be a multiple of the sample frame size, e.g. from PushStreamPump::ChunkSizeFor.
+    explicit AudioBroadcaster(uint32_t chunkSize, size_t maxQueuedChunks = 16)
+        : m_chunkSize(chunkSize), m_maxQueuedChunks(maxQueuedChunks)
+    {
+        if (chunkSize == 0 || maxQueuedChunks == 0)
+        {
+            throw std::invalid_argument("Chunk size and queue length must be at least 1");
+        }
+    }
+
+    ~AudioBroadcaster()
+    {
+        Close();
+    }
+
+    AudioBroadcaster(const AudioBroadcaster&) = delete;
+    AudioBroadcaster& operator=(const AudioBroadcaster&) = delete;
+
+    // Adds a stream that gets all audio written from now on. Streams must be added before the first Write().
+    void AddStream(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream)
+    {
+        if (pushStream == nullptr)
+        {
+            throw std::invalid_argument("Push stream is null");
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_started || m_closing)
+        {
+            throw std::runtime_error("Streams must be added before the first write");
+        }
+        auto consumer = std::unique_ptr<Consumer>(new Consumer());
+        consumer->PushStream = std::move(pushStream);
+        m_consumers.push_back(std::move(consumer));
+        m_consumers.back()->Thread = std::thread(&AudioBroadcaster::Run, this, m_consumers.back().get());
+    }
+
+    // Queues audio for all streams. Only one thread may call Write().
+    void Write(const uint8_t* data, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_started = true;
+        }
+        while (size > 0)
+        {
+            if (m_current == nullptr)
+            {
+                m_current = AcquireChunk();
+            }
+            const size_t count = std::min<size_t>(size, m_chunkSize - m_current->Size);
+            memcpy(m_current->Data.get() + m_current->Size, data, count);
+            m_current->Size += (uint32_t)count;
+            data += count;
+            size -= count;
+            if (m_current->Size == m_chunkSize)
+            {
+                Publish();
+            }
+        }
+    }
+
+    // Queues the last partial chunk, waits until all streams have written their audio, and closes them.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closing)
+            {
+                return;
+            }
+        }
+        if (m_current != nullptr && m_current->Size > 0)
+        {
+            Publish();
+        }
+        m_current = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closing = true;
+        }
+        m_changed.notify_all();
+        for (auto& consumer : m_consumers)
+        {
+            consumer->Thread.join();
+        }
+    }
+
+    // Returns the number of chunk buffers that have been allocated, a measure of the memory in use.
+    size_t AllocatedChunks() const
+    {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        return m_allocatedChunks;
+    }
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<uint8_t[]> Data;
+        uint32_t Size = 0;
+    };
+
+    struct Consumer
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> PushStream;
+        std::deque<std::shared_ptr<const Chunk>> Queue;
+        std::thread Thread;
+    };
+
+    // Returns an empty chunk, whose buffer goes back to the free list when the last reference to it is released.
+    std::shared_ptr<Chunk> AcquireChunk()
+    {
+        std::unique_ptr<uint8_t[]> data;
+        {
+            std::lock_guard<std::mutex> lock(m_poolMutex);
+            if (m_free.empty())
+            {
+                m_allocatedChunks++;
+                data.reset(new uint8_t[m_chunkSize]);
+            }
+            else
+            {
+                data = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        auto chunk = new Chunk{ std::move(data), 0 };
+        return std::shared_ptr<Chunk>(chunk, [this](Chunk* released)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_poolMutex);
+                m_free.push_back(std::move(released->Data));
+            }
+            delete released;
+        });
+    }
+
+    void Publish()
+    {
+        std::shared_ptr<const Chunk> chunk = std::move(m_current);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this]()
+            {
+                return std::all_of(m_consumers.begin(), m_consumers.end(), [this](const std::unique_ptr<Consumer>& c) { return c->Queue.size() < m_maxQueuedChunks; });
+            });
+            for (auto& consumer : m_consumers)
+            {
+                consumer->Queue.push_back(chunk);
+            }
+        }
+        m_changed.notify_all();
+    }
+
+    void Run(Consumer* consumer)
+    {
+        while (true)
+        {
+            std::shared_ptr<const Chunk> chunk;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this, consumer]() { return m_closing || !consumer->Queue.empty(); });
+                if (consumer->Queue.empty())
+                {
+                    break;
+                }
+                chunk = std::move(consumer->Queue.front());
+                consumer->Queue.pop_front();
+            }
+            m_changed.notify_all();
+            consumer->PushStream->Write(const_cast<uint8_t*>(chunk->Data.get()), chunk->Size);
+        }
+        consumer->PushStream->Close();
+    }
+
+    const uint32_t m_chunkSize;
+    const size_t m_maxQueuedChunks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<std::unique_ptr<Consumer>> m_consumers;
+    bool m_started = false;
+    bool m_closing = false;
+    // The chunk being filled by Write(), only used by the writing thread.
+    std::shared_ptr<Chunk> m_current;
+
+    mutable std::mutex m_poolMutex;
+    std::vector<std::unique_ptr<uint8_t[]>> m_free;
+    size_t m_allocatedChunks = 0;
+};
@@ -0,0 +1,225 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "session_completion.h"
+#include "subtitle_writer.h"
+#include "wav_file_reader.h"
+
+// Translates an archive of recordings, e.g. lectures, into several languages at once, with a fixed number of
+// translation recognizers running at the same time. Each file is streamed from a WavFileReader pull stream as fast
+// as the service takes it, and every translated phrase is added to a subtitle file per target language as soon as
+// it is recognized, e.g. "lecture1.de.srt" and "lecture1.fr.srt" for "lecture1.wav".
+//
+// The target languages are added to the config once, and every recognizer is created from it: recognizers copy
+// the settings of their config, so the files share one template instead of building a config each.
+class BatchTranslator final
+{
+public:
+    struct Options
+    {
+        // The number of files translated at the same time.
+        size_t Concurrency = 4;
+        // Where the subtitle files are written.
+        std::string OutputDirectory = ".";
+        SubtitleWriter::Format Format = SubtitleWriter::Format::SubRip;
+    };
+
+    struct FileResult
+    {
+        std::string File;
+        // Cues written per file and language, summed over the languages.
+        size_t Cues = 0;
+        // Empty unless the file failed.
+        std::string Error;
+    };
+
+    struct Summary
+    {
+        size_t Translated = 0;
+        size_t Failed = 0;
+        // In the order of the files.
+        std::vector<FileResult> Files;
+    };
+
+    BatchTranslator(std::shared_ptr<Microsoft::CognitiveServices::Speech::Translation::SpeechTranslationConfig> config, const std::vector<std::string>& targetLanguages)
+        : BatchTranslator(std::move(config), targetLanguages, Options())
+    {
+    }
+
+    // 'config' has the subscription and the source language, the target languages are added to it.
+    BatchTranslator(std::shared_ptr<Microsoft::CognitiveServices::Speech::Translation::SpeechTranslationConfig> config, const std::vector<std::string>& targetLanguages,
+        const Options& options)
+        : m_config(std::move(config)), m_targetLanguages(targetLanguages), m_options(options)
+    {
+        if (m_config == nullptr)
+        {
+            throw std::invalid_argument("Config is null");
+        }
+        if (targetLanguages.empty())
+        {
+            throw std::invalid_argument("At least one target language is needed");
+        }
+        if (options.Concurrency == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1");
+        }
+        for (const auto& language : targetLanguages)
+        {
+            m_config->AddTargetLanguage(language);
+        }
+    }
+
+    BatchTranslator(const BatchTranslator&) = delete;
+    BatchTranslator& operator=(const BatchTranslator&) = delete;
+
+    // Returns the subtitle file of a recording in a target language.
+    std::string SubtitleFileName(const std::string& fileName, const std::string& language) const
+    {
+        const size_t slash = fileName.find_last_of("/\\");
+        std::string base = slash == std::string::npos ? fileName : fileName.substr(slash + 1);
+        const size_t dot = base.find_last_of('.');
+        if (dot != std::string::npos && dot > 0)
+        {
+            base.resize(dot);
+        }
+        return m_options.OutputDirectory + "/" + base + "." + language + SubtitleWriter::Extension(m_options.Format);
+    }
+
+    // Translates all files and returns when they are done.
+    Summary Run(const std::vector<std::string>& fileNames)
+    {
+        Summary summary;
+        summary.Files.resize(fileNames.size());
+        std::atomic<size_t> next{ 0 };
+        auto work = [&]()
+        {
+            for (size_t index = next++; index < fileNames.size(); index = next++)
+            {
+                // Each worker writes only the results of its own files.
+                summary.Files[index] = Translate(fileNames[index]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min(m_options.Concurrency, fileNames.size()); i++)
+        {
+            workers.emplace_back(work);
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        for (const auto& file : summary.Files)
+        {
+            (file.Error.empty() ? summary.Translated : summary.Failed)++;
+        }
+        return summary;
+    }
+
+private:
+    class FileCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        explicit FileCallback(std::shared_ptr<WavFileReader> reader)
+            : m_reader(std::move(reader))
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader->Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader->Close();
+        }
+
+    private:
+        std::shared_ptr<WavFileReader> m_reader;
+    };
+
+    FileResult Translate(const std::string& fileName)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Translation;
+
+        FileResult result;
+        result.File = fileName;
+        try
+        {
+            auto reader = std::make_shared<WavFileReader>(fileName);
+            const auto& format = reader->Format();
+            auto pullStream = AudioInputStream::CreatePullStream(
+                AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), std::make_shared<FileCallback>(reader));
+
+            // Declared before the recognizer, so that they outlive its event handlers.
+            std::map<std::string, std::unique_ptr<SubtitleWriter>> writers;
+            for (const auto& language : m_targetLanguages)
+            {
+                writers[language].reset(new SubtitleWriter(SubtitleFileName(fileName, language), m_options.Format));
+            }
+            std::string writeError;
+
+            auto recognizer = TranslationRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(pullStream));
+            auto end = SessionCompletion::Track(*recognizer);
+            // The events of one recognizer are raised one at a time, so the writers do not lock.
+            recognizer->Recognized.Connect([&writers, &writeError, end](const TranslationRecognitionEventArgs& e)
+            {
+                if (e.Result->Reason != ResultReason::TranslatedSpeech || !writeError.empty())
+                {
+                    return;
+                }
+                try
+                {
+                    for (const auto& translation : e.Result->Translations)
+                    {
+                        auto writer = writers.find(translation.first);
+                        if (writer != writers.end())
+                        {
+                            writer->second->Add(e.Result->Offset(), e.Result->Duration(), translation.second);
+                        }
+                    }
+                }
+                catch (const std::exception& error)
+                {
+                    // Ends the session, there is no use translating what cannot be written.
+                    writeError = error.what();
+                    end.Complete();
+                }
+            });
+
+            recognizer->StartContinuousRecognitionAsync().get();
+            auto outcome = end.Wait();
+            recognizer->StopContinuousRecognitionAsync().get();
+            for (const auto& writer : writers)
+            {
+                result.Cues += writer.second->Cues();
+            }
+            result.Error = outcome.Canceled ? (outcome.ErrorDetails.empty() ? "Translation was canceled" : outcome.ErrorDetails) : writeError;
+        }
+        catch (const std::exception& e)
+        {
+            result.Error = e.what();
+        }
+        return result;
+    }
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::Translation::SpeechTranslationConfig> m_config;
+    const std::vector<std::string> m_targetLanguages;
+    const Options m_options;
+};
@@ -0,0 +1,591 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "latency_stats.h"
+#include "load_runner.h"
+#include "paced_wav_file_reader.h"
+#include "push_stream_pump.h"
+#include "session_completion.h"
+#include "wav_file_reader.h"
+
+using namespace std;
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+using namespace Microsoft::CognitiveServices::Speech::Translation;
+
+namespace
+{
+    // Timestamps of one recognition run, in milliseconds since recognition was started.
+    struct RunTimings
+    {
+        double SessionStarted = -1;
+        double FirstRecognizing = -1;
+        vector<double> Recognized;
+        double SessionStopped = -1;
+        double WallTime = 0;
+        double AudioSeconds = 0;
+        string Error;
+    };
+
+    // Latencies of all runs with the same audio file and input kind.
+    struct BenchmarkCase
+    {
+        string AudioFileName;
+        string Input;
+        LatencyStats SessionStarted;
+        LatencyStats FirstRecognizing;
+        LatencyStats Recognized;
+        LatencyStats SessionStopped;
+        LatencyStats RealTimeFactor;
+        int Failures = 0;
+    };
+
+    class PullStreamFromFile final : public PullAudioInputStreamCallback
+    {
+    public:
+        PullStreamFromFile(const string& audioFileName, double speed)
+            : m_reader(audioFileName, speed)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader.Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+    private:
+        PacedWavFileReader m_reader;
+    };
+
+    double MillisecondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Recognizes the file once with the given input kind and records the event timestamps.
+    // "file", "pull" and "push" feed the audio as fast as possible, "pull-realtime" paces it like live audio.
+    RunTimings RunOnce(shared_ptr<SpeechConfig> config, const string& audioFileName, const string& input)
+    {
+        RunTimings timings;
+        shared_ptr<AudioConfig> audioConfig;
+        shared_ptr<PushAudioInputStream> pushStream;
+        {
+            WavFileReader reader(audioFileName);
+            timings.AudioSeconds = reader.DurationTicks() / 10000000.0;
+            const auto& format = reader.Format();
+            if (input == "file")
+            {
+                audioConfig = AudioConfig::FromWavFileInput(audioFileName);
+            }
+            else if (input == "pull" || input == "pull-realtime")
+            {
+                auto pullStream = AudioInputStream::CreatePullStream(
+                    AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels),
+                    make_shared<PullStreamFromFile>(audioFileName, input == "pull" ? 0 : 1));
+                audioConfig = AudioConfig::FromStreamInput(pullStream);
+            }
+            else
+            {
+                pushStream = AudioInputStream::CreatePushStream(
+                    AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels));
+                audioConfig = AudioConfig::FromStreamInput(pushStream);
+            }
+        }
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioConfig);
+
+        // Event handlers run on SDK threads, the mutex guards the timings until the run has ended.
+        mutex timingsMutex;
+        promise<void> recognitionEnd;
+        once_flag endOnce;
+        auto signalEnd = [&]() { call_once(endOnce, [&]() { recognitionEnd.set_value(); }); };
+        chrono::steady_clock::time_point start;
+
+        recognizer->SessionStarted.Connect([&](const SessionEventArgs&)
+        {
+            lock_guard<mutex> lock(timingsMutex);
+            timings.SessionStarted = MillisecondsSince(start);
+        });
+        recognizer->Recognizing.Connect([&](const SpeechRecognitionEventArgs&)
+        {
+            lock_guard<mutex> lock(timingsMutex);
+            if (timings.FirstRecognizing < 0)
+            {
+                timings.FirstRecognizing = MillisecondsSince(start);
+            }
+        });
+        recognizer->Recognized.Connect([&](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                lock_guard<mutex> lock(timingsMutex);
+                timings.Recognized.push_back(MillisecondsSince(start));
+            }
+        });
+        recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                lock_guard<mutex> lock(timingsMutex);
+                timings.Error = e.ErrorDetails;
+                signalEnd();
+            }
+        });
+        recognizer->SessionStopped.Connect([&](const SessionEventArgs&)
+        {
+            {
+                lock_guard<mutex> lock(timingsMutex);
+                timings.SessionStopped = MillisecondsSince(start);
+            }
+            signalEnd();
+        });
+
+        start = chrono::steady_clock::now();
+        recognizer->StartContinuousRecognitionAsync().get();
+        if (pushStream != nullptr)
+        {
+            // Pushes the whole file as fast as the stream accepts it, in 100 ms chunks.
+            WavFileReader reader(audioFileName);
+            const auto& format = reader.Format();
+            PushStreamPump pump(pushStream, PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100),
+                PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 1000));
+            vector<uint8_t> buffer(pump.Capacity() / 4);
+            int read;
+            while ((read = reader.Read(buffer.data(), (uint32_t)buffer.size())) > 0)
+            {
+                pump.Write(buffer.data(), (size_t)read);
+            }
+            pump.Close();
+        }
+        recognitionEnd.get_future().get();
+        timings.WallTime = MillisecondsSince(start);
+        recognizer->StopContinuousRecognitionAsync().get();
+
+        lock_guard<mutex> lock(timingsMutex);
+        return timings;
+    }
+
+    void WriteStats(ostream& os, const char* name, LatencyStats& stats)
+    {
+        os << ",\"" << name << "\":";
+        stats.WriteJson(os);
+    }
+
+    // Replaces inputs of the form "@file" by the lines of the file, so that long input lists can be kept in a file.
+    vector<string> ExpandInputs(const vector<string>& inputs)
+    {
+        vector<string> expanded;
+        for (const auto& input : inputs)
+        {
+            if (input.empty() || input[0] != '@')
+            {
+                expanded.push_back(input);
+                continue;
+            }
+            ifstream file(input.substr(1));
+            if (!file)
+            {
+                throw runtime_error("Cannot open input list " + input.substr(1));
+            }
+            string line;
+            while (getline(file, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.pop_back();
+                }
+                if (!line.empty())
+                {
+                    expanded.push_back(line);
+                }
+            }
+        }
+        return expanded;
+    }
+
+    // Records the latency the service reports in a result property, if it is set.
+    void RecordProperty(LoadRunner::Iteration& iteration, const string& name, const string& value)
+    {
+        if (!value.empty())
+        {
+            iteration.Record(name, stod(value));
+        }
+    }
+
+    [[noreturn]] void ThrowCanceled(CancellationErrorCode errorCode, const string& errorDetails)
+    {
+        // Throttling is reported separately, it is the first sign that a region is at its limit.
+        throw LoadTestFailure(errorCode == CancellationErrorCode::TooManyRequests ? LoadTestFailure::Kind::Throttled : LoadTestFailure::Kind::Canceled,
+            "CANCELED: " + (errorDetails.empty() ? string("no details") : errorDetails));
+    }
+
+    void ThrowIfCanceled(shared_ptr<RecognitionResult> result)
+    {
+        if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            ThrowCanceled(cancellation->ErrorCode, cancellation->ErrorDetails);
+        }
+        if (result->Reason == ResultReason::NoMatch)
+        {
+            throw runtime_error("NOMATCH: Speech could not be recognized.");
+        }
+    }
+
+    // Recognizes a whole stream with continuous recognition. 'feed' is called once recognition has started, to
+    // push the audio, and returns when it has pushed all of it.
+    void RecognizeContinuously(shared_ptr<SpeechConfig> config, shared_ptr<AudioConfig> audioConfig, LoadRunner::Iteration& iteration,
+        const function<void()>& feed = nullptr)
+    {
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioConfig);
+        auto completion = SessionCompletion::Track(*recognizer);
+        auto firstRecognized = make_shared<once_flag>();
+        recognizer->Recognized.Connect([&iteration, firstRecognized](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                call_once(*firstRecognized, [&iteration]() { iteration.Mark("firstRecognizedMs"); });
+            }
+        });
+        recognizer->StartContinuousRecognitionAsync().get();
+        if (feed != nullptr)
+        {
+            feed();
+        }
+        auto outcome = completion.Wait();
+        recognizer->StopContinuousRecognitionAsync().get();
+        if (outcome.Canceled)
+        {
+            ThrowCanceled(outcome.ErrorCode, outcome.ErrorDetails);
+        }
+    }
+
+    // Creates the scenarios of the load test, by name. Each iteration uses the next input, across all workers.
+    LoadRunner::ScenarioFactory CreateLoadScenario(const string& scenario, const vector<string>& inputs)
+    {
+        // Creates an instance of a speech config with specified subscription key and service region.
+        // Replace with your own subscription key and service region (e.g., "westus").
+        // The config is only read when a recognizer or synthesizer is created, so the workers share it.
+        const string key = "YourSubscriptionKey";
+        const string region = "YourServiceRegion";
+
+        if (scenario == "recognize-once")
+        {
+            // As SpeechRecognitionWithLanguageAndUsingDetailedOutputFormat, with the audio read from the inputs.
+            auto config = SpeechConfig::FromSubscription(key, region);
+            return [config, inputs](size_t) -> LoadRunner::Scenario
+            {
+                return [config, inputs](LoadRunner::Iteration& iteration)
+                {
+                    auto audioConfig = AudioConfig::FromWavFileInput(inputs[iteration.Number() % inputs.size()]);
+                    auto recognizer = SpeechRecognizer::FromConfig(config, audioConfig);
+                    auto result = recognizer->RecognizeOnceAsync().get();
+                    ThrowIfCanceled(result);
+                    RecordProperty(iteration, "serviceLatencyMs", result->Properties.GetProperty(PropertyId::SpeechServiceResponse_RecognitionLatencyMs));
+                };
+            };
+        }
+        if (scenario == "recognize-continuous")
+        {
+            // As SpeechContinuousRecognitionWithFile, each iteration recognizes a whole file as fast as possible.
+            auto config = SpeechConfig::FromSubscription(key, region);
+            return [config, inputs](size_t) -> LoadRunner::Scenario
+            {
+                return [config, inputs](LoadRunner::Iteration& iteration)
+                {
+                    RecognizeContinuously(config, AudioConfig::FromWavFileInput(inputs[iteration.Number() % inputs.size()]), iteration);
+                };
+            };
+        }
+        if (scenario == "recognize-realtime" || scenario == "recognize-realtime-push")
+        {
+            // As SpeechContinuousRecognitionWithPullStream and SpeechContinuousRecognitionWithPushStream, with the
+            // file read at real-time pace, so that each session holds a connection as long as a live caller would.
+            // "afterAudioMs" is the time from the end of the audio to the end of the session.
+            auto config = SpeechConfig::FromSubscription(key, region);
+            const bool push = scenario == "recognize-realtime-push";
+            return [config, inputs, push](size_t) -> LoadRunner::Scenario
+            {
+                return [config, inputs, push](LoadRunner::Iteration& iteration)
+                {
+                    const auto& audioFileName = inputs[iteration.Number() % inputs.size()];
+                    WavFileReader::WAVEFORMAT format;
+                    double audioMilliseconds;
+                    {
+                        WavFileReader reader(audioFileName);
+                        format = reader.Format();
+                        audioMilliseconds = reader.DurationTicks() / 10000.0;
+                    }
+                    auto streamFormat = AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels);
+                    if (!push)
+                    {
+                        auto pullStream = AudioInputStream::CreatePullStream(streamFormat, make_shared<PullStreamFromFile>(audioFileName, 1));
+                        RecognizeContinuously(config, AudioConfig::FromStreamInput(pullStream), iteration);
+                    }
+                    else
+                    {
+                        auto pushStream = AudioInputStream::CreatePushStream(streamFormat);
+                        RecognizeContinuously(config, AudioConfig::FromStreamInput(pushStream), iteration, [&]()
+                        {
+                            // Pushes 100 ms at a time, each once it would have been captured.
+                            PacedWavFileReader reader(audioFileName, 1);
+                            vector<uint8_t> buffer(PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100));
+                            int read;
+                            while ((read = reader.Read(buffer.data(), (uint32_t)buffer.size())) > 0)
+                            {
+                                pushStream->Write(buffer.data(), (uint32_t)read);
+                            }
+                            pushStream->Close();
+                        });
+                    }
+                    iteration.Record("afterAudioMs", iteration.ElapsedMilliseconds() - audioMilliseconds);
+                };
+            };
+        }
+        if (scenario == "translate")
+        {
+            // As TranslationContinuousRecognition, translates one utterance of the input from en-US to German.
+            auto config = SpeechTranslationConfig::FromSubscription(key, region);
+            config->SetSpeechRecognitionLanguage("en-US");
+            config->AddTargetLanguage("de");
+            return [config, inputs](size_t) -> LoadRunner::Scenario
+            {
+                return [config, inputs](LoadRunner::Iteration& iteration)
+                {
+                    auto audioConfig = AudioConfig::FromWavFileInput(inputs[iteration.Number() % inputs.size()]);
+                    auto recognizer = TranslationRecognizer::FromConfig(config, audioConfig);
+                    auto result = recognizer->RecognizeOnceAsync().get();
+                    ThrowIfCanceled(result);
+                };
+            };
+        }
+        if (scenario == "synthesize")
+        {
+            // As SpeechSynthesisToResult, the inputs are the texts to synthesize. Each worker keeps its synthesizer,
+            // and with it the connection, across its iterations.
+            auto config = SpeechConfig::FromSubscription(key, region);
+            return [config, inputs](size_t) -> LoadRunner::Scenario
+            {
+                shared_ptr<SpeechSynthesizer> synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+                return [synthesizer, inputs](LoadRunner::Iteration& iteration)
+                {
+                    auto result = synthesizer->SpeakTextAsync(inputs[iteration.Number() % inputs.size()]).get();
+                    if (result->Reason == ResultReason::Canceled)
+                    {
+                        auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+                        ThrowCanceled(cancellation->ErrorCode, cancellation->ErrorDetails);
+                    }
+                    RecordProperty(iteration, "firstByteMs", result->Properties.GetProperty(PropertyId::SpeechServiceResponse_SynthesisFirstByteLatencyMs));
+                    RecordProperty(iteration, "finishMs", result->Properties.GetProperty(PropertyId::SpeechServiceResponse_SynthesisFinishLatencyMs));
+                };
+            };
+        }
+        throw invalid_argument("Unknown scenario " + scenario
+            + ", use recognize-once, recognize-continuous, recognize-realtime, recognize-realtime-push, translate or synthesize");
+    }
+}
+
+// Replays the sample files through file, pull stream and push stream input, and through a pull stream paced
+// to real time. Reports the latency from the start of recognition to SessionStarted, the first Recognizing,
+// each Recognized and SessionStopped, as well as the real-time factor (wall time / audio duration), as json.
+// Runs without user interaction, so that results can be compared between builds.
+void SpeechRecognitionBenchmark(int iterations, const string& outputFileName)
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    const vector<string> audioFileNames{ "whatstheweatherlike.wav", "katiesteve.wav", "en-us_zh-cn.wav" };
+    const vector<string> inputs{ "file", "pull", "push", "pull-realtime" };
+
+    vector<BenchmarkCase> cases;
+    for (const auto& audioFileName : audioFileNames)
+    {
+        for (const auto& input : inputs)
+        {
+            BenchmarkCase benchmarkCase;
+            benchmarkCase.AudioFileName = audioFileName;
+            benchmarkCase.Input = input;
+            for (int i = 0; i < iterations; i++)
+            {
+                RunTimings timings = RunOnce(config, audioFileName, input);
+                if (!timings.Error.empty())
+                {
+                    cerr << audioFileName << " (" << input << "): CANCELED: " << timings.Error << std::endl;
+                    benchmarkCase.Failures++;
+                    continue;
+                }
+                if (timings.SessionStarted >= 0)
+                {
+                    benchmarkCase.SessionStarted.Add(timings.SessionStarted);
+                }
+                if (timings.FirstRecognizing >= 0)
+                {
+                    benchmarkCase.FirstRecognizing.Add(timings.FirstRecognizing);
+                }
+                for (double recognized : timings.Recognized)
+                {
+                    benchmarkCase.Recognized.Add(recognized);
+                }
+                benchmarkCase.SessionStopped.Add(timings.SessionStopped);
+                if (timings.AudioSeconds > 0)
+                {
+                    benchmarkCase.RealTimeFactor.Add(timings.WallTime / 1000 / timings.AudioSeconds);
+                }
+            }
+            cerr << audioFileName << " (" << input << "): " << iterations - benchmarkCase.Failures << " of " << iterations << " runs completed." << std::endl;
+            cases.push_back(move(benchmarkCase));
+        }
+    }
+
+    ofstream outputFile;
+    if (!outputFileName.empty())
+    {
+        outputFile.open(outputFileName);
+        if (!outputFile)
+        {
+            throw runtime_error("Cannot open benchmark output file " + outputFileName);
+        }
+    }
+    ostream& os = outputFileName.empty() ? cout : outputFile;
+
+    os << "{\"iterations\":" << iterations << ",\"cases\":[";
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        auto& c = cases[i];
+        os << (i == 0 ? "" : ",")
+           << "{\"audioFile\":\"" << c.AudioFileName << "\",\"input\":\"" << c.Input << "\",\"failures\":" << c.Failures;
+        WriteStats(os, "sessionStartedMs", c.SessionStarted);
+        WriteStats(os, "firstRecognizingMs", c.FirstRecognizing);
+        WriteStats(os, "recognizedMs", c.Recognized);
+        WriteStats(os, "sessionStoppedMs", c.SessionStopped);
+        WriteStats(os, "realTimeFactor", c.RealTimeFactor);
+        os << "}";
+    }
+    os << "]}" << std::endl;
+}
+
+// Runs a sample flow repeatedly for a fixed time, without user interaction, and reports the throughput and latency
+// as json. Meant as a load generator: the scenario, its inputs and the load are all given on the command line,
+// see main.cpp for the options. By default a number of workers each run one session at a time; with a rate,
+// sessions are started at that rate regardless of completions, which shows how latency, cancellations and
+// throttling develop under a constant load. Audio scenarios take wav files as inputs, the synthesis scenario takes
+// texts. The sample files, or a sample sentence, are used if no inputs are given.
+void SpeechLoadTest(const vector<string>& args)
+{
+    if (args.empty() || args[0].compare(0, 2, "--") == 0)
+    {
+        throw invalid_argument("A scenario must be given after --load");
+    }
+    const string scenario = args[0];
+    vector<string> inputs;
+    string outputFileName;
+    LoadRunner::Options options;
+    for (size_t i = 1; i < args.size(); i += 2)
+    {
+        if (i + 1 >= args.size())
+        {
+            throw invalid_argument("Missing value for " + args[i]);
+        }
+        const string& option = args[i];
+        const string& value = args[i + 1];
+        if (option == "--input")
+        {
+            inputs.push_back(value);
+        }
+        else if (option == "--concurrency")
+        {
+            options.Concurrency = (size_t)max(0, stoi(value));
+        }
+        else if (option == "--duration")
+        {
+            options.Duration = chrono::seconds(stoi(value));
+        }
+        else if (option == "--iterations")
+        {
+            options.MaxIterations = (uint64_t)max(0, stoi(value));
+        }
+        else if (option == "--rate")
+        {
+            options.ArrivalRate = stod(value);
+        }
+        else if (option == "--arrivals")
+        {
+            if (value != "poisson" && value != "fixed")
+            {
+                throw invalid_argument("Arrivals must be poisson or fixed");
+            }
+            options.ArrivalProcess = value == "fixed" ? LoadRunner::Arrivals::Fixed : LoadRunner::Arrivals::Poisson;
+        }
+        else if (option == "--max-in-flight")
+        {
+            options.MaxInFlight = (size_t)max(0, stoi(value));
+        }
+        else if (option == "--output")
+        {
+            outputFileName = value;
+        }
+        else
+        {
+            throw invalid_argument("Unknown option " + option);
+        }
+    }
+
+    auto expandedInputs = ExpandInputs(inputs);
+    if (expandedInputs.empty())
+    {
+        expandedInputs = scenario == "synthesize"
+            ? vector<string>{ "Hello, this is a test of the speech synthesis service." }
+            : vector<string>{ "whatstheweatherlike.wav", "katiesteve.wav", "en-us_zh-cn.wav" };
+    }
+    LoadRunner runner(options);
+    auto factory = CreateLoadScenario(scenario, expandedInputs);
+
+    ofstream outputFile;
+    if (!outputFileName.empty())
+    {
+        outputFile.open(outputFileName);
+        if (!outputFile)
+        {
+            throw runtime_error("Cannot open load test output file " + outputFileName);
+        }
+    }
+    ostream& os = outputFileName.empty() ? cout : outputFile;
+
+    if (options.ArrivalRate > 0)
+    {
+        cerr << "Running " << scenario << " at " << options.ArrivalRate << " sessions per second for " << options.Duration.count() << " s." << std::endl;
+    }
+    else
+    {
+        cerr << "Running " << scenario << " with " << options.Concurrency << " workers for " << options.Duration.count() << " s." << std::endl;
+    }
+    auto report = runner.Run(factory, cerr);
+    cerr << report.Iterations << " iterations, " << report.Failures << " failed, " << report.Throttled << " throttled, "
+         << report.Dropped << " dropped, " << report.Throughput << " per second, p50 " << report.Histogram.Percentile(50)
+         << " ms, p99 " << report.Histogram.Percentile(99) << " ms." << std::endl;
+
+    os << "{\"scenario\":\"" << scenario << "\",\"concurrency\":" << options.Concurrency << ",\"arrivalRate\":" << options.ArrivalRate
+       << ",\"arrivals\":\"" << (options.ArrivalProcess == LoadRunner::Arrivals::Fixed ? "fixed" : "poisson")
+       << "\",\"durationSeconds\":" << options.Duration.count() << ",\"report\":";
+    report.WriteJson(os);
+    os << "}" << std::endl;
+}
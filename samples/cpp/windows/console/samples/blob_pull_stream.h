@@ -0,0 +1,348 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "wav_file_reader.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <winhttp.h>
+#pragma comment(lib, "winhttp.lib")
+#endif
+
+// Reads byte ranges of a file on an HTTP server with ranged GETs, e.g. of a blob through its SAS url. The requests
+// share one WinHTTP connection handle, so that they reuse the keep-alive connections to the host, and may be sent
+// from several threads at once.
+class HttpRangeReader final
+{
+public:
+    struct Range
+    {
+        std::vector<uint8_t> Data;
+        // The size of the whole file, taken from the Content-Range header.
+        uint64_t TotalSize = 0;
+    };
+
+    // True if the reader is implemented on this platform, it uses WinHTTP on Windows. Elsewhere pass your own
+    // range fetcher to BlobPullStreamCallback, e.g. one built on libcurl.
+    static bool IsAvailable()
+    {
+#ifdef _WIN32
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Throws std::invalid_argument if 'url' is not an http or https url.
+    explicit HttpRangeReader(const std::string& url)
+    {
+#ifdef _WIN32
+        // Urls are ASCII, with everything else percent-encoded.
+        const std::wstring wideUrl(url.begin(), url.end());
+        URL_COMPONENTS components = {};
+        components.dwStructSize = sizeof(components);
+        components.dwHostNameLength = (DWORD)-1;
+        components.dwUrlPathLength = (DWORD)-1;
+        components.dwExtraInfoLength = (DWORD)-1;
+        if (!WinHttpCrackUrl(wideUrl.c_str(), 0, 0, &components))
+        {
+            throw std::invalid_argument("Invalid url " + url);
+        }
+        const std::wstring host(components.lpszHostName, components.dwHostNameLength);
+        m_path.assign(components.lpszUrlPath, components.dwUrlPathLength);
+        m_path.append(components.lpszExtraInfo, components.dwExtraInfoLength);
+        m_secure = components.nScheme == INTERNET_SCHEME_HTTPS;
+
+        m_session.reset(WinHttpOpen(L"SpeechSDKSamples/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0));
+        m_connection.reset(m_session ? WinHttpConnect(m_session.get(), host.c_str(), components.nPort, 0) : nullptr);
+        if (!m_connection)
+        {
+            throw std::runtime_error("Cannot connect to " + url + ", error " + std::to_string(GetLastError()));
+        }
+#else
+        (void)url;
+        throw std::runtime_error("HttpRangeReader is not available on this platform");
+#endif
+    }
+
+    // Returns the 'size' bytes at 'offset', fewer at the end of the file, none past it. Throws std::runtime_error
+    // if the request fails or the server does not support ranges.
+    Range Read(uint64_t offset, uint32_t size) const
+    {
+        Range range;
+#ifdef _WIN32
+        Handle request(WinHttpOpenRequest(m_connection.get(), L"GET", m_path.c_str(), nullptr, WINHTTP_NO_REFERER,
+            WINHTTP_DEFAULT_ACCEPT_TYPES, m_secure ? WINHTTP_FLAG_SECURE : 0));
+        if (!request)
+        {
+            throw std::runtime_error("Cannot create the range request, error " + std::to_string(GetLastError()));
+        }
+        const std::wstring headers = L"Range: bytes=" + std::to_wstring(offset) + L"-" + std::to_wstring(offset + size - 1) + L"\r\n";
+        if (!WinHttpSendRequest(request.get(), headers.c_str(), (DWORD)-1L, WINHTTP_NO_REQUEST_DATA, 0, 0, 0)
+            || !WinHttpReceiveResponse(request.get(), nullptr))
+        {
+            throw std::runtime_error("Range request failed, error " + std::to_string(GetLastError()));
+        }
+
+        DWORD status = 0;
+        DWORD statusSize = sizeof(status);
+        WinHttpQueryHeaders(request.get(), WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+            &status, &statusSize, WINHTTP_NO_HEADER_INDEX);
+        if (status == 416)
+        {
+            // Range Not Satisfiable, the offset is at or past the end of the file.
+            return range;
+        }
+        if (status != 206)
+        {
+            throw std::runtime_error(status == 200
+                ? "The server does not support range requests"
+                : "Range request returned http code " + std::to_string(status));
+        }
+
+        // Content-Range: bytes <first>-<last>/<total>
+        wchar_t contentRange[128] = {};
+        DWORD contentRangeSize = sizeof(contentRange);
+        if (WinHttpQueryHeaders(request.get(), WINHTTP_QUERY_CUSTOM, L"Content-Range", contentRange, &contentRangeSize, WINHTTP_NO_HEADER_INDEX))
+        {
+            const wchar_t* total = wcschr(contentRange, L'/');
+            range.TotalSize = total != nullptr ? _wcstoui64(total + 1, nullptr, 10) : 0;
+        }
+
+        range.Data.reserve(size);
+        DWORD available = 0;
+        while (WinHttpQueryDataAvailable(request.get(), &available) && available > 0)
+        {
+            const size_t start = range.Data.size();
+            range.Data.resize(start + available);
+            DWORD read = 0;
+            if (!WinHttpReadData(request.get(), range.Data.data() + start, available, &read))
+            {
+                throw std::runtime_error("Cannot read the range, error " + std::to_string(GetLastError()));
+            }
+            range.Data.resize(start + read);
+        }
+#else
+        (void)offset;
+        (void)size;
+#endif
+        return range;
+    }
+
+private:
+#ifdef _WIN32
+    struct HandleCloser
+    {
+        void operator()(HINTERNET handle) const
+        {
+            WinHttpCloseHandle(handle);
+        }
+    };
+    using Handle = std::unique_ptr<void, HandleCloser>;
+
+    Handle m_session;
+    Handle m_connection;
+    std::wstring m_path;
+    bool m_secure = true;
+#endif
+};
+
+// Streams the audio of a wav file on an HTTP server, e.g. of a blob, to a recognizer without downloading it first.
+// The header is parsed from the first range as WavFileReader does, and the audio is read in ranges, of which a few
+// are requested ahead in parallel, so that the recognizer rarely waits for the network. Recognition starts as soon
+// as the first range has arrived, and no temporary file is written.
+class BlobPullStreamCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    // Returns the bytes at 'offset', as HttpRangeReader::Read() does. It is called from several threads at once.
+    using RangeFetcher = std::function<HttpRangeReader::Range(uint64_t offset, uint32_t size)>;
+
+    struct Options
+    {
+        // The size of each ranged GET.
+        uint32_t RangeSize = 64 * 1024;
+        // The number of ranges requested ahead of the one being read.
+        size_t Prefetch = 4;
+    };
+
+    // Reads the blob at 'url' with an HttpRangeReader.
+    explicit BlobPullStreamCallback(const std::string& url)
+        : BlobPullStreamCallback(ReaderFetcher(std::make_shared<HttpRangeReader>(url)), Options())
+    {
+    }
+
+    // Reads the header, throws std::runtime_error if it cannot be read or is not a wav header.
+    BlobPullStreamCallback(RangeFetcher fetcher, const Options& options)
+        : m_fetcher(std::move(fetcher)), m_options(options)
+    {
+        if (!m_fetcher)
+        {
+            throw std::invalid_argument("Range fetcher must be set");
+        }
+        if (options.RangeSize == 0)
+        {
+            throw std::invalid_argument("Range size must not be 0");
+        }
+
+        // The header is usually within the first range, a long metadata chunk before the audio needs more.
+        uint32_t dataChunkSize = 0;
+        size_t dataOffset = 0;
+        while (true)
+        {
+            auto range = m_fetcher(m_fetched, options.RangeSize);
+            m_fetched += range.Data.size();
+            m_totalSize = range.TotalSize;
+            m_current.insert(m_current.end(), range.Data.begin(), range.Data.end());
+            dataOffset = WavFileReader::ParseHeader(m_current.data(), m_current.size(), m_format, dataChunkSize);
+            if (dataOffset != 0)
+            {
+                break;
+            }
+            if (range.Data.empty() || m_current.size() >= maxHeaderSize)
+            {
+                throw std::runtime_error("Did not find the data chunk of the wav file");
+            }
+        }
+
+        // The chunk size is clamped to the file size, as it is for truncated files or streamed writers.
+        const uint64_t available = m_totalSize > dataOffset ? m_totalSize - dataOffset : 0;
+        m_remaining = m_totalSize == 0 || dataChunkSize < available ? dataChunkSize : available;
+        m_position = dataOffset;
+        for (size_t i = 0; i < options.Prefetch; i++)
+        {
+            RequestNext();
+        }
+    }
+
+    // The format of the audio, to create the stream with.
+    const WavFileReader::WAVEFORMAT& Format() const
+    {
+        return m_format;
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        uint32_t copied = 0;
+        try
+        {
+            while (copied < size && m_remaining > 0)
+            {
+                if (m_position == m_current.size())
+                {
+                    if (!NextRange())
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                const uint64_t count = std::min<uint64_t>({ size - copied, m_current.size() - m_position, m_remaining });
+                memcpy(dataBuffer + copied, m_current.data() + m_position, (size_t)count);
+                copied += (uint32_t)count;
+                m_position += (size_t)count;
+                m_remaining -= count;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            // Ends the stream, the recognizer sees the end of the audio. The error is kept for Error().
+            std::lock_guard<std::mutex> lock(m_errorMutex);
+            m_error = e.what();
+            m_remaining = 0;
+        }
+        // returns the number of bytes that have been read, 0 indicates that the stream reaches end.
+        return (int)copied;
+    }
+
+    void Close() override
+    {
+        m_remaining = 0;
+    }
+
+    // Returns why the stream ended early, or an empty string.
+    std::string Error() const
+    {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        return m_error;
+    }
+
+private:
+    // Bounds the bytes read while looking for the data chunk.
+    static constexpr size_t maxHeaderSize = 1024 * 1024;
+
+    static RangeFetcher ReaderFetcher(std::shared_ptr<HttpRangeReader> reader)
+    {
+        return [reader](uint64_t offset, uint32_t size)
+        {
+            return reader->Read(offset, size);
+        };
+    }
+
+    void RequestNext()
+    {
+        if (m_totalSize != 0 && m_requested + m_fetched >= m_totalSize)
+        {
+            return;
+        }
+        const uint64_t offset = m_fetched + m_requested;
+        m_requested += m_options.RangeSize;
+        m_pending.push_back(std::async(std::launch::async, m_fetcher, offset, m_options.RangeSize));
+    }
+
+    // Moves on to the oldest prefetched range and requests another one. Returns false at the end of the file.
+    bool NextRange()
+    {
+        if (m_pending.empty())
+        {
+            RequestNext();
+            if (m_pending.empty())
+            {
+                return false;
+            }
+        }
+        auto range = m_pending.front().get();
+        m_pending.pop_front();
+        m_fetched += m_options.RangeSize;
+        m_requested -= m_options.RangeSize;
+        if (range.Data.empty())
+        {
+            return false;
+        }
+        m_current = std::move(range.Data);
+        m_position = 0;
+        RequestNext();
+        return true;
+    }
+
+    const RangeFetcher m_fetcher;
+    const Options m_options;
+    WavFileReader::WAVEFORMAT m_format = {};
+    uint64_t m_totalSize = 0;
+    // The offset of the first byte after the current range, and the bytes of the ranges requested after it.
+    uint64_t m_fetched = 0;
+    uint64_t m_requested = 0;
+    std::deque<std::future<HttpRangeReader::Range>> m_pending;
+    std::vector<uint8_t> m_current;
+    size_t m_position = 0;
+    // The audio bytes left in the data chunk.
+    uint64_t m_remaining = 0;
+    mutable std::mutex m_errorMutex;
+    std::string m_error;
+};
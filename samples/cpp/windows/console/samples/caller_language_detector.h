@@ -0,0 +1,279 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "json_reader.h"
+#include "session_completion.h"
+#include "wav_file_reader.h"
+
+// The languages detected for callers, by caller id, e.g. the calling number. Entries expire after the time to live,
+// and the least recently used entry is dropped when the cache is full.
+class CallerLanguageCache final
+{
+public:
+    struct Options
+    {
+        std::chrono::seconds TimeToLive = std::chrono::hours(24 * 30);
+        size_t Capacity = 100000;
+    };
+
+    CallerLanguageCache()
+        : CallerLanguageCache(Options())
+    {
+    }
+
+    explicit CallerLanguageCache(const Options& options)
+        : m_options(options)
+    {
+        if (options.Capacity == 0)
+        {
+            throw std::invalid_argument("Cache capacity must be at least 1");
+        }
+    }
+
+    CallerLanguageCache(const CallerLanguageCache&) = delete;
+    CallerLanguageCache& operator=(const CallerLanguageCache&) = delete;
+
+    // Returns true, and sets 'language', if the caller's language is cached and has not expired.
+    bool TryGet(const std::string& callerId, std::string& language, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(callerId);
+        if (it == m_entries.end() || it->second->Expires <= now)
+        {
+            if (it != m_entries.end())
+            {
+                m_lru.erase(it->second);
+                m_entries.erase(it);
+            }
+            m_misses++;
+            return false;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        language = it->second->Language;
+        m_hits++;
+        return true;
+    }
+
+    void Put(const std::string& callerId, const std::string& language, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(callerId);
+        if (it != m_entries.end())
+        {
+            m_lru.erase(it->second);
+            m_entries.erase(it);
+        }
+        m_lru.push_front(Entry{ callerId, language, now + m_options.TimeToLive });
+        m_entries[callerId] = m_lru.begin();
+        if (m_entries.size() > m_options.Capacity)
+        {
+            m_entries.erase(m_lru.back().CallerId);
+            m_lru.pop_back();
+        }
+    }
+
+    uint64_t Hits() const
+    {
+        return m_hits;
+    }
+
+    uint64_t Misses() const
+    {
+        return m_misses;
+    }
+
+private:
+    struct Entry
+    {
+        std::string CallerId;
+        std::string Language;
+        std::chrono::steady_clock::time_point Expires;
+    };
+
+    const Options m_options;
+    std::mutex m_mutex;
+    // Most recently used first.
+    std::list<Entry> m_lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+};
+
+// Detects the language of a caller with standalone language detection, and stops as soon as the service is
+// confident. The audio is streamed through a pull stream that ends when a result reaches the confidence
+// threshold, so the rest of the call is never uploaded. Detected languages are cached by caller id, a repeat
+// caller gets the cached language without any audio being sent.
+class CallerLanguageDetector final
+{
+public:
+    // The confidence the service reports with the detected language, in increasing order.
+    enum class Confidence { Unknown, Low, Medium, High };
+
+    struct Detection
+    {
+        // Empty if no language could be detected.
+        std::string Language;
+        Confidence DetectedWith = Confidence::Unknown;
+        bool FromCache = false;
+        // The audio that was sent to the service.
+        uint64_t BytesSent = 0;
+        // Empty unless the detection was canceled with an error.
+        std::string Error;
+    };
+
+    // Reads up to 'size' bytes of the caller's audio, returns 0 at the end of the call.
+    using AudioReader = std::function<int(uint8_t* dataBuffer, uint32_t size)>;
+
+    // 'config' should set SpeechServiceConnection_ContinuousLanguageIdPriority to "Latency", so that results come early.
+    // The cache must outlive the detector.
+    CallerLanguageDetector(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::AutoDetectSourceLanguageConfig> languages,
+        CallerLanguageCache& cache, Confidence threshold = Confidence::High)
+        : m_config(std::move(config)), m_languages(std::move(languages)), m_cache(cache), m_threshold(threshold)
+    {
+        if (m_config == nullptr || m_languages == nullptr)
+        {
+            throw std::invalid_argument("Speech config and languages must be set");
+        }
+    }
+
+    // Detects the language of a call, 'format' is the format of the audio returned by 'read'. Returns the cached
+    // language of the caller if there is one, without reading any audio. Only confident detections are cached, a
+    // call that ends before the threshold is reached returns the most confident language it got.
+    Detection Detect(const std::string& callerId, const AudioReader& read, const WavFileReader::WAVEFORMAT& format)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        Detection detection;
+        if (m_cache.TryGet(callerId, detection.Language))
+        {
+            detection.FromCache = true;
+            return detection;
+        }
+
+        // Guards the detection, declared before the recognizer so that it outlives the recognizer's handlers.
+        std::mutex mutex;
+        auto gate = std::make_shared<GatedAudioInput>(read);
+        auto stream = AudioInputStream::CreatePullStream(
+            AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), gate);
+        auto recognizer = SourceLanguageRecognizer::FromConfig(m_config, m_languages, AudioConfig::FromStreamInput(stream));
+        auto completion = SessionCompletion::Track(*recognizer);
+
+        const Confidence threshold = m_threshold;
+        recognizer->Recognized.Connect([&detection, &mutex, gate, threshold](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason != ResultReason::RecognizedSpeech)
+            {
+                return;
+            }
+            const auto language = AutoDetectSourceLanguageResult::FromResult(e.Result)->Language;
+            const auto confidence = ParseConfidence(e.Result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult));
+            std::lock_guard<std::mutex> lock(mutex);
+            if (detection.Language.empty() || confidence > detection.DetectedWith)
+            {
+                detection.Language = language;
+                detection.DetectedWith = confidence;
+            }
+            if (confidence >= threshold)
+            {
+                // Ends the stream, the session stops once the SDK has read the end.
+                gate->Close();
+            }
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        auto outcome = completion.Wait();
+        recognizer->StopContinuousRecognitionAsync().get();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        detection.BytesSent = gate->BytesRead();
+        if (outcome.Canceled)
+        {
+            detection.Error = outcome.ErrorDetails;
+        }
+        if (!detection.Language.empty() && detection.DetectedWith >= m_threshold)
+        {
+            m_cache.Put(callerId, detection.Language);
+        }
+        return detection;
+    }
+
+    // Returns the confidence of the primary language in the json result of a detection.
+    static Confidence ParseConfidence(const std::string& json)
+    {
+        if (json.empty())
+        {
+            return Confidence::Unknown;
+        }
+        try
+        {
+            const auto root = JsonValue::Parse(json);
+            const auto& confidence = root["PrimaryLanguage"]["Confidence"].AsString();
+            return confidence == "High" ? Confidence::High : confidence == "Medium" ? Confidence::Medium
+                : confidence == "Low" ? Confidence::Low : Confidence::Unknown;
+        }
+        catch (const std::runtime_error&)
+        {
+            return Confidence::Unknown;
+        }
+    }
+
+private:
+    // Passes the caller's audio to the SDK until it is closed, then returns the end of the stream.
+    class GatedAudioInput final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        explicit GatedAudioInput(AudioReader read)
+            : m_read(std::move(read))
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            if (m_closed)
+            {
+                return 0;
+            }
+            int count = m_read(dataBuffer, size);
+            if (count > 0)
+            {
+                m_bytesRead += count;
+            }
+            return count;
+        }
+
+        void Close() override
+        {
+            m_closed = true;
+        }
+
+        uint64_t BytesRead() const
+        {
+            return m_bytesRead;
+        }
+
+    private:
+        const AudioReader m_read;
+        std::atomic<bool> m_closed{ false };
+        std::atomic<uint64_t> m_bytesRead{ 0 };
+    };
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::AutoDetectSourceLanguageConfig> m_languages;
+    CallerLanguageCache& m_cache;
+    const Confidence m_threshold;
+};
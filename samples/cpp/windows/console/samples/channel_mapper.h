@@ -0,0 +1,212 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "wav_file_reader.h"
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define CHANNEL_MAPPER_SSSE3
+#endif
+
+// Rearranges the channels of interleaved 16-bit PCM, e.g. to turn the capture of a microphone array into the
+// channel layout conversation transcription expects. Each output channel is a channel of the input, silence,
+// or the average of all input channels.
+//
+// Mapping 8 channels to 8 channels without averaging, the layout of conversation audio, moves a whole sample
+// frame with one byte shuffle when the compiler targets SSSE3 or AVX.
+class ChannelMapper final
+{
+public:
+    enum : int
+    {
+        Silence = -1,
+        Mix = -2
+    };
+
+    // 'map' holds the source of each output channel: an input channel index, Silence or Mix.
+    ChannelMapper(uint16_t inputChannels, std::vector<int> map)
+        : m_inputChannels(inputChannels), m_map(std::move(map))
+    {
+        if (inputChannels == 0 || m_map.empty())
+        {
+            throw std::invalid_argument("Input and output must have at least one channel");
+        }
+        for (int source : m_map)
+        {
+            if (source >= (int)inputChannels || (source < 0 && source != Silence && source != Mix))
+            {
+                throw std::invalid_argument("Channel map refers to channel " + std::to_string(source) + " of " + std::to_string(inputChannels));
+            }
+            m_mixes = m_mixes || source == Mix;
+        }
+#ifdef CHANNEL_MAPPER_SSSE3
+        m_shuffle = inputChannels == 8 && m_map.size() == 8 && !m_mixes;
+        for (size_t i = 0; i < 8 && m_shuffle; i++)
+        {
+            // A byte index with the high bit set makes the shuffle write 0.
+            m_shuffleMask[2 * i] = (char)(m_map[i] == Silence ? 0x80 : 2 * m_map[i]);
+            m_shuffleMask[2 * i + 1] = (char)(m_map[i] == Silence ? 0x80 : 2 * m_map[i] + 1);
+        }
+#endif
+    }
+
+    // Parses a comma-separated channel map, e.g. "0,1,2,3,4,5,6,7", "7,6,5,4,3,2,1,0" or "m,0,1,s",
+    // where "s" is silence and "m" the mix of all input channels.
+    static std::vector<int> Parse(const std::string& text)
+    {
+        std::vector<int> map;
+        std::istringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            if (item == "s")
+            {
+                map.push_back(Silence);
+            }
+            else if (item == "m")
+            {
+                map.push_back(Mix);
+            }
+            else if (!item.empty() && item.find_first_not_of("0123456789") == std::string::npos)
+            {
+                map.push_back(std::stoi(item));
+            }
+            else
+            {
+                throw std::invalid_argument("Invalid channel '" + item + "' in channel map " + text);
+            }
+        }
+        return map;
+    }
+
+    uint16_t InputChannels() const
+    {
+        return m_inputChannels;
+    }
+
+    uint16_t OutputChannels() const
+    {
+        return (uint16_t)m_map.size();
+    }
+
+    // Maps 'frames' sample frames from 'input' to 'output', which must not overlap.
+    void Process(const int16_t* input, int16_t* output, size_t frames) const
+    {
+        size_t frame = 0;
+#ifdef CHANNEL_MAPPER_SSSE3
+        if (m_shuffle)
+        {
+            const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_shuffleMask));
+            for (; frame < frames; frame++)
+            {
+                const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + frame * 8));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + frame * 8), _mm_shuffle_epi8(samples, mask));
+            }
+            return;
+        }
+#endif
+        const size_t outputChannels = m_map.size();
+        for (; frame < frames; frame++)
+        {
+            const int16_t* in = input + frame * m_inputChannels;
+            int16_t* out = output + frame * outputChannels;
+            int32_t mix = 0;
+            if (m_mixes)
+            {
+                for (size_t c = 0; c < m_inputChannels; c++)
+                {
+                    mix += in[c];
+                }
+                mix /= (int32_t)m_inputChannels;
+            }
+            for (size_t c = 0; c < outputChannels; c++)
+            {
+                const int source = m_map[c];
+                out[c] = source >= 0 ? in[source] : source == Mix ? (int16_t)mix : 0;
+            }
+        }
+    }
+
+private:
+    const uint16_t m_inputChannels;
+    const std::vector<int> m_map;
+    bool m_mixes = false;
+#ifdef CHANNEL_MAPPER_SSSE3
+    bool m_shuffle = false;
+    char m_shuffleMask[16] = {};
+#endif
+};
+
+// Pull stream callback that reads a 16-bit PCM wav file and delivers it with the channel layout of a channel map,
+// so that a raw capture can be streamed as is, without writing a converted copy of it first.
+class ChannelMappedWavCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    ChannelMappedWavCallback(const std::string& fileName, const std::vector<int>& map)
+        : m_reader(fileName), m_mapper(ValidFormat(m_reader.Format()).Channels, map)
+    {
+    }
+
+    // Returns the format of the mapped audio, for AudioStreamFormat::GetWaveFormatPCM.
+    WavFileReader::WAVEFORMAT Format() const
+    {
+        auto format = m_reader.Format();
+        format.Channels = m_mapper.OutputChannels();
+        format.BlockAlign = (uint16_t)(format.Channels * 2);
+        format.AvgBytesPerSec = format.SamplesPerSec * format.BlockAlign;
+        return format;
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        const size_t inputFrameSize = m_mapper.InputChannels() * sizeof(int16_t);
+        const size_t outputFrameSize = m_mapper.OutputChannels() * sizeof(int16_t);
+        const size_t frames = size / outputFrameSize;
+        m_input.resize(frames * m_mapper.InputChannels());
+
+        // Reads whole input frames, a frame cut short by the end of the file is dropped.
+        uint8_t* input = reinterpret_cast<uint8_t*>(m_input.data());
+        size_t read = 0;
+        int count = 0;
+        while (read < frames * inputFrameSize && (count = m_reader.Read(input + read, (uint32_t)(frames * inputFrameSize - read))) > 0)
+        {
+            read += (size_t)count;
+        }
+        const size_t framesRead = read / inputFrameSize;
+        m_output.resize(framesRead * m_mapper.OutputChannels());
+        m_mapper.Process(m_input.data(), m_output.data(), framesRead);
+        memcpy(dataBuffer, m_output.data(), framesRead * outputFrameSize);
+        return (int)(framesRead * outputFrameSize);
+    }
+
+    void Close() override
+    {
+        m_reader.Close();
+    }
+
+private:
+    static const WavFileReader::WAVEFORMAT& ValidFormat(const WavFileReader::WAVEFORMAT& format)
+    {
+        // WAVE_FORMAT_PCM and WAVE_FORMAT_EXTENSIBLE.
+        if ((format.FormatTag != 1 && format.FormatTag != 0xFFFE) || format.BitsPerSample != 16)
+        {
+            throw std::invalid_argument("Only 16-bit PCM wav files can be channel mapped");
+        }
+        return format;
+    }
+
+    WavFileReader m_reader;
+    ChannelMapper m_mapper;
+    // Buffers of the last read, kept so that reading does not allocate once they have grown.
+    std::vector<int16_t> m_input;
+    std::vector<int16_t> m_output;
+};
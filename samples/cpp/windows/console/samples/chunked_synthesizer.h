@@ -0,0 +1,359 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <cctype>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One part of a document that is synthesized on its own. SSML chunks repeat the open tags of the document at
+// their start, 'PrefixLength' characters, and close them at their end.
+struct SynthesisChunk
+{
+    std::string Text;
+    size_t DocumentOffset;
+    size_t PrefixLength;
+};
+
+// Returns true if the document is SSML rather than plain text.
+inline bool IsSsml(const std::string& document)
+{
+    size_t start = 0;
+    while (start < document.size() && std::isspace((unsigned char)document[start]))
+    {
+        start++;
+    }
+    return document.compare(start, 6, "<speak") == 0;
+}
+
+// Splits text or SSML (if it starts with "<speak") into chunks at the ends of sentences, and, for SSML, also
+// after <break/> elements. The first chunk is cut after 'firstChunkChars' characters, so that its audio is
+// back soon, the others after 'chunkChars'. Sentences are never split.
+// SSML is only cut where all open elements hold whole sentences (speak, voice, prosody, lang, p, s and
+// mstts:express-as), each chunk then reopens and closes those elements, so voice and prosody carry over.
+inline std::vector<SynthesisChunk> SplitIntoChunks(const std::string& document, size_t firstChunkChars = 150, size_t chunkChars = 800)
+{
+    const bool ssml = IsSsml(document);
+
+    struct OpenElement
+    {
+        std::string Name;
+        std::string Tag;
+    };
+    auto nameOf = [](const std::string& tag)
+    {
+        size_t begin = tag[1] == '/' ? 2 : 1;
+        size_t end = begin;
+        while (end < tag.size() && !std::isspace((unsigned char)tag[end]) && tag[end] != '/' && tag[end] != '>')
+        {
+            end++;
+        }
+        return tag.substr(begin, end - begin);
+    };
+    auto splittable = [](const std::vector<OpenElement>& open)
+    {
+        for (const auto& element : open)
+        {
+            const std::string& n = element.Name;
+            if (n != "speak" && n != "voice" && n != "prosody" && n != "lang" && n != "p" && n != "s" && n != "mstts:express-as")
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    // Returns the end of the tag that starts at 'position', skipping '>' in quoted attribute values.
+    auto tagEnd = [&document](size_t position)
+    {
+        char quote = 0;
+        for (size_t i = position + 1; i < document.size(); i++)
+        {
+            const char c = document[i];
+            if (quote != 0)
+            {
+                quote = c == quote ? 0 : quote;
+            }
+            else if (c == '"' || c == '\'')
+            {
+                quote = c;
+            }
+            else if (c == '>')
+            {
+                return i + 1;
+            }
+        }
+        return document.size();
+    };
+
+    // Only cuts that leave some text for the next chunk are taken, so that no chunk is made of tags only.
+    size_t lastText = 0;
+    for (size_t i = 0; i < document.size();)
+    {
+        if (ssml && document[i] == '<')
+        {
+            i = tagEnd(i);
+            continue;
+        }
+        if (!std::isspace((unsigned char)document[i]))
+        {
+            lastText = i;
+        }
+        i++;
+    }
+
+    std::vector<SynthesisChunk> chunks;
+    std::vector<OpenElement> open;
+    std::string prefix;
+    size_t chunkStart = 0;
+    bool chunkHasText = false;
+    auto cut = [&](size_t position)
+    {
+        if (!chunkHasText || position > lastText || position - chunkStart < (chunks.empty() ? firstChunkChars : chunkChars) || !splittable(open))
+        {
+            return;
+        }
+        chunkHasText = false;
+        std::string suffix;
+        std::string nextPrefix;
+        for (auto it = open.rbegin(); it != open.rend(); ++it)
+        {
+            suffix += "</" + it->Name + ">";
+        }
+        for (const auto& element : open)
+        {
+            nextPrefix += element.Tag;
+        }
+        chunks.push_back(SynthesisChunk{ prefix + document.substr(chunkStart, position - chunkStart) + suffix, chunkStart, prefix.size() });
+        prefix = nextPrefix;
+        chunkStart = position;
+    };
+
+    for (size_t i = 0; i < document.size();)
+    {
+        const char c = document[i];
+        if (ssml && c == '<')
+        {
+            const size_t end = tagEnd(i);
+            const std::string tag = document.substr(i, end - i);
+            i = end;
+            if (tag.compare(0, 2, "<!") == 0 || tag.compare(0, 2, "<?") == 0)
+            {
+                continue;
+            }
+            const std::string name = nameOf(tag);
+            if (tag[1] == '/')
+            {
+                if (!open.empty() && open.back().Name == name)
+                {
+                    open.pop_back();
+                }
+            }
+            else if (tag.size() >= 2 && tag[tag.size() - 2] == '/')
+            {
+                if (name == "break")
+                {
+                    cut(i);
+                }
+            }
+            else
+            {
+                open.push_back(OpenElement{ name, tag });
+            }
+            continue;
+        }
+        i++;
+        chunkHasText = chunkHasText || !std::isspace((unsigned char)c);
+        // The end of a sentence is a '.', '!' or '?' followed by white space or a tag, the white space stays in the chunk.
+        // A <break/> right after it stays in the chunk as well, the chunk is then cut after the break.
+        if ((c == '.' || c == '!' || c == '?') && i < document.size() && (std::isspace((unsigned char)document[i]) || (ssml && document[i] == '<')))
+        {
+            while (i < document.size() && std::isspace((unsigned char)document[i]))
+            {
+                i++;
+            }
+            if (!ssml || document.compare(i, 6, "<break") != 0)
+            {
+                cut(i);
+            }
+        }
+    }
+    chunks.push_back(SynthesisChunk{ prefix + document.substr(chunkStart), chunkStart, prefix.size() });
+    return chunks;
+}
+
+// Synthesizes long text or SSML chunk by chunk, see SplitIntoChunks(). The request for the next chunk is sent
+// as soon as the audio of a chunk is back, so the service works on it while the sink plays the previous one,
+// and the first audio only waits for the first chunk. The audio of all chunks forms one stream, which is why
+// the output format must be raw PCM, e.g. Raw24Khz16BitMonoPcm. Word boundary, viseme and bookmark events are
+// reported with offsets in the whole document: audio offsets from the start of the first chunk, text offsets
+// into the document that was passed in.
+class ChunkedSynthesizer final
+{
+public:
+    struct WordBoundary
+    {
+        uint64_t AudioOffset;
+        uint32_t TextOffset;
+        uint32_t WordLength;
+        std::string Text;
+    };
+
+    struct Viseme
+    {
+        uint64_t AudioOffset;
+        uint32_t VisemeId;
+        std::string Animation;
+    };
+
+    struct Bookmark
+    {
+        uint64_t AudioOffset;
+        std::string Text;
+    };
+
+    // Handlers are called on SDK threads. Leave a handler empty to ignore the event.
+    struct Handlers
+    {
+        std::function<void(const uint8_t* data, uint32_t size)> Audio;
+        std::function<void(const WordBoundary&)> OnWordBoundary;
+        std::function<void(const Viseme&)> OnViseme;
+        std::function<void(const Bookmark&)> OnBookmark;
+    };
+
+    ChunkedSynthesizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer, size_t firstChunkChars = 150, size_t chunkChars = 800)
+        : m_synthesizer(std::move(synthesizer)), m_firstChunkChars(firstChunkChars), m_chunkChars(chunkChars)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (m_synthesizer == nullptr)
+        {
+            throw std::invalid_argument("Synthesizer is null");
+        }
+        // Format names are like "raw-24khz-16bit-mono-pcm".
+        const std::string format = m_synthesizer->Properties.GetProperty(PropertyId::SpeechServiceConnection_SynthOutputFormat);
+        unsigned int kiloHertz = 0;
+        unsigned int bits = 0;
+        if (sscanf(format.c_str(), "raw-%ukhz-%ubit-mono-pcm", &kiloHertz, &bits) != 2 || kiloHertz == 0 || bits % 8 != 0)
+        {
+            throw std::invalid_argument("Chunked synthesis needs a raw mono PCM output format, e.g. Raw24Khz16BitMonoPcm");
+        }
+        m_bytesPerSecond = (uint64_t)kiloHertz * 1000 * (bits / 8);
+
+        // Requests of a synthesizer run one after the other, so events belong to the chunk after the ones completed so far.
+        m_synthesizer->SynthesisCompleted.Connect([this](const SpeechSynthesisEventArgs& e)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completedBytes += e.Result->GetAudioLength();
+            m_completedChunks++;
+        });
+        m_synthesizer->WordBoundary.Connect([this](const SpeechSynthesisWordBoundaryEventArgs& e)
+        {
+            uint64_t audioBase;
+            const SynthesisChunk* chunk = CurrentChunk(audioBase);
+            if (chunk != nullptr && m_handlers.OnWordBoundary)
+            {
+                const size_t textOffset = e.TextOffset >= chunk->PrefixLength ? e.TextOffset - chunk->PrefixLength : 0;
+                m_handlers.OnWordBoundary(WordBoundary{ audioBase + e.AudioOffset, (uint32_t)(chunk->DocumentOffset + textOffset), e.WordLength, e.Text });
+            }
+        });
+        m_synthesizer->VisemeReceived.Connect([this](const SpeechSynthesisVisemeEventArgs& e)
+        {
+            uint64_t audioBase;
+            if (CurrentChunk(audioBase) != nullptr && m_handlers.OnViseme)
+            {
+                m_handlers.OnViseme(Viseme{ audioBase + e.AudioOffset, e.VisemeId, e.Animation });
+            }
+        });
+        m_synthesizer->BookmarkReached.Connect([this](const SpeechSynthesisBookmarkEventArgs& e)
+        {
+            uint64_t audioBase;
+            if (CurrentChunk(audioBase) != nullptr && m_handlers.OnBookmark)
+            {
+                m_handlers.OnBookmark(Bookmark{ audioBase + e.AudioOffset, e.Text });
+            }
+        });
+    }
+
+    ChunkedSynthesizer(const ChunkedSynthesizer&) = delete;
+    ChunkedSynthesizer& operator=(const ChunkedSynthesizer&) = delete;
+
+    // Synthesizes the document and returns the number of chunks, after all audio was passed to the handler.
+    // Throws std::runtime_error if a chunk is canceled.
+    size_t Speak(const std::string& document, const Handlers& handlers)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_chunks = SplitIntoChunks(document, m_firstChunkChars, m_chunkChars);
+            m_ssml = IsSsml(document);
+            m_completedBytes = 0;
+            m_completedChunks = 0;
+            m_handlers = handlers;
+        }
+
+        auto next = Start(0);
+        for (size_t i = 0; i < m_chunks.size(); i++)
+        {
+            auto result = next.get();
+            if (i + 1 < m_chunks.size())
+            {
+                next = Start(i + 1);
+            }
+            if (result->Reason != ResultReason::SynthesizingAudioCompleted)
+            {
+                if (next.valid())
+                {
+                    next.wait();
+                }
+                throw std::runtime_error("Synthesis of chunk " + std::to_string(i + 1) + " canceled: " + SpeechSynthesisCancellationDetails::FromResult(result)->ErrorDetails);
+            }
+            if (handlers.Audio)
+            {
+                auto audio = result->GetAudioData();
+                handlers.Audio(audio->data(), (uint32_t)audio->size());
+            }
+        }
+        return m_chunks.size();
+    }
+
+private:
+    std::future<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesisResult>> Start(size_t index)
+    {
+        const std::string& text = m_chunks[index].Text;
+        return m_ssml ? m_synthesizer->SpeakSsmlAsync(text) : m_synthesizer->SpeakTextAsync(text);
+    }
+
+    // Returns the chunk that events are raised for, and the audio offset of its start in ticks.
+    const SynthesisChunk* CurrentChunk(uint64_t& audioBase)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_completedChunks >= m_chunks.size())
+        {
+            return nullptr;
+        }
+        audioBase = m_completedBytes * 10000000 / m_bytesPerSecond;
+        return &m_chunks[m_completedChunks];
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> m_synthesizer;
+    const size_t m_firstChunkChars;
+    const size_t m_chunkChars;
+    uint64_t m_bytesPerSecond;
+
+    std::mutex m_mutex;
+    std::vector<SynthesisChunk> m_chunks;
+    bool m_ssml = false;
+    uint64_t m_completedBytes = 0;
+    size_t m_completedChunks = 0;
+    Handlers m_handlers;
+};
@@ -0,0 +1,235 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+// Keeps one recognizer and its service connection open across the commands of a voice command loop. Each command
+// is a single RecognizeOnceAsync, which would otherwise connect, recognize and disconnect. A background thread
+// checks the connection between commands, and reopens it when the service or the network has dropped it, so that
+// reconnecting stays off the path of the next command. Reconnect attempts back off while they keep failing.
+//
+// Works with any recognizer that has RecognizeOnceAsync(), e.g. SpeechRecognizer or IntentRecognizer. Commands
+// must be recognized one at a time, as with the recognizer itself.
+template <class Recognizer>
+class CommandSession final
+{
+public:
+    using Result = typename decltype(std::declval<Recognizer&>().RecognizeOnceAsync().get())::element_type;
+
+    struct Options
+    {
+        // How often the connection is checked between commands.
+        std::chrono::milliseconds HealthCheckInterval = std::chrono::seconds(5);
+        // The first delay before a failed reconnect is retried, doubled on each failure up to the maximum. A reconnect
+        // has failed when the connection is not up one health check interval after opening it.
+        std::chrono::milliseconds ReconnectDelay = std::chrono::milliseconds(500);
+        std::chrono::milliseconds MaxReconnectDelay = std::chrono::seconds(30);
+    };
+
+    explicit CommandSession(std::shared_ptr<Recognizer> recognizer)
+        : CommandSession(std::move(recognizer), Options())
+    {
+    }
+
+    CommandSession(std::shared_ptr<Recognizer> recognizer, const Options& options)
+        : m_recognizer(std::move(recognizer)), m_options(options), m_state(std::make_shared<State>())
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (m_recognizer == nullptr)
+        {
+            throw std::invalid_argument("Recognizer must be set");
+        }
+        m_connection = Connection::FromRecognizer(m_recognizer);
+
+        // The handlers only hold a weak reference, the connection may raise events after the session is gone.
+        std::weak_ptr<State> weakState = m_state;
+        m_connection->Connected.Connect([weakState](const ConnectionEventArgs&)
+        {
+            if (auto state = weakState.lock())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(state->Mutex);
+                    state->Connected = true;
+                }
+                state->Changed.notify_one();
+            }
+        });
+        m_connection->Disconnected.Connect([weakState](const ConnectionEventArgs&)
+        {
+            if (auto state = weakState.lock())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(state->Mutex);
+                    state->Connected = false;
+                }
+                // Reopening is left to the reconnect thread, the connection cannot be opened from its own callback.
+                state->Changed.notify_one();
+            }
+        });
+
+        // Opens the connection for single-shot recognition, which is what commands use.
+        m_connection->Open(false);
+        m_thread = std::thread(&CommandSession::Reconnect, this);
+    }
+
+    ~CommandSession()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            m_state->Closing = true;
+        }
+        m_state->Changed.notify_one();
+        m_thread.join();
+    }
+
+    CommandSession(const CommandSession&) = delete;
+    CommandSession& operator=(const CommandSession&) = delete;
+
+    // Recognizes one command. If the connection is down, e.g. because a reconnect has not succeeded yet, the
+    // recognizer connects by itself as it would without the session.
+    std::shared_ptr<Result> Recognize()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            m_state->Recognizing = true;
+            m_commands++;
+            if (!m_state->Connected)
+            {
+                m_commandsWithoutConnection++;
+            }
+        }
+        std::shared_ptr<Result> result;
+        try
+        {
+            result = m_recognizer->RecognizeOnceAsync().get();
+        }
+        catch (...)
+        {
+            EndRecognition();
+            throw;
+        }
+        EndRecognition();
+        return result;
+    }
+
+    const std::shared_ptr<Recognizer>& Get() const
+    {
+        return m_recognizer;
+    }
+
+    bool IsConnected() const
+    {
+        return m_state->Connected;
+    }
+
+    uint64_t Commands() const
+    {
+        return m_commands;
+    }
+
+    // Returns the number of commands that started while the connection was down, and so waited for a connection.
+    uint64_t CommandsWithoutConnection() const
+    {
+        return m_commandsWithoutConnection;
+    }
+
+    // Returns the number of times the connection was reopened in the background and came up.
+    uint64_t Reconnects() const
+    {
+        return m_reconnects;
+    }
+
+private:
+    struct State
+    {
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        std::atomic<bool> Connected{ false };
+        // Guarded by Mutex.
+        bool Recognizing = false;
+        bool Closing = false;
+    };
+
+    void EndRecognition()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            m_state->Recognizing = false;
+        }
+        // A connection that dropped during the command is reopened right away.
+        m_state->Changed.notify_one();
+    }
+
+    // Waits for the connection to drop, or for the next health check, and reopens the connection between commands.
+    void Reconnect()
+    {
+        auto delay = m_options.ReconnectDelay;
+        std::unique_lock<std::mutex> lock(m_state->Mutex);
+        // Gives the connection opened by the constructor time to come up.
+        m_state->Changed.wait_for(lock, m_options.HealthCheckInterval, [this]() { return m_state->Closing || m_state->Connected; });
+        while (!m_state->Closing)
+        {
+            m_state->Changed.wait_for(lock, m_options.HealthCheckInterval, [this]()
+            {
+                return m_state->Closing || (!m_state->Connected && !m_state->Recognizing);
+            });
+            if (m_state->Closing || m_state->Connected || m_state->Recognizing)
+            {
+                continue;
+            }
+
+            // Opens the connection outside of the lock, it takes a network round trip. A command that starts
+            // meanwhile runs on the connection that is being opened.
+            lock.unlock();
+            try
+            {
+                m_connection->Open(false);
+            }
+            catch (const std::exception&)
+            {
+                // Handled as any other failure below.
+            }
+            lock.lock();
+
+            // Open() returns before the connection is up, and reports a failure with the Canceled or Disconnected
+            // event rather than by throwing. The reconnect only succeeded if the Connected event follows in time.
+            m_state->Changed.wait_for(lock, m_options.HealthCheckInterval, [this]() { return m_state->Closing || m_state->Connected; });
+            if (m_state->Closing)
+            {
+                break;
+            }
+            if (m_state->Connected)
+            {
+                m_reconnects++;
+                delay = m_options.ReconnectDelay;
+            }
+            else
+            {
+                m_state->Changed.wait_for(lock, delay, [this]() { return m_state->Closing; });
+                delay = std::min(delay * 2, m_options.MaxReconnectDelay);
+            }
+        }
+    }
+
+    const std::shared_ptr<Recognizer> m_recognizer;
+    const Options m_options;
+    std::shared_ptr<State> m_state;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> m_connection;
+    std::atomic<uint64_t> m_commands{ 0 };
+    std::atomic<uint64_t> m_commandsWithoutConnection{ 0 };
+    std::atomic<uint64_t> m_reconnects{ 0 };
+    std::thread m_thread;
+};
@@ -0,0 +1,208 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "result_sink.h"
+#include "wav_file_list.h"
+#include "wav_file_reader.h"
+
+// A participant of the conversations, with the voice signature created with the signature REST API.
+struct ConversationParticipantInfo
+{
+    std::string UserId;
+    std::string Language;
+    // The json signature, with Version, Tag and Data.
+    std::string VoiceSignature;
+};
+
+// Transcribes many recorded conversations with the same participants, e.g. the meetings of a day, with a fixed
+// number of conversation transcribers running at the same time. The voice signatures are parsed into participant
+// objects once, and these are added to the conversation of every file.
+//
+// Each transcribed utterance is posted to the sink as a "Transcribed" record with the fields File, UserId, Offset
+// and Duration, e.g. for a DelimitedResultBackend with these columns. A file that fails is posted as a "CANCELED"
+// record with the fields File and ErrorDetails.
+class ConversationBatchTranscriber final
+{
+public:
+    struct Summary
+    {
+        size_t Transcribed = 0;
+        size_t Failed = 0;
+    };
+
+    ConversationBatchTranscriber(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+        const std::vector<ConversationParticipantInfo>& participants, size_t concurrency = 4)
+        : m_config(std::move(config)), m_concurrency(concurrency)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Transcription;
+
+        if (m_config == nullptr)
+        {
+            throw std::invalid_argument("Config is null");
+        }
+        if (concurrency == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1");
+        }
+        for (const auto& participant : participants)
+        {
+            m_participants.push_back(Participant::From(participant.UserId, participant.Language, participant.VoiceSignature));
+        }
+    }
+
+    ConversationBatchTranscriber(const ConversationBatchTranscriber&) = delete;
+    ConversationBatchTranscriber& operator=(const ConversationBatchTranscriber&) = delete;
+
+    // Returns the paths of the .wav files in a directory, sorted by name.
+    static std::vector<std::string> ListWavFiles(const std::string& directory)
+    {
+        return ::ListWavFiles(directory);
+    }
+
+    // Transcribes all files and returns when they are done. The records of different files are interleaved
+    // in the sink, use the File field to tell them apart.
+    Summary Run(const std::vector<std::string>& fileNames, AsyncResultSink& sink)
+    {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> failed{ 0 };
+        auto work = [&]()
+        {
+            for (size_t index = next++; index < fileNames.size(); index = next++)
+            {
+                if (!Transcribe(fileNames[index], sink))
+                {
+                    failed++;
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min(m_concurrency, fileNames.size()); i++)
+        {
+            workers.emplace_back(work);
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        Summary summary;
+        summary.Failed = failed;
+        summary.Transcribed = fileNames.size() - summary.Failed;
+        return summary;
+    }
+
+private:
+    class FileCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        explicit FileCallback(std::shared_ptr<WavFileReader> reader)
+            : m_reader(std::move(reader))
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader->Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader->Close();
+        }
+
+    private:
+        std::shared_ptr<WavFileReader> m_reader;
+    };
+
+    // Returns false if the transcription of the file was canceled with an error.
+    bool Transcribe(const std::string& fileName, AsyncResultSink& sink)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Transcription;
+
+        auto fail = [&sink, &fileName](const std::string& error)
+        {
+            sink.Post(ResultRecord{ "CANCELED", "" }.Add("File", fileName).Add("ErrorDetails", error));
+            return false;
+        };
+
+        try
+        {
+            // The stream format is taken from the file, conversation files usually have 8 channels.
+            auto reader = std::make_shared<WavFileReader>(fileName);
+            const auto& format = reader->Format();
+            auto pullStream = AudioInputStream::CreatePullStream(
+                AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), std::make_shared<FileCallback>(reader));
+
+            auto conversation = Conversation::CreateConversationAsync(m_config, "").get();
+            auto transcriber = ConversationTranscriber::FromConfig(AudioConfig::FromStreamInput(pullStream));
+            transcriber->JoinConversationAsync(conversation).get();
+            for (const auto& participant : m_participants)
+            {
+                conversation->AddParticipantAsync(participant).get();
+            }
+
+            // Set by the first of SessionStopped and an error, with the error details or an empty string.
+            std::promise<std::string> done;
+            std::once_flag doneOnce;
+            auto finish = [&done, &doneOnce](const std::string& error)
+            {
+                std::call_once(doneOnce, [&]() { done.set_value(error); });
+            };
+
+            transcriber->Transcribed.Connect([&sink, &fileName](const ConversationTranscriptionEventArgs& e)
+            {
+                if (e.Result->Reason == ResultReason::RecognizedSpeech)
+                {
+                    sink.Post(ResultRecord{ "Transcribed", e.Result->Text }
+                        .Add("File", fileName)
+                        .Add("UserId", e.Result->UserId)
+                        .Add("Offset", e.Result->Offset())
+                        .Add("Duration", e.Result->Duration()));
+                }
+            });
+            transcriber->Canceled.Connect([&finish](const ConversationTranscriptionCanceledEventArgs& e)
+            {
+                if (e.Reason == CancellationReason::Error)
+                {
+                    finish(e.ErrorDetails.empty() ? "Transcription canceled" : e.ErrorDetails);
+                }
+            });
+            transcriber->SessionStopped.Connect([&finish](const SessionEventArgs&)
+            {
+                finish("");
+            });
+
+            transcriber->StartTranscribingAsync().wait();
+            const std::string error = done.get_future().get();
+            transcriber->StopTranscribingAsync().wait();
+            transcriber->Transcribed.DisconnectAll();
+            transcriber->Canceled.DisconnectAll();
+            transcriber->SessionStopped.DisconnectAll();
+            return error.empty() ? true : fail(error);
+        }
+        catch (const std::exception& e)
+        {
+            return fail(e.what());
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const size_t m_concurrency;
+    std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Transcription::Participant>> m_participants;
+};
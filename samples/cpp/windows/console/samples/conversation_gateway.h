@@ -0,0 +1,391 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "result_sink.h"
+
+// A connection to one client of a ConversationGateway, e.g. a websocket. All rooms the client subscribes to share
+// the connection, every payload names its room.
+class GatewayClient
+{
+public:
+    virtual ~GatewayClient() = default;
+    // Sends one payload, a json object. Called from the gateway's thread, so it must not block, e.g. it queues the
+    // payload to the connection. Returns false if the connection is closed, the client is then unsubscribed.
+    virtual bool Send(const std::string& payload) = 0;
+};
+
+// Relays the events of multi-device conversations, the rooms, to many clients. The Transcribing, Transcribed,
+// TextMessageReceived and ParticipantsChanged events of a room's ConversationTranslator are collected for a batch
+// interval and then sent to all clients of the room as one payload:
+//   {"room":"...","events":[{"type":"transcribed","participant":"...","text":"...","translations":{"de":"..."}},...]}
+// Within a batch only the latest partial of each participant is kept. Each event is serialized once, however many
+// clients the room has, and a batch that is larger than the payload limit is split.
+//
+// A room keeps its participants and a ring buffer of its last final events. A client that subscribes late gets them
+// as a snapshot payload with "snapshot":true first, so it shows the current state without replaying the conversation.
+class ConversationGateway final
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds BatchInterval{ 100 };
+        // The largest payload sent to a client, in bytes. Single events that do not fit are dropped.
+        size_t MaxPayloadBytes = 64 * 1024;
+        // The number of final events a room keeps for clients that subscribe later.
+        size_t HistorySize = 200;
+    };
+
+    ConversationGateway()
+        : ConversationGateway(Options())
+    {
+    }
+
+    explicit ConversationGateway(const Options& options)
+        : m_options(options)
+    {
+        if (options.MaxPayloadBytes < 256 || options.HistorySize == 0 || options.BatchInterval.count() <= 0)
+        {
+            throw std::invalid_argument("Gateway needs a batch interval, a payload limit of at least 256 bytes and a history");
+        }
+        m_thread = std::thread(&ConversationGateway::Run, this);
+    }
+
+    ~ConversationGateway()
+    {
+        Close();
+    }
+
+    ConversationGateway(const ConversationGateway&) = delete;
+    ConversationGateway& operator=(const ConversationGateway&) = delete;
+
+    // Relays the events of a conversation translator as the room 'room'. The gateway must outlive the translator's
+    // event handlers.
+    void Attach(const std::string& room, Microsoft::CognitiveServices::Speech::Transcription::ConversationTranslator& translator)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Transcription;
+
+        Room* target = GetRoom(room);
+        translator.Transcribing += [this, target](const ConversationTranslationEventArgs& e)
+        {
+            Post(target, Event{ Event::Partial, e.Result->ParticipantId, Serialize("transcribing", *e.Result) });
+        };
+        translator.Transcribed += [this, target](const ConversationTranslationEventArgs& e)
+        {
+            Post(target, Event{ Event::Final, e.Result->ParticipantId, Serialize("transcribed", *e.Result) });
+        };
+        translator.TextMessageReceived += [this, target](const ConversationTranslationEventArgs& e)
+        {
+            Post(target, Event{ Event::Final, e.Result->ParticipantId, Serialize("message", *e.Result) });
+        };
+        translator.ParticipantsChanged += [this, target](const ConversationParticipantsChangedEventArgs& e)
+        {
+            Event event{ Event::Participants, "", "" };
+            event.Left = e.Reason == ParticipantChangedReason::LeftConversation;
+            std::string list;
+            for (const auto& participant : e.Participants)
+            {
+                std::string json = "{\"id\":\"" + JsonLinesResultBackend::Escape(participant->Id) +
+                    "\",\"name\":\"" + JsonLinesResultBackend::Escape(participant->DisplayName) +
+                    "\",\"muted\":" + (participant->IsMuted ? "true" : "false") +
+                    ",\"host\":" + (participant->IsHost ? "true" : "false") + "}";
+                list += (list.empty() ? "" : ",") + json;
+                event.Changed.emplace_back(participant->Id, std::move(json));
+            }
+            event.Json = std::string("{\"type\":\"participants\",\"reason\":\"") +
+                (event.Left ? "left" : e.Reason == ParticipantChangedReason::JoinedConversation ? "joined" : "updated") +
+                "\",\"participants\":[" + list + "]}";
+            Post(target, std::move(event));
+        };
+    }
+
+    // Sends the room's snapshot to the client, and then every batch of the room.
+    void Subscribe(const std::string& room, std::shared_ptr<GatewayClient> client)
+    {
+        if (client == nullptr)
+        {
+            throw std::invalid_argument("Gateway client is null");
+        }
+        Room* target = GetRoom(room);
+        std::lock_guard<std::mutex> lock(target->Mutex);
+        std::vector<const std::string*> events;
+        for (const auto& participant : target->Participants)
+        {
+            events.push_back(&participant.second);
+        }
+        const std::string prefix = "{\"room\":\"" + JsonLinesResultBackend::Escape(room) + "\",\"snapshot\":true,";
+        std::vector<std::string> payloads = BuildPayloads(prefix + "\"participants\":[", events);
+        events.clear();
+        for (size_t i = 0; i < target->History.size(); i++)
+        {
+            // The oldest event is at HistoryNext once the ring is full.
+            events.push_back(&target->History[(target->HistoryNext + i) % target->History.size()]);
+        }
+        for (auto& payload : BuildPayloads(prefix + "\"events\":[", events))
+        {
+            payloads.push_back(std::move(payload));
+        }
+        for (const auto& payload : payloads)
+        {
+            if (!client->Send(payload))
+            {
+                return;
+            }
+        }
+        target->Clients.push_back(std::move(client));
+    }
+
+    // Sends the pending batches and stops the gateway. Events posted later are not sent.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closing)
+            {
+                return;
+            }
+            m_closing = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    // Returns the number of partials that were replaced by a later partial of the same participant in a batch.
+    uint64_t CoalescedPartials() const
+    {
+        return m_coalesced;
+    }
+
+    // Returns the number of events that were dropped because they were larger than the payload limit.
+    uint64_t OversizedEvents() const
+    {
+        return m_oversized;
+    }
+
+private:
+    struct Event
+    {
+        enum Kind { Partial, Final, Participants };
+
+        Kind Type;
+        std::string ParticipantId;
+        std::string Json;
+        // For participant changes, the id and json of each participant, and whether they left.
+        std::vector<std::pair<std::string, std::string>> Changed;
+        bool Left = false;
+    };
+
+    struct Room
+    {
+        explicit Room(std::string name)
+            : Name(std::move(name))
+        {
+        }
+
+        const std::string Name;
+        std::mutex Mutex;
+        std::vector<Event> Pending;
+        // The index in Pending of each participant's partial.
+        std::unordered_map<std::string, size_t> PendingPartials;
+        std::vector<std::shared_ptr<GatewayClient>> Clients;
+        std::map<std::string, std::string> Participants;
+        std::vector<std::string> History;
+        size_t HistoryNext = 0;
+    };
+
+    static std::string Serialize(const char* type, const Microsoft::CognitiveServices::Speech::Transcription::ConversationTranslationResult& result)
+    {
+        std::string json = std::string("{\"type\":\"") + type + "\",\"participant\":\"" + JsonLinesResultBackend::Escape(result.ParticipantId) +
+            "\",\"text\":\"" + JsonLinesResultBackend::Escape(result.Text) + "\",\"translations\":{";
+        bool first = true;
+        for (const auto& it : result.Translations)
+        {
+            json += (first ? "\"" : ",\"") + JsonLinesResultBackend::Escape(it.first) + "\":\"" + JsonLinesResultBackend::Escape(it.second) + "\"";
+            first = false;
+        }
+        return json + "}}";
+    }
+
+    Room* GetRoom(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& room = m_rooms[name];
+        if (room == nullptr)
+        {
+            room.reset(new Room(name));
+        }
+        return room.get();
+    }
+
+    void Post(Room* room, Event&& event)
+    {
+        // The payload needs room for the prefix and the closing brackets of the batch.
+        if (event.Json.size() + room->Name.size() + 32 > m_options.MaxPayloadBytes)
+        {
+            m_oversized++;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(room->Mutex);
+        if (event.Type == Event::Partial)
+        {
+            auto it = room->PendingPartials.find(event.ParticipantId);
+            if (it != room->PendingPartials.end())
+            {
+                room->Pending[it->second] = std::move(event);
+                m_coalesced++;
+                return;
+            }
+            room->PendingPartials[event.ParticipantId] = room->Pending.size();
+        }
+        else if (event.Type == Event::Final)
+        {
+            // A final ends the participant's utterance, a later partial starts a new one.
+            room->PendingPartials.erase(event.ParticipantId);
+        }
+        room->Pending.push_back(std::move(event));
+    }
+
+    // Joins the json of the events into payloads of at most MaxPayloadBytes, each starting with 'prefix'.
+    std::vector<std::string> BuildPayloads(const std::string& prefix, const std::vector<const std::string*>& events) const
+    {
+        std::vector<std::string> payloads;
+        std::string payload = prefix;
+        bool empty = true;
+        for (const std::string* json : events)
+        {
+            if (!empty && payload.size() + json->size() + 3 > m_options.MaxPayloadBytes)
+            {
+                payloads.push_back(payload + "]}");
+                payload = prefix;
+                empty = true;
+            }
+            payload += (empty ? "" : ",") + *json;
+            empty = false;
+        }
+        if (!empty)
+        {
+            payloads.push_back(payload + "]}");
+        }
+        return payloads;
+    }
+
+    void Flush(Room* room)
+    {
+        std::vector<Event> batch;
+        std::vector<std::shared_ptr<GatewayClient>> clients;
+        std::vector<std::string> payloads;
+        {
+            std::lock_guard<std::mutex> lock(room->Mutex);
+            if (room->Pending.empty())
+            {
+                return;
+            }
+            batch.swap(room->Pending);
+            room->PendingPartials.clear();
+
+            // The room's state is updated when the batch is sent, so a client that subscribes afterwards finds
+            // these events in the snapshot, and a client that subscribed before gets them in this batch.
+            std::vector<const std::string*> events;
+            for (auto& event : batch)
+            {
+                events.push_back(&event.Json);
+                if (event.Type == Event::Final)
+                {
+                    if (room->History.size() < m_options.HistorySize)
+                    {
+                        room->History.push_back(event.Json);
+                    }
+                    else
+                    {
+                        room->History[room->HistoryNext] = event.Json;
+                    }
+                    room->HistoryNext = (room->HistoryNext + 1) % m_options.HistorySize;
+                }
+                else if (event.Type == Event::Participants)
+                {
+                    for (auto& participant : event.Changed)
+                    {
+                        if (event.Left)
+                        {
+                            room->Participants.erase(participant.first);
+                        }
+                        else
+                        {
+                            room->Participants[participant.first] = participant.second;
+                        }
+                    }
+                }
+            }
+            payloads = BuildPayloads("{\"room\":\"" + JsonLinesResultBackend::Escape(room->Name) + "\",\"events\":[", events);
+            clients = room->Clients;
+        }
+
+        std::vector<std::shared_ptr<GatewayClient>> closed;
+        for (const auto& client : clients)
+        {
+            for (const auto& payload : payloads)
+            {
+                if (!client->Send(payload))
+                {
+                    closed.push_back(client);
+                    break;
+                }
+            }
+        }
+        if (!closed.empty())
+        {
+            std::lock_guard<std::mutex> lock(room->Mutex);
+            for (const auto& client : closed)
+            {
+                room->Clients.erase(std::remove(room->Clients.begin(), room->Clients.end(), client), room->Clients.end());
+            }
+        }
+    }
+
+    void Run()
+    {
+        bool closing = false;
+        while (!closing)
+        {
+            std::vector<Room*> rooms;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait_for(lock, m_options.BatchInterval, [this]() { return m_closing; });
+                closing = m_closing;
+                for (const auto& room : m_rooms)
+                {
+                    rooms.push_back(room.second.get());
+                }
+            }
+            for (Room* room : rooms)
+            {
+                Flush(room);
+            }
+        }
+    }
+
+    const Options m_options;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::map<std::string, std::unique_ptr<Room>> m_rooms;
+    bool m_closing = false;
+    std::atomic<uint64_t> m_coalesced{ 0 };
+    std::atomic<uint64_t> m_oversized{ 0 };
+    std::thread m_thread;
+};
@@ -8,6 +8,13 @@
 #include <speechapi_cxx.h>
 #include <fstream>
 #include "wav_file_reader.h"
+#include "adaptive_wav_file_reader.h"
+#include "result_sink.h"
+#include "conversation_batch_transcriber.h"
+#include "channel_mapper.h"
+#include "conversation_gateway.h"
+#include "session_completion.h"
+#include "speaker_turn_merger.h"
 #include <chrono>
 
 using namespace std;
@@ -111,8 +118,8 @@ void ConversationWithPullAudioStream()
     // Adds steve as a participant to the conversation.
     conversation->AddParticipantAsync(steve).get();
 
-    // a promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Transcribing.Connect([](const ConversationTranscriptionEventArgs& e)
@@ -146,7 +153,7 @@ void ConversationWithPullAudioStream()
         case CancellationReason::Error:
             cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
             cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
-            recognitionEnd.set_value();
+            recognitionEnd.Complete();
             break;
 
         default:
@@ -157,14 +164,14 @@ void ConversationWithPullAudioStream()
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
         cout << "SESSION: " << e.SessionId << " stopped." << std::endl;
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     // Starts transcribing.
     recognizer->StartTranscribingAsync().wait();
 
     // Waits for transcribing to end.
-    recognitionEnd.get_future().wait();
+    recognitionEnd.Wait();
 
     // Stops transcribing. This is optional.
     recognizer->StopTranscribingAsync().wait();
@@ -214,8 +221,8 @@ void ConversationWithPushAudioStream()
     // adds steve as a participant to the conversation.
     conversation->AddParticipantAsync(steve).get();
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Transcribing.Connect([](const ConversationTranscriptionEventArgs& e)
@@ -249,7 +256,7 @@ void ConversationWithPushAudioStream()
         case CancellationReason::Error:
             cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
             cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
-            recognitionEnd.set_value();
+            recognitionEnd.Complete();
             break;
 
         default:
@@ -263,7 +270,7 @@ void ConversationWithPushAudioStream()
         cout << "SESSION: " << e.SessionId << " stopped." << std::endl;
 
         // Notify transcribing ends.
-        recognitionEnd.set_value();
+        recognitionEnd.Complete();
     });
 
     // open and read the wave file and push the buffers into the recognizer
@@ -293,8 +300,388 @@ void ConversationWithPushAudioStream()
     pushStream->Close();
 
     // Waits for completion.
-    recognitionEnd.get_future().wait();
+    recognitionEnd.Wait();
 
     // Leaves the conversation.
     recognizer->StopTranscribingAsync().wait();
 }
+
+// Transcribing all conversations in a directory, with several conversation transcribers at the same time
+// Note: This is only available on the devices that can be paired with the Cognitive Services Speech Device SDK.
+void ConversationBatchFromDirectory()
+{
+    // Creates an instance of a speech config with your subscription key and region.
+    // Replace with your own subscription key and service region (e.g., "eastasia").
+    // Conversation Transcription is currently available in eastasia and centralus region.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
+
+    // Create voice signatures using REST API at https://signature.centralus.cts.speech.microsoft.com by using YourSubscriptionKey
+    // and the provided enrollment_audio_katie.wav and enrollment_audio_steve.wav, and save the Signature value of each response body
+    // to katie.signature.json and steve.signature.json. The signatures are parsed once and used for all conversations.
+    vector<ConversationParticipantInfo> participants;
+    for (const auto& name : { "katie", "steve" })
+    {
+        ifstream signatureFile(string(name) + ".signature.json");
+        if (!signatureFile)
+        {
+            cout << "Cannot open " << name << ".signature.json" << endl;
+            return;
+        }
+        string signature((istreambuf_iterator<char>(signatureFile)), istreambuf_iterator<char>());
+        participants.push_back(ConversationParticipantInfo{ string(name) + "@example.com", "en-us", signature });
+    }
+
+    cout << "Enter the directory of the conversation files (16 kHz, 16 bits per sample, 8 channels):" << endl;
+    string directory;
+    getline(cin, directory);
+    auto fileNames = ConversationBatchTranscriber::ListWavFiles(directory.empty() ? "." : directory);
+    if (fileNames.empty())
+    {
+        cout << "No .wav files found." << endl;
+        return;
+    }
+
+    // All utterances of all files go into one table with a column per field. The sink waits rather than drops
+    // when the file cannot keep up, so that no utterance is lost.
+    AsyncResultSink sink(unique_ptr<ResultSinkBackend>(new DelimitedResultBackend("conversations.tsv", { "File", "UserId", "Offset", "Duration", "Text", "ErrorDetails" })),
+        1024, AsyncResultSink::OverflowPolicy::Block);
+
+    ConversationBatchTranscriber transcriber(config, participants, 4);
+    cout << "Transcribing " << fileNames.size() << " files..." << endl;
+    auto summary = transcriber.Run(fileNames, sink);
+    sink.Close();
+    cout << summary.Transcribed << " files transcribed, " << summary.Failed << " failed. The results are in [conversations.tsv]." << endl;
+}
+
+// Transcribing conversation from the raw capture of a microphone array, with the channels rearranged while streaming
+// Note: This is only available on the devices that can be paired with the Cognitive Services Speech Device SDK.
+void ConversationWithChannelMappedAudioStream()
+{
+    // Creates an instance of a speech config with your subscription key and region.
+    // Replace with your own subscription key and service region (e.g., "eastasia").
+    // Conversation Transcription is currently available in eastasia and centralus region.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
+
+    // The capture is a 16-bit PCM wav file with any number of channels. The channel map gives the source of each of
+    // the 8 channels the transcriber expects, e.g. "0,1,2,3,4,5,6,7" for a capture in that order already,
+    // "7,6,5,4,3,2,1,0" for a reversed array, or "0,1,2,3,4,5,s,s" for a 6-microphone array without reference channels.
+    cout << "Enter the capture file name (empty for katiesteve.wav):" << endl;
+    string fileName;
+    getline(cin, fileName);
+    cout << "Enter the channel map (empty for 0,1,2,3,4,5,6,7):" << endl;
+    string mapText;
+    getline(cin, mapText);
+
+    shared_ptr<ChannelMappedWavCallback> callback;
+    try
+    {
+        auto map = ChannelMapper::Parse(mapText.empty() ? "0,1,2,3,4,5,6,7" : mapText);
+        if (map.size() != 8)
+        {
+            cout << "The channel map must have 8 channels." << endl;
+            return;
+        }
+        callback = make_shared<ChannelMappedWavCallback>(fileName.empty() ? "katiesteve.wav" : fileName, map);
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+
+    const auto format = callback->Format();
+    auto pullStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, 16, 8), callback);
+    auto audioInput = AudioConfig::FromStreamInput(pullStream);
+    auto conversation = Conversation::CreateConversationAsync(config, "ConversationTranscriberSamples").get();
+    auto recognizer = ConversationTranscriber::FromConfig(audioInput);
+    recognizer->JoinConversationAsync(conversation).get();
+
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
+
+    recognizer->Transcribed.Connect([](const ConversationTranscriptionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl
+                << "  Offset=" << e.Result->Offset() << std::endl
+                << "  Duration=" << e.Result->Duration() << std::endl
+                << "  UserId=" << e.Result->UserId << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([](const ConversationTranscriptionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "SESSION: " << e.SessionId << " stopped." << std::endl;
+        recognitionEnd.Complete();
+    });
+
+    // Starts transcribing, and waits for the end of the file.
+    recognizer->StartTranscribingAsync().wait();
+    recognitionEnd.Wait();
+    recognizer->StopTranscribingAsync().wait();
+}
+
+// Hosting a multi-device conversation and relaying its events to clients in batches, with a snapshot for late joiners
+void ConversationTranslatorWithGateway()
+{
+    // Stands for the connection of one client, e.g. a websocket. Payloads are handed to the result sink, so that
+    // Send() does not wait for the console.
+    class ConsoleGatewayClient final : public GatewayClient
+    {
+    public:
+        ConsoleGatewayClient(const string& name, AsyncResultSink& sink)
+            : m_name(name), m_sink(sink)
+        {
+        }
+
+        bool Send(const string& payload) override
+        {
+            m_sink.Post(ResultRecord{ "PAYLOAD to " + m_name, payload });
+            return true;
+        }
+
+    private:
+        const string m_name;
+        AsyncResultSink& m_sink;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetSpeechRecognitionLanguage("en-US");
+
+    auto conversation = Conversation::CreateConversationAsync(config).get();
+    conversation->StartConversationAsync().get();
+    const string room = conversation->GetConversationId();
+    cout << "CONVERSATION: Created a new conversation with ID " << room << std::endl;
+
+    // The sink and the gateway are declared before the translator, so they outlive its event handlers.
+    AsyncResultSink sink(unique_ptr<ResultSinkBackend>(new TextResultBackend(cout)));
+    ConversationGateway gateway;
+    gateway.Subscribe(room, make_shared<ConsoleGatewayClient>("first client", sink));
+
+    auto conversationTranslator = ConversationTranslator::FromConfig(AudioConfig::FromDefaultMicrophoneInput());
+    gateway.Attach(room, *conversationTranslator);
+    conversationTranslator->Canceled += [&sink](const ConversationTranslationCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            sink.Post(ResultRecord{ "CANCELED", "" }.Add("ErrorCode", (uint64_t)e.ErrorCode).Add("ErrorDetails", e.ErrorDetails));
+        }
+    };
+
+    conversationTranslator->JoinConversationAsync(conversation, "Host").get();
+    conversationTranslator->SendTextMessageAsync("This is a short test message").get();
+    conversationTranslator->StartTranscribingAsync().get();
+
+    cout << "Started transcribing. Press Enter to subscribe a second client" << std::endl;
+    string s;
+    getline(cin, s);
+
+    // The second client gets the participants and the last events first, and then the batches like the first client.
+    gateway.Subscribe(room, make_shared<ConsoleGatewayClient>("late client", sink));
+
+    cout << "Press Enter to stop" << std::endl;
+    getline(cin, s);
+
+    conversationTranslator->StopTranscribingAsync().get();
+    conversationTranslator->LeaveConversationAsync().get();
+    gateway.Close();
+    cout << "Partials coalesced: " << gateway.CoalescedPartials() << ", oversized events: " << gateway.OversizedEvents() << std::endl;
+
+    conversation->EndConversationAsync().get();
+    conversation->DeleteConversationAsync().get();
+}
+
+// Transcribing conversation using a pull audio stream that reads the file ahead into double buffers
+// Note: This is only available on the devices that can be paired with the Cognitive Services Speech Device SDK.
+void ConversationWithAdaptivePullAudioStream()
+{
+    // The file is read ahead into two buffers of whole 10 ms frames, so that Read() rarely reads from the file itself.
+    class AdaptiveAudioInputFromFileCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        AdaptiveAudioInputFromFileCallback(const string& audioFileName)
+            : m_reader(audioFileName)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader.Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+        const WavFileReader::WAVEFORMAT& Format() const
+        {
+            return m_reader.Format();
+        }
+
+        // Returns the sizes the SDK requested and the number of file reads that served them.
+        AdaptiveWavFileReader::Statistics GetStatistics() const
+        {
+            return m_reader.GetStatistics();
+        }
+
+    private:
+        AdaptiveWavFileReader m_reader;
+    };
+
+    // Creates an instance of a speech config with your subscription key and region.
+    // Replace with your own subscription key and service region (e.g., "eastasia").
+    // Conversation Transcription is currently available in eastasia and centralus region.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
+
+    shared_ptr<AdaptiveAudioInputFromFileCallback> callback;
+    try
+    {
+        // Replace with your own audio file name.
+        // The audio file should be in a format of 16 kHz sampling rate, 16 bits per sample, and 8 channels.
+        callback = make_shared<AdaptiveAudioInputFromFileCallback>("katiesteve.wav");
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+
+    const auto& format = callback->Format();
+    auto pullStream = AudioInputStream::CreatePullStream(
+        AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), callback);
+    auto audioInput = AudioConfig::FromStreamInput(pullStream);
+    auto conversation = Conversation::CreateConversationAsync(config, "ConversationTranscriberSamples").get();
+    auto recognizer = ConversationTranscriber::FromConfig(audioInput);
+    recognizer->JoinConversationAsync(conversation).get();
+
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
+
+    recognizer->Transcribed.Connect([](const ConversationTranscriptionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "Transcribed: Text=" << e.Result->Text << std::endl
+                << "  Offset=" << e.Result->Offset() << std::endl
+                << "  Duration=" << e.Result->Duration() << std::endl
+                << "  UserId=" << e.Result->UserId << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([](const ConversationTranscriptionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "SESSION: " << e.SessionId << " stopped." << std::endl;
+        recognitionEnd.Complete();
+    });
+
+    // Starts transcribing, and waits for the end of the file.
+    recognizer->StartTranscribingAsync().wait();
+    recognitionEnd.Wait();
+    recognizer->StopTranscribingAsync().wait();
+
+    // Shows how the read-ahead served the requests of the SDK, to tune the buffer sizes.
+    callback->GetStatistics().Write(cout);
+}
+
+// Transcribing conversation into speaker turns, with the consecutive segments of a speaker merged as for minutes
+// Note: This is only available on the devices that can be paired with the Cognitive Services Speech Device SDK.
+void ConversationWithSpeakerTurns()
+{
+    // Creates an instance of a speech config with your subscription key and region.
+    // Replace with your own subscription key and service region (e.g., "eastasia").
+    // Conversation Transcription is currently available in eastasia and centralus region.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty("ConversationTranscriptionInRoomAndOnline", "true");
+
+    // Creates a push stream using 16kHz, 16bits per sample and 8 channels audio.
+    auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 8));
+    auto audioInput = AudioConfig::FromStreamInput(pushStream);
+    auto conversation = Conversation::CreateConversationAsync(config, "ConversationTranscriberSamples").get();
+    auto recognizer = ConversationTranscriber::FromConfig(audioInput);
+    recognizer->JoinConversationAsync(conversation).get();
+
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
+
+    // Consecutive segments of a speaker are merged into turns, printed once no earlier segment can arrive.
+    SpeakerTurnMerger turns([](const SpeakerTurn& turn)
+    {
+        cout << "TURN: UserId=" << turn.UserId << " Offset=" << turn.Offset << " Duration=" << turn.Duration
+            << " Segments=" << turn.Segments << " Text=" << turn.Text << std::endl;
+    });
+
+    // Results that are not recognized speech are ignored by the merger.
+    recognizer->Transcribed.Connect([&turns](const ConversationTranscriptionEventArgs& e)
+    {
+        turns.Add(*e.Result);
+    });
+
+    recognizer->Canceled.Connect([](const ConversationTranscriptionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "SESSION: " << e.SessionId << " stopped." << std::endl;
+        recognitionEnd.Complete();
+    });
+
+    recognizer->StartTranscribingAsync().wait();
+
+    // The audio file should be in a format of 16 kHz sampling rate, 16 bits per sample, and 8 channels.
+    try
+    {
+        WavFileReader reader("katiesteve.wav");
+        vector<uint8_t> buffer(1000);
+        int readSamples = 0;
+        while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+        {
+            pushStream->Write(buffer.data(), readSamples);
+        }
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception " << e.what() << endl;
+    }
+    pushStream->Close();
+
+    recognitionEnd.Wait();
+    recognizer->StopTranscribingAsync().wait();
+
+    // No more segments arrive, prints the last turns.
+    turns.Flush();
+    if (turns.LateSegments() > 0)
+    {
+        cout << turns.LateSegments() << " segments arrived too late to be merged in order." << std::endl;
+    }
+}
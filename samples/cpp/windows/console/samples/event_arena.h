@@ -0,0 +1,252 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Read-only view of characters owned by an EventArena, std::string_view is not available in C++14.
+struct TextView
+{
+    const char* Data = nullptr;
+    size_t Size = 0;
+
+    std::string ToString() const
+    {
+        return std::string(Data, Size);
+    }
+
+    bool operator==(const TextView& other) const
+    {
+        return Size == other.Size && (Size == 0 || memcmp(Data, other.Data, Size) == 0);
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const TextView& text)
+{
+    return os.write(text.Data, (std::streamsize)text.Size);
+}
+
+// Read-only view of an array owned by an EventArena.
+template <class T>
+struct ArrayView
+{
+    const T* Data = nullptr;
+    size_t Size = 0;
+
+    const T* begin() const
+    {
+        return Data;
+    }
+
+    const T* end() const
+    {
+        return Data + Size;
+    }
+};
+
+// A monotonic allocator for the payloads of events: copies are placed one after the other in large blocks and are
+// never freed one by one, all of them are released at once by Reset(). The blocks are kept for reuse, so once the
+// arena has grown to the size of the busiest utterance, copying a payload takes no call to the heap.
+class EventArena final
+{
+public:
+    explicit EventArena(size_t blockSize = 16 * 1024)
+        : m_blockSize(blockSize == 0 ? 1 : blockSize)
+    {
+    }
+
+    EventArena(const EventArena&) = delete;
+    EventArena& operator=(const EventArena&) = delete;
+
+    TextView Copy(const std::string& text)
+    {
+        char* data = Allocate<char>(text.size());
+        if (!text.empty())
+        {
+            memcpy(data, text.data(), text.size());
+        }
+        return TextView{ data, text.size() };
+    }
+
+    // Returns uninitialized room for 'count' objects that need no destructor, e.g. views.
+    template <class T>
+    T* Allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Objects in the arena are never destroyed");
+        const size_t size = count * sizeof(T);
+        // Blocks come from operator new[], which aligns them for any fundamental type.
+        size_t offset = (m_used + alignof(T) - 1) / alignof(T) * alignof(T);
+        if (size > m_blockSize / 4)
+        {
+            // Large payloads get a block of their own, so they do not waste the rest of the current block.
+            m_largeBlocks.emplace_back(new char[size]);
+            m_bytesUsed += size;
+            return reinterpret_cast<T*>(m_largeBlocks.back().get());
+        }
+        if (m_blocks.empty())
+        {
+            m_blocks.emplace_back(new char[m_blockSize]);
+        }
+        else if (offset + size > m_blockSize)
+        {
+            // Moves on to the next block, which is left from before the last Reset() or added now.
+            if (++m_block == m_blocks.size())
+            {
+                m_blocks.emplace_back(new char[m_blockSize]);
+            }
+            offset = 0;
+        }
+        m_used = offset + size;
+        m_bytesUsed += size;
+        return reinterpret_cast<T*>(m_blocks[m_block].get() + offset);
+    }
+
+    // Releases all payloads, the views into them must not be used any more.
+    void Reset()
+    {
+        m_block = 0;
+        m_used = 0;
+        m_bytesUsed = 0;
+        m_largeBlocks.clear();
+    }
+
+    // Returns the bytes of the payloads copied since the last Reset().
+    size_t BytesUsed() const
+    {
+        return m_bytesUsed;
+    }
+
+    // Returns the bytes held in reusable blocks.
+    size_t Capacity() const
+    {
+        return m_blocks.size() * m_blockSize;
+    }
+
+private:
+    const size_t m_blockSize;
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    std::vector<std::unique_ptr<char[]>> m_largeBlocks;
+    // The block being filled, and the bytes used in it.
+    size_t m_block = 0;
+    size_t m_used = 0;
+    size_t m_bytesUsed = 0;
+};
+
+struct TranslationView
+{
+    TextView Language;
+    TextView Text;
+};
+
+struct ParticipantView
+{
+    TextView Id;
+    TextView DisplayName;
+    bool IsHost = false;
+    bool IsMuted = false;
+};
+
+// The payload of a recognition or translation event, with views into the arena of its session.
+struct RecognitionPayload
+{
+    TextView Text;
+    uint64_t Offset = 0;
+    uint64_t Duration = 0;
+    ArrayView<TranslationView> Translations;
+};
+
+// Adapts the events of one session into payloads in an arena, instead of strings of their own. The arena is reset
+// when the next final result arrives, so memory is reused utterance by utterance: the views of a partial result
+// and of a final result stay valid until the next call to Recognized(). Consumers that keep a payload longer, e.g.
+// to hand it to another thread, copy it with TextView::ToString().
+//
+// The events of one recognizer are raised one at a time, so the payloads do not lock.
+class SessionEventPayloads final
+{
+public:
+    explicit SessionEventPayloads(size_t blockSize = 16 * 1024)
+        : m_arena(blockSize)
+    {
+    }
+
+    // Adapts a partial result, e.g. of a Recognizing event.
+    RecognitionPayload Recognizing(const Microsoft::CognitiveServices::Speech::RecognitionResult& result)
+    {
+        return Adapt(result);
+    }
+
+    RecognitionPayload Recognizing(const Microsoft::CognitiveServices::Speech::Translation::TranslationRecognitionResult& result)
+    {
+        return AdaptTranslations(result);
+    }
+
+    // Adapts a final result, e.g. of a Recognized event, after releasing the payloads of the last utterance.
+    RecognitionPayload Recognized(const Microsoft::CognitiveServices::Speech::RecognitionResult& result)
+    {
+        m_arena.Reset();
+        return Adapt(result);
+    }
+
+    RecognitionPayload Recognized(const Microsoft::CognitiveServices::Speech::Translation::TranslationRecognitionResult& result)
+    {
+        m_arena.Reset();
+        return AdaptTranslations(result);
+    }
+
+    // Adapts the participants of a multi-device conversation event, the views are valid until the next final result.
+    ArrayView<ParticipantView> Participants(const Microsoft::CognitiveServices::Speech::Transcription::ConversationParticipantsChangedEventArgs& e)
+    {
+        ArrayView<ParticipantView> participants;
+        ParticipantView* views = m_arena.Allocate<ParticipantView>(e.Participants.size());
+        for (const auto& participant : e.Participants)
+        {
+            ParticipantView& view = views[participants.Size++];
+            view.Id = m_arena.Copy(participant->Id);
+            view.DisplayName = m_arena.Copy(participant->DisplayName);
+            view.IsHost = participant->IsHost;
+            view.IsMuted = participant->IsMuted;
+        }
+        participants.Data = views;
+        return participants;
+    }
+
+    const EventArena& Arena() const
+    {
+        return m_arena;
+    }
+
+private:
+    RecognitionPayload Adapt(const Microsoft::CognitiveServices::Speech::RecognitionResult& result)
+    {
+        RecognitionPayload payload;
+        payload.Text = m_arena.Copy(result.Text);
+        payload.Offset = result.Offset();
+        payload.Duration = result.Duration();
+        return payload;
+    }
+
+    RecognitionPayload AdaptTranslations(const Microsoft::CognitiveServices::Speech::Translation::TranslationRecognitionResult& result)
+    {
+        RecognitionPayload payload = Adapt(result);
+        TranslationView* views = m_arena.Allocate<TranslationView>(result.Translations.size());
+        for (const auto& translation : result.Translations)
+        {
+            TranslationView& view = views[payload.Translations.Size++];
+            view.Language = m_arena.Copy(translation.first);
+            view.Text = m_arena.Copy(translation.second);
+        }
+        payload.Translations.Data = views;
+        return payload;
+    }
+
+    EventArena m_arena;
+};
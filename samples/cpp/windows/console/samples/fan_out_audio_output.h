@@ -0,0 +1,231 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "trace_recorder.h"
+
+// Push audio output callback that hands the synthesized audio to several other callbacks at once, e.g. one that
+// plays it to the caller, one that archives it to disk and one that sends it to a monitor. Each chunk the
+// synthesizer writes is copied once into a shared, reference-counted buffer, which is queued to all sinks, and
+// reused once the last sink has written it.
+//
+// Every sink has its own thread and queue, so Write() never waits for a sink: a slow disk delays the archive
+// and nothing else. A sink whose queue is bounded drops its oldest queued audio when it falls further behind,
+// e.g. playback, where late audio is no use. An unbounded queue keeps all audio, e.g. for the archive.
+class FanOutAudioOutputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback
+{
+public:
+    struct SinkStatistics
+    {
+        // Bytes written to the sink, and bytes dropped because its queue was full.
+        uint64_t Bytes = 0;
+        uint64_t DroppedBytes = 0;
+        // The most bytes that were queued for the sink at once.
+        size_t MaxQueuedBytes = 0;
+    };
+
+    FanOutAudioOutputCallback() = default;
+
+    ~FanOutAudioOutputCallback()
+    {
+        Close();
+        for (auto& sink : m_sinks)
+        {
+            sink->Thread.join();
+        }
+    }
+
+    FanOutAudioOutputCallback(const FanOutAudioOutputCallback&) = delete;
+    FanOutAudioOutputCallback& operator=(const FanOutAudioOutputCallback&) = delete;
+
+    // Adds a sink that gets all audio written from now on, with at most 'maxQueuedBytes' queued, 0 for no limit.
+    // Returns the index of the sink for Statistics(). Sinks must be added before the first Write().
+    size_t AddSink(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback> output, size_t maxQueuedBytes = 0)
+    {
+        if (output == nullptr)
+        {
+            throw std::invalid_argument("Sink is null");
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_started)
+        {
+            throw std::runtime_error("Sinks must be added before the first write");
+        }
+        auto sink = std::unique_ptr<Sink>(new Sink());
+        sink->Output = std::move(output);
+        sink->MaxQueuedBytes = maxQueuedBytes;
+        m_sinks.push_back(std::move(sink));
+        m_sinks.back()->Thread = std::thread(&FanOutAudioOutputCallback::Run, this, m_sinks.back().get());
+        return m_sinks.size() - 1;
+    }
+
+    int Write(uint8_t* dataBuffer, uint32_t size) override
+    {
+        TraceSpan span("synthesis", "FanOutAudioOutputCallback::Write", "size", size);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_started = true;
+        }
+        if (size == 0)
+        {
+            return 0;
+        }
+
+        std::shared_ptr<const Chunk> chunk = AcquireChunk(dataBuffer, size);
+        for (auto& sink : m_sinks)
+        {
+            {
+                std::lock_guard<std::mutex> lock(sink->Mutex);
+                if (sink->Closing)
+                {
+                    continue;
+                }
+                sink->Queue.push_back(chunk);
+                sink->QueuedBytes += size;
+                // Drops the oldest audio, but never the chunk just queued.
+                while (sink->MaxQueuedBytes != 0 && sink->QueuedBytes > sink->MaxQueuedBytes && sink->Queue.size() > 1)
+                {
+                    sink->QueuedBytes -= sink->Queue.front()->Data.size();
+                    sink->Statistics.DroppedBytes += sink->Queue.front()->Data.size();
+                    sink->Queue.pop_front();
+                }
+                sink->Statistics.MaxQueuedBytes = std::max(sink->Statistics.MaxQueuedBytes, sink->QueuedBytes);
+            }
+            sink->Changed.notify_all();
+        }
+        return (int)size;
+    }
+
+    // Closes the sinks once they have written their queued audio, without waiting for them.
+    void Close() override
+    {
+        for (auto& sink : m_sinks)
+        {
+            {
+                std::lock_guard<std::mutex> lock(sink->Mutex);
+                sink->Closing = true;
+            }
+            sink->Changed.notify_all();
+        }
+    }
+
+    // Waits until all sinks have written the audio queued so far, e.g. before the archive is read.
+    void Flush()
+    {
+        for (auto& sink : m_sinks)
+        {
+            std::unique_lock<std::mutex> lock(sink->Mutex);
+            sink->Changed.wait(lock, [&sink]() { return sink->Queue.empty() && !sink->Writing; });
+        }
+    }
+
+    SinkStatistics Statistics(size_t sink) const
+    {
+        std::lock_guard<std::mutex> lock(m_sinks.at(sink)->Mutex);
+        return m_sinks[sink]->Statistics;
+    }
+
+    // Returns the number of chunk buffers that have been allocated, a measure of the memory in use.
+    size_t AllocatedChunks() const
+    {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        return m_allocatedChunks;
+    }
+
+private:
+    struct Chunk
+    {
+        std::vector<uint8_t> Data;
+    };
+
+    struct Sink
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback> Output;
+        size_t MaxQueuedBytes = 0;
+        mutable std::mutex Mutex;
+        std::condition_variable Changed;
+        std::deque<std::shared_ptr<const Chunk>> Queue;
+        size_t QueuedBytes = 0;
+        bool Writing = false;
+        bool Closing = false;
+        SinkStatistics Statistics;
+        std::thread Thread;
+    };
+
+    // Returns a chunk with a copy of the audio, whose buffer goes back to the free list when the last sink has
+    // released it. Buffers keep their capacity, so the copy does not allocate once the pool has warmed up.
+    std::shared_ptr<const Chunk> AcquireChunk(const uint8_t* data, uint32_t size)
+    {
+        std::unique_ptr<Chunk> chunk;
+        {
+            std::lock_guard<std::mutex> lock(m_poolMutex);
+            if (m_free.empty())
+            {
+                m_allocatedChunks++;
+                chunk.reset(new Chunk());
+            }
+            else
+            {
+                chunk = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        chunk->Data.assign(data, data + size);
+        return std::shared_ptr<const Chunk>(chunk.release(), [this](const Chunk* released)
+        {
+            std::lock_guard<std::mutex> lock(m_poolMutex);
+            m_free.emplace_back(const_cast<Chunk*>(released));
+        });
+    }
+
+    void Run(Sink* sink)
+    {
+        std::unique_lock<std::mutex> lock(sink->Mutex);
+        while (true)
+        {
+            sink->Changed.wait(lock, [sink]() { return sink->Closing || !sink->Queue.empty(); });
+            if (sink->Queue.empty())
+            {
+                break;
+            }
+            std::shared_ptr<const Chunk> chunk = std::move(sink->Queue.front());
+            sink->Queue.pop_front();
+            sink->QueuedBytes -= chunk->Data.size();
+            sink->Writing = true;
+            lock.unlock();
+
+            sink->Output->Write(const_cast<uint8_t*>(chunk->Data.data()), (uint32_t)chunk->Data.size());
+            const size_t size = chunk->Data.size();
+            // Returns the buffer to the pool before taking the lock, the last sink to release it does that.
+            chunk.reset();
+
+            lock.lock();
+            sink->Writing = false;
+            sink->Statistics.Bytes += size;
+            sink->Changed.notify_all();
+        }
+        lock.unlock();
+        sink->Output->Close();
+    }
+
+    // Declared before the sinks, so that the pool outlives the chunks they hold.
+    mutable std::mutex m_poolMutex;
+    std::vector<std::unique_ptr<Chunk>> m_free;
+    size_t m_allocatedChunks = 0;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Sink>> m_sinks;
+    bool m_started = false;
+};
@@ -6,7 +6,14 @@
 #include "stdafx.h"
 
 // <toplevel>
+#include <memory>
+#include <string>
+#include <vector>
 #include <speechapi_cxx.h>
+#include "local_intent_matcher.h"
+#include "session_completion.h"
+#include "utterance_audio_cache.h"
+#include "wav_file_reader.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -159,8 +166,8 @@ void IntentContinuousRecognitionWithFile()
     auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
     auto recognizer = IntentRecognizer::FromConfig(config, audioInput);
 
-    // promise for synchronization of recognition end.
-    std::promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Creates a Language Understanding model using the app id, and adds specific intents from your model
     auto model = LanguageUnderstandingModel::FromAppId("YourLanguageUnderstandingAppId");
@@ -203,22 +210,180 @@ void IntentContinuousRecognitionWithFile()
             cout << "CANCELED: Did you update the subscription info?" << std::endl;
         }
 
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
         cout << "Session stopped.";
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
     // </IntentContinuousRecognitionWithFile>
 }
+
+// Continuous intent recognition that answers the common commands on the device, and only sends the other
+// utterances to the Language Understanding service.
+void IntentContinuousRecognitionWithLocalFastPath()
+{
+    // Keeps the audio that is streamed to the speech recognizer, so that the utterances without a local match
+    // can be recognized again by the intent recognizer.
+    class TappedAudioInputCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        TappedAudioInputCallback(const string& audioFileName)
+            : m_reader(audioFileName), m_audio(m_reader.Format())
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            int count = m_reader.Read(dataBuffer, size);
+            if (count > 0)
+            {
+                m_audio.Add(dataBuffer, (size_t)count);
+            }
+            return count;
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+        UtteranceAudioCache& Audio()
+        {
+            return m_audio;
+        }
+
+    private:
+        WavFileReader m_reader;
+        UtteranceAudioCache m_audio;
+    };
+
+    shared_ptr<TappedAudioInputCallback> callback;
+    try
+    {
+        // Replace with your own audio file name.
+        callback = make_shared<TappedAudioInputCallback>("YourCommands.wav");
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+
+    // The commands that are answered on the device. Replace with the phrases of your most frequent intents.
+    LocalIntentMatcher matcher;
+    matcher.AddIntent("turn on the {device}", "HomeAutomation.TurnOn");
+    matcher.AddIntent("switch on the {device}", "HomeAutomation.TurnOn");
+    matcher.AddIntent("turn off the {device}", "HomeAutomation.TurnOff");
+    matcher.AddIntent("switch off the {device}", "HomeAutomation.TurnOff");
+    matcher.AddEntityValues("device", { "light", "lights", "fan", "heater", "living room lamp" });
+    matcher.Compile();
+
+    // Recognizes an utterance that has no local match with the Language Understanding model. See
+    // IntentRecognitionWithMicrophone() for the subscription of the Language Understanding service.
+    auto intentConfig = SpeechConfig::FromSubscription("YourLanguageUnderstandingSubscriptionKey", "YourLanguageUnderstandingServiceRegion");
+    auto model = LanguageUnderstandingModel::FromAppId("YourLanguageUnderstandingAppId");
+    const auto format = callback->Audio().Format();
+    auto recognizeWithModel = [intentConfig, model, format](const vector<uint8_t>& audio)
+    {
+        auto pushStream = AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels));
+        pushStream->Write(const_cast<uint8_t*>(audio.data()), (uint32_t)audio.size());
+        pushStream->Close();
+        auto intentRecognizer = IntentRecognizer::FromConfig(intentConfig, AudioConfig::FromStreamInput(pushStream));
+        intentRecognizer->AddAllIntents(model);
+        return intentRecognizer->RecognizeOnceAsync().get();
+    };
+
+    // Answers are printed one at a time and in the order of the utterances, whether they come from the device
+    // or from the service. Declared before the recognizer, so that it outlives its event handlers.
+    SerialExecutor executor;
+
+    // Only recognizes speech, the intents are found by the matcher or the model.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    auto pullStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), callback);
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+
+    recognizer->Recognized.Connect([&matcher, &executor, callback, recognizeWithModel](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason != ResultReason::RecognizedSpeech)
+        {
+            return;
+        }
+        string text = e.Result->Text;
+        LocalIntentMatcher::Match match;
+        if (matcher.TryMatch(text, match))
+        {
+            // Answered without a service round trip, the audio of the utterance is no longer needed.
+            callback->Audio().Take(e.Result->Offset(), e.Result->Duration(), false);
+            executor.Post([text, match]()
+            {
+                cout << "RECOGNIZED LOCALLY: Text=" << text << std::endl;
+                cout << "  Intent Id: " << match.IntentId << " (confidence " << match.Confidence << ")" << std::endl;
+                for (const auto& entity : match.Entities)
+                {
+                    cout << "  Entity " << entity.first << ": " << entity.second << std::endl;
+                }
+            });
+            return;
+        }
+
+        auto audio = callback->Audio().Take(e.Result->Offset(), e.Result->Duration());
+        executor.Post([text, audio, recognizeWithModel]()
+        {
+            if (audio.empty())
+            {
+                cout << "RECOGNIZED: Text=" << text << " (the audio of the utterance is no longer available)" << std::endl;
+                return;
+            }
+            auto result = recognizeWithModel(audio);
+            if (result->Reason == ResultReason::RecognizedIntent)
+            {
+                cout << "RECOGNIZED BY MODEL: Text=" << result->Text << std::endl;
+                cout << "  Intent Id: " << result->IntentId << std::endl;
+                cout << "  Intent Service JSON: " << result->Properties.GetProperty(PropertyId::LanguageUnderstandingServiceResponse_JsonResult) << std::endl;
+            }
+            else if (result->Reason == ResultReason::Canceled)
+            {
+                cout << "CANCELED: ErrorDetails=" << CancellationDetails::FromResult(result)->ErrorDetails << std::endl;
+            }
+            else
+            {
+                cout << "RECOGNIZED: Text=" << text << " (intent could not be recognized)" << std::endl;
+            }
+        });
+    });
+
+    recognizer->Canceled.Connect([](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().get();
+    recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    // Waits for the utterances that are still being recognized by the model.
+    SessionCompletion answered;
+    executor.Post([answered]() { answered.Complete(); });
+    answered.Wait();
+    cout << "Answered on the device: " << matcher.Hits() << ", sent to the service: " << matcher.Misses() << std::endl;
+}
@@ -0,0 +1,377 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A parsed json document, for reading the detailed json results of the service, e.g. the words and phonemes of a
+// pronunciation assessment. Members of objects are kept in document order and looked up by a linear search, which
+// is fast for the small objects of a result. Looking up a member that does not exist, or an element out of range,
+// returns a null value, so that optional parts of a result can be read without checks:
+//
+//     auto score = JsonValue::Parse(json)["NBest"][0]["PronunciationAssessment"]["AccuracyScore"].AsNumber();
+class JsonValue final
+{
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    JsonValue() = default;
+
+    // Parses a json document. Throws std::runtime_error if it is not valid json.
+    static JsonValue Parse(const std::string& text)
+    {
+        size_t position = 0;
+        JsonValue value = ParseValue(text, position, 0);
+        SkipSpace(text, position);
+        if (position != text.size())
+        {
+            Fail("unexpected text after the json value", position);
+        }
+        return value;
+    }
+
+    Type GetType() const
+    {
+        return m_type;
+    }
+
+    bool IsNull() const
+    {
+        return m_type == Type::Null;
+    }
+
+    // Returns the value of a number, or 'fallback' if this is not a number.
+    double AsNumber(double fallback = 0) const
+    {
+        return m_type == Type::Number ? m_number : fallback;
+    }
+
+    bool AsBool(bool fallback = false) const
+    {
+        return m_type == Type::Bool ? m_bool : fallback;
+    }
+
+    // Returns the value of a string, or an empty string if this is not a string.
+    const std::string& AsString() const
+    {
+        static const std::string empty;
+        return m_type == Type::String ? m_string : empty;
+    }
+
+    // Returns the number of elements of an array or members of an object, 0 for other values.
+    size_t Size() const
+    {
+        return m_type == Type::Array ? m_elements.size() : m_type == Type::Object ? m_members.size() : 0;
+    }
+
+    const JsonValue& operator[](size_t index) const
+    {
+        return m_type == Type::Array && index < m_elements.size() ? m_elements[index] : Null();
+    }
+
+    const JsonValue& operator[](int index) const
+    {
+        return index < 0 ? Null() : (*this)[(size_t)index];
+    }
+
+    const JsonValue& operator[](const char* name) const
+    {
+        for (const auto& member : m_members)
+        {
+            if (member.first == name)
+            {
+                return member.second;
+            }
+        }
+        return Null();
+    }
+
+    const JsonValue& operator[](const std::string& name) const
+    {
+        return (*this)[name.c_str()];
+    }
+
+    const std::vector<JsonValue>& Elements() const
+    {
+        return m_elements;
+    }
+
+    const std::vector<std::pair<std::string, JsonValue>>& Members() const
+    {
+        return m_members;
+    }
+
+private:
+    // Deeper documents are rejected, so that a malformed result cannot exhaust the stack.
+    static constexpr int maxDepth = 64;
+
+    static const JsonValue& Null()
+    {
+        static const JsonValue null;
+        return null;
+    }
+
+    [[noreturn]] static void Fail(const char* message, size_t position)
+    {
+        throw std::runtime_error(std::string("Invalid json: ") + message + " at offset " + std::to_string(position));
+    }
+
+    static void SkipSpace(const std::string& text, size_t& position)
+    {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\r' || text[position] == '\n'))
+        {
+            position++;
+        }
+    }
+
+    static bool Consume(const std::string& text, size_t& position, const char* literal)
+    {
+        const size_t length = strlen(literal);
+        if (text.compare(position, length, literal) != 0)
+        {
+            return false;
+        }
+        position += length;
+        return true;
+    }
+
+    static JsonValue ParseValue(const std::string& text, size_t& position, int depth)
+    {
+        if (depth > maxDepth)
+        {
+            Fail("nested too deeply", position);
+        }
+        SkipSpace(text, position);
+        if (position >= text.size())
+        {
+            Fail("unexpected end", position);
+        }
+
+        JsonValue value;
+        const char c = text[position];
+        if (c == '{')
+        {
+            value.m_type = Type::Object;
+            position++;
+            SkipSpace(text, position);
+            if (position < text.size() && text[position] == '}')
+            {
+                position++;
+                return value;
+            }
+            while (true)
+            {
+                SkipSpace(text, position);
+                if (position >= text.size() || text[position] != '"')
+                {
+                    Fail("expected a member name", position);
+                }
+                std::string name = ParseString(text, position);
+                SkipSpace(text, position);
+                if (position >= text.size() || text[position] != ':')
+                {
+                    Fail("expected ':'", position);
+                }
+                position++;
+                value.m_members.emplace_back(std::move(name), ParseValue(text, position, depth + 1));
+                if (!EndOfList(text, position, '}'))
+                {
+                    continue;
+                }
+                return value;
+            }
+        }
+        if (c == '[')
+        {
+            value.m_type = Type::Array;
+            position++;
+            SkipSpace(text, position);
+            if (position < text.size() && text[position] == ']')
+            {
+                position++;
+                return value;
+            }
+            while (true)
+            {
+                value.m_elements.push_back(ParseValue(text, position, depth + 1));
+                if (EndOfList(text, position, ']'))
+                {
+                    return value;
+                }
+            }
+        }
+        if (c == '"')
+        {
+            value.m_type = Type::String;
+            value.m_string = ParseString(text, position);
+            return value;
+        }
+        if (Consume(text, position, "true") || Consume(text, position, "false"))
+        {
+            value.m_type = Type::Bool;
+            value.m_bool = c == 't';
+            return value;
+        }
+        if (Consume(text, position, "null"))
+        {
+            return value;
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            const char* start = text.c_str() + position;
+            char* end = nullptr;
+            value.m_type = Type::Number;
+            value.m_number = strtod(start, &end);
+            if (end == start)
+            {
+                Fail("invalid number", position);
+            }
+            position += end - start;
+            return value;
+        }
+        Fail("unexpected character", position);
+    }
+
+    // Skips the ',' between the elements of a list, returns true after its closing character.
+    static bool EndOfList(const std::string& text, size_t& position, char close)
+    {
+        SkipSpace(text, position);
+        if (position < text.size() && text[position] == ',')
+        {
+            position++;
+            return false;
+        }
+        if (position < text.size() && text[position] == close)
+        {
+            position++;
+            return true;
+        }
+        Fail("expected ',' or the end of the list", position);
+    }
+
+    // Parses a string literal, escapes are decoded to UTF-8.
+    static std::string ParseString(const std::string& text, size_t& position)
+    {
+        std::string value;
+        position++;
+        while (true)
+        {
+            if (position >= text.size())
+            {
+                Fail("unterminated string", position);
+            }
+            const char c = text[position++];
+            if (c == '"')
+            {
+                return value;
+            }
+            if (c != '\\')
+            {
+                value += c;
+                continue;
+            }
+            if (position >= text.size())
+            {
+                Fail("unterminated string", position);
+            }
+            const char escaped = text[position++];
+            switch (escaped)
+            {
+            case '"': value += '"'; break;
+            case '\\': value += '\\'; break;
+            case '/': value += '/'; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'u':
+            {
+                uint32_t code = ParseHex(text, position);
+                // A character outside the basic plane is escaped as a surrogate pair.
+                if (code >= 0xd800 && code < 0xdc00 && Consume(text, position, "\\u"))
+                {
+                    const uint32_t low = ParseHex(text, position);
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                AppendUtf8(code, value);
+                break;
+            }
+            default:
+                Fail("invalid escape", position - 1);
+            }
+        }
+    }
+
+    static uint32_t ParseHex(const std::string& text, size_t& position)
+    {
+        if (position + 4 > text.size())
+        {
+            Fail("incomplete \\u escape", position);
+        }
+        uint32_t code = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            const char c = text[position++];
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+            {
+                code |= c - '0';
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                code |= c - 'a' + 10;
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                code |= c - 'A' + 10;
+            }
+            else
+            {
+                Fail("invalid \\u escape", position - 1);
+            }
+        }
+        return code;
+    }
+
+    static void AppendUtf8(uint32_t code, std::string& value)
+    {
+        if (code < 0x80)
+        {
+            value += (char)code;
+        }
+        else if (code < 0x800)
+        {
+            value += (char)(0xc0 | (code >> 6));
+            value += (char)(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+            value += (char)(0xe0 | (code >> 12));
+            value += (char)(0x80 | ((code >> 6) & 0x3f));
+            value += (char)(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            value += (char)(0xf0 | (code >> 18));
+            value += (char)(0x80 | ((code >> 12) & 0x3f));
+            value += (char)(0x80 | ((code >> 6) & 0x3f));
+            value += (char)(0x80 | (code & 0x3f));
+        }
+    }
+
+    Type m_type = Type::Null;
+    bool m_bool = false;
+    double m_number = 0;
+    std::string m_string;
+    std::vector<JsonValue> m_elements;
+    std::vector<std::pair<std::string, JsonValue>> m_members;
+};
@@ -0,0 +1,220 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Recognizes spoken commands that start with a keyword, e.g. on a far-field device that listens all day. While no
+// keyword has been spoken, the audio only goes to an on-device KeywordRecognizer, there is no service connection.
+// Once the keyword is recognized, a speech recognizer is created for the command, and the audio is routed to it.
+//
+// The command starts while the keyword is still being detected, so the last audio is kept in a pre-roll buffer. The
+// speech recognizer first gets the buffered audio from the end of the keyword on, and then the live audio. After the
+// command the gate goes back to listening for the keyword.
+class KeywordGatedRecognizer final
+{
+public:
+    // Creates the speech recognizer of a command with the given audio input, e.g. with SpeechRecognizer::FromConfig.
+    using RecognizerFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer>(
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> audioConfig)>;
+    // Called on the gate's thread with the result of each command.
+    using CommandHandler = std::function<void(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognitionResult>& result)>;
+
+    // 'format' is the format of the audio passed to Write(). 'preRollMilliseconds' should cover the time the
+    // keyword recognizer takes to confirm the keyword after it was spoken.
+    KeywordGatedRecognizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> model,
+        const WavFileReader::WAVEFORMAT& format, RecognizerFactory createRecognizer, CommandHandler onCommand,
+        uint32_t preRollMilliseconds = 2000)
+        : m_model(std::move(model)), m_format(format), m_createRecognizer(std::move(createRecognizer)), m_onCommand(std::move(onCommand))
+    {
+        if (m_model == nullptr || !m_createRecognizer || !m_onCommand)
+        {
+            throw std::invalid_argument("Keyword model, recognizer factory and command handler must be set");
+        }
+        if (format.AvgBytesPerSec == 0 || format.BlockAlign == 0)
+        {
+            throw std::invalid_argument("Audio format has no byte rate");
+        }
+        const uint64_t preRollBytes = (uint64_t)format.AvgBytesPerSec * preRollMilliseconds / 1000;
+        m_preRoll.resize((size_t)std::max<uint64_t>(preRollBytes - preRollBytes % format.BlockAlign, format.BlockAlign));
+        m_thread = std::thread(&KeywordGatedRecognizer::Run, this);
+    }
+
+    ~KeywordGatedRecognizer()
+    {
+        Stop();
+    }
+
+    KeywordGatedRecognizer(const KeywordGatedRecognizer&) = delete;
+    KeywordGatedRecognizer& operator=(const KeywordGatedRecognizer&) = delete;
+
+    // Passes captured audio to the gate, from the capture thread.
+    void Write(const uint8_t* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Only one of the streams is set: the command's while a command is recognized, otherwise the keyword's.
+        auto& stream = m_commandStream != nullptr ? m_commandStream : m_keywordStream;
+        if (stream != nullptr)
+        {
+            stream->Write(const_cast<uint8_t*>(data), (uint32_t)size);
+        }
+
+        // Keeps the last bytes in the pre-roll ring, the position in the ring is the position in the audio.
+        if (size > m_preRoll.size())
+        {
+            data += size - m_preRoll.size();
+            m_written += size - m_preRoll.size();
+            size = m_preRoll.size();
+        }
+        const size_t start = (size_t)(m_written % m_preRoll.size());
+        const size_t first = std::min(size, m_preRoll.size() - start);
+        memcpy(m_preRoll.data() + start, data, first);
+        memcpy(m_preRoll.data(), data + first, size - first);
+        m_written += size;
+    }
+
+    // Stops listening, a command that is being recognized ends with the audio written so far.
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+            {
+                return;
+            }
+            m_stopping = true;
+            // Closing the streams ends the recognition that reads from them. A stream is closed by whoever
+            // takes it out of its member, so it is closed once.
+            if (m_keywordStream != nullptr)
+            {
+                m_keywordStream->Close();
+                m_keywordStream.reset();
+            }
+            if (m_commandStream != nullptr)
+            {
+                m_commandStream->Close();
+                m_commandStream.reset();
+            }
+        }
+        m_changed.notify_all();
+        m_thread.join();
+    }
+
+    // Returns the number of keywords that opened a command.
+    uint64_t Keywords() const
+    {
+        return m_keywords;
+    }
+
+private:
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> CreateStream() const
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        return AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(m_format.SamplesPerSec, (uint8_t)m_format.BitsPerSample, (uint8_t)m_format.Channels));
+    }
+
+    // Returns the position of a time in the audio, in bytes rounded down to whole sample frames.
+    uint64_t BytesAt(uint64_t ticks) const
+    {
+        const uint64_t bytes = ticks / 10000 * m_format.AvgBytesPerSec / 1000;
+        return bytes - bytes % m_format.BlockAlign;
+    }
+
+    void Run()
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        while (true)
+        {
+            // Listens for the keyword on the device, on a new stream so that it does not get the audio of the last command.
+            auto keywordStream = CreateStream();
+            uint64_t keywordStreamStart;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopping)
+                {
+                    return;
+                }
+                m_keywordStream = keywordStream;
+                keywordStreamStart = m_written;
+            }
+            auto keywordRecognizer = KeywordRecognizer::FromConfig(AudioConfig::FromStreamInput(keywordStream));
+            auto keyword = keywordRecognizer->RecognizeOnceAsync(m_model).get();
+            if (keyword->Reason != ResultReason::RecognizedKeyword)
+            {
+                // The stream was closed by Stop(), or keyword recognition failed. Waits a moment before listening again.
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_keywordStream.reset();
+                m_changed.wait_for(lock, std::chrono::seconds(1), [this]() { return m_stopping; });
+                continue;
+            }
+
+            // Opens the command with the audio after the keyword that has been captured already.
+            auto commandStream = CreateStream();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopping)
+                {
+                    return;
+                }
+                m_keywordStream.reset();
+                const uint64_t keywordEnd = keywordStreamStart + BytesAt(keyword->Offset() + keyword->Duration());
+                const uint64_t oldest = m_written > m_preRoll.size() ? m_written - m_preRoll.size() : 0;
+                for (uint64_t position = std::max(keywordEnd, oldest); position < m_written;)
+                {
+                    const size_t start = (size_t)(position % m_preRoll.size());
+                    const size_t count = (size_t)std::min<uint64_t>(m_written - position, m_preRoll.size() - start);
+                    commandStream->Write(m_preRoll.data() + start, (uint32_t)count);
+                    position += count;
+                }
+                m_commandStream = commandStream;
+            }
+            keywordStream->Close();
+            m_keywords++;
+
+            auto recognizer = m_createRecognizer(AudioConfig::FromStreamInput(commandStream));
+            auto result = recognizer->RecognizeOnceAsync().get();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_commandStream != nullptr)
+                {
+                    m_commandStream->Close();
+                    m_commandStream.reset();
+                }
+            }
+            m_onCommand(result);
+        }
+    }
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> m_model;
+    const WavFileReader::WAVEFORMAT m_format;
+    const RecognizerFactory m_createRecognizer;
+    const CommandHandler m_onCommand;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_keywordStream;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_commandStream;
+    std::vector<uint8_t> m_preRoll;
+    // The number of bytes written so far.
+    uint64_t m_written = 0;
+    bool m_stopping = false;
+    std::atomic<uint64_t> m_keywords{ 0 };
+    std::thread m_thread;
+};
@@ -0,0 +1,197 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utterance_audio_cache.h"
+#include "wav_file_reader.h"
+
+// Translates the segments of a recognition with language detection, but only the segments whose language has a
+// route, and only into the target languages of that route. E.g. with the route zh-CN -> en, the Chinese segments
+// of a mixed English and Chinese call are translated into English, and the English segments are not translated.
+//
+// The recognition reads the audio once. The translator keeps the audio that has not been recognized yet, and
+// when a segment is recognized it cuts out the segment's time range and sends only that audio to a translation
+// recognizer for the segment's language. The file is never read a second time.
+//
+// Segments are handed to the handler in the order they were recognized, on the translator's worker thread.
+class LanguageRoutedTranslator final
+{
+public:
+    struct Segment
+    {
+        std::string Language;
+        std::string Text;
+        // In ticks (100 nanoseconds) from the start of the audio.
+        uint64_t Offset = 0;
+        uint64_t Duration = 0;
+        // Empty if the language has no route.
+        std::map<std::string, std::string> Translations;
+        // Empty unless the translation of a routed segment failed.
+        std::string Error;
+    };
+
+    using SegmentHandler = std::function<void(const Segment& segment)>;
+    // Creates a translation config with the subscription, the translator sets the languages.
+    using ConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Translation::SpeechTranslationConfig>()>;
+
+    // 'routes' maps a detected language, e.g. "zh-CN", to the target languages of its translation, e.g. { "en" }.
+    // 'format' is the format of the audio passed to AddAudio().
+    LanguageRoutedTranslator(const ConfigFactory& createConfig, const std::map<std::string, std::vector<std::string>>& routes,
+        const WavFileReader::WAVEFORMAT& format, SegmentHandler onSegment)
+        : m_audio(format), m_onSegment(std::move(onSegment))
+    {
+        if (!m_onSegment)
+        {
+            throw std::invalid_argument("Segment handler must be set");
+        }
+        for (const auto& route : routes)
+        {
+            auto config = createConfig();
+            config->SetSpeechRecognitionLanguage(route.first);
+            for (const auto& target : route.second)
+            {
+                config->AddTargetLanguage(target);
+            }
+            m_configs[route.first] = config;
+        }
+        m_worker = std::thread(&LanguageRoutedTranslator::Run, this);
+    }
+
+    ~LanguageRoutedTranslator()
+    {
+        Finish();
+    }
+
+    LanguageRoutedTranslator(const LanguageRoutedTranslator&) = delete;
+    LanguageRoutedTranslator& operator=(const LanguageRoutedTranslator&) = delete;
+
+    // Keeps audio that is being streamed to the recognizer, e.g. from its pull stream callback.
+    void AddAudio(const uint8_t* data, size_t size)
+    {
+        m_audio.Add(data, size);
+    }
+
+    // Routes a result of the recognizer, e.g. from its Recognized event. Results must be passed in order.
+    void OnRecognized(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognitionResult>& result)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (result->Reason != ResultReason::RecognizedSpeech)
+        {
+            return;
+        }
+        Job job;
+        job.Recognized.Language = AutoDetectSourceLanguageResult::FromResult(result)->Language;
+        job.Recognized.Text = result->Text;
+        job.Recognized.Offset = result->Offset();
+        job.Recognized.Duration = result->Duration();
+        // Only the audio of routed segments is kept, the audio of the others is released.
+        job.Audio = m_audio.Take(job.Recognized.Offset, job.Recognized.Duration, m_configs.count(job.Recognized.Language) != 0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+        m_changed.notify_all();
+    }
+
+    // Waits until all segments passed so far have been handed to the handler.
+    void Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_finishing)
+            {
+                return;
+            }
+            m_finishing = true;
+        }
+        m_changed.notify_all();
+        m_worker.join();
+    }
+
+private:
+    struct Job
+    {
+        Segment Recognized;
+        std::vector<uint8_t> Audio;
+    };
+
+    void Run()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this]() { return m_finishing || !m_jobs.empty(); });
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            auto config = m_configs.find(job.Recognized.Language);
+            if (config != m_configs.end())
+            {
+                Translate(config->second, job);
+            }
+            m_onSegment(job.Recognized);
+        }
+    }
+
+    void Translate(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Translation::SpeechTranslationConfig>& config, Job& job) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        using namespace Microsoft::CognitiveServices::Speech::Translation;
+
+        if (job.Audio.empty())
+        {
+            job.Recognized.Error = "The audio of the segment is no longer available";
+            return;
+        }
+        // The segment is one utterance, so a single shot recognition of its audio translates all of it.
+        const auto& format = m_audio.Format();
+        auto pushStream = AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels));
+        pushStream->Write(job.Audio.data(), (uint32_t)job.Audio.size());
+        pushStream->Close();
+        auto recognizer = TranslationRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+        auto result = recognizer->RecognizeOnceAsync().get();
+        if (result->Reason == ResultReason::TranslatedSpeech)
+        {
+            job.Recognized.Translations = result->Translations;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            job.Recognized.Error = CancellationDetails::FromResult(result)->ErrorDetails;
+        }
+        else
+        {
+            job.Recognized.Error = "The segment could not be translated";
+        }
+    }
+
+    UtteranceAudioCache m_audio;
+    const SegmentHandler m_onSegment;
+    std::map<std::string, std::shared_ptr<Microsoft::CognitiveServices::Speech::Translation::SpeechTranslationConfig>> m_configs;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<Job> m_jobs;
+    bool m_finishing = false;
+    std::thread m_worker;
+};
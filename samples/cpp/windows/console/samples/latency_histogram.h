@@ -0,0 +1,169 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <utility>
+
+// Counts latencies in buckets of fixed relative precision, in the manner of an HDR histogram: values below 128
+// microseconds are counted exactly, larger values in 64 buckets per power of two, so every value is within 1.6%
+// of its bucket. Memory does not grow with the number of values, which makes it suitable for load tests that
+// run for hours. Values can be recorded from any number of threads without locks.
+class LatencyHistogram final
+{
+public:
+    LatencyHistogram()
+        : m_counts(new std::atomic<uint64_t>[bucketCount])
+    {
+        for (size_t i = 0; i < bucketCount; i++)
+        {
+            m_counts[i] = 0;
+        }
+    }
+
+    // Must not be called while values are added to 'other'.
+    LatencyHistogram(LatencyHistogram&& other)
+        : m_counts(std::move(other.m_counts)), m_count(other.m_count.load()), m_sum(other.m_sum.load()), m_max(other.m_max.load())
+    {
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void Add(double milliseconds)
+    {
+        const uint64_t microseconds = milliseconds <= 0 ? 0 : (uint64_t)(milliseconds * 1000);
+        m_counts[Index(microseconds)]++;
+        m_count++;
+        m_sum += microseconds;
+        uint64_t max = m_max;
+        while (microseconds > max && !m_max.compare_exchange_weak(max, microseconds))
+        {
+        }
+    }
+
+    // Adds the counts of another histogram. Not atomic with regard to values being added to 'other'.
+    void Merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < bucketCount; i++)
+        {
+            m_counts[i] += other.m_counts[i].load();
+        }
+        m_count += other.m_count.load();
+        m_sum += other.m_sum.load();
+        uint64_t max = m_max;
+        const uint64_t otherMax = other.m_max;
+        while (otherMax > max && !m_max.compare_exchange_weak(max, otherMax))
+        {
+        }
+    }
+
+    uint64_t Count() const
+    {
+        return m_count;
+    }
+
+    double Mean() const
+    {
+        const uint64_t count = m_count;
+        return count == 0 ? 0 : m_sum / 1000.0 / count;
+    }
+
+    double Max() const
+    {
+        return m_max / 1000.0;
+    }
+
+    // Returns the p-th percentile (0 < p <= 100) in milliseconds, as the highest value of the bucket that holds it,
+    // 0 if there are no values.
+    double Percentile(double p) const
+    {
+        const uint64_t count = m_count;
+        if (count == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(p / 100 * count + 0.999999);
+        rank = rank == 0 ? 1 : rank > count ? count : rank;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; i++)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+            {
+                const uint64_t highest = HighestValueOf(i);
+                return (highest < m_max ? highest : m_max.load()) / 1000.0;
+            }
+        }
+        return Max();
+    }
+
+    // Writes the statistics and the non-empty buckets as a json object:
+    // {"count":..,"mean":..,"p50":..,"p90":..,"p99":..,"p999":..,"max":..,"buckets":[[highest ms,count],..]}.
+    void WriteJson(std::ostream& os) const
+    {
+        os << "{\"count\":" << Count()
+           << ",\"mean\":" << Mean()
+           << ",\"p50\":" << Percentile(50)
+           << ",\"p90\":" << Percentile(90)
+           << ",\"p99\":" << Percentile(99)
+           << ",\"p999\":" << Percentile(99.9)
+           << ",\"max\":" << Max() << ",\"buckets\":[";
+        bool first = true;
+        for (size_t i = 0; i < bucketCount; i++)
+        {
+            const uint64_t count = m_counts[i];
+            if (count != 0)
+            {
+                os << (first ? "" : ",") << "[" << HighestValueOf(i) / 1000.0 << "," << count << "]";
+                first = false;
+            }
+        }
+        os << "]}";
+    }
+
+private:
+    static constexpr int subBucketBits = 6;
+    static constexpr uint64_t exactLimit = 2ull << subBucketBits;
+    // Exact values, then 64 buckets for each power of two from 2^7 to 2^63.
+    static constexpr size_t bucketCount = (size_t)exactLimit + (63 - subBucketBits) * (1ull << subBucketBits);
+
+    static size_t Index(uint64_t value)
+    {
+        if (value < exactLimit)
+        {
+            return (size_t)value;
+        }
+        int msb = 0;
+        while ((value >> msb) > 1)
+        {
+            msb++;
+        }
+        // Keeps the top 7 bits of the value, of which the first is always set.
+        const int shift = msb - subBucketBits;
+        const uint64_t top = value >> shift;
+        return (size_t)(exactLimit + (shift - 1) * (1ull << subBucketBits) + (top - (1ull << subBucketBits)));
+    }
+
+    static uint64_t HighestValueOf(size_t index)
+    {
+        if (index < exactLimit)
+        {
+            return index;
+        }
+        const size_t offset = index - (size_t)exactLimit;
+        const int shift = (int)(offset >> subBucketBits) + 1;
+        const uint64_t top = (offset & ((1ull << subBucketBits) - 1)) + (1ull << subBucketBits);
+        return ((top + 1) << shift) - 1;
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    std::atomic<uint64_t> m_count{ 0 };
+    std::atomic<uint64_t> m_sum{ 0 };
+    std::atomic<uint64_t> m_max{ 0 };
+};
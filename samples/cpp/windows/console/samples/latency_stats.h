@@ -0,0 +1,84 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+// Collects latency samples in milliseconds and reports percentiles.
+class LatencyStats final
+{
+public:
+    void Add(double milliseconds)
+    {
+        m_samples.push_back(milliseconds);
+        m_sorted = false;
+    }
+
+    // Adds the samples of another collection, e.g. to combine the stats that worker threads kept separately.
+    void Merge(const LatencyStats& other)
+    {
+        m_samples.insert(m_samples.end(), other.m_samples.begin(), other.m_samples.end());
+        m_sorted = m_samples.empty();
+    }
+
+    size_t Count() const
+    {
+        return m_samples.size();
+    }
+
+    // Returns the p-th percentile (0 < p <= 100) using the nearest-rank method, 0 if there are no samples.
+    double Percentile(double p)
+    {
+        if (m_samples.empty())
+        {
+            return 0;
+        }
+        Sort();
+        size_t rank = (size_t)std::ceil(p / 100 * m_samples.size());
+        return m_samples[rank == 0 ? 0 : std::min(rank, m_samples.size()) - 1];
+    }
+
+    double Mean() const
+    {
+        double sum = 0;
+        for (double sample : m_samples)
+        {
+            sum += sample;
+        }
+        return m_samples.empty() ? 0 : sum / m_samples.size();
+    }
+
+    double Max()
+    {
+        return Percentile(100);
+    }
+
+    // Writes the statistics as a json object: {"count":..,"mean":..,"p50":..,"p95":..,"p99":..,"max":..}.
+    void WriteJson(std::ostream& os)
+    {
+        os << "{\"count\":" << Count()
+           << ",\"mean\":" << Mean()
+           << ",\"p50\":" << Percentile(50)
+           << ",\"p95\":" << Percentile(95)
+           << ",\"p99\":" << Percentile(99)
+           << ",\"max\":" << Max() << "}";
+    }
+
+private:
+    void Sort()
+    {
+        if (!m_sorted)
+        {
+            std::sort(m_samples.begin(), m_samples.end());
+            m_sorted = true;
+        }
+    }
+
+    std::vector<double> m_samples;
+    bool m_sorted = true;
+};
@@ -0,0 +1,626 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.h"
+#include "latency_stats.h"
+
+// Thrown by a scenario when the service canceled the session, so that the load runner can report cancellations,
+// and throttling in particular, separately from other failures.
+class LoadTestFailure final : public std::runtime_error
+{
+public:
+    enum class Kind { Canceled, Throttled };
+
+    LoadTestFailure(Kind kind, const std::string& message)
+        : std::runtime_error(message), m_kind(kind)
+    {
+    }
+
+    Kind GetKind() const
+    {
+        return m_kind;
+    }
+
+private:
+    Kind m_kind;
+};
+
+// Runs a scenario over and over for a fixed time, and reports the throughput and the latency of its iterations.
+//
+// By default the runner is a closed loop: each of a number of workers runs one iteration at a time, so the
+// concurrency is the number of sessions in flight. With an arrival rate it is an open loop instead: sessions are
+// started at that rate whether or not earlier ones have completed, each on its own thread, as independent callers
+// would. A closed loop slows down with the service and hides how latency grows under load, an open loop keeps the
+// load constant and shows it, which is what finding the concurrency a region can take requires. Latencies of an
+// open loop are measured from the time the session was due to start.
+//
+// Workers and sessions keep their measurements to themselves while running, they are only combined into the report
+// when they end, so measuring adds no contention between the sessions under test.
+class LoadRunner final
+{
+public:
+    enum class Arrivals
+    {
+        // Sessions start at even intervals.
+        Fixed,
+        // Sessions start at random intervals with the given mean rate, like calls arriving independently.
+        Poisson
+    };
+
+    struct Options
+    {
+        // The number of workers of a closed loop.
+        size_t Concurrency = 1;
+        // Sessions started per second by an open loop, 0 runs a closed loop.
+        double ArrivalRate = 0;
+        Arrivals ArrivalProcess = Arrivals::Poisson;
+        // An open loop does not start sessions while this many are running, and counts them as dropped instead.
+        size_t MaxInFlight = 1000;
+        // Seeds the random intervals of Poisson arrivals, so that runs can be repeated.
+        uint32_t Seed = 1;
+        // No iterations are started after this time, iterations that are running are completed.
+        std::chrono::seconds Duration = std::chrono::seconds(60);
+        // Stops after this many iterations in total, 0 for no limit.
+        uint64_t MaxIterations = 0;
+        // Progress is written to the progress stream at this interval, 0 for no progress.
+        std::chrono::seconds ProgressInterval = std::chrono::seconds(10);
+        // Failures with more distinct error messages than this are counted together, so that errors which include
+        // e.g. a session id do not grow the report without bounds.
+        size_t MaxDistinctErrors = 32;
+    };
+
+    // One run of the scenario, passed to the scenario by the worker that runs it.
+    class Iteration final
+    {
+    public:
+        Iteration(size_t worker, uint64_t number, std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now())
+            : m_worker(worker), m_number(number), m_start(start)
+        {
+        }
+
+        // The worker of a closed loop, the same as the number in an open loop.
+        size_t Worker() const
+        {
+            return m_worker;
+        }
+
+        // Numbers iterations across all workers, starting at 0, e.g. to pick the input of the iteration.
+        uint64_t Number() const
+        {
+            return m_number;
+        }
+
+        double ElapsedMilliseconds() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+        // Records the time since the iteration started under a name, e.g. "firstRecognizedMs" when the first result
+        // arrives. Can be called from the SDK's event threads, but not after the scenario has returned.
+        void Mark(const std::string& name)
+        {
+            Record(name, ElapsedMilliseconds());
+        }
+
+        // Records a value of the iteration under a name, e.g. a latency that the service reports with a result.
+        void Record(const std::string& name, double value)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_values.emplace_back(name, value);
+        }
+
+    private:
+        friend class LoadRunner;
+
+        const size_t m_worker;
+        const uint64_t m_number;
+        const std::chrono::steady_clock::time_point m_start;
+        std::mutex m_mutex;
+        std::vector<std::pair<std::string, double>> m_values;
+    };
+
+    // Runs one iteration of a scenario, and throws to report that it failed.
+    using Scenario = std::function<void(Iteration& iteration)>;
+
+    // Creates the scenario of a worker, on the worker's thread, so that a worker can reuse e.g. a synthesizer
+    // across its iterations, as an application would. An open loop creates a scenario for each session.
+    using ScenarioFactory = std::function<Scenario(size_t worker)>;
+
+    // What happened in one second of the run, by the time iterations started or completed.
+    struct Second
+    {
+        uint64_t Started = 0;
+        uint64_t Completed = 0;
+        uint64_t Failed = 0;
+        uint64_t Canceled = 0;
+        uint64_t Throttled = 0;
+        uint64_t Dropped = 0;
+        // The sum of the latencies of the successful iterations that completed in this second.
+        double LatencySum = 0;
+    };
+
+    struct Report
+    {
+        uint64_t Iterations = 0;
+        uint64_t Failures = 0;
+        // Failures the service canceled, including those it throttled.
+        uint64_t Canceled = 0;
+        uint64_t Throttled = 0;
+        // Sessions of an open loop that were not started because too many were running.
+        uint64_t Dropped = 0;
+        double Seconds = 0;
+        // Completed iterations, successful or not, per second.
+        double Throughput = 0;
+        // The duration of the successful iterations.
+        LatencyStats Latency;
+        LatencyHistogram Histogram;
+        // The values recorded by the successful iterations, by name.
+        std::map<std::string, LatencyStats> Values;
+        // The number of failures by error message.
+        std::map<std::string, uint64_t> Errors;
+        std::vector<Second> Timeline;
+
+        // Writes the report as a json object.
+        void WriteJson(std::ostream& os)
+        {
+            os << "{\"iterations\":" << Iterations << ",\"failures\":" << Failures << ",\"canceled\":" << Canceled
+               << ",\"throttled\":" << Throttled << ",\"dropped\":" << Dropped
+               << ",\"seconds\":" << Seconds << ",\"throughput\":" << Throughput << ",\"latencyMs\":";
+            Latency.WriteJson(os);
+            os << ",\"latencyHistogramMs\":";
+            Histogram.WriteJson(os);
+            for (auto& value : Values)
+            {
+                os << ",\"" << Escape(value.first) << "\":";
+                value.second.WriteJson(os);
+            }
+            os << ",\"errors\":{";
+            bool first = true;
+            for (const auto& error : Errors)
+            {
+                os << (first ? "" : ",") << "\"" << Escape(error.first) << "\":" << error.second;
+                first = false;
+            }
+            os << "},\"timeline\":[";
+            for (size_t i = 0; i < Timeline.size(); i++)
+            {
+                const auto& second = Timeline[i];
+                const uint64_t succeeded = second.Completed - second.Failed;
+                os << (i == 0 ? "" : ",") << "{\"second\":" << i << ",\"started\":" << second.Started
+                   << ",\"completed\":" << second.Completed << ",\"failed\":" << second.Failed
+                   << ",\"canceled\":" << second.Canceled << ",\"throttled\":" << second.Throttled
+                   << ",\"dropped\":" << second.Dropped
+                   << ",\"meanLatencyMs\":" << (succeeded == 0 ? 0 : second.LatencySum / succeeded) << "}";
+            }
+            os << "]}";
+        }
+
+    private:
+        static std::string Escape(const std::string& text)
+        {
+            std::string escaped;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    escaped += '\\';
+                    escaped += c;
+                }
+                else if ((unsigned char)c < 0x20)
+                {
+                    escaped += ' ';
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+            return escaped;
+        }
+    };
+
+    LoadRunner()
+        : LoadRunner(Options())
+    {
+    }
+
+    explicit LoadRunner(const Options& options)
+        : m_options(options)
+    {
+        if (options.Concurrency == 0 || options.MaxInFlight == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1");
+        }
+        if (options.ArrivalRate < 0)
+        {
+            throw std::invalid_argument("The arrival rate must not be negative");
+        }
+        if (options.Duration.count() <= 0 && options.MaxIterations == 0)
+        {
+            throw std::invalid_argument("Either a duration or a number of iterations must be set");
+        }
+    }
+
+    // Runs the scenario until the duration has passed, or the maximum number of iterations has been started, and
+    // waits for the running iterations to complete. Progress is written to 'progress' while running.
+    Report Run(const ScenarioFactory& factory, std::ostream& progress)
+    {
+        RunState run;
+        run.Start = std::chrono::steady_clock::now();
+        run.Deadline = m_options.Duration.count() > 0 ? run.Start + m_options.Duration : std::chrono::steady_clock::time_point::max();
+
+        WorkerResult total;
+        if (m_options.ArrivalRate > 0)
+        {
+            RunOpenLoop(run, factory, progress, total);
+        }
+        else
+        {
+            RunClosedLoop(run, factory, progress, total);
+        }
+
+        Report report;
+        report.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run.Start).count();
+        report.Iterations = total.Iterations;
+        report.Failures = total.Failures;
+        report.Canceled = total.Canceled;
+        report.Throttled = total.Throttled;
+        report.Dropped = total.Dropped;
+        report.Throughput = report.Seconds > 0 ? report.Iterations / report.Seconds : 0;
+        report.Latency.Merge(total.Latency);
+        report.Histogram.Merge(total.Histogram);
+        report.Values = std::move(total.Values);
+        report.Errors = std::move(total.Errors);
+        report.Timeline = std::move(total.Timeline);
+        return report;
+    }
+
+private:
+    // The state of a run that its workers share.
+    struct RunState
+    {
+        std::chrono::steady_clock::time_point Start;
+        std::chrono::steady_clock::time_point Deadline;
+        std::atomic<uint64_t> Started{ 0 };
+        std::atomic<uint64_t> Completed{ 0 };
+        std::atomic<uint64_t> Failed{ 0 };
+    };
+
+    // The measurements of a worker, or of a session of an open loop.
+    struct WorkerResult
+    {
+        uint64_t Iterations = 0;
+        uint64_t Failures = 0;
+        uint64_t Canceled = 0;
+        uint64_t Throttled = 0;
+        uint64_t Dropped = 0;
+        LatencyStats Latency;
+        LatencyHistogram Histogram;
+        std::map<std::string, LatencyStats> Values;
+        std::map<std::string, uint64_t> Errors;
+        std::vector<Second> Timeline;
+    };
+
+    // A session of an open loop, on its own thread.
+    struct Session
+    {
+        std::thread Thread;
+        WorkerResult Result;
+        std::atomic<bool> Done{ false };
+    };
+
+    void RunClosedLoop(RunState& run, const ScenarioFactory& factory, std::ostream& progress, WorkerResult& total)
+    {
+        std::atomic<size_t> running{ m_options.Concurrency };
+        std::mutex doneMutex;
+        std::condition_variable done;
+
+        std::vector<WorkerResult> results(m_options.Concurrency);
+        std::vector<std::thread> workers;
+        for (size_t worker = 0; worker < m_options.Concurrency; worker++)
+        {
+            workers.emplace_back([&, worker]()
+            {
+                RunWorker(run, worker, factory, results[worker]);
+                {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    running--;
+                }
+                done.notify_one();
+            });
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(doneMutex);
+            auto nextProgress = run.Start + m_options.ProgressInterval;
+            while (running > 0)
+            {
+                if (m_options.ProgressInterval.count() <= 0)
+                {
+                    done.wait(lock);
+                    continue;
+                }
+                if (done.wait_until(lock, nextProgress) == std::cv_status::timeout)
+                {
+                    WriteProgress(progress, run, nextProgress, running, "workers");
+                    nextProgress += m_options.ProgressInterval;
+                }
+            }
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        for (auto& result : results)
+        {
+            Merge(result, total);
+        }
+    }
+
+    void RunWorker(RunState& run, size_t worker, const ScenarioFactory& factory, WorkerResult& result)
+    {
+        Scenario scenario;
+        if (!CreateScenario(run, factory, worker, std::chrono::steady_clock::now(), scenario, result))
+        {
+            return;
+        }
+        while (std::chrono::steady_clock::now() < run.Deadline)
+        {
+            const uint64_t number = run.Started++;
+            if (m_options.MaxIterations != 0 && number >= m_options.MaxIterations)
+            {
+                break;
+            }
+            Iteration iteration(worker, number);
+            SecondAt(result.Timeline, run, iteration.m_start).Started++;
+            RunIteration(run, scenario, iteration, result);
+        }
+    }
+
+    void RunOpenLoop(RunState& run, const ScenarioFactory& factory, std::ostream& progress, WorkerResult& total)
+    {
+        std::mt19937 random(m_options.Seed);
+        std::exponential_distribution<double> poissonInterval(m_options.ArrivalRate);
+        const double fixedInterval = 1 / m_options.ArrivalRate;
+
+        std::list<std::unique_ptr<Session>> sessions;
+        auto due = run.Start;
+        auto nextProgress = run.Start + m_options.ProgressInterval;
+        while (due < run.Deadline)
+        {
+            if (m_options.ProgressInterval.count() > 0)
+            {
+                while (nextProgress <= due)
+                {
+                    std::this_thread::sleep_until(nextProgress);
+                    Reap(sessions, total);
+                    WriteProgress(progress, run, nextProgress, sessions.size(), "sessions");
+                    nextProgress += m_options.ProgressInterval;
+                }
+            }
+            std::this_thread::sleep_until(due);
+            Reap(sessions, total);
+
+            const uint64_t number = run.Started++;
+            if (m_options.MaxIterations != 0 && number >= m_options.MaxIterations)
+            {
+                break;
+            }
+            if (sessions.size() >= m_options.MaxInFlight)
+            {
+                total.Dropped++;
+                SecondAt(total.Timeline, run, due).Dropped++;
+            }
+            else
+            {
+                SecondAt(total.Timeline, run, due).Started++;
+                sessions.emplace_back(new Session());
+                Session* session = sessions.back().get();
+                session->Thread = std::thread([this, &run, &factory, session, number, due]()
+                {
+                    Scenario scenario;
+                    if (CreateScenario(run, factory, (size_t)number, due, scenario, session->Result))
+                    {
+                        Iteration iteration((size_t)number, number, due);
+                        RunIteration(run, scenario, iteration, session->Result);
+                    }
+                    session->Done = true;
+                });
+            }
+
+            const double interval = m_options.ArrivalProcess == Arrivals::Fixed ? fixedInterval : poissonInterval(random);
+            due += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval));
+        }
+
+        for (auto& session : sessions)
+        {
+            session->Thread.join();
+            Merge(session->Result, total);
+        }
+    }
+
+    // Joins the sessions that are done, and adds their measurements to the total.
+    void Reap(std::list<std::unique_ptr<Session>>& sessions, WorkerResult& total)
+    {
+        for (auto it = sessions.begin(); it != sessions.end();)
+        {
+            if ((*it)->Done)
+            {
+                (*it)->Thread.join();
+                Merge((*it)->Result, total);
+                it = sessions.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // Creates the scenario of a worker or session. A worker that cannot set up its scenario counts as one failure.
+    bool CreateScenario(RunState& run, const ScenarioFactory& factory, size_t worker, std::chrono::steady_clock::time_point start,
+        Scenario& scenario, WorkerResult& result)
+    {
+        std::string error;
+        try
+        {
+            scenario = factory(worker);
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            error = std::string("Scenario setup failed: ") + e.what();
+        }
+        result.Iterations++;
+        result.Failures++;
+        CountError(result.Errors, error, 1);
+        auto& second = SecondAt(result.Timeline, run, start);
+        second.Completed++;
+        second.Failed++;
+        run.Completed++;
+        run.Failed++;
+        return false;
+    }
+
+    void RunIteration(RunState& run, const Scenario& scenario, Iteration& iteration, WorkerResult& result)
+    {
+        std::string error;
+        bool canceled = false;
+        bool throttled = false;
+        try
+        {
+            scenario(iteration);
+        }
+        catch (const LoadTestFailure& e)
+        {
+            error = e.what();
+            canceled = true;
+            throttled = e.GetKind() == LoadTestFailure::Kind::Throttled;
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+            if (error.empty())
+            {
+                error = "Unknown error";
+            }
+        }
+        const double elapsed = iteration.ElapsedMilliseconds();
+        auto& second = SecondAt(result.Timeline, run, std::chrono::steady_clock::now());
+
+        result.Iterations++;
+        second.Completed++;
+        if (!error.empty())
+        {
+            result.Failures++;
+            second.Failed++;
+            if (canceled)
+            {
+                result.Canceled++;
+                second.Canceled++;
+            }
+            if (throttled)
+            {
+                result.Throttled++;
+                second.Throttled++;
+            }
+            CountError(result.Errors, error, 1);
+            run.Failed++;
+        }
+        else
+        {
+            result.Latency.Add(elapsed);
+            result.Histogram.Add(elapsed);
+            second.LatencySum += elapsed;
+            std::lock_guard<std::mutex> lock(iteration.m_mutex);
+            for (const auto& value : iteration.m_values)
+            {
+                result.Values[value.first].Add(value.second);
+            }
+        }
+        run.Completed++;
+    }
+
+    static Second& SecondAt(std::vector<Second>& timeline, const RunState& run, std::chrono::steady_clock::time_point time)
+    {
+        const auto index = time <= run.Start ? 0 : (size_t)std::chrono::duration_cast<std::chrono::seconds>(time - run.Start).count();
+        if (timeline.size() <= index)
+        {
+            timeline.resize(index + 1);
+        }
+        return timeline[index];
+    }
+
+    void Merge(WorkerResult& result, WorkerResult& total) const
+    {
+        total.Iterations += result.Iterations;
+        total.Failures += result.Failures;
+        total.Canceled += result.Canceled;
+        total.Throttled += result.Throttled;
+        total.Dropped += result.Dropped;
+        total.Latency.Merge(result.Latency);
+        total.Histogram.Merge(result.Histogram);
+        for (const auto& value : result.Values)
+        {
+            total.Values[value.first].Merge(value.second);
+        }
+        for (const auto& error : result.Errors)
+        {
+            CountError(total.Errors, error.first, error.second);
+        }
+        if (total.Timeline.size() < result.Timeline.size())
+        {
+            total.Timeline.resize(result.Timeline.size());
+        }
+        for (size_t i = 0; i < result.Timeline.size(); i++)
+        {
+            auto& second = total.Timeline[i];
+            const auto& other = result.Timeline[i];
+            second.Started += other.Started;
+            second.Completed += other.Completed;
+            second.Failed += other.Failed;
+            second.Canceled += other.Canceled;
+            second.Throttled += other.Throttled;
+            second.Dropped += other.Dropped;
+            second.LatencySum += other.LatencySum;
+        }
+    }
+
+    static void WriteProgress(std::ostream& progress, const RunState& run, std::chrono::steady_clock::time_point at, size_t running, const char* what)
+    {
+        progress << std::chrono::duration_cast<std::chrono::seconds>(at - run.Start).count() << " s: "
+                 << run.Completed << " iterations, " << run.Failed << " failed, " << running << " " << what << " running." << std::endl;
+    }
+
+    void CountError(std::map<std::string, uint64_t>& errors, const std::string& error, uint64_t count) const
+    {
+        if (errors.count(error) == 0 && errors.size() >= m_options.MaxDistinctErrors)
+        {
+            errors["Other errors"] += count;
+            return;
+        }
+        errors[error] += count;
+    }
+
+    const Options m_options;
+};
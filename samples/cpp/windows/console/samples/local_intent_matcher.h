@@ -0,0 +1,396 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Matches the recognized text of an utterance against a fixed set of command patterns on the device, so that
+// common commands get their intent without a call to the Language Understanding service. Utterances that do not
+// match with enough confidence are left to the service.
+//
+// A pattern is a phrase like "turn on the {device}". Words are matched ignoring case and punctuation. An entity in
+// braces matches the values given by AddEntityValues, or any one to 'maxEntityWords' words if it has none.
+//
+// Compile() builds an Aho-Corasick automaton over the first literal words of all patterns, so finding the candidate
+// patterns takes a single pass over the text however many patterns there are. Only the candidates are then matched
+// word by word. After Compile() the matcher is read only and TryMatch can be called from any thread.
+class LocalIntentMatcher final
+{
+public:
+    struct Match
+    {
+        std::string IntentId;
+        std::string Pattern;
+        // The share of the words of the utterance that the pattern covers, 1 if it covers all of them.
+        double Confidence = 0;
+        // Maps the name of each entity of the pattern to the words it matched.
+        std::map<std::string, std::string> Entities;
+    };
+
+    // 'minConfidence' is the confidence a match needs to be accepted by TryMatch.
+    explicit LocalIntentMatcher(double minConfidence = 0.8, size_t maxEntityWords = 3)
+        : m_minConfidence(minConfidence), m_maxEntityWords(maxEntityWords)
+    {
+        if (minConfidence <= 0 || minConfidence > 1 || maxEntityWords == 0)
+        {
+            throw std::invalid_argument("Confidence must be in (0, 1] and entities must match at least one word");
+        }
+    }
+
+    LocalIntentMatcher(const LocalIntentMatcher&) = delete;
+    LocalIntentMatcher& operator=(const LocalIntentMatcher&) = delete;
+
+    // Adds a pattern of an intent, like the phrases passed to IntentRecognizer::AddIntent.
+    void AddIntent(const std::string& pattern, const std::string& intentId)
+    {
+        ThrowIfCompiled();
+        Pattern compiled;
+        compiled.IntentId = intentId;
+        compiled.Text = pattern;
+        size_t position = 0;
+        while (position < pattern.size())
+        {
+            const size_t open = pattern.find('{', position);
+            AddWords(pattern.substr(position, open == std::string::npos ? std::string::npos : open - position), compiled);
+            if (open == std::string::npos)
+            {
+                break;
+            }
+            const size_t close = pattern.find('}', open);
+            if (close == std::string::npos || close == open + 1)
+            {
+                throw std::invalid_argument("Pattern has an unnamed or unclosed entity: " + pattern);
+            }
+            Item entity;
+            entity.Entity = true;
+            entity.Word = pattern.substr(open + 1, close - open - 1);
+            compiled.Items.push_back(entity);
+            position = close + 1;
+        }
+
+        // The automaton finds a pattern by its first literal words, so a pattern of entities only cannot be found.
+        size_t first = 0;
+        while (first < compiled.Items.size() && compiled.Items[first].Entity)
+        {
+            first++;
+        }
+        if (first == compiled.Items.size())
+        {
+            throw std::invalid_argument("Pattern has no words: " + pattern);
+        }
+        compiled.LeadingEntities = first;
+        m_patterns.push_back(std::move(compiled));
+    }
+
+    // Restricts an entity to a list of values, e.g. "device" to { "light", "fan", "living room lamp" }.
+    void AddEntityValues(const std::string& entity, const std::vector<std::string>& values)
+    {
+        ThrowIfCompiled();
+        auto& list = m_entityValues[entity];
+        for (const auto& value : values)
+        {
+            auto words = Tokenize(value);
+            if (!words.empty())
+            {
+                list.push_back(std::move(words));
+            }
+        }
+    }
+
+    // Builds the automaton. Patterns and entity values cannot be added afterwards.
+    void Compile()
+    {
+        ThrowIfCompiled();
+        m_longestEntity = m_maxEntityWords;
+        for (const auto& values : m_entityValues)
+        {
+            for (const auto& value : values.second)
+            {
+                m_longestEntity = std::max(m_longestEntity, value.size());
+            }
+        }
+        m_nodes.assign(1, Node());
+        for (size_t index = 0; index < m_patterns.size(); index++)
+        {
+            const auto& items = m_patterns[index].Items;
+            size_t node = 0;
+            for (size_t i = m_patterns[index].LeadingEntities; i < items.size() && !items[i].Entity; i++)
+            {
+                const int word = m_vocabulary.emplace(items[i].Word, (int)m_vocabulary.size()).first->second;
+                auto next = m_nodes[node].Next.find(word);
+                if (next == m_nodes[node].Next.end())
+                {
+                    next = m_nodes[node].Next.emplace(word, m_nodes.size()).first;
+                    m_nodes.push_back(Node());
+                }
+                node = next->second;
+            }
+            m_nodes[node].Patterns.push_back(index);
+        }
+
+        // Sets the failure links breadth first, a node then also reports the patterns of its longest proper suffix.
+        std::deque<size_t> queue;
+        for (const auto& child : m_nodes[0].Next)
+        {
+            queue.push_back(child.second);
+        }
+        while (!queue.empty())
+        {
+            const size_t node = queue.front();
+            queue.pop_front();
+            for (const auto& child : m_nodes[node].Next)
+            {
+                m_nodes[child.second].Fail = Step(m_nodes[node].Fail, child.first);
+                const auto& inherited = m_nodes[m_nodes[child.second].Fail].Patterns;
+                m_nodes[child.second].Patterns.insert(m_nodes[child.second].Patterns.end(), inherited.begin(), inherited.end());
+                queue.push_back(child.second);
+            }
+        }
+        m_compiled = true;
+    }
+
+    // Returns true, and sets 'match' to the best match, if a pattern matches the text with enough confidence.
+    bool TryMatch(const std::string& text, Match& match) const
+    {
+        if (!m_compiled)
+        {
+            throw std::runtime_error("Compile() must be called before matching");
+        }
+        const auto words = Tokenize(text);
+        Match best;
+        size_t node = 0;
+        for (size_t end = 0; end < words.size(); end++)
+        {
+            auto word = m_vocabulary.find(words[end]);
+            node = word == m_vocabulary.end() ? 0 : Step(node, word->second);
+            for (size_t index : m_nodes[node].Patterns)
+            {
+                // The automaton found the first literal words of the pattern, its leading entities come before them.
+                const auto& pattern = m_patterns[index];
+                const size_t literalStart = end + 1 - CountLiterals(pattern);
+                const size_t leading = pattern.LeadingEntities;
+                for (size_t start = literalStart >= leading * m_longestEntity ? literalStart - leading * m_longestEntity : 0;
+                    start + leading <= literalStart; start++)
+                {
+                    Candidate candidate;
+                    MatchFrom(pattern, 0, words, start, std::map<std::string, std::string>(), candidate);
+                    const double confidence = words.empty() ? 0 : (double)(candidate.End - start) / words.size();
+                    if (candidate.Found && confidence > best.Confidence)
+                    {
+                        best.IntentId = pattern.IntentId;
+                        best.Pattern = pattern.Text;
+                        best.Confidence = confidence;
+                        best.Entities = std::move(candidate.Entities);
+                    }
+                }
+            }
+        }
+        if (best.Confidence < m_minConfidence)
+        {
+            m_misses++;
+            return false;
+        }
+        m_hits++;
+        match = std::move(best);
+        return true;
+    }
+
+    // Returns the number of utterances answered on the device.
+    uint64_t Hits() const
+    {
+        return m_hits;
+    }
+
+    // Returns the number of utterances that were left to the service.
+    uint64_t Misses() const
+    {
+        return m_misses;
+    }
+
+private:
+    struct Item
+    {
+        // A lower case word, or the name of an entity.
+        std::string Word;
+        bool Entity = false;
+    };
+
+    struct Pattern
+    {
+        std::string IntentId;
+        std::string Text;
+        std::vector<Item> Items;
+        size_t LeadingEntities = 0;
+    };
+
+    struct Node
+    {
+        std::unordered_map<int, size_t> Next;
+        size_t Fail = 0;
+        // The patterns whose first literal words end here.
+        std::vector<size_t> Patterns;
+    };
+
+    struct Candidate
+    {
+        bool Found = false;
+        size_t End = 0;
+        std::map<std::string, std::string> Entities;
+    };
+
+    // Splits text into lower case words. Bytes of multi-byte UTF-8 characters are kept as letters.
+    static std::vector<std::string> Tokenize(const std::string& text)
+    {
+        std::vector<std::string> words;
+        std::string word;
+        for (char c : text)
+        {
+            const unsigned char u = (unsigned char)c;
+            if (u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z'))
+            {
+                word += c;
+            }
+            else if (u >= 'A' && u <= 'Z')
+            {
+                word += (char)(u - 'A' + 'a');
+            }
+            else if (!word.empty())
+            {
+                words.push_back(std::move(word));
+                word.clear();
+            }
+        }
+        if (!word.empty())
+        {
+            words.push_back(std::move(word));
+        }
+        return words;
+    }
+
+    static void AddWords(const std::string& text, Pattern& pattern)
+    {
+        for (auto& word : Tokenize(text))
+        {
+            Item item;
+            item.Word = std::move(word);
+            pattern.Items.push_back(std::move(item));
+        }
+    }
+
+    // Returns the number of literal words after the leading entities, the words the automaton matches.
+    static size_t CountLiterals(const Pattern& pattern)
+    {
+        size_t count = 0;
+        for (size_t i = pattern.LeadingEntities; i < pattern.Items.size() && !pattern.Items[i].Entity; i++)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    void ThrowIfCompiled() const
+    {
+        if (m_compiled)
+        {
+            throw std::runtime_error("The matcher has already been compiled");
+        }
+    }
+
+    // Follows the automaton from a node on a word, through the failure links if the node has no such child.
+    size_t Step(size_t node, int word) const
+    {
+        while (true)
+        {
+            auto next = m_nodes[node].Next.find(word);
+            if (next != m_nodes[node].Next.end())
+            {
+                return next->second;
+            }
+            if (node == 0)
+            {
+                return 0;
+            }
+            node = m_nodes[node].Fail;
+        }
+    }
+
+    // Matches the items of a pattern from 'item' on against the words from 'position' on, and keeps the match that
+    // covers the most words in 'best'. Patterns are short, so trying every length of every entity is cheap.
+    void MatchFrom(const Pattern& pattern, size_t item, const std::vector<std::string>& words, size_t position,
+        std::map<std::string, std::string> entities, Candidate& best) const
+    {
+        if (item == pattern.Items.size())
+        {
+            if (!best.Found || position > best.End)
+            {
+                best.Found = true;
+                best.End = position;
+                best.Entities = std::move(entities);
+            }
+            return;
+        }
+        const auto& current = pattern.Items[item];
+        if (!current.Entity)
+        {
+            if (position < words.size() && words[position] == current.Word)
+            {
+                MatchFrom(pattern, item + 1, words, position + 1, std::move(entities), best);
+            }
+            return;
+        }
+
+        // An entity with values matches one of them, otherwise any one to m_maxEntityWords words.
+        std::vector<size_t> counts;
+        auto values = m_entityValues.find(current.Word);
+        if (values != m_entityValues.end())
+        {
+            for (const auto& value : values->second)
+            {
+                if (position + value.size() <= words.size() && std::equal(value.begin(), value.end(), words.begin() + position))
+                {
+                    counts.push_back(value.size());
+                }
+            }
+        }
+        else
+        {
+            for (size_t count = 1; count <= m_maxEntityWords && position + count <= words.size(); count++)
+            {
+                counts.push_back(count);
+            }
+        }
+        for (size_t count : counts)
+        {
+            std::string value = words[position];
+            for (size_t i = 1; i < count; i++)
+            {
+                value += " " + words[position + i];
+            }
+            auto next = entities;
+            next[current.Word] = value;
+            MatchFrom(pattern, item + 1, words, position + count, std::move(next), best);
+        }
+    }
+
+    const double m_minConfidence;
+    const size_t m_maxEntityWords;
+    // The most words any entity can match.
+    size_t m_longestEntity = 0;
+    std::vector<Pattern> m_patterns;
+    std::map<std::string, std::vector<std::vector<std::string>>> m_entityValues;
+    std::unordered_map<std::string, int> m_vocabulary;
+    std::vector<Node> m_nodes;
+    bool m_compiled = false;
+    mutable std::atomic<uint64_t> m_hits{ 0 };
+    mutable std::atomic<uint64_t> m_misses{ 0 };
+};
@@ -0,0 +1,191 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "transcript_store.h"
+
+// Collects the final results of a session that runs for hours within a fixed amount of memory. The latest results
+// are kept in a ring, e.g. as context for the display or a summary, and all results are compacted to a transcript
+// store in pages of a fixed number of segments, each written as a call named "<session>/<page>", so that
+// TranscriptStore looks them up as it does whole calls. Only the page being filled and the ring are in memory,
+// plus the time range of each page written, a few bytes per page.
+class LongSessionTranscript final
+{
+public:
+    struct Options
+    {
+        // The latest results kept in memory.
+        size_t RecentSegments = 64;
+        // The results per page of the store.
+        size_t PageSegments = 256;
+    };
+
+    // The time range of a page in ticks, from the start of its first segment to the end of its last one.
+    struct Page
+    {
+        uint64_t Begin = 0;
+        uint64_t End = 0;
+    };
+
+    LongSessionTranscript(TranscriptStoreWriter& store, const std::string& sessionId)
+        : LongSessionTranscript(store, sessionId, Options())
+    {
+    }
+
+    // Pages are written to 'store', which must outlive this object.
+    LongSessionTranscript(TranscriptStoreWriter& store, const std::string& sessionId, const Options& options)
+        : m_store(store), m_sessionId(sessionId), m_options(options)
+    {
+        if (options.RecentSegments == 0 || options.PageSegments == 0)
+        {
+            throw std::invalid_argument("Transcript ring and pages must hold at least one segment");
+        }
+        m_recent.reserve(options.RecentSegments);
+        m_page.reserve(options.PageSegments);
+    }
+
+    ~LongSessionTranscript()
+    {
+        try
+        {
+            Flush();
+        }
+        catch (const std::exception&)
+        {
+            // Errors are reported by an explicit Flush().
+        }
+    }
+
+    LongSessionTranscript(const LongSessionTranscript&) = delete;
+    LongSessionTranscript& operator=(const LongSessionTranscript&) = delete;
+
+    // Adds a final result, e.g. from a Recognized or Transcribed event. Writes a page to the store when it is full.
+    // Throws std::runtime_error if the store is closed.
+    void Add(TranscriptSegment segment)
+    {
+        std::vector<TranscriptSegment> full;
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_segments++;
+            m_pageBytes += segment.Text.size();
+            m_page.push_back(segment);
+            if (m_recent.size() < m_options.RecentSegments)
+            {
+                m_recentBytes += segment.Text.size();
+                m_recent.push_back(std::move(segment));
+            }
+            else
+            {
+                // Overwrites the oldest result, whose string buffer is reused if it is large enough.
+                TranscriptSegment& oldest = m_recent[m_next];
+                m_recentBytes = m_recentBytes - oldest.Text.size() + segment.Text.size();
+                oldest.Offset = segment.Offset;
+                oldest.Duration = segment.Duration;
+                oldest.Text.assign(segment.Text);
+                m_next = (m_next + 1) % m_options.RecentSegments;
+            }
+            if (m_page.size() == m_options.PageSegments)
+            {
+                name = TakePage(full);
+            }
+        }
+        // Written outside the lock, so that results of other threads are not held up by the disk.
+        if (!full.empty())
+        {
+            m_store.Write(name, std::move(full));
+        }
+    }
+
+    // Writes the results that have not filled a page yet as a page of their own, e.g. at the end of the session.
+    void Flush()
+    {
+        std::vector<TranscriptSegment> partial;
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_page.empty())
+            {
+                return;
+            }
+            name = TakePage(partial);
+        }
+        m_store.Write(name, std::move(partial));
+    }
+
+    // Returns the latest results, oldest first.
+    std::vector<TranscriptSegment> Recent() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<TranscriptSegment> recent(m_recent.begin() + m_next, m_recent.end());
+        recent.insert(recent.end(), m_recent.begin(), m_recent.begin() + m_next);
+        return recent;
+    }
+
+    // Returns the name under which page 'page' is in the store.
+    std::string PageName(size_t page) const
+    {
+        return m_sessionId + "/" + std::to_string(page);
+    }
+
+    // Returns the pages written so far, in order.
+    std::vector<Page> Pages() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pages;
+    }
+
+    // Returns the number of results added.
+    uint64_t SegmentCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_segments;
+    }
+
+    // Returns the bytes of text held in memory, in the ring and in the page being filled.
+    size_t RetainedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_recentBytes + m_pageBytes;
+    }
+
+private:
+    // Moves the page being filled to 'page' and returns its name, called with the lock held.
+    std::string TakePage(std::vector<TranscriptSegment>& page)
+    {
+        Page range;
+        range.Begin = m_page.front().Offset;
+        for (const auto& segment : m_page)
+        {
+            range.Begin = std::min(range.Begin, segment.Offset);
+            range.End = std::max(range.End, segment.Offset + segment.Duration);
+        }
+        m_pages.push_back(range);
+        page.swap(m_page);
+        m_page.reserve(m_options.PageSegments);
+        m_pageBytes = 0;
+        return PageName(m_pages.size() - 1);
+    }
+
+    TranscriptStoreWriter& m_store;
+    const std::string m_sessionId;
+    const Options m_options;
+
+    mutable std::mutex m_mutex;
+    // The ring of the latest results, m_next is the oldest once it is full.
+    std::vector<TranscriptSegment> m_recent;
+    size_t m_next = 0;
+    size_t m_recentBytes = 0;
+    std::vector<TranscriptSegment> m_page;
+    size_t m_pageBytes = 0;
+    std::vector<Page> m_pages;
+    uint64_t m_segments = 0;
+};
@@ -0,0 +1,465 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_stats.h"
+
+// On Windows the capture uses WASAPI. On Linux it uses ALSA, which needs the ALSA development package
+// (libasound2-dev); build it with `make ALSA=1`, which defines SPEECH_SAMPLES_WITH_ALSA. The Makefile links
+// libasound in either case, as the Speech SDK needs it for its own microphone input.
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <audioclient.h>
+#include <mmdeviceapi.h>
+#include <wrl/client.h>
+#elif defined(SPEECH_SAMPLES_WITH_ALSA)
+#include <alsa/asoundlib.h>
+#endif
+
+// Captures 16-bit PCM from the default microphone into a push stream, with a device buffer of a few short periods
+// instead of the defaults of AudioConfig::FromDefaultMicrophoneInput(). A capture thread wakes up once per period
+// and writes what was captured to the push stream right away, so the audio reaches the recognizer one period after
+// it was spoken rather than after a buffer of 100 ms or more has filled up.
+//
+// On Windows the device is opened in event-driven exclusive mode, which bypasses the audio engine's mixing buffer,
+// and in shared mode if the device does not allow exclusive use or the format. On Linux the ALSA period and buffer
+// sizes are set as given.
+class LowLatencyCapture final
+{
+public:
+    struct Options
+    {
+        uint32_t SamplesPerSec = 16000;
+        uint16_t Channels = 1;
+        // The audio captured per wakeup. Shorter periods lower the latency and wake the capture thread more often.
+        uint32_t PeriodMilliseconds = 10;
+        // The device buffer, in periods. More periods ride out scheduling delays of the capture thread without
+        // losing audio, at the cost of latency when the thread falls behind.
+        uint32_t Periods = 3;
+        // Windows only: asks for exclusive use of the device, shared mode is used if it is refused.
+        bool Exclusive = true;
+        // Linux only: the ALSA capture device, e.g. "hw:1,0" to bypass the plug layers.
+        std::string Device = "default";
+    };
+
+    LowLatencyCapture() : LowLatencyCapture(Options())
+    {
+    }
+
+    explicit LowLatencyCapture(const Options& options)
+        : m_options(options)
+    {
+        if (options.SamplesPerSec == 0 || options.Channels == 0)
+        {
+            throw std::invalid_argument("Sample rate and channels must not be 0");
+        }
+        if (options.PeriodMilliseconds == 0 || options.Periods < 2)
+        {
+            throw std::invalid_argument("The device buffer needs at least 2 periods of at least 1 ms");
+        }
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+        m_stream = AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(options.SamplesPerSec, 16, (uint8_t)options.Channels));
+    }
+
+    ~LowLatencyCapture()
+    {
+        try
+        {
+            Close();
+        }
+        catch (const std::exception&)
+        {
+            // Errors are reported by an explicit Close().
+        }
+    }
+
+    LowLatencyCapture(const LowLatencyCapture&) = delete;
+    LowLatencyCapture& operator=(const LowLatencyCapture&) = delete;
+
+    // Returns true if this build has a capture backend for the platform.
+    static bool IsAvailable()
+    {
+#if defined(_WIN32) || defined(SPEECH_SAMPLES_WITH_ALSA)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // The stream to create the recognizer with, see AudioConfig::FromStreamInput().
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream>& Stream() const
+    {
+        return m_stream;
+    }
+
+    // Opens the device and starts capturing. Throws std::runtime_error if the device cannot be opened with the
+    // options, e.g. if there is no microphone.
+    void Start()
+    {
+        if (m_thread.joinable() || m_closed)
+        {
+            throw std::logic_error("Capture can only be started once");
+        }
+        std::promise<void> opened;
+        auto openedFuture = opened.get_future();
+        m_thread = std::thread(&LowLatencyCapture::Run, this, std::move(opened));
+        try
+        {
+            openedFuture.get();
+        }
+        catch (...)
+        {
+            m_thread.join();
+            m_closed = true;
+            throw;
+        }
+    }
+
+    // Stops capturing and closes the push stream, which ends the audio of the recognizer. Throws
+    // std::runtime_error if capturing failed after it was started.
+    void Close()
+    {
+        if (!m_closed)
+        {
+            m_closed = true;
+            m_stopping.store(true, std::memory_order_release);
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+            m_stream->Close();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error.empty())
+        {
+            throw std::runtime_error(m_error);
+        }
+    }
+
+    // Returns the time from the capture of the first frame of each period until it was written to the push
+    // stream, in milliseconds.
+    LatencyStats CaptureToSendLatency() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_latency;
+    }
+
+    // Returns the number of overruns, the times that the capture thread fell behind and audio was lost.
+    uint64_t Xruns() const
+    {
+        return m_xruns.load(std::memory_order_relaxed);
+    }
+
+    // Returns the period that the device granted, in frames, once capturing has started.
+    uint32_t PeriodFrames() const
+    {
+        return m_periodFrames.load(std::memory_order_relaxed);
+    }
+
+    // Returns true if the device was opened for exclusive use, once capturing has started.
+    bool IsExclusive() const
+    {
+        return m_exclusive.load(std::memory_order_relaxed);
+    }
+
+private:
+    void Send(const uint8_t* data, uint32_t size, double capturedMillisecondsAgo, std::chrono::steady_clock::time_point now)
+    {
+        m_stream->Write(const_cast<uint8_t*>(data), size);
+        const double writeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - now).count();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latency.Add(capturedMillisecondsAgo + writeMilliseconds);
+    }
+
+    void Fail(const std::string& error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = error;
+    }
+
+#ifdef _WIN32
+    void Run(std::promise<void> opened)
+    {
+        const HRESULT coInit = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        bool isOpen = false;
+        try
+        {
+            Capture(opened, isOpen);
+        }
+        catch (const std::exception& e)
+        {
+            // Before the device is open, the error is reported by Start(), afterwards by Close().
+            if (!isOpen)
+            {
+                opened.set_exception(std::current_exception());
+            }
+            else
+            {
+                Fail(e.what());
+            }
+        }
+        if (SUCCEEDED(coInit))
+        {
+            CoUninitialize();
+        }
+    }
+
+    static void Check(HRESULT hr, const char* what)
+    {
+        if (FAILED(hr))
+        {
+            throw std::runtime_error(std::string(what) + " failed with HRESULT " + std::to_string((unsigned long)hr));
+        }
+    }
+
+    void Capture(std::promise<void>& opened, bool& isOpen)
+    {
+        using Microsoft::WRL::ComPtr;
+        ComPtr<IMMDeviceEnumerator> enumerator;
+        Check(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumerator)), "Creating the device enumerator");
+        ComPtr<IMMDevice> device;
+        Check(enumerator->GetDefaultAudioEndpoint(eCapture, eCommunications, &device), "Getting the default microphone");
+
+        WAVEFORMATEX format = {};
+        format.wFormatTag = WAVE_FORMAT_PCM;
+        format.nChannels = m_options.Channels;
+        format.nSamplesPerSec = m_options.SamplesPerSec;
+        format.wBitsPerSample = 16;
+        format.nBlockAlign = (WORD)(format.nChannels * 2);
+        format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+        // In 100 ns units.
+        REFERENCE_TIME period = (REFERENCE_TIME)m_options.PeriodMilliseconds * 10000;
+        ComPtr<IAudioClient> client;
+        HRESULT hr = E_FAIL;
+        if (m_options.Exclusive)
+        {
+            Check(device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, &client), "Activating the audio client");
+            // In exclusive event-driven mode the buffer is one period, the device fills it while the last one is read.
+            hr = client->Initialize(AUDCLNT_SHAREMODE_EXCLUSIVE, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, period, period, &format, nullptr);
+            if (hr == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED)
+            {
+                // The device needs a period of whole hardware buffers, retries with the aligned size it suggests.
+                UINT32 alignedFrames = 0;
+                Check(client->GetBufferSize(&alignedFrames), "Getting the aligned buffer size");
+                period = (REFERENCE_TIME)(10000000.0 * alignedFrames / m_options.SamplesPerSec + 0.5);
+                client.Reset();
+                Check(device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, &client), "Activating the audio client");
+                hr = client->Initialize(AUDCLNT_SHAREMODE_EXCLUSIVE, AUDCLNT_STREAMFLAGS_EVENTCALLBACK, period, period, &format, nullptr);
+            }
+        }
+        m_exclusive.store(SUCCEEDED(hr), std::memory_order_relaxed);
+        if (FAILED(hr))
+        {
+            // Shared mode converts from the engine's mix format, the buffer holds all periods.
+            client.Reset();
+            Check(device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, &client), "Activating the audio client");
+            Check(client->Initialize(AUDCLNT_SHAREMODE_SHARED,
+                AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY,
+                period * m_options.Periods, 0, &format, nullptr), "Opening the microphone");
+        }
+
+        HANDLE event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        if (event == nullptr)
+        {
+            throw std::runtime_error("Cannot create the capture event");
+        }
+        std::unique_ptr<void, decltype(&CloseHandle)> eventHandle(event, &CloseHandle);
+        Check(client->SetEventHandle(event), "Setting the capture event");
+        ComPtr<IAudioCaptureClient> capture;
+        Check(client->GetService(IID_PPV_ARGS(&capture)), "Getting the capture client");
+        Check(client->Start(), "Starting the capture");
+        m_periodFrames.store((uint32_t)(period * m_options.SamplesPerSec / 10000000), std::memory_order_relaxed);
+        isOpen = true;
+        opened.set_value();
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        std::vector<uint8_t> silence;
+        while (!m_stopping.load(std::memory_order_acquire))
+        {
+            // Times out now and then to see Close() when the device stops delivering.
+            if (WaitForSingleObject(event, 200) != WAIT_OBJECT_0)
+            {
+                continue;
+            }
+            UINT32 packetFrames = 0;
+            while (SUCCEEDED(capture->GetNextPacketSize(&packetFrames)) && packetFrames > 0)
+            {
+                BYTE* data = nullptr;
+                UINT32 frames = 0;
+                DWORD flags = 0;
+                UINT64 qpcPosition = 0;
+                Check(capture->GetBuffer(&data, &frames, &flags, nullptr, &qpcPosition), "Reading the captured audio");
+                const auto now = std::chrono::steady_clock::now();
+                LARGE_INTEGER counter;
+                QueryPerformanceCounter(&counter);
+                // The position is the performance counter at the capture of the first frame, in 100 ns units.
+                const double capturedAgo = (counter.QuadPart * 10000000.0 / frequency.QuadPart - (double)qpcPosition) / 10000;
+                if ((flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) != 0)
+                {
+                    m_xruns.fetch_add(1, std::memory_order_relaxed);
+                }
+                const uint32_t size = frames * format.nBlockAlign;
+                if ((flags & AUDCLNT_BUFFERFLAGS_SILENT) != 0)
+                {
+                    silence.assign(size, 0);
+                    data = silence.data();
+                }
+                Send(data, size, capturedAgo, now);
+                Check(capture->ReleaseBuffer(frames), "Releasing the captured audio");
+            }
+        }
+        client->Stop();
+    }
+#elif defined(SPEECH_SAMPLES_WITH_ALSA)
+    void Run(std::promise<void> opened)
+    {
+        snd_pcm_t* pcm = nullptr;
+        try
+        {
+            pcm = Open();
+        }
+        catch (const std::exception&)
+        {
+            opened.set_exception(std::current_exception());
+            return;
+        }
+        opened.set_value();
+        try
+        {
+            Capture(pcm);
+        }
+        catch (const std::exception& e)
+        {
+            Fail(e.what());
+        }
+        snd_pcm_close(pcm);
+    }
+
+    static void Check(int result, const char* what)
+    {
+        if (result < 0)
+        {
+            throw std::runtime_error(std::string(what) + " failed: " + snd_strerror(result));
+        }
+    }
+
+    snd_pcm_t* Open()
+    {
+        snd_pcm_t* pcm = nullptr;
+        Check(snd_pcm_open(&pcm, m_options.Device.c_str(), SND_PCM_STREAM_CAPTURE, 0), "Opening the microphone");
+        std::unique_ptr<snd_pcm_t, int (*)(snd_pcm_t*)> pcmHandle(pcm, &snd_pcm_close);
+
+        snd_pcm_hw_params_t* hw = nullptr;
+        snd_pcm_hw_params_alloca(&hw);
+        Check(snd_pcm_hw_params_any(pcm, hw), "Reading the device parameters");
+        Check(snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED), "Setting interleaved access");
+        Check(snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16_LE), "Setting 16-bit samples");
+        Check(snd_pcm_hw_params_set_channels(pcm, hw, m_options.Channels), "Setting the channels");
+        unsigned int rate = m_options.SamplesPerSec;
+        Check(snd_pcm_hw_params_set_rate(pcm, hw, rate, 0), "Setting the sample rate");
+
+        // The device may round the sizes to what it supports, the granted period is reported by PeriodFrames().
+        snd_pcm_uframes_t periodFrames = (snd_pcm_uframes_t)m_options.SamplesPerSec * m_options.PeriodMilliseconds / 1000;
+        int direction = 0;
+        Check(snd_pcm_hw_params_set_period_size_near(pcm, hw, &periodFrames, &direction), "Setting the period size");
+        snd_pcm_uframes_t bufferFrames = periodFrames * m_options.Periods;
+        Check(snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &bufferFrames), "Setting the buffer size");
+        Check(snd_pcm_hw_params(pcm, hw), "Applying the device parameters");
+
+        // Wakes up the capture thread as soon as one period has been captured.
+        snd_pcm_sw_params_t* sw = nullptr;
+        snd_pcm_sw_params_alloca(&sw);
+        Check(snd_pcm_sw_params_current(pcm, sw), "Reading the software parameters");
+        Check(snd_pcm_sw_params_set_avail_min(pcm, sw, periodFrames), "Setting the wakeup size");
+        Check(snd_pcm_sw_params(pcm, sw), "Applying the software parameters");
+        Check(snd_pcm_start(pcm), "Starting the capture");
+
+        m_periodFrames.store((uint32_t)periodFrames, std::memory_order_relaxed);
+        return pcmHandle.release();
+    }
+
+    void Capture(snd_pcm_t* pcm)
+    {
+        const uint32_t blockAlign = m_options.Channels * 2u;
+        const snd_pcm_uframes_t periodFrames = m_periodFrames.load(std::memory_order_relaxed);
+        std::vector<uint8_t> period(periodFrames * blockAlign);
+        while (!m_stopping.load(std::memory_order_acquire))
+        {
+            // Times out now and then to see Close() when the device stops delivering.
+            const int ready = snd_pcm_wait(pcm, 200);
+            if (ready == 0)
+            {
+                continue;
+            }
+            snd_pcm_sframes_t frames = ready < 0 ? ready : snd_pcm_readi(pcm, period.data(), periodFrames);
+            if (frames == -EPIPE || frames == -ESTRPIPE)
+            {
+                // The buffer overran while the thread was not scheduled, the audio it held is lost.
+                m_xruns.fetch_add(1, std::memory_order_relaxed);
+                Check(snd_pcm_recover(pcm, (int)frames, 1), "Recovering from an overrun");
+                Check(snd_pcm_start(pcm), "Restarting the capture");
+                continue;
+            }
+            if (frames == -EAGAIN)
+            {
+                continue;
+            }
+            Check((int)frames, "Reading the captured audio");
+            const auto now = std::chrono::steady_clock::now();
+
+            // The frames still in the device buffer were captured after the ones just read.
+            snd_pcm_sframes_t delay = 0;
+            if (snd_pcm_delay(pcm, &delay) < 0 || delay < 0)
+            {
+                delay = 0;
+            }
+            const double capturedAgo = 1000.0 * (double)(delay + frames) / m_options.SamplesPerSec;
+            Send(period.data(), (uint32_t)frames * blockAlign, capturedAgo, now);
+        }
+    }
+#else
+    void Run(std::promise<void> opened)
+    {
+        try
+        {
+            throw std::runtime_error("This build has no audio capture backend, see low_latency_capture.h");
+        }
+        catch (const std::exception&)
+        {
+            opened.set_exception(std::current_exception());
+        }
+    }
+#endif
+
+    const Options m_options;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_stream;
+    std::thread m_thread;
+    bool m_closed = false;
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<uint64_t> m_xruns{ 0 };
+    std::atomic<uint32_t> m_periodFrames{ 0 };
+    std::atomic<bool> m_exclusive{ false };
+    mutable std::mutex m_mutex;
+    LatencyStats m_latency;
+    std::string m_error;
+};
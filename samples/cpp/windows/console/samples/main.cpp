@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -14,15 +15,43 @@ extern void SpeechContinuousRecognitionWithFile();
 extern void SpeechRecognitionUsingCustomizedModel();
 extern void SpeechContinuousRecognitionWithPullStream();
 extern void SpeechContinuousRecognitionWithPushStream();
+extern void SpeechContinuousRecognitionWithPushStreamAndSilenceFilter();
+extern void SpeechContinuousRecognitionWithPacedPullStream();
 extern void KeywordTriggeredSpeechRecognitionWithMicrophone();
+extern void KeywordGatedSpeechRecognitionWithFile();
+extern void SpeechRecognitionUsingCustomizedModelWithPhraseListBundle();
+extern void PronunciationAssessmentBatchWithFiles();
+extern void SpeechRecognitionCommandLoopWithMicrophone();
+extern void SpeechContinuousRecognitionWithPullStreamAndReconnect();
+extern void SpeechContinuousRecognitionWithPullStreamAndArchive();
+extern void SpeechContinuousRecognitionWithOpusPushStream();
+extern void SpeechContinuousRecognitionWithTranscriptStore();
+extern void SpeechRecognitionWithConfigFactory();
+extern void SpeechContinuousRecognitionWithTracing();
+extern void SpeechRecognitionWithLowLatencyMicrophone();
+extern void SpeechContinuousRecognitionWithBlobPullStream();
+extern void SpeechContinuousRecognitionInLongSession();
+extern void SpeechRecognitionWithRegionFailover();
+extern void SpeechRecognitionRecordAndReplay();
 extern void PronunciationAssessmentWithMicrophone();
+extern void SpeechContinuousRecognitionWithSegmentedFile();
+extern void SpeechRecognitionWithRecognizerPool();
+extern void SpeechContinuousRecognitionWithMetrics();
+extern void SpeechContinuousRecognitionWithMultiplexedPushStreams();
+extern void SpeechContinuousRecognitionWithConvertedPullStream();
 
 extern void IntentRecognitionWithMicrophone();
 extern void IntentRecognitionWithLanguage();
 extern void IntentContinuousRecognitionWithFile();
+extern void IntentContinuousRecognitionWithLocalFastPath();
 
 extern void TranslationWithMicrophone();
 extern void TranslationContinuousRecognition();
+extern void TranslationRecognitionAndLanguageIdOfSharedAudio();
+extern void TranslationOfDetectedLanguageSegmentsWithMultiLingualFile();
+extern void TranslationContinuousRecognitionWithLanguageSubscribers();
+extern void TranslationContinuousRecognitionWithEventArena();
+extern void TranslationBatchOfFilesToSubtitles();
 
 extern void SpeechSynthesisToSpeaker();
 extern void SpeechSynthesisWithLanguage();
@@ -40,13 +69,29 @@ extern void SpeechSynthesisUsingCustomVoice();
 extern void SpeechSynthesisGetAvailableVoices();
 extern void SpeechSynthesisVisemeEvent();
 extern void SpeechSynthesisBookmarkEvent();
+extern void SpeechSynthesisWithCache();
+extern void SpeechSynthesisWithStreamingOutput();
+extern void SpeechSynthesisBatchFromManifest();
+extern void SpeechSynthesisWithChunkedLongText();
+extern void SpeechSynthesisVoiceSelectionFromCatalog();
+extern void SpeechSynthesisEventsToBinaryLog();
+extern void SpeechSynthesisToMultipleSinks();
+extern void SpeechSynthesisWithPrefetchedPrompts();
+extern void SpeechSynthesisToPushAudioOutputStreamWithPooledChunks();
 
 extern void ConversationWithPullAudioStream();
 extern void ConversationWithPushAudioStream();
+extern void ConversationBatchFromDirectory();
+extern void ConversationWithChannelMappedAudioStream();
+extern void ConversationTranslatorWithGateway();
+extern void ConversationWithAdaptivePullAudioStream();
+extern void ConversationWithSpeakerTurns();
 
 extern void SpeakerVerificationWithMicrophone();
 extern void SpeakerVerificationWithPushStream();
 extern void SpeakerIdentificationWithPullStream();
+extern void SpeakerIdentificationBatchWithProfileRegistry();
+extern void SpeakerVerificationAgainstCandidateProfiles();
 extern void SpeakerIdentificationWithMicrophone();
 
 // Language Id related tests
@@ -60,6 +105,10 @@ extern void StandaloneLanguageDetectionWithMicrophone();
 extern void StandaloneLanguageDetectionInSingleshotModeWithFileInput();
 extern void StandaloneLanguageDetectionInContinuousModeWithFileInput();
 extern void StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput();
+extern void StandaloneLanguageDetectionOfCallersWithEarlyExit();
+
+extern void SpeechRecognitionBenchmark(int iterations, const string& outputFileName);
+extern void SpeechLoadTest(const vector<string>& args);
 
 void SpeechSamples()
 {
@@ -75,6 +124,28 @@ void SpeechSamples()
         cout << "6.) Speech recognition using push stream input.\n";
         cout << "7.) Speech recognition using microphone with a keyword trigger.\n";
         cout << "8.) Pronunciation assessment using microphone input.\n";
+        cout << "9.) Speech continuous recognition of a long file in parallel segments.\n";
+        cout << "A.) Speech recognition of short commands using a pool of pre-warmed recognizers.\n";
+        cout << "B.) Speech continuous recognition with file input and recognizer metrics.\n";
+        cout << "C.) Speech continuous recognition of many push streams fed by a shared thread pool.\n";
+        cout << "D.) Speech continuous recognition using pull stream input converted from a multi-channel file.\n";
+        cout << "E.) Speech recognition of keyword-triggered commands, connecting only after the keyword.\n";
+        cout << "F.) Speech recognition using a customized model with a phrase list bundle shared by pooled recognizers.\n";
+        cout << "G.) Pronunciation assessment of a batch of recorded answers, scored concurrently.\n";
+        cout << "H.) Speech recognition of a loop of voice commands over one long-lived connection.\n";
+        cout << "I.) Speech continuous recognition using pull stream input, resumed after errors.\n";
+        cout << "J.) Speech continuous recognition using pull stream input, archived to a wav file.\n";
+        cout << "K.) Speech continuous recognition using push stream input, encoded as Ogg Opus.\n";
+        cout << "L.) Speech continuous recognition stored in a transcript store, looked up by time.\n";
+        cout << "M.) Speech recognition with configs from a factory that caches authorization tokens.\n";
+        cout << "N.) Speech continuous recognition using push stream input, traced per stage to a Chrome trace.\n";
+        cout << "O.) Speech recognition with microphone input captured in low-latency periods.\n";
+        cout << "P.) Speech continuous recognition of a blob, streamed with ranged HTTP requests.\n";
+        cout << "Q.) Speech continuous recognition of a long session, with bounded audio and result history.\n";
+        cout << "R.) Speech recognition of voice commands routed to the fastest healthy region, with failover.\n";
+        cout << "S.) Speech continuous recognition recorded, then replayed offline to benchmark the handlers.\n";
+        cout << "T.) Speech continuous recognition using push stream input, with long silences shortened before pushing.\n";
+        cout << "U.) Speech continuous recognition using pull stream input paced in real time, with partials sent as deltas.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -107,6 +178,93 @@ void SpeechSamples()
         case '8':
             PronunciationAssessmentWithMicrophone();
             break;
+        case '9':
+            SpeechContinuousRecognitionWithSegmentedFile();
+            break;
+        case 'A':
+        case 'a':
+            SpeechRecognitionWithRecognizerPool();
+            break;
+        case 'B':
+        case 'b':
+            SpeechContinuousRecognitionWithMetrics();
+            break;
+        case 'C':
+        case 'c':
+            SpeechContinuousRecognitionWithMultiplexedPushStreams();
+            break;
+        case 'D':
+        case 'd':
+            SpeechContinuousRecognitionWithConvertedPullStream();
+            break;
+        case 'E':
+        case 'e':
+            KeywordGatedSpeechRecognitionWithFile();
+            break;
+        case 'F':
+        case 'f':
+            SpeechRecognitionUsingCustomizedModelWithPhraseListBundle();
+            break;
+        case 'G':
+        case 'g':
+            PronunciationAssessmentBatchWithFiles();
+            break;
+        case 'H':
+        case 'h':
+            SpeechRecognitionCommandLoopWithMicrophone();
+            break;
+        case 'I':
+        case 'i':
+            SpeechContinuousRecognitionWithPullStreamAndReconnect();
+            break;
+        case 'J':
+        case 'j':
+            SpeechContinuousRecognitionWithPullStreamAndArchive();
+            break;
+        case 'K':
+        case 'k':
+            SpeechContinuousRecognitionWithOpusPushStream();
+            break;
+        case 'L':
+        case 'l':
+            SpeechContinuousRecognitionWithTranscriptStore();
+            break;
+        case 'M':
+        case 'm':
+            SpeechRecognitionWithConfigFactory();
+            break;
+        case 'N':
+        case 'n':
+            SpeechContinuousRecognitionWithTracing();
+            break;
+        case 'O':
+        case 'o':
+            SpeechRecognitionWithLowLatencyMicrophone();
+            break;
+        case 'P':
+        case 'p':
+            SpeechContinuousRecognitionWithBlobPullStream();
+            break;
+        case 'Q':
+        case 'q':
+            SpeechContinuousRecognitionInLongSession();
+            break;
+        case 'R':
+        case 'r':
+            SpeechRecognitionWithRegionFailover();
+            break;
+        case 'S':
+        case 's':
+            SpeechRecognitionRecordAndReplay();
+            break;
+        case 'T':
+        case 't':
+            SpeechContinuousRecognitionWithPushStreamAndSilenceFilter();
+            break;
+        case 'U':
+        case 'u':
+            SpeechContinuousRecognitionWithPacedPullStream();
+            break;
         case '0':
             break;
         }
@@ -150,6 +308,7 @@ void IntentSamples()
         cout << "1.) Intent recognition with microphone input.\n";
         cout << "2.) Intent recognition in the specified language.\n";
         cout << "3.) Intent continuous recognition with file input.\n";
+        cout << "4.) Intent continuous recognition with commands answered on the device.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -167,6 +326,9 @@ void IntentSamples()
         case '3':
             IntentContinuousRecognitionWithFile();
             break;
+        case '4':
+            IntentContinuousRecognitionWithLocalFastPath();
+            break;
         case '0':
             break;
         }
@@ -183,6 +345,11 @@ void TranslationSamples()
         cout << "2.) Translation continuous recognition.\n";
         cout << "3.) Translation with language detection using microphone input.\n";
         cout << "4.) Translation with language detection using multi-lingual file input.\n";
+        cout << "5.) Recognition, translation and language detection of the same file input.\n";
+        cout << "6.) Translation of the detected languages that need it using multi-lingual file input.\n";
+        cout << "7.) Translation continuous recognition with a subscriber per target language.\n";
+        cout << "8.) Translation continuous recognition with the event payloads in an arena.\n";
+        cout << "9.) Translation of a directory of recordings into subtitle files per language.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -203,6 +370,21 @@ void TranslationSamples()
         case '4':
             TranslationRecognitionAndLanguageIdWithMultiLingualFile();
             break;
+        case '5':
+            TranslationRecognitionAndLanguageIdOfSharedAudio();
+            break;
+        case '6':
+            TranslationOfDetectedLanguageSegmentsWithMultiLingualFile();
+            break;
+        case '7':
+            TranslationContinuousRecognitionWithLanguageSubscribers();
+            break;
+        case '8':
+            TranslationContinuousRecognitionWithEventArena();
+            break;
+        case '9':
+            TranslationBatchOfFilesToSubtitles();
+            break;
         case '0':
             break;
         }
@@ -231,6 +413,15 @@ void SpeechSynthesisSamples()
         cout << "E.) Speech synthesis get available voices\n";
         cout << "F.) Speech synthesis viseme event.\n";
         cout << "G.) Speech synthesis bookmark event.\n";
+        cout << "H.) Speech synthesis with a cache for repeated prompts.\n";
+        cout << "I.) Speech synthesis streamed while it is synthesized.\n";
+        cout << "J.) Speech synthesis of a manifest to audio files, in parallel.\n";
+        cout << "K.) Speech synthesis of long text in chunks of sentences.\n";
+        cout << "L.) Speech synthesis voice selection from a cached voice catalog.\n";
+        cout << "M.) Speech synthesis events recorded to a binary log.\n";
+        cout << "N.) Speech synthesis to the caller, an archive file and a monitor at once.\n";
+        cout << "O.) Speech synthesis of the likely next prompts of a dialog ahead of time.\n";
+        cout << "P.) Speech synthesis to push audio output stream in pooled chunks, saved in one gather write.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -294,6 +485,42 @@ void SpeechSynthesisSamples()
         case 'g':
             SpeechSynthesisBookmarkEvent();
             break;
+        case 'H':
+        case 'h':
+            SpeechSynthesisWithCache();
+            break;
+        case 'I':
+        case 'i':
+            SpeechSynthesisWithStreamingOutput();
+            break;
+        case 'J':
+        case 'j':
+            SpeechSynthesisBatchFromManifest();
+            break;
+        case 'K':
+        case 'k':
+            SpeechSynthesisWithChunkedLongText();
+            break;
+        case 'L':
+        case 'l':
+            SpeechSynthesisVoiceSelectionFromCatalog();
+            break;
+        case 'M':
+        case 'm':
+            SpeechSynthesisEventsToBinaryLog();
+            break;
+        case 'N':
+        case 'n':
+            SpeechSynthesisToMultipleSinks();
+            break;
+        case 'O':
+        case 'o':
+            SpeechSynthesisWithPrefetchedPrompts();
+            break;
+        case 'P':
+        case 'p':
+            SpeechSynthesisToPushAudioOutputStreamWithPooledChunks();
+            break;
         case '0':
             break;
         }
@@ -308,6 +535,11 @@ void ConversationTranscriberSamples()
         cout << "\nConversationTranscriber SAMPLES:\n";
         cout << "1.) ConversationTranscriber with pull input audio stream.\n";
         cout << "2.) ConversationTranscriber with push input audio stream.\n";
+        cout << "3.) ConversationTranscriber for all files of a directory.\n";
+        cout << "4.) ConversationTranscriber with a channel-mapped microphone array capture.\n";
+        cout << "5.) Multi-device conversation with events relayed to clients in batches.\n";
+        cout << "6.) ConversationTranscriber with pull input audio stream read ahead into double buffers.\n";
+        cout << "7.) ConversationTranscriber with the segments merged into speaker turns.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -322,6 +554,21 @@ void ConversationTranscriberSamples()
         case '2':
             ConversationWithPushAudioStream();
             break;
+        case '3':
+            ConversationBatchFromDirectory();
+            break;
+        case '4':
+            ConversationWithChannelMappedAudioStream();
+            break;
+        case '5':
+            ConversationTranslatorWithGateway();
+            break;
+        case '6':
+            ConversationWithAdaptivePullAudioStream();
+            break;
+        case '7':
+            ConversationWithSpeakerTurns();
+            break;
         case '0':
             break;
         }
@@ -338,6 +585,8 @@ void SpeakerRecognitionSamples()
         cout << "2.) Speaker verification with push audio stream input.\n";
         cout << "3.) Speaker identification with pull audio stream input.\n";
         cout << "4.) Speaker identification with microphone input.\n";
+        cout << "5.) Speaker identification of a batch of clips with a profile registry.\n";
+        cout << "6.) Speaker verification of a caller against several candidate profiles.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -362,6 +611,14 @@ void SpeakerRecognitionSamples()
             SpeakerIdentificationWithMicrophone();
             break;
 
+        case '5':
+            SpeakerIdentificationBatchWithProfileRegistry();
+            break;
+
+        case '6':
+            SpeakerVerificationAgainstCandidateProfiles();
+            break;
+
         case '0':
             break;
         }
@@ -378,6 +635,7 @@ void StandaloneLanguageDetectionSamples()
         cout << "2.) Standalone language detection in single-shot mode with file input.\n";
         cout << "3.) Standalone language detection in continuous mode with file input.\n";
         cout << "4.) Standalone language detection in continuous mode with multi-lingual file input.\n";
+        cout << "5.) Standalone language detection of callers, stopping early and caching each caller's language.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -402,6 +660,10 @@ void StandaloneLanguageDetectionSamples()
             StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput();
             break;
 
+        case '5':
+            StandaloneLanguageDetectionOfCallersWithEarlyExit();
+            break;
+
         case '0':
             break;
         }
@@ -414,6 +676,59 @@ int wmain(int argc, wchar_t **argv)
 int main(int argc, char **argv)
 #endif
 {
+    // Command line arguments are only used for the options below, which are plain ASCII.
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+#ifdef _WIN32
+        wstring arg(argv[i]);
+        args.push_back(string(arg.begin(), arg.end()));
+#else
+        args.push_back(argv[i]);
+#endif
+    }
+
+    // Runs the recognition latency benchmark without the interactive menu:
+    //   --benchmark [iterations] [output.json]
+    if (!args.empty() && args[0] == "--benchmark")
+    {
+        try
+        {
+            int iterations = args.size() > 1 ? stoi(args[1]) : 10;
+            if (iterations <= 0)
+            {
+                throw invalid_argument("Iterations must be at least 1");
+            }
+            SpeechRecognitionBenchmark(iterations, args.size() > 2 ? args[2] : string());
+            return 0;
+        }
+        catch (const exception& e)
+        {
+            cerr << "Benchmark failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // Runs a sample flow as a load test without the interactive menu:
+    //   --load <scenario> [--input <file, text or @list>]... [--concurrency N] [--duration seconds]
+    //          [--iterations N] [--rate sessions/s [--arrivals poisson|fixed] [--max-in-flight N]]
+    //          [--output report.json]
+    // Scenarios are recognize-once, recognize-continuous, recognize-realtime, recognize-realtime-push, translate
+    // and synthesize. With --rate, sessions are started at that rate regardless of completions.
+    if (!args.empty() && args[0] == "--load")
+    {
+        try
+        {
+            SpeechLoadTest(vector<string>(args.begin() + 1, args.end()));
+            return 0;
+        }
+        catch (const exception& e)
+        {
+            cerr << "Load test failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     string input;
     do
     {
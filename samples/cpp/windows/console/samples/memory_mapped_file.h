@@ -0,0 +1,161 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file mapped into memory (mmap on Linux/macOS, CreateFileMapping on Windows).
+class MemoryMappedFile final
+{
+public:
+    // How the mapping will be read, passed on to the OS to tune read-ahead.
+    enum class Access { Sequential, Random };
+
+    MemoryMappedFile() = default;
+
+    ~MemoryMappedFile()
+    {
+        Close();
+    }
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    // Maps the specified file. Returns false if the file cannot be opened or mapped (e.g. it is empty),
+    // so that the caller can fall back to regular file I/O.
+    bool Open(const std::string& fileName, Access access = Access::Sequential)
+    {
+        Close();
+
+#ifdef _WIN32
+        const DWORD flags = access == Access::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+        m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data == nullptr)
+        {
+            Close();
+            return false;
+        }
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        m_fd = open(fileName.c_str(), O_RDONLY);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        struct stat fileStat;
+        if (fstat(m_fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+
+        void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (data == MAP_FAILED)
+        {
+            Close();
+            return false;
+        }
+
+        // Audio is consumed front to back, let the kernel read ahead aggressively. Lookups only touch a few pages.
+        madvise(data, static_cast<size_t>(fileStat.st_size), access == Access::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (m_data != nullptr)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return m_data != nullptr;
+    }
+
+    const uint8_t* Data() const
+    {
+        return m_data;
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
@@ -0,0 +1,532 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "wav_file_reader.h"
+
+// The encoder needs libopus, which is not part of the Speech SDK. To build it, define SPEECH_SAMPLES_WITH_OPUS,
+// add the opus include directory and link with the opus library, e.g. with the opus package of vcpkg, or on Linux
+// with `make OPUS=1`. The Ogg framing below does not need libopus.
+#ifdef SPEECH_SAMPLES_WITH_OPUS
+#include <opus/opus.h>
+#endif
+
+// Frames the packets of one logical stream into Ogg pages (RFC 3533). Packets are not split across pages, so a
+// page holds whole packets and its granule position is the one of its last packet.
+class OggPageWriter final
+{
+public:
+    explicit OggPageWriter(uint32_t serial)
+    {
+        Reset(serial);
+    }
+
+    // Starts a new logical stream, its first page is marked as the beginning of the stream.
+    void Reset(uint32_t serial)
+    {
+        m_serial = serial;
+        m_sequence = 0;
+        m_granulePosition = 0;
+        m_lacing.clear();
+        m_body.clear();
+        m_packets = 0;
+    }
+
+    // Adds a packet to the current page. If the page has no room left for it, the page is appended to 'out' first.
+    void AddPacket(const uint8_t* data, size_t size, int64_t granulePosition, std::vector<uint8_t>& out)
+    {
+        // A packet takes one lacing value per 255 bytes, and one more for the remainder, which may be 0.
+        const size_t segments = size / 255 + 1;
+        if (segments > maxSegments)
+        {
+            throw std::invalid_argument("Packet does not fit into an Ogg page");
+        }
+        if (m_lacing.size() + segments > maxSegments)
+        {
+            FlushPage(out, false);
+        }
+        m_lacing.insert(m_lacing.end(), size / 255, (uint8_t)255);
+        m_lacing.push_back((uint8_t)(size % 255));
+        m_body.insert(m_body.end(), data, data + size);
+        m_granulePosition = granulePosition;
+        m_packets++;
+    }
+
+    // Returns the number of packets on the page that has not been written yet.
+    size_t PacketsOnPage() const
+    {
+        return m_packets;
+    }
+
+    // Appends the current page to 'out', 'last' marks it as the end of the stream. The granule position of the
+    // page may be set lower than the one of its last packet, to trim padding at the end of the stream.
+    void FlushPage(std::vector<uint8_t>& out, bool last)
+    {
+        FlushPage(out, last, m_granulePosition);
+    }
+
+    void FlushPage(std::vector<uint8_t>& out, bool last, int64_t granulePosition)
+    {
+        if (m_packets == 0 && !last)
+        {
+            return;
+        }
+        const size_t start = out.size();
+        out.insert(out.end(), { 'O', 'g', 'g', 'S', 0 });
+        out.push_back((uint8_t)((m_sequence == 0 ? beginOfStream : 0) | (last ? endOfStream : 0)));
+        Append(out, (uint64_t)granulePosition);
+        Append(out, m_serial);
+        Append(out, m_sequence);
+        // The checksum is computed over the page with its own field set to 0.
+        Append(out, (uint32_t)0);
+        out.push_back((uint8_t)m_lacing.size());
+        out.insert(out.end(), m_lacing.begin(), m_lacing.end());
+        out.insert(out.end(), m_body.begin(), m_body.end());
+
+        uint32_t crc = 0;
+        const auto& table = CrcTable();
+        for (size_t i = start; i < out.size(); i++)
+        {
+            crc = (crc << 8) ^ table[((crc >> 24) ^ out[i]) & 0xFF];
+        }
+        for (size_t i = 0; i < 4; i++)
+        {
+            out[start + crcOffset + i] = (uint8_t)(crc >> (8 * i));
+        }
+
+        m_sequence++;
+        m_lacing.clear();
+        m_body.clear();
+        m_packets = 0;
+    }
+
+private:
+    static constexpr size_t maxSegments = 255;
+    static constexpr size_t crcOffset = 22;
+    static constexpr uint8_t beginOfStream = 0x02;
+    static constexpr uint8_t endOfStream = 0x04;
+
+    // The Ogg checksum is a CRC-32 with the polynomial 0x04c11db7, not reflected, starting at 0.
+    static const std::array<uint32_t, 256>& CrcTable()
+    {
+        static const std::array<uint32_t, 256> table = []()
+        {
+            std::array<uint32_t, 256> t;
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i << 24;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04c11db7u : crc << 1;
+                }
+                t[i] = crc;
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    // Appends the little-endian bytes of a number.
+    template <class T>
+    static void Append(std::vector<uint8_t>& out, T value)
+    {
+        for (size_t i = 0; i < sizeof(value); i++)
+        {
+            out.push_back((uint8_t)(value >> (8 * i)));
+        }
+    }
+
+    uint32_t m_serial = 0;
+    uint32_t m_sequence = 0;
+    int64_t m_granulePosition = 0;
+    std::vector<uint8_t> m_lacing;
+    std::vector<uint8_t> m_body;
+    size_t m_packets = 0;
+};
+
+#ifdef SPEECH_SAMPLES_WITH_OPUS
+
+// Encodes 16-bit PCM to an Ogg Opus stream (RFC 7845), the format AudioStreamFormat::GetCompressedFormat(OGG_OPUS)
+// describes. At 24 kbps a 16 kHz mono stream takes less than a tenth of the bandwidth of its PCM.
+//
+// An instance encodes one stream at a time and is reused for the next one after Start(), which resets the codec
+// state and writes new stream headers. Creating the codec allocates its state, reusing it does not.
+class OggOpusEncoder final
+{
+public:
+    struct Options
+    {
+        // The target bitrate in bits per second, 6000 to 510000. 16 to 32 kbps are plenty for speech.
+        int32_t Bitrate = 24000;
+        // Trades CPU for quality, from 0 to 10.
+        int Complexity = 5;
+        // The audio in each Opus packet: 10, 20, 40 or 60 ms.
+        uint32_t FrameMilliseconds = 20;
+        // Packets are sent in Ogg pages of this many frames. A page costs 27 bytes plus one per frame, so pages
+        // of 5 frames of 20 ms add about 2.5 kbps, while the service waits for at most 100 ms of audio.
+        uint32_t FramesPerPage = 5;
+    };
+
+    // Opus takes 8, 12, 16, 24 or 48 kHz input with one or two channels.
+    OggOpusEncoder(uint32_t sampleRate, uint16_t channels)
+        : m_sampleRate(sampleRate), m_channels(channels), m_pages(0), m_random(std::random_device()())
+    {
+        if (channels != 1 && channels != 2)
+        {
+            throw std::invalid_argument("Opus streams must have one or two channels");
+        }
+        int error = OPUS_OK;
+        m_encoder = opus_encoder_create((opus_int32)sampleRate, channels, OPUS_APPLICATION_VOIP, &error);
+        if (error != OPUS_OK || m_encoder == nullptr)
+        {
+            throw std::invalid_argument("Cannot create an Opus encoder for " + std::to_string(sampleRate) + " Hz: " + opus_strerror(error));
+        }
+        opus_encoder_ctl(m_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    }
+
+    ~OggOpusEncoder()
+    {
+        opus_encoder_destroy(m_encoder);
+    }
+
+    OggOpusEncoder(const OggOpusEncoder&) = delete;
+    OggOpusEncoder& operator=(const OggOpusEncoder&) = delete;
+
+    uint32_t SampleRate() const
+    {
+        return m_sampleRate;
+    }
+
+    uint16_t Channels() const
+    {
+        return m_channels;
+    }
+
+    // Starts a new stream with the given settings, and appends its header pages to 'out'.
+    void Start(const Options& options, std::vector<uint8_t>& out)
+    {
+        if (options.Bitrate < 6000 || options.Bitrate > 510000)
+        {
+            throw std::invalid_argument("Opus bitrate must be between 6000 and 510000 bits per second");
+        }
+        if (options.Complexity < 0 || options.Complexity > 10)
+        {
+            throw std::invalid_argument("Opus complexity must be between 0 and 10");
+        }
+        if (options.FrameMilliseconds != 10 && options.FrameMilliseconds != 20 && options.FrameMilliseconds != 40
+            && options.FrameMilliseconds != 60)
+        {
+            throw std::invalid_argument("Opus frames must be 10, 20, 40 or 60 ms long");
+        }
+        if (options.FramesPerPage == 0)
+        {
+            throw std::invalid_argument("An Ogg page must hold at least one frame");
+        }
+
+        opus_encoder_ctl(m_encoder, OPUS_RESET_STATE);
+        opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(options.Bitrate));
+        opus_encoder_ctl(m_encoder, OPUS_SET_COMPLEXITY(options.Complexity));
+        m_framesPerPage = options.FramesPerPage;
+        m_frameSamples = m_sampleRate / 1000 * options.FrameMilliseconds;
+        m_pending.clear();
+        m_samples = 0;
+        m_packets.resize(maxPacketSize);
+        m_pages.Reset(m_random());
+
+        // The lookahead of the encoder is skipped by the decoder, it is given in samples at 48 kHz.
+        opus_int32 lookahead = 0;
+        opus_encoder_ctl(m_encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+        m_preSkip = (uint64_t)lookahead * 48000 / m_sampleRate;
+
+        // Identification header: version 1, channel count, pre-skip, input rate, no gain, channel mapping family 0.
+        std::vector<uint8_t> header = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, (uint8_t)m_channels };
+        Append(header, (uint16_t)m_preSkip);
+        Append(header, m_sampleRate);
+        Append(header, (uint16_t)0);
+        header.push_back(0);
+        m_pages.AddPacket(header.data(), header.size(), 0, out);
+        m_pages.FlushPage(out, false);
+
+        // Comment header: the vendor string and no user comments.
+        const std::string vendor = opus_get_version_string();
+        std::vector<uint8_t> tags = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' };
+        Append(tags, (uint32_t)vendor.size());
+        tags.insert(tags.end(), vendor.begin(), vendor.end());
+        Append(tags, (uint32_t)0);
+        m_pages.AddPacket(tags.data(), tags.size(), 0, out);
+        m_pages.FlushPage(out, false);
+    }
+
+    // Encodes 'size' bytes of 16-bit little-endian PCM and appends the completed pages to 'out'. A partial frame
+    // is kept until the next call.
+    void Encode(const uint8_t* pcm, size_t size, std::vector<uint8_t>& out)
+    {
+        const size_t frameBytes = m_frameSamples * m_channels * sizeof(int16_t);
+        m_pending.insert(m_pending.end(), pcm, pcm + size);
+        size_t offset = 0;
+        while (m_pending.size() - offset >= frameBytes)
+        {
+            EncodeFrame(m_pending.data() + offset, out);
+            offset += frameBytes;
+        }
+        m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+    }
+
+    // Encodes the remaining audio, padded with silence to a whole frame, and appends the last page to 'out'. Its
+    // granule position ends the stream at the last sample of the input, so the padding is not decoded.
+    void Finish(std::vector<uint8_t>& out)
+    {
+        const size_t frameBytes = m_frameSamples * m_channels * sizeof(int16_t);
+        const uint64_t samples = m_samples + m_pending.size() / (m_channels * sizeof(int16_t));
+        if (!m_pending.empty() || (m_samples == 0 && m_pages.PacketsOnPage() == 0))
+        {
+            m_pending.resize(frameBytes, 0);
+            EncodeFrame(m_pending.data(), out);
+            m_pending.clear();
+        }
+        m_pages.FlushPage(out, true, (int64_t)GranulePosition(samples));
+    }
+
+private:
+    // The largest packet Opus produces for a frame of up to 60 ms.
+    static constexpr size_t maxPacketSize = 4000;
+
+    void EncodeFrame(const uint8_t* frame, std::vector<uint8_t>& out)
+    {
+        // Copied out of the byte buffer, as opus_encode needs aligned samples.
+        m_frame.resize(m_frameSamples * m_channels);
+        std::memcpy(m_frame.data(), frame, m_frame.size() * sizeof(int16_t));
+        const opus_int32 size = opus_encode(m_encoder, m_frame.data(), (int)m_frameSamples, m_packets.data(), (opus_int32)m_packets.size());
+        if (size < 0)
+        {
+            throw std::runtime_error(std::string("Opus encoding failed: ") + opus_strerror(size));
+        }
+        m_samples += m_frameSamples;
+
+        // A full page is only written when the next packet arrives, so that the last page of the stream always
+        // holds a packet and can carry the end of stream.
+        if (m_pages.PacketsOnPage() >= m_framesPerPage)
+        {
+            m_pages.FlushPage(out, false);
+        }
+        m_pages.AddPacket(m_packets.data(), (size_t)size, (int64_t)GranulePosition(m_samples), out);
+    }
+
+    // Granule positions count samples at 48 kHz, from the start of the stream including the pre-skip.
+    uint64_t GranulePosition(uint64_t samples) const
+    {
+        return m_preSkip + samples * 48000 / m_sampleRate;
+    }
+
+    template <class T>
+    static void Append(std::vector<uint8_t>& out, T value)
+    {
+        for (size_t i = 0; i < sizeof(value); i++)
+        {
+            out.push_back((uint8_t)(value >> (8 * i)));
+        }
+    }
+
+    const uint32_t m_sampleRate;
+    const uint16_t m_channels;
+    OpusEncoder* m_encoder = nullptr;
+    OggPageWriter m_pages;
+    std::mt19937 m_random;
+    uint32_t m_framesPerPage = 0;
+    uint32_t m_frameSamples = 0;
+    uint64_t m_preSkip = 0;
+    uint64_t m_samples = 0;
+    std::vector<uint8_t> m_pending;
+    std::vector<opus_int16> m_frame;
+    std::vector<uint8_t> m_packets;
+};
+
+// Keeps Opus encoders for reuse across streams, one set per sample rate and channel count. Acquire() returns an
+// idle encoder if there is one, and the encoder goes back to the pool when its lease is released, so streams that
+// start and stop all day create only as many encoders as run at the same time.
+//
+// The pool must outlive the leases, e.g. one pool for the process.
+class OpusEncoderPool final
+{
+public:
+    using Lease = std::unique_ptr<OggOpusEncoder, std::function<void(OggOpusEncoder*)>>;
+
+    OpusEncoderPool() = default;
+    OpusEncoderPool(const OpusEncoderPool&) = delete;
+    OpusEncoderPool& operator=(const OpusEncoderPool&) = delete;
+
+    Lease Acquire(uint32_t sampleRate, uint16_t channels)
+    {
+        const auto key = std::make_pair(sampleRate, channels);
+        std::unique_ptr<OggOpusEncoder> encoder;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& idle = m_idle[key];
+            if (!idle.empty())
+            {
+                encoder = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        if (encoder == nullptr)
+        {
+            // Creates the encoder outside of the lock.
+            encoder.reset(new OggOpusEncoder(sampleRate, channels));
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_created++;
+        }
+        return Lease(encoder.release(), [this, key](OggOpusEncoder* released)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_idle[key].emplace_back(released);
+        });
+    }
+
+    // Returns the number of encoders that are kept for reuse.
+    size_t IdleEncoderCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = 0;
+        for (const auto& entry : m_idle)
+        {
+            count += entry.second.size();
+        }
+        return count;
+    }
+
+    // Returns the number of encoders created so far, idle or in use.
+    size_t CreatedEncoderCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_created;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::pair<uint32_t, uint16_t>, std::vector<std::unique_ptr<OggOpusEncoder>>> m_idle;
+    size_t m_created = 0;
+};
+
+// A push stream that takes PCM and sends it to the service as Ogg Opus. It sits where the application would call
+// PushAudioInputStream::Write with PCM: recognizers are created with Stream(), and audio is written to Write().
+// The encoder is taken from a pool and returned when the stream is closed.
+class OpusPushStream final
+{
+public:
+    using Options = OggOpusEncoder::Options;
+
+    OpusPushStream(OpusEncoderPool& pool, const WavFileReader::WAVEFORMAT& format)
+        : OpusPushStream(pool, format, Options())
+    {
+    }
+
+    OpusPushStream(OpusEncoderPool& pool, const WavFileReader::WAVEFORMAT& format, const Options& options)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        if (format.FormatTag != 1 || format.BitsPerSample != 16)
+        {
+            throw std::invalid_argument("Only 16-bit PCM can be encoded as Opus");
+        }
+        m_encoder = pool.Acquire(format.SamplesPerSec, format.Channels);
+        m_encoder->Start(options, m_encoded);
+        m_stream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetCompressedFormat(AudioStreamContainerFormat::OGG_OPUS));
+    }
+
+    ~OpusPushStream()
+    {
+        try
+        {
+            Close();
+        }
+        catch (const std::exception&)
+        {
+            // Errors are reported by an explicit Close().
+        }
+    }
+
+    OpusPushStream(const OpusPushStream&) = delete;
+    OpusPushStream& operator=(const OpusPushStream&) = delete;
+
+    // The stream to create the recognizer's AudioConfig from.
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream>& Stream() const
+    {
+        return m_stream;
+    }
+
+    // Encodes PCM and writes the completed Ogg pages to the push stream. Only one thread may call Write().
+    void Write(const uint8_t* pcm, size_t size)
+    {
+        if (m_encoder == nullptr)
+        {
+            throw std::runtime_error("Stream is closed");
+        }
+        m_pcmBytes += size;
+        m_encoder->Encode(pcm, size, m_encoded);
+        Send();
+    }
+
+    // Writes the rest of the audio, closes the push stream and returns the encoder to the pool.
+    void Close()
+    {
+        if (m_encoder == nullptr)
+        {
+            return;
+        }
+        auto encoder = std::move(m_encoder);
+        encoder->Finish(m_encoded);
+        Send();
+        m_stream->Close();
+    }
+
+    uint64_t PcmBytes() const
+    {
+        return m_pcmBytes;
+    }
+
+    // Returns the bytes sent, including the Ogg headers and pages.
+    uint64_t EncodedBytes() const
+    {
+        return m_encodedBytes;
+    }
+
+    // Returns how many bytes of PCM each byte sent stands for, e.g. 10 for a tenth of the bandwidth.
+    double CompressionRatio() const
+    {
+        return m_encodedBytes == 0 ? 0 : (double)m_pcmBytes / m_encodedBytes;
+    }
+
+private:
+    void Send()
+    {
+        if (!m_encoded.empty())
+        {
+            m_stream->Write(m_encoded.data(), (uint32_t)m_encoded.size());
+            m_encodedBytes += m_encoded.size();
+            m_encoded.clear();
+        }
+    }
+
+    OpusEncoderPool::Lease m_encoder;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_stream;
+    std::vector<uint8_t> m_encoded;
+    uint64_t m_pcmBytes = 0;
+    uint64_t m_encodedBytes = 0;
+};
+
+#endif
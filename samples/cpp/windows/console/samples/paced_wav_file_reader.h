@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include "wav_file_reader.h"
+
+// Reads a wav file no faster than real time, so that a file-backed stream behaves like live audio.
+// Each Read() returns once the audio it returns would have been captured, i.e. reading 100 ms of audio
+// takes 100 ms from the first read on. This shows the latency of live input, rather than of a file that
+// is recognized as fast as it can be uploaded.
+class PacedWavFileReader final
+{
+public:
+    // 'speed' is the pace relative to real time, e.g. 2 reads twice as fast. 0 disables pacing.
+    PacedWavFileReader(const std::string& audioFileName, double speed = 1.0)
+        : m_reader(audioFileName), m_speed(speed)
+    {
+        if (speed < 0)
+        {
+            throw std::invalid_argument("Speed must not be negative");
+        }
+        if (m_reader.Format().AvgBytesPerSec == 0)
+        {
+            throw std::runtime_error("Wav file has an average byte rate of 0, cannot pace it");
+        }
+    }
+
+    // Reads up to 'size' bytes of audio, waiting until they are due. Returns 0 at the end of the audio.
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        if (m_bytesRead == 0)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+        int read = m_reader.Read(dataBuffer, size);
+        if (read <= 0 || m_speed == 0)
+        {
+            return read;
+        }
+
+        // Due times are derived from the total read, so rounding does not add up over a long file.
+        m_bytesRead += (uint64_t)read;
+        auto due = m_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(m_bytesRead / (m_reader.Format().AvgBytesPerSec * m_speed)));
+        std::this_thread::sleep_until(due);
+        return read;
+    }
+
+    const WavFileReader::WAVEFORMAT& Format() const
+    {
+        return m_reader.Format();
+    }
+
+    uint64_t DurationTicks() const
+    {
+        return m_reader.DurationTicks();
+    }
+
+    void Close()
+    {
+        m_reader.Close();
+    }
+
+private:
+    WavFileReader m_reader;
+    double m_speed;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_bytesRead = 0;
+};
@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Turns the partial results of any recognizer, e.g. the Recognizing event of a SpeechRecognizer or the Transcribing
+// event of a ConversationTranscriber, into small updates for a client that shows the hypothesis as it grows.
+//
+// Each partial repeats the whole hypothesis, so forwarding it as is sends O(n^2) bytes over an utterance. Instead,
+// an update holds the length of the prefix that did not change since the last update, and the text after it.
+// Partials that arrive within the debounce interval of the last update are skipped, the next update includes
+// their changes. The final result is not debounced, call Reset() when it arrives.
+//
+// The events of one recognizer are raised one at a time, so the debouncer does not lock.
+class PartialResultDebouncer final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Delta
+    {
+        // The number of bytes of the previous update's text to keep, always at a UTF-8 character boundary.
+        size_t Keep = 0;
+        // The text to append after the kept bytes.
+        std::string Append;
+    };
+
+    // 'interval' is the shortest time between two updates, 0 sends an update for every changed partial.
+    explicit PartialResultDebouncer(std::chrono::milliseconds interval = std::chrono::milliseconds(200))
+        : m_interval(interval)
+    {
+    }
+
+    // Returns true and sets 'delta' if the partial should be sent, false if it is skipped.
+    bool OnPartial(const std::string& text, Delta& delta, Clock::time_point now = Clock::now())
+    {
+        m_textBytes += text.size();
+        if (text == m_sent || (m_hasSent && now - m_lastSent < m_interval))
+        {
+            m_skipped++;
+            return false;
+        }
+        size_t keep = 0;
+        const size_t common = text.size() < m_sent.size() ? text.size() : m_sent.size();
+        while (keep < common && text[keep] == m_sent[keep])
+        {
+            keep++;
+        }
+        // Moves back to the start of a character, so that a client never splits a multi-byte character.
+        while (keep > 0 && keep < text.size() && IsContinuationByte(text[keep]))
+        {
+            keep--;
+        }
+        delta.Keep = keep;
+        delta.Append.assign(text, keep, std::string::npos);
+        m_sent = text;
+        m_lastSent = now;
+        m_hasSent = true;
+        m_sentBytes += delta.Append.size();
+        return true;
+    }
+
+    // Starts the next utterance, the first partial after it is sent in full.
+    void Reset()
+    {
+        m_sent.clear();
+        m_hasSent = false;
+    }
+
+    // Returns the number of partials that were not sent.
+    uint64_t Skipped() const
+    {
+        return m_skipped;
+    }
+
+    // Returns the bytes of text in the updates sent so far, and the bytes the full partials would have taken.
+    uint64_t SentBytes() const
+    {
+        return m_sentBytes;
+    }
+
+    uint64_t TextBytes() const
+    {
+        return m_textBytes;
+    }
+
+private:
+    static bool IsContinuationByte(char c)
+    {
+        return ((unsigned char)c & 0xC0) == 0x80;
+    }
+
+    const std::chrono::milliseconds m_interval;
+    std::string m_sent;
+    Clock::time_point m_lastSent;
+    bool m_hasSent = false;
+    uint64_t m_skipped = 0;
+    uint64_t m_sentBytes = 0;
+    uint64_t m_textBytes = 0;
+};
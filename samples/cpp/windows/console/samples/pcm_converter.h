@@ -0,0 +1,310 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "pcm_decoders.h"
+#include "trace_recorder.h"
+#include "wav_file_reader.h"
+
+// Converts audio from a wav file to mono 16-bit PCM at a given sample rate, the format the speech service
+// expects from stream input. Channels are mixed down by averaging, the sample rate is changed with a
+// windowed-sinc filter, which also removes frequencies above the new Nyquist rate.
+//
+// Supported inputs are integer PCM of 8, 16, 24 and 32 bits, 32-bit float, mu-law and a-law, at any
+// sample rate and channel count. WAVE_FORMAT_EXTENSIBLE is taken as integer PCM. Samples are decoded by
+// the decoder of pcm_decoders.h for the input format.
+class PcmConverter final
+{
+public:
+    PcmConverter(const WavFileReader::WAVEFORMAT& input, uint32_t outputSampleRate = 16000)
+        : m_input(input), m_outputSampleRate(outputSampleRate)
+    {
+        if (input.Channels == 0 || input.SamplesPerSec == 0 || input.BlockAlign < input.Channels * (input.BitsPerSample / 8))
+        {
+            throw std::invalid_argument("Invalid wav format");
+        }
+        m_decode = FindMonoDecoder(input);
+        if (m_decode == nullptr)
+        {
+            throw std::invalid_argument("Unsupported wav format " + std::to_string(input.FormatTag) + " with " + std::to_string(input.BitsPerSample) + " bits per sample");
+        }
+        if (outputSampleRate == 0)
+        {
+            throw std::invalid_argument("Output sample rate must be greater than 0");
+        }
+
+        // Resamples by the ratio up/down, reduced by the greatest common divisor of the two rates.
+        const uint32_t divisor = Gcd(input.SamplesPerSec, outputSampleRate);
+        m_up = outputSampleRate / divisor;
+        m_down = input.SamplesPerSec / divisor;
+        if (m_up != m_down)
+        {
+            BuildFilter();
+        }
+        // Samples before the start of the audio are taken as silence.
+        m_history.assign(m_halfTaps, 0.0f);
+        m_historyStart = -(int64_t)m_halfTaps;
+    }
+
+    // Returns the format of the converted audio.
+    WavFileReader::WAVEFORMAT OutputFormat() const
+    {
+        return WavFileReader::WAVEFORMAT{ formatPcm, 1, m_outputSampleRate, m_outputSampleRate * 2, 2, 16 };
+    }
+
+    // Returns true if the input already has the output format, in which case Process() only copies.
+    bool IsPassThrough() const
+    {
+        return (m_input.FormatTag == formatPcm || m_input.FormatTag == formatExtensible) && m_input.BitsPerSample == 16
+            && m_input.Channels == 1 && m_input.SamplesPerSec == m_outputSampleRate;
+    }
+
+    // Converts 'size' bytes of input audio and appends the converted audio to 'output'. Incomplete sample
+    // frames, and the few samples the resampling filter needs to look ahead, are kept for the next call.
+    void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+    {
+        TraceSpan span("convert", "PcmConverter::Process", "size", (int64_t)size);
+        if (IsPassThrough())
+        {
+            output.insert(output.end(), data, data + size);
+            return;
+        }
+
+        // Completes a sample frame that was split between calls.
+        if (!m_partialFrame.empty())
+        {
+            size_t needed = std::min(size, (size_t)m_input.BlockAlign - m_partialFrame.size());
+            m_partialFrame.insert(m_partialFrame.end(), data, data + needed);
+            data += needed;
+            size -= needed;
+            if (m_partialFrame.size() < m_input.BlockAlign)
+            {
+                return;
+            }
+            AppendFrames(m_partialFrame.data(), 1);
+            m_partialFrame.clear();
+        }
+
+        const size_t frames = size / m_input.BlockAlign;
+        AppendFrames(data, frames);
+        m_partialFrame.assign(data + frames * m_input.BlockAlign, data + size);
+        Resample(false, output);
+    }
+
+    // Appends the remaining converted audio to 'output', call it at the end of the audio.
+    void Flush(std::vector<uint8_t>& output)
+    {
+        if (!IsPassThrough())
+        {
+            m_partialFrame.clear();
+            Resample(true, output);
+        }
+    }
+
+private:
+    static constexpr uint16_t formatPcm = 1;
+    static constexpr uint16_t formatExtensible = 0xFFFE;
+    // Filter length on either side of a sample, at the lower of the two rates.
+    static constexpr uint32_t baseHalfTaps = 16;
+
+    static uint32_t Gcd(uint32_t a, uint32_t b)
+    {
+        while (b != 0)
+        {
+            uint32_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    // Precomputes one set of filter coefficients for each of the 'm_up' output phases between two input samples.
+    void BuildFilter()
+    {
+        const double pi = 3.14159265358979323846;
+        // Cutoff relative to the input Nyquist rate, lowered when downsampling to avoid aliasing.
+        const double cutoff = std::min(1.0, (double)m_up / m_down) * 0.95;
+        m_halfTaps = (uint32_t)std::ceil(baseHalfTaps / cutoff);
+        const uint32_t taps = 2 * m_halfTaps;
+        m_filter.resize((size_t)m_up * taps);
+        for (uint32_t phase = 0; phase < m_up; phase++)
+        {
+            const double fraction = (double)phase / m_up;
+            double sum = 0;
+            for (uint32_t k = 0; k < taps; k++)
+            {
+                // Distance of tap k from the output position, in input samples. Tap m_halfTaps - 1 is the sample at or before it.
+                const double t = (double)k - (m_halfTaps - 1) - fraction;
+                const double x = pi * cutoff * t;
+                const double sinc = x == 0 ? 1.0 : std::sin(x) / x;
+                // Blackman window over the filter length.
+                const double w = (t + m_halfTaps) / (2.0 * m_halfTaps);
+                const double window = 0.42 - 0.5 * std::cos(2 * pi * w) + 0.08 * std::cos(4 * pi * w);
+                const double value = sinc * window;
+                m_filter[(size_t)phase * taps + k] = (float)value;
+                sum += value;
+            }
+            // Normalizes each phase to unity gain.
+            for (uint32_t k = 0; k < taps; k++)
+            {
+                m_filter[(size_t)phase * taps + k] = (float)(m_filter[(size_t)phase * taps + k] / sum);
+            }
+        }
+    }
+
+    // Decodes sample frames and mixes them down to mono samples in the range [-1, 1].
+    void AppendFrames(const uint8_t* data, size_t frames)
+    {
+        const size_t start = m_history.size();
+        m_history.resize(start + frames);
+        m_decode(m_input, data, frames, m_history.data() + start);
+        m_inputSamples += frames;
+    }
+
+    static void AppendSample(float value, std::vector<uint8_t>& output)
+    {
+        const float clamped = std::max(-1.0f, std::min(1.0f, value));
+        const int16_t sample = (int16_t)std::lround(clamped * 32767.0f);
+        output.push_back((uint8_t)(sample & 0xFF));
+        output.push_back((uint8_t)((sample >> 8) & 0xFF));
+    }
+
+    // Computes the output samples whose filter window lies within the decoded input. At the end of the
+    // audio, the input is padded with silence and all remaining output samples are computed.
+    void Resample(bool flush, std::vector<uint8_t>& output)
+    {
+        if (m_up == m_down)
+        {
+            for (size_t i = m_halfTaps; i < m_history.size(); i++)
+            {
+                AppendSample(m_history[i], output);
+            }
+            m_history.resize(m_halfTaps);
+            std::fill(m_history.begin(), m_history.end(), 0.0f);
+            return;
+        }
+
+        const uint64_t totalOutput = m_inputSamples * m_up / m_down;
+        if (flush)
+        {
+            m_history.resize(m_history.size() + 2 * m_halfTaps, 0.0f);
+        }
+        const int64_t historyEnd = m_historyStart + (int64_t)m_history.size();
+        const uint32_t taps = 2 * m_halfTaps;
+
+        while (!flush || m_outputSamples < totalOutput)
+        {
+            // Position of the output sample in input samples: 'index' plus 'phase' / m_up.
+            const uint64_t position = m_outputSamples * m_down;
+            const int64_t index = (int64_t)(position / m_up);
+            const uint32_t phase = (uint32_t)(position % m_up);
+            const int64_t first = index - (int64_t)(m_halfTaps - 1);
+            if (first + (int64_t)taps > historyEnd)
+            {
+                break;
+            }
+
+            // A plain dot product, which compilers vectorize for the target's SIMD instructions.
+            const float* x = m_history.data() + (first - m_historyStart);
+            const float* h = m_filter.data() + (size_t)phase * taps;
+            float sum = 0;
+            for (uint32_t k = 0; k < taps; k++)
+            {
+                sum += x[k] * h[k];
+            }
+            AppendSample(sum, output);
+            m_outputSamples++;
+        }
+
+        // Drops the input that no future output sample needs.
+        const uint64_t nextIndex = m_outputSamples * m_down / m_up;
+        const int64_t keepFrom = std::min<int64_t>((int64_t)nextIndex - (int64_t)(m_halfTaps - 1), historyEnd);
+        if (keepFrom > m_historyStart)
+        {
+            m_history.erase(m_history.begin(), m_history.begin() + (size_t)(keepFrom - m_historyStart));
+            m_historyStart = keepFrom;
+        }
+    }
+
+    WavFileReader::WAVEFORMAT m_input;
+    // Chosen once for the input format, so decoding does not branch on it per sample.
+    MonoDecoder m_decode = nullptr;
+    uint32_t m_outputSampleRate;
+    uint32_t m_up = 1;
+    uint32_t m_down = 1;
+    uint32_t m_halfTaps = 0;
+    std::vector<float> m_filter;
+
+    std::vector<uint8_t> m_partialFrame;
+    // Decoded mono input, m_history[0] is input sample m_historyStart.
+    std::vector<float> m_history;
+    int64_t m_historyStart = 0;
+    uint64_t m_inputSamples = 0;
+    uint64_t m_outputSamples = 0;
+};
+
+// Reads a wav file of any supported format and returns it converted by a PcmConverter, e.g. as the source of a pull stream.
+class ConvertingWavFileReader final
+{
+public:
+    ConvertingWavFileReader(const std::string& audioFileName, uint32_t outputSampleRate = 16000)
+        : m_reader(audioFileName), m_converter(m_reader.Format(), outputSampleRate), m_buffer(readSize)
+    {
+    }
+
+    // Returns the format of the audio returned by Read().
+    WavFileReader::WAVEFORMAT Format() const
+    {
+        return m_converter.OutputFormat();
+    }
+
+    // Reads up to 'size' bytes of converted audio. Returns 0 at the end of the audio.
+    int Read(uint8_t* dataBuffer, uint32_t size)
+    {
+        while (m_converted.size() - m_convertedOffset < size && !m_ended)
+        {
+            // Compacts the converted audio before adding more.
+            m_converted.erase(m_converted.begin(), m_converted.begin() + m_convertedOffset);
+            m_convertedOffset = 0;
+
+            int read = m_reader.Read(m_buffer.data(), (uint32_t)m_buffer.size());
+            if (read <= 0)
+            {
+                m_converter.Flush(m_converted);
+                m_ended = true;
+            }
+            else
+            {
+                m_converter.Process(m_buffer.data(), (size_t)read, m_converted);
+            }
+        }
+
+        // Returns whole 16-bit samples only.
+        size_t count = std::min<size_t>(size & ~1u, m_converted.size() - m_convertedOffset);
+        memcpy(dataBuffer, m_converted.data() + m_convertedOffset, count);
+        m_convertedOffset += count;
+        return (int)count;
+    }
+
+    void Close()
+    {
+        m_reader.Close();
+    }
+
+private:
+    static constexpr uint32_t readSize = 32768;
+
+    WavFileReader m_reader;
+    PcmConverter m_converter;
+    std::vector<uint8_t> m_buffer;
+    std::vector<uint8_t> m_converted;
+    size_t m_convertedOffset = 0;
+    bool m_ended = false;
+};
@@ -0,0 +1,276 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "wav_file_reader.h"
+
+// Sample types of PcmView that have no C++ type of their own.
+struct Int24 {};
+struct MuLaw {};
+struct ALaw {};
+
+// Decodes one sample of type 'Sample' from little-endian bytes to the range [-1, 1]. Specialized for the sample
+// types of wav files, uint8_t is 8-bit PCM, which is unsigned, float is 32-bit IEEE float.
+template <class Sample>
+struct SampleCodec;
+
+template <>
+struct SampleCodec<uint8_t>
+{
+    static constexpr uint16_t FormatTag = 1;
+    static constexpr uint16_t BitsPerSample = 8;
+
+    static float Decode(const uint8_t* sample)
+    {
+        return ((int)sample[0] - 128) / 128.0f;
+    }
+};
+
+template <>
+struct SampleCodec<int16_t>
+{
+    static constexpr uint16_t FormatTag = 1;
+    static constexpr uint16_t BitsPerSample = 16;
+
+    static float Decode(const uint8_t* sample)
+    {
+        return (int16_t)(sample[0] | (sample[1] << 8)) / 32768.0f;
+    }
+};
+
+template <>
+struct SampleCodec<Int24>
+{
+    static constexpr uint16_t FormatTag = 1;
+    static constexpr uint16_t BitsPerSample = 24;
+
+    static float Decode(const uint8_t* sample)
+    {
+        return (int32_t)((uint32_t)sample[0] << 8 | (uint32_t)sample[1] << 16 | (uint32_t)sample[2] << 24) / 2147483648.0f;
+    }
+};
+
+template <>
+struct SampleCodec<int32_t>
+{
+    static constexpr uint16_t FormatTag = 1;
+    static constexpr uint16_t BitsPerSample = 32;
+
+    static float Decode(const uint8_t* sample)
+    {
+        return (int32_t)((uint32_t)sample[0] | (uint32_t)sample[1] << 8 | (uint32_t)sample[2] << 16 | (uint32_t)sample[3] << 24) / 2147483648.0f;
+    }
+};
+
+template <>
+struct SampleCodec<float>
+{
+    static constexpr uint16_t FormatTag = 3;
+    static constexpr uint16_t BitsPerSample = 32;
+
+    static float Decode(const uint8_t* sample)
+    {
+        float value;
+        memcpy(&value, sample, sizeof(value));
+        return value;
+    }
+};
+
+// G.711 a-law and mu-law expansion to 16-bit linear PCM.
+template <>
+struct SampleCodec<ALaw>
+{
+    static constexpr uint16_t FormatTag = 6;
+    static constexpr uint16_t BitsPerSample = 8;
+
+    static float Decode(const uint8_t* sample)
+    {
+        return Expand(*sample) / 32768.0f;
+    }
+
+    static int16_t Expand(uint8_t value)
+    {
+        value ^= 0x55;
+        int magnitude = (value & 0x0F) << 4;
+        const int segment = (value & 0x70) >> 4;
+        magnitude += segment == 0 ? 8 : 0x108;
+        if (segment > 1)
+        {
+            magnitude <<= segment - 1;
+        }
+        return (int16_t)((value & 0x80) ? magnitude : -magnitude);
+    }
+};
+
+template <>
+struct SampleCodec<MuLaw>
+{
+    static constexpr uint16_t FormatTag = 7;
+    static constexpr uint16_t BitsPerSample = 8;
+
+    static float Decode(const uint8_t* sample)
+    {
+        return Expand(*sample) / 32768.0f;
+    }
+
+    static int16_t Expand(uint8_t value)
+    {
+        value = ~value;
+        int magnitude = (((value & 0x0F) << 3) + 0x84) << ((value & 0x70) >> 4);
+        return (int16_t)((value & 0x80) ? 0x84 - magnitude : magnitude - 0x84);
+    }
+};
+
+// Audio of a sample type and channel count known at compile time, e.g. PcmView<int16_t, 1> for 16-bit mono.
+// Decoding loops over a constant frame size and channel count, which compilers unroll and inline into a loop
+// without branches.
+template <class Sample, uint16_t Channels>
+class PcmView final
+{
+public:
+    static_assert(Channels > 0, "A sample frame has at least one channel");
+
+    static constexpr uint16_t BytesPerSample = SampleCodec<Sample>::BitsPerSample / 8;
+    static constexpr uint16_t BlockAlign = Channels * BytesPerSample;
+
+    // True if audio of 'format' can be viewed as this format. WAVE_FORMAT_EXTENSIBLE is taken as integer PCM.
+    static bool Matches(const WavFileReader::WAVEFORMAT& format)
+    {
+        const bool formatTag = format.FormatTag == SampleCodec<Sample>::FormatTag
+            || (format.FormatTag == 0xFFFE && SampleCodec<Sample>::FormatTag == 1);
+        return formatTag && format.BitsPerSample == SampleCodec<Sample>::BitsPerSample && format.Channels == Channels
+            && format.BlockAlign == BlockAlign;
+    }
+
+    // Views the whole sample frames of 'size' bytes.
+    PcmView(const uint8_t* data, size_t size)
+        : m_data(data), m_frames(size / BlockAlign)
+    {
+    }
+
+    size_t Frames() const
+    {
+        return m_frames;
+    }
+
+    // Decodes the frames and mixes them down to mono samples in the range [-1, 1], one per frame.
+    void MixToMono(float* mono) const
+    {
+        const float scale = 1.0f / Channels;
+        const uint8_t* frame = m_data;
+        for (size_t i = 0; i < m_frames; i++, frame += BlockAlign)
+        {
+            float sum = 0;
+            for (uint16_t channel = 0; channel < Channels; channel++)
+            {
+                sum += SampleCodec<Sample>::Decode(frame + channel * BytesPerSample);
+            }
+            mono[i] = Scale(sum, scale);
+        }
+    }
+
+private:
+    // Mono needs no scaling, the multiplication is folded away.
+    static float Scale(float sum, float scale)
+    {
+        return Channels == 1 ? sum : sum * scale;
+    }
+
+    const uint8_t* m_data;
+    size_t m_frames;
+};
+
+// Decodes 'frames' sample frames of 'format' and mixes them down to mono samples in the range [-1, 1].
+using MonoDecoder = void (*)(const WavFileReader::WAVEFORMAT& format, const uint8_t* data, size_t frames, float* mono);
+
+namespace PcmDecoders
+{
+    // For the formats the samples use most, with the frame size and channel count fixed at compile time.
+    template <class View>
+    void DecodeView(const WavFileReader::WAVEFORMAT&, const uint8_t* data, size_t frames, float* mono)
+    {
+        View(data, frames * View::BlockAlign).MixToMono(mono);
+    }
+
+    // For all other layouts of a sample type, e.g. 6 channels or padded frames. The sample type is still fixed, so
+    // the only branches are those of the loops.
+    template <class Sample>
+    void DecodeAny(const WavFileReader::WAVEFORMAT& format, const uint8_t* data, size_t frames, float* mono)
+    {
+        const size_t channels = format.Channels;
+        const size_t bytesPerSample = SampleCodec<Sample>::BitsPerSample / 8;
+        const float scale = 1.0f / channels;
+        for (size_t i = 0; i < frames; i++)
+        {
+            const uint8_t* sample = data + i * format.BlockAlign;
+            float sum = 0;
+            for (size_t channel = 0; channel < channels; channel++, sample += bytesPerSample)
+            {
+                sum += SampleCodec<Sample>::Decode(sample);
+            }
+            mono[i] = sum * scale;
+        }
+    }
+
+    struct Entry
+    {
+        bool (*Matches)(const WavFileReader::WAVEFORMAT& format);
+        MonoDecoder Decode;
+    };
+
+    template <class Sample>
+    bool MatchesAny(const WavFileReader::WAVEFORMAT& format)
+    {
+        const bool formatTag = format.FormatTag == SampleCodec<Sample>::FormatTag
+            || (format.FormatTag == 0xFFFE && SampleCodec<Sample>::FormatTag == 1);
+        return formatTag && format.BitsPerSample == SampleCodec<Sample>::BitsPerSample && format.Channels > 0
+            && format.BlockAlign >= format.Channels * (SampleCodec<Sample>::BitsPerSample / 8);
+    }
+
+    template <class View>
+    Entry Specialized()
+    {
+        return Entry{ &View::Matches, &DecodeView<View> };
+    }
+
+    template <class Sample>
+    Entry Generic()
+    {
+        return Entry{ &MatchesAny<Sample>, &DecodeAny<Sample> };
+    }
+}
+
+// Returns the decoder for audio of 'format', as parsed from a wav header, or nullptr if the format is not supported.
+// The format is looked up once, so decoding does not branch on it per sample.
+inline MonoDecoder FindMonoDecoder(const WavFileReader::WAVEFORMAT& format)
+{
+    using namespace PcmDecoders;
+    // The sample rate does not change how samples are decoded, so formats of any rate share these loops.
+    static const Entry decoders[] =
+    {
+        Specialized<PcmView<MuLaw, 1>>(),
+        Specialized<PcmView<int16_t, 1>>(),
+        Specialized<PcmView<int16_t, 2>>(),
+        Specialized<PcmView<float, 1>>(),
+        Specialized<PcmView<float, 2>>(),
+        Generic<uint8_t>(),
+        Generic<int16_t>(),
+        Generic<Int24>(),
+        Generic<int32_t>(),
+        Generic<float>(),
+        Generic<ALaw>(),
+        Generic<MuLaw>(),
+    };
+    for (const auto& decoder : decoders)
+    {
+        if (decoder.Matches(format))
+        {
+            return decoder.Decode;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,244 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The scores of an assessed answer, see PronunciationBatchScorer.
+struct AnswerScore
+{
+    uint32_t Answer = 0;
+    std::string AudioFileName;
+    std::string ReferenceText;
+    std::string RecognizedText;
+    float Accuracy = 0;
+    float Fluency = 0;
+    float Completeness = 0;
+    float Pronunciation = 0;
+    // Empty unless the answer could not be assessed.
+    std::string Error;
+};
+
+// The score of one phoneme of an assessed answer.
+struct PhonemeScore
+{
+    uint32_t Answer = 0;
+    std::string Word;
+    // The error type of the word, e.g. "None", "Omission" or "Mispronunciation".
+    std::string ErrorType;
+    float WordAccuracy = 0;
+    std::string Phoneme;
+    // From the start of the answer's audio.
+    uint32_t OffsetMilliseconds = 0;
+    uint32_t DurationMilliseconds = 0;
+    float Accuracy = 0;
+};
+
+// Streams phoneme scores to a columnar file, so that a grading job can be analysed by reading only the columns
+// it needs, e.g. the phoneme and accuracy columns to find the phonemes a class struggles with. Rows are kept in
+// memory until a row group is full, and are then written column by column. Strings are written once, to a
+// dictionary, the columns refer to them by id.
+//
+// The file starts with "PHSC" and a uint32 version, followed by blocks of a uint8 kind, a uint32 payload size
+// and the payload. Numbers are little-endian, strings are a uint32 length and UTF-8 bytes.
+//   1 string:    uint32 id, string. Strings are defined before the first row group that refers to them.
+//   2 answer:    uint32 answer, string audio file, string reference, string recognized, float32 accuracy,
+//                fluency, completeness, pronunciation, string error.
+//   3 row group: uint32 rows, then one array per column, each with one value per row: uint32 answer, uint32 word,
+//                uint32 error type, float32 word accuracy, uint32 phoneme, uint32 offset ms, uint32 duration ms,
+//                float32 accuracy. The string columns hold string ids.
+//
+// The writer can be used from any thread.
+class PhonemeScoreWriter final
+{
+public:
+    explicit PhonemeScoreWriter(const std::string& fileName, size_t rowsPerGroup = 4096)
+        : m_file(fileName, std::ios::binary | std::ios::trunc), m_rowsPerGroup(rowsPerGroup)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot open score file " + fileName);
+        }
+        if (rowsPerGroup == 0)
+        {
+            throw std::invalid_argument("Row groups must have at least one row");
+        }
+        m_file.write("PHSC", 4);
+        std::string version;
+        Append(version, (uint32_t)1);
+        m_file.write(version.data(), version.size());
+    }
+
+    ~PhonemeScoreWriter()
+    {
+        Close();
+    }
+
+    PhonemeScoreWriter(const PhonemeScoreWriter&) = delete;
+    PhonemeScoreWriter& operator=(const PhonemeScoreWriter&) = delete;
+
+    void WriteAnswer(const AnswerScore& answer)
+    {
+        std::string payload;
+        Append(payload, answer.Answer);
+        Append(payload, answer.AudioFileName);
+        Append(payload, answer.ReferenceText);
+        Append(payload, answer.RecognizedText);
+        Append(payload, answer.Accuracy);
+        Append(payload, answer.Fluency);
+        Append(payload, answer.Completeness);
+        Append(payload, answer.Pronunciation);
+        Append(payload, answer.Error);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        WriteBlock(blockAnswer, payload);
+    }
+
+    void Write(const std::vector<PhonemeScore>& phonemes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& phoneme : phonemes)
+        {
+            m_answers.push_back(phoneme.Answer);
+            m_words.push_back(Intern(phoneme.Word));
+            m_errorTypes.push_back(Intern(phoneme.ErrorType));
+            m_wordAccuracies.push_back(phoneme.WordAccuracy);
+            m_phonemes.push_back(Intern(phoneme.Phoneme));
+            m_offsets.push_back(phoneme.OffsetMilliseconds);
+            m_durations.push_back(phoneme.DurationMilliseconds);
+            m_accuracies.push_back(phoneme.Accuracy);
+            if (m_answers.size() == m_rowsPerGroup)
+            {
+                WriteRowGroup();
+            }
+        }
+    }
+
+    // Writes the rows of the incomplete row group, and closes the file.
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file.is_open())
+        {
+            return;
+        }
+        WriteRowGroup();
+        m_file.close();
+    }
+
+    // Returns the number of phoneme rows written so far.
+    uint64_t Rows() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_rows + m_answers.size();
+    }
+
+private:
+    static constexpr uint8_t blockString = 1;
+    static constexpr uint8_t blockAnswer = 2;
+    static constexpr uint8_t blockRowGroup = 3;
+
+    // Appends the little-endian bytes of a number. Windows targets are little-endian, so they are copied.
+    template <class T>
+    static void Append(std::string& payload, T value)
+    {
+        payload.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void Append(std::string& payload, const std::string& value)
+    {
+        Append(payload, (uint32_t)value.size());
+        payload += value;
+    }
+
+    template <class T>
+    static void AppendColumn(std::string& payload, const std::vector<T>& column)
+    {
+        payload.append(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+    }
+
+    // Returns the id of a string, and defines it in the file the first time. Must be called with the mutex held.
+    uint32_t Intern(const std::string& value)
+    {
+        auto it = m_strings.find(value);
+        if (it != m_strings.end())
+        {
+            return it->second;
+        }
+        const uint32_t id = (uint32_t)m_strings.size();
+        m_strings.emplace(value, id);
+        std::string payload;
+        Append(payload, id);
+        Append(payload, value);
+        WriteBlock(blockString, payload);
+        return id;
+    }
+
+    // Must be called with the mutex held.
+    void WriteBlock(uint8_t kind, const std::string& payload)
+    {
+        std::string header;
+        Append(header, kind);
+        Append(header, (uint32_t)payload.size());
+        m_file.write(header.data(), header.size());
+        m_file.write(payload.data(), payload.size());
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot write to the score file");
+        }
+    }
+
+    // Must be called with the mutex held.
+    void WriteRowGroup()
+    {
+        if (m_answers.empty())
+        {
+            return;
+        }
+        std::string payload;
+        Append(payload, (uint32_t)m_answers.size());
+        AppendColumn(payload, m_answers);
+        AppendColumn(payload, m_words);
+        AppendColumn(payload, m_errorTypes);
+        AppendColumn(payload, m_wordAccuracies);
+        AppendColumn(payload, m_phonemes);
+        AppendColumn(payload, m_offsets);
+        AppendColumn(payload, m_durations);
+        AppendColumn(payload, m_accuracies);
+        WriteBlock(blockRowGroup, payload);
+
+        m_rows += m_answers.size();
+        m_answers.clear();
+        m_words.clear();
+        m_errorTypes.clear();
+        m_wordAccuracies.clear();
+        m_phonemes.clear();
+        m_offsets.clear();
+        m_durations.clear();
+        m_accuracies.clear();
+    }
+
+    std::ofstream m_file;
+    const size_t m_rowsPerGroup;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, uint32_t> m_strings;
+    uint64_t m_rows = 0;
+
+    // The columns of the row group that is being filled.
+    std::vector<uint32_t> m_answers;
+    std::vector<uint32_t> m_words;
+    std::vector<uint32_t> m_errorTypes;
+    std::vector<float> m_wordAccuracies;
+    std::vector<uint32_t> m_phonemes;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_durations;
+    std::vector<float> m_accuracies;
+};
@@ -0,0 +1,201 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A phrase list that is built once and then attached to any number of recognizers, e.g. the domain phrases of a
+// customized model. Building it trims the phrases, collapses their inner white space, drops empty phrases and
+// duplicates, and sorts them, so that two bundles can be compared phrase by phrase. A bundle cannot be changed
+// once built, a new version of the list is a new bundle.
+class PhraseListBundle final
+{
+public:
+    // The phrases that are in one bundle and not in another.
+    struct Diff
+    {
+        std::vector<std::string> Added;
+        std::vector<std::string> Removed;
+    };
+
+    static std::shared_ptr<const PhraseListBundle> Build(const std::vector<std::string>& phrases)
+    {
+        std::shared_ptr<PhraseListBundle> bundle(new PhraseListBundle());
+        bundle->m_phrases.reserve(phrases.size());
+        for (const auto& phrase : phrases)
+        {
+            auto normalized = Normalize(phrase);
+            if (!normalized.empty())
+            {
+                bundle->m_phrases.push_back(std::move(normalized));
+            }
+        }
+        std::sort(bundle->m_phrases.begin(), bundle->m_phrases.end());
+        bundle->m_phrases.erase(std::unique(bundle->m_phrases.begin(), bundle->m_phrases.end()), bundle->m_phrases.end());
+
+        // FNV-1a over the sorted phrases, with a separator byte that does not occur in UTF-8.
+        uint64_t hash = 14695981039346656037ULL;
+        for (const auto& phrase : bundle->m_phrases)
+        {
+            for (char c : phrase)
+            {
+                hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+            }
+            hash = (hash ^ 0xff) * 1099511628211ULL;
+        }
+        bundle->m_fingerprint = hash;
+        return bundle;
+    }
+
+    // Returns a new bundle with the phrases of this one and the given ones.
+    std::shared_ptr<const PhraseListBundle> With(const std::vector<std::string>& phrases) const
+    {
+        auto all = m_phrases;
+        all.insert(all.end(), phrases.begin(), phrases.end());
+        return Build(all);
+    }
+
+    const std::vector<std::string>& Phrases() const
+    {
+        return m_phrases;
+    }
+
+    // Identifies the content of the bundle, bundles with the same phrases have the same fingerprint.
+    uint64_t Fingerprint() const
+    {
+        return m_fingerprint;
+    }
+
+    // Returns the phrases that were added and removed from 'from' to this bundle, in one pass over both.
+    Diff DiffFrom(const PhraseListBundle& from) const
+    {
+        Diff diff;
+        std::set_difference(m_phrases.begin(), m_phrases.end(), from.m_phrases.begin(), from.m_phrases.end(), std::back_inserter(diff.Added));
+        std::set_difference(from.m_phrases.begin(), from.m_phrases.end(), m_phrases.begin(), m_phrases.end(), std::back_inserter(diff.Removed));
+        return diff;
+    }
+
+private:
+    PhraseListBundle() = default;
+
+    static std::string Normalize(const std::string& phrase)
+    {
+        std::string normalized;
+        normalized.reserve(phrase.size());
+        bool space = false;
+        for (char c : phrase)
+        {
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                space = !normalized.empty();
+                continue;
+            }
+            if (space)
+            {
+                normalized += ' ';
+                space = false;
+            }
+            normalized += c;
+        }
+        return normalized;
+    }
+
+    std::vector<std::string> m_phrases;
+    uint64_t m_fingerprint = 0;
+};
+
+// Attaches phrase list bundles to recognizers, and remembers which bundle each recognizer has. Attaching a bundle
+// to a recognizer that already has it does nothing, and attaching a newer version only adds the new phrases. The
+// phrase list of a recognizer has no way to remove single phrases, so a version that removes phrases clears the
+// list and adds all of its phrases again.
+//
+// Recognizers that keep their phrase list between sessions, e.g. the ones of a RecognizerPool, so only get the
+// changes. The binder keeps no recognizer alive.
+class PhraseListBinder final
+{
+public:
+    // Attaches the bundle to the recognizer, and returns the number of phrases that were added to its phrase list.
+    template <class RecognizerType>
+    size_t Attach(const std::shared_ptr<RecognizerType>& recognizer, const std::shared_ptr<const PhraseListBundle>& bundle)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_attached.begin(); it != m_attached.end();)
+        {
+            it = it->second.Owner.expired() ? m_attached.erase(it) : std::next(it);
+        }
+
+        auto& attached = m_attached[recognizer.get()];
+        if (attached.Bundle != nullptr && attached.Bundle->Fingerprint() == bundle->Fingerprint())
+        {
+            m_phrasesSkipped += bundle->Phrases().size();
+            return 0;
+        }
+        if (attached.Grammar == nullptr)
+        {
+            attached.Owner = recognizer;
+            attached.Grammar = PhraseListGrammar::FromRecognizer(recognizer);
+        }
+
+        const std::vector<std::string>* phrases = &bundle->Phrases();
+        PhraseListBundle::Diff diff;
+        if (attached.Bundle != nullptr)
+        {
+            diff = bundle->DiffFrom(*attached.Bundle);
+            if (diff.Removed.empty())
+            {
+                phrases = &diff.Added;
+            }
+            else
+            {
+                attached.Grammar->Clear();
+            }
+        }
+        for (const auto& phrase : *phrases)
+        {
+            attached.Grammar->AddPhrase(phrase);
+        }
+        m_phrasesSkipped += bundle->Phrases().size() - phrases->size();
+        m_phrasesSent += phrases->size();
+        attached.Bundle = bundle;
+        return phrases->size();
+    }
+
+    // Returns the number of phrases added to the phrase lists of recognizers.
+    uint64_t PhrasesSent() const
+    {
+        return m_phrasesSent;
+    }
+
+    // Returns the number of phrases that were not added again because a recognizer already had them.
+    uint64_t PhrasesSkipped() const
+    {
+        return m_phrasesSkipped;
+    }
+
+private:
+    struct Attached
+    {
+        // Tells whether the key still refers to the same recognizer, the address of a destroyed one can be reused.
+        std::weak_ptr<void> Owner;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::PhraseListGrammar> Grammar;
+        std::shared_ptr<const PhraseListBundle> Bundle;
+    };
+
+    std::mutex m_mutex;
+    std::map<const void*, Attached> m_attached;
+    std::atomic<uint64_t> m_phrasesSent{ 0 };
+    std::atomic<uint64_t> m_phrasesSkipped{ 0 };
+};
@@ -0,0 +1,261 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "trace_recorder.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Fixed-size chunks of memory, allocated a slab at a time and recycled through a free list, so that audio
+// output does not allocate once the pool has grown to the working set. Can be shared by many streams.
+class AudioChunkPool final
+{
+public:
+    explicit AudioChunkPool(size_t chunkSize = 16 * 1024, size_t chunksPerSlab = 64)
+        : m_chunkSize(chunkSize), m_chunksPerSlab(chunksPerSlab)
+    {
+        if (chunkSize == 0 || chunksPerSlab == 0)
+        {
+            throw std::invalid_argument("Chunk size and chunks per slab must be at least 1");
+        }
+    }
+
+    AudioChunkPool(const AudioChunkPool&) = delete;
+    AudioChunkPool& operator=(const AudioChunkPool&) = delete;
+
+    size_t ChunkSize() const
+    {
+        return m_chunkSize;
+    }
+
+    uint8_t* Acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.empty())
+        {
+            m_slabs.emplace_back(new uint8_t[m_chunkSize * m_chunksPerSlab]);
+            for (size_t i = m_chunksPerSlab; i > 0; i--)
+            {
+                m_free.push_back(m_slabs.back().get() + (i - 1) * m_chunkSize);
+            }
+        }
+        uint8_t* chunk = m_free.back();
+        m_free.pop_back();
+        return chunk;
+    }
+
+    void Release(uint8_t* chunk)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(chunk);
+    }
+
+    // Returns the memory held by the pool, in use or free.
+    size_t CapacityBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slabs.size() * m_chunksPerSlab * m_chunkSize;
+    }
+
+private:
+    const size_t m_chunkSize;
+    const size_t m_chunksPerSlab;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<uint8_t[]>> m_slabs;
+    std::vector<uint8_t*> m_free;
+};
+
+// Push audio output callback that collects the audio in pooled chunks. Unlike a growing vector, a long
+// synthesis never reallocates or copies the audio it has already received, and Write() does no I/O on the
+// synthesizer thread. The audio is exposed as a list of segments, and written out with one writev() call
+// per batch of segments, without being flattened into one buffer.
+class PooledAudioOutputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback
+{
+public:
+    // One contiguous part of the audio. Valid until Reset() is called or the callback is destroyed.
+    struct Segment
+    {
+        const uint8_t* Data;
+        size_t Size;
+    };
+
+    explicit PooledAudioOutputCallback(std::shared_ptr<AudioChunkPool> pool)
+        : m_pool(std::move(pool))
+    {
+        if (m_pool == nullptr)
+        {
+            throw std::invalid_argument("Pool is null");
+        }
+    }
+
+    ~PooledAudioOutputCallback()
+    {
+        Reset();
+    }
+
+    int Write(uint8_t* dataBuffer, uint32_t size) override
+    {
+        TraceSpan span("synthesis", "PooledAudioOutputCallback::Write", "size", size);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const size_t chunkSize = m_pool->ChunkSize();
+        size_t written = 0;
+        while (written < size)
+        {
+            if (m_segments.empty() || m_segments.back().Size == chunkSize)
+            {
+                m_segments.push_back(Segment{ m_pool->Acquire(), 0 });
+            }
+            auto& tail = m_segments.back();
+            const size_t count = std::min<size_t>(size - written, chunkSize - tail.Size);
+            memcpy(const_cast<uint8_t*>(tail.Data) + tail.Size, dataBuffer + written, count);
+            tail.Size += count;
+            written += count;
+        }
+        m_size += size;
+        return (int)size;
+    }
+
+    void Close() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+
+    bool IsClosed() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_size;
+    }
+
+    std::vector<Segment> Segments() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_segments;
+    }
+
+    // Writes all audio to a file or socket descriptor. Returns false if writing fails.
+    bool WriteTo(int fileDescriptor) const
+    {
+        const auto segments = Segments();
+#ifdef _WIN32
+        for (const auto& segment : segments)
+        {
+            size_t offset = 0;
+            while (offset < segment.Size)
+            {
+                const int count = _write(fileDescriptor, segment.Data + offset, (unsigned int)(segment.Size - offset));
+                if (count <= 0)
+                {
+                    return false;
+                }
+                offset += (size_t)count;
+            }
+        }
+        return true;
+#else
+        // At most 64 segments, i.e. 1 MB of audio with the default chunk size, are passed per call.
+        const size_t batchSize = 64;
+        iovec vectors[batchSize];
+        size_t next = 0;
+        size_t offset = 0;
+        while (next < segments.size())
+        {
+            size_t count = 0;
+            for (size_t i = next; i < segments.size() && count < batchSize; i++, count++)
+            {
+                const size_t skip = i == next ? offset : 0;
+                vectors[count].iov_base = const_cast<uint8_t*>(segments[i].Data + skip);
+                vectors[count].iov_len = segments[i].Size - skip;
+            }
+            ssize_t written = writev(fileDescriptor, vectors, (int)count);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+            // A short write ends within a segment, the next call starts there.
+            while (written > 0)
+            {
+                const size_t left = segments[next].Size - offset;
+                if ((size_t)written < left)
+                {
+                    offset += (size_t)written;
+                    break;
+                }
+                written -= (ssize_t)left;
+                next++;
+                offset = 0;
+            }
+        }
+        return true;
+#endif
+    }
+
+    // Writes all audio to a new file. Returns false if the file cannot be written.
+    bool SaveToFile(const std::string& fileName) const
+    {
+#ifdef _WIN32
+        const int file = _open(fileName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        const int file = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        if (file < 0)
+        {
+            return false;
+        }
+        const bool written = WriteTo(file);
+#ifdef _WIN32
+        return _close(file) == 0 && written;
+#else
+        return close(file) == 0 && written;
+#endif
+    }
+
+    // Returns the chunks to the pool, so that the callback can be used for the next synthesis.
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& segment : m_segments)
+        {
+            m_pool->Release(const_cast<uint8_t*>(segment.Data));
+        }
+        m_segments.clear();
+        m_size = 0;
+        m_closed = false;
+    }
+
+private:
+    std::shared_ptr<AudioChunkPool> m_pool;
+    mutable std::mutex m_mutex;
+    std::vector<Segment> m_segments;
+    size_t m_size = 0;
+    bool m_closed = false;
+};
@@ -0,0 +1,57 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+// The memory of this process as the OS accounts it: the working set on Windows, the resident set from /proc on
+// Linux. Both are 0 where they cannot be read, e.g. on macOS.
+struct ProcessMemory
+{
+    uint64_t ResidentBytes = 0;
+    // The largest resident set since the process started.
+    uint64_t PeakResidentBytes = 0;
+
+    static ProcessMemory Current()
+    {
+        ProcessMemory memory;
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters = {};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            memory.ResidentBytes = counters.WorkingSetSize;
+            memory.PeakResidentBytes = counters.PeakWorkingSetSize;
+        }
+#elif defined(__linux__)
+        // Lines such as "VmRSS:     10240 kB".
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+            {
+                memory.ResidentBytes = std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+            }
+            else if (line.compare(0, 6, "VmHWM:") == 0)
+            {
+                memory.PeakResidentBytes = std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+            }
+        }
+#endif
+        return memory;
+    }
+};
@@ -0,0 +1,362 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json_reader.h"
+#include "pcm_converter.h"
+#include "phoneme_score_writer.h"
+#include "recognizer_pool.h"
+
+// Scores recorded answers, pairs of a wav file and the reference text that was read out, with pronunciation
+// assessment. Answers are assessed concurrently by worker threads, each with a recognizer leased from a
+// RecognizerPool, so the connections are opened once for the whole batch instead of once per answer. The detailed
+// json result of each answer is reduced to one record per phoneme, which are streamed to a PhonemeScoreWriter.
+//
+// A pooled recognizer keeps the audio input it was created with, so each one reads from an AnswerFeed, a pull stream
+// that the worker switches to the next answer. After an answer the feed returns silence, which ends the utterance.
+class PronunciationBatchScorer final
+{
+public:
+    // Called on a worker thread after each answer, e.g. to show progress.
+    using AnswerHandler = std::function<void(const AnswerScore& answer)>;
+
+    // 'concurrency' is the number of answers assessed at the same time, and of pooled recognizers.
+    // The writer must outlive the scorer.
+    PronunciationBatchScorer(const std::string& subscriptionKey, const RecognizerPoolKey& key, size_t concurrency,
+        PhonemeScoreWriter& writer, AnswerHandler onAnswer = nullptr)
+        : m_key(key), m_writer(writer), m_onAnswer(std::move(onAnswer)),
+        m_pool(subscriptionKey, concurrency, [this]() { return CreateAudioInput(); })
+    {
+        if (concurrency == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1");
+        }
+        m_pool.Warm(m_key, concurrency);
+        for (size_t i = 0; i < concurrency; i++)
+        {
+            m_workers.emplace_back(&PronunciationBatchScorer::Run, this);
+        }
+    }
+
+    ~PronunciationBatchScorer()
+    {
+        Finish();
+    }
+
+    PronunciationBatchScorer(const PronunciationBatchScorer&) = delete;
+    PronunciationBatchScorer& operator=(const PronunciationBatchScorer&) = delete;
+
+    // Queues an answer, and returns its id in the score file. Answers are not necessarily scored in order.
+    uint32_t Add(const std::string& audioFileName, const std::string& referenceText)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_finishing)
+        {
+            throw std::runtime_error("Answers cannot be added after Finish()");
+        }
+        Job job{ m_nextAnswer++, audioFileName, referenceText };
+        m_jobs.push_back(job);
+        m_changed.notify_one();
+        return job.Answer;
+    }
+
+    // Waits until all queued answers are scored.
+    void Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_finishing)
+            {
+                return;
+            }
+            m_finishing = true;
+        }
+        m_changed.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& feed : m_feeds)
+        {
+            feed.second->Shutdown();
+        }
+    }
+
+    uint64_t Scored() const
+    {
+        return m_scored;
+    }
+
+    // Returns the number of answers that could not be assessed.
+    uint64_t Failed() const
+    {
+        return m_failed;
+    }
+
+private:
+    // The sample rate of the audio that is sent to the service, answers are converted to it.
+    static constexpr uint32_t sampleRate = 16000;
+    // Silence returned without pacing after an answer, enough for the end silence timeout of the assessment.
+    static constexpr uint32_t trailingSilenceMilliseconds = 6000;
+
+    struct Job
+    {
+        uint32_t Answer;
+        std::string AudioFileName;
+        std::string ReferenceText;
+    };
+
+    // The audio input of a pooled recognizer. Returns the audio of the current answer, then silence.
+    class AnswerFeed final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        // Starts the next answer, 16-bit mono PCM at the scorer's sample rate.
+        void Start(std::vector<uint8_t> audio)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_audio = std::move(audio);
+            m_position = 0;
+            m_startPending = true;
+            m_silence = 0;
+        }
+
+        // Returns the position in the stream where the current answer starts, in ticks, as the result offsets.
+        uint64_t AnswerStartTicks() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_answerStart / (sampleRate * 2 / 1000) * 10000;
+        }
+
+        // Ends the stream, the next read returns 0.
+        void Shutdown()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            size &= ~1u;
+            bool paced = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_shutdown)
+                {
+                    return 0;
+                }
+                if (m_startPending)
+                {
+                    // The stream offsets of the answer's results count from here.
+                    m_answerStart = m_delivered;
+                    m_startPending = false;
+                }
+                const size_t count = std::min<size_t>(size, m_audio.size() - m_position);
+                memcpy(dataBuffer, m_audio.data() + m_position, count);
+                m_position += count;
+                memset(dataBuffer + count, 0, size - count);
+                m_silence += size - count;
+                m_delivered += size;
+                // Between answers silence is returned in real time, the service needs no more than that.
+                paced = m_silence > (uint64_t)trailingSilenceMilliseconds * sampleRate * 2 / 1000;
+            }
+            if (paced)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(size / (sampleRate * 2 / 1000)));
+            }
+            return (int)size;
+        }
+
+        void Close() override
+        {
+        }
+
+    private:
+        mutable std::mutex m_mutex;
+        std::vector<uint8_t> m_audio;
+        size_t m_position = 0;
+        uint64_t m_delivered = 0;
+        uint64_t m_answerStart = 0;
+        uint64_t m_silence = 0;
+        bool m_startPending = false;
+        bool m_shutdown = false;
+    };
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> CreateAudioInput()
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto feed = std::make_shared<AnswerFeed>();
+        auto audioInput = AudioConfig::FromStreamInput(AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(sampleRate, 16, 1), feed));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_feeds[audioInput.get()] = feed;
+        return audioInput;
+    }
+
+    void Run()
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        // The reference text is set per answer, so each worker has its own config.
+        auto pronunciationConfig = PronunciationAssessmentConfig::Create("",
+            PronunciationAssessmentGradingSystem::HundredMark, PronunciationAssessmentGranularity::Phoneme, true);
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this]() { return m_finishing || !m_jobs.empty(); });
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            AnswerScore answer;
+            answer.Answer = job.Answer;
+            answer.AudioFileName = job.AudioFileName;
+            answer.ReferenceText = job.ReferenceText;
+            std::vector<PhonemeScore> phonemes;
+            try
+            {
+                // Reads the answer before leasing a recognizer, so the recognizers are only held while assessing.
+                auto audio = ReadAnswer(job.AudioFileName);
+                auto recognizer = m_pool.Acquire(m_key);
+                std::shared_ptr<AnswerFeed> feed;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    feed = m_feeds.at(recognizer.AudioInput().get());
+                }
+                pronunciationConfig->SetReferenceText(job.ReferenceText);
+                pronunciationConfig->ApplyTo(recognizer.Get());
+                // The answer starts once the recognition has started, so none of it can go to the end of the last one.
+                auto recognition = recognizer->RecognizeOnceAsync();
+                feed->Start(std::move(audio));
+                auto result = recognition.get();
+                if (result->Reason == ResultReason::RecognizedSpeech)
+                {
+                    Parse(result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult), feed->AnswerStartTicks(), answer, phonemes);
+                }
+                else if (result->Reason == ResultReason::Canceled)
+                {
+                    answer.Error = CancellationDetails::FromResult(result)->ErrorDetails;
+                }
+                else
+                {
+                    answer.Error = "No speech could be recognized";
+                }
+            }
+            catch (const std::exception& e)
+            {
+                answer.Error = e.what();
+            }
+
+            m_writer.WriteAnswer(answer);
+            m_writer.Write(phonemes);
+            if (answer.Error.empty())
+            {
+                m_scored++;
+            }
+            else
+            {
+                m_failed++;
+            }
+            if (m_onAnswer)
+            {
+                m_onAnswer(answer);
+            }
+        }
+    }
+
+    static std::vector<uint8_t> ReadAnswer(const std::string& audioFileName)
+    {
+        ConvertingWavFileReader reader(audioFileName, sampleRate);
+        std::vector<uint8_t> audio;
+        std::vector<uint8_t> buffer(64 * 1024);
+        int count = 0;
+        while ((count = reader.Read(buffer.data(), (uint32_t)buffer.size())) > 0)
+        {
+            audio.insert(audio.end(), buffer.begin(), buffer.begin() + count);
+        }
+        return audio;
+    }
+
+    // Reads the scores of the answer and of its phonemes from the detailed json result. Offsets in the result count
+    // from the start of the stream, they are made relative to the start of the answer.
+    static void Parse(const std::string& json, uint64_t answerStartTicks, AnswerScore& answer, std::vector<PhonemeScore>& phonemes)
+    {
+        auto toMilliseconds = [answerStartTicks](const JsonValue& ticks)
+        {
+            const uint64_t value = (uint64_t)ticks.AsNumber();
+            return (uint32_t)((value > answerStartTicks ? value - answerStartTicks : 0) / 10000);
+        };
+
+        const auto root = JsonValue::Parse(json);
+        const auto& best = root["NBest"][0];
+        const auto& scores = best["PronunciationAssessment"];
+        answer.RecognizedText = root["DisplayText"].AsString();
+        answer.Accuracy = (float)scores["AccuracyScore"].AsNumber();
+        answer.Fluency = (float)scores["FluencyScore"].AsNumber();
+        answer.Completeness = (float)scores["CompletenessScore"].AsNumber();
+        answer.Pronunciation = (float)scores["PronScore"].AsNumber();
+        for (const auto& word : best["Words"].Elements())
+        {
+            PhonemeScore phoneme;
+            phoneme.Answer = answer.Answer;
+            phoneme.Word = word["Word"].AsString();
+            phoneme.ErrorType = word["PronunciationAssessment"]["ErrorType"].AsString();
+            phoneme.WordAccuracy = (float)word["PronunciationAssessment"]["AccuracyScore"].AsNumber();
+            for (const auto& item : word["Phonemes"].Elements())
+            {
+                phoneme.Phoneme = item["Phoneme"].AsString();
+                phoneme.OffsetMilliseconds = toMilliseconds(item["Offset"]);
+                phoneme.DurationMilliseconds = (uint32_t)(item["Duration"].AsNumber() / 10000);
+                phoneme.Accuracy = (float)item["PronunciationAssessment"]["AccuracyScore"].AsNumber();
+                phonemes.push_back(phoneme);
+            }
+            // An omitted word has no phonemes, it is kept as one row without a phoneme.
+            if (word["Phonemes"].Size() == 0)
+            {
+                phoneme.OffsetMilliseconds = toMilliseconds(word["Offset"]);
+                phoneme.DurationMilliseconds = (uint32_t)(word["Duration"].AsNumber() / 10000);
+                phonemes.push_back(phoneme);
+            }
+        }
+    }
+
+    const RecognizerPoolKey m_key;
+    PhonemeScoreWriter& m_writer;
+    const AnswerHandler m_onAnswer;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // The feed of each pooled recognizer, by its audio input. Declared before the pool, which reads from them.
+    std::map<const void*, std::shared_ptr<AnswerFeed>> m_feeds;
+    std::deque<Job> m_jobs;
+    uint32_t m_nextAnswer = 0;
+    bool m_finishing = false;
+    std::atomic<uint64_t> m_scored{ 0 };
+    std::atomic<uint64_t> m_failed{ 0 };
+
+    RecognizerPool m_pool;
+    std::vector<std::thread> m_workers;
+};
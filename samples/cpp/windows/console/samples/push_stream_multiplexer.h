@@ -0,0 +1,239 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Feeds many PushAudioInputStreams from a small, fixed pool of threads instead of one thread per stream.
+// Every stream is paced to real time: it gets one chunk of audio per chunk duration, and the chunks of all
+// streams are written in the order of their deadlines. A thread that is not writing waits for the nearest
+// deadline, so idle streams cost no thread and no CPU time.
+class PushStreamMultiplexer final
+{
+public:
+    // Reads up to 'size' bytes of audio into 'buffer' and returns the number of bytes read, 0 at the end of the audio.
+    // A reader is only ever called by one thread at a time.
+    using AudioReader = std::function<int(uint8_t* buffer, uint32_t size)>;
+    // Called on a writer thread once the audio of a stream has been written and the push stream is closed.
+    // An exception it throws is ignored.
+    using CompletionHandler = std::function<void()>;
+
+    // Starts 'threadCount' writer threads. 'speed' scales the pacing, e.g. 2 feeds audio at twice real time.
+    explicit PushStreamMultiplexer(size_t threadCount, double speed = 1.0)
+        : m_speed(speed)
+    {
+        if (threadCount == 0)
+        {
+            throw std::invalid_argument("Thread count must be at least 1");
+        }
+        if (speed <= 0)
+        {
+            throw std::invalid_argument("Speed must be greater than 0");
+        }
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_threads.emplace_back(&PushStreamMultiplexer::Run, this);
+        }
+    }
+
+    // Stops the writer threads. Call WaitAll() first, streams that are still active are not closed.
+    ~PushStreamMultiplexer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        for (auto& t : m_threads)
+        {
+            t.join();
+        }
+    }
+
+    PushStreamMultiplexer(const PushStreamMultiplexer&) = delete;
+    PushStreamMultiplexer& operator=(const PushStreamMultiplexer&) = delete;
+
+    // Adds a stream that is fed from 'reader' with 'bytesPerSecond' of audio, in chunks of 'chunkSize' bytes.
+    // The chunk size should be a multiple of the sample frame size, e.g. from PushStreamPump::ChunkSizeFor.
+    // The first chunk is written right away.
+    void Add(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream,
+        AudioReader reader, uint32_t bytesPerSecond, uint32_t chunkSize, CompletionHandler onCompleted = nullptr)
+    {
+        if (pushStream == nullptr || !reader)
+        {
+            throw std::invalid_argument("Push stream and reader must be set");
+        }
+        if (bytesPerSecond == 0 || chunkSize == 0)
+        {
+            throw std::invalid_argument("Byte rate and chunk size must be greater than 0");
+        }
+
+        auto stream = std::make_shared<Stream>();
+        stream->PushStream = std::move(pushStream);
+        stream->Reader = std::move(reader);
+        stream->BytesPerSecond = bytesPerSecond;
+        stream->Buffer.resize(chunkSize);
+        stream->OnCompleted = std::move(onCompleted);
+        stream->Start = Clock::now();
+        stream->Deadline = stream->Start;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active++;
+            m_schedule.push(stream);
+        }
+        // Only a new earliest deadline needs to wake a thread, but waking one is cheap and keeps this simple.
+        m_changed.notify_one();
+    }
+
+    // Returns the number of streams that have not been completed yet.
+    size_t ActiveCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_active;
+    }
+
+    // Waits until all streams added so far have been completed.
+    void WaitAll()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_allCompleted.wait(lock, [this]() { return m_active == 0; });
+    }
+
+    // Returns the largest delay of a chunk write behind its deadline, a measure of whether the thread pool keeps up.
+    std::chrono::microseconds MaxLateness() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_maxLateness;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stream
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> PushStream;
+        AudioReader Reader;
+        uint32_t BytesPerSecond = 0;
+        std::vector<uint8_t> Buffer;
+        CompletionHandler OnCompleted;
+        Clock::time_point Start;
+        Clock::time_point Deadline;
+        uint64_t BytesWritten = 0;
+    };
+
+    struct LaterDeadline
+    {
+        bool operator()(const std::shared_ptr<Stream>& a, const std::shared_ptr<Stream>& b) const
+        {
+            return a->Deadline > b->Deadline;
+        }
+    };
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            if (m_stopping)
+            {
+                return;
+            }
+            if (m_schedule.empty())
+            {
+                m_changed.wait(lock);
+                continue;
+            }
+            auto deadline = m_schedule.top()->Deadline;
+            if (Clock::now() < deadline)
+            {
+                m_changed.wait_until(lock, deadline);
+                continue;
+            }
+
+            // Takes the stream out of the schedule, so no other thread touches it while its chunk is written.
+            auto stream = m_schedule.top();
+            m_schedule.pop();
+            auto lateness = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - deadline);
+            if (lateness > m_maxLateness)
+            {
+                m_maxLateness = lateness;
+            }
+            lock.unlock();
+
+            bool completed = WriteChunk(*stream);
+            if (completed && stream->OnCompleted)
+            {
+                try
+                {
+                    stream->OnCompleted();
+                }
+                catch (...)
+                {
+                    // A failing handler must not stop the writer thread, the stream still counts as completed.
+                }
+            }
+
+            lock.lock();
+            if (completed)
+            {
+                if (--m_active == 0)
+                {
+                    m_allCompleted.notify_all();
+                }
+            }
+            else
+            {
+                m_schedule.push(stream);
+                // The next deadline may now be earlier than the one another thread is waiting for.
+                m_changed.notify_one();
+            }
+        }
+    }
+
+    // Writes the next chunk of a stream. Returns true if the audio has ended and the push stream is closed.
+    bool WriteChunk(Stream& stream)
+    {
+        int read = 0;
+        try
+        {
+            read = stream.Reader(stream.Buffer.data(), (uint32_t)stream.Buffer.size());
+        }
+        catch (const std::exception&)
+        {
+            // A failing source ends its stream, it must not take the writer thread down.
+            read = 0;
+        }
+        if (read <= 0)
+        {
+            stream.PushStream->Close();
+            return true;
+        }
+
+        stream.PushStream->Write(stream.Buffer.data(), (uint32_t)read);
+        stream.BytesWritten += (uint64_t)read;
+        // Deadlines are derived from the total amount written, so rounding does not add up to drift.
+        auto elapsed = std::chrono::duration<double>(stream.BytesWritten / (stream.BytesPerSecond * m_speed));
+        stream.Deadline = stream.Start + std::chrono::duration_cast<Clock::duration>(elapsed);
+        return false;
+    }
+
+    const double m_speed;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::condition_variable m_allCompleted;
+    std::priority_queue<std::shared_ptr<Stream>, std::vector<std::shared_ptr<Stream>>, LaterDeadline> m_schedule;
+    size_t m_active = 0;
+    std::chrono::microseconds m_maxLateness{ 0 };
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,172 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "spsc_ring_buffer.h"
+#include "trace_recorder.h"
+
+// Decouples an audio producer from a PushAudioInputStream. The producer copies audio into a lock-free
+// ring buffer, and a pump thread writes it to the push stream in frame-aligned chunks. Stalls of the
+// producer do not reach the SDK, and many small writes turn into few large ones. A side that has to wait, the
+// producer for space or the pump thread for a full chunk, blocks on a condition variable; the other side only
+// takes the lock to wake it when it is actually waiting.
+class PushStreamPump final
+{
+public:
+    // Returns the number of bytes in 'milliseconds' of audio, rounded down to whole sample frames.
+    static uint32_t ChunkSizeFor(uint32_t samplesPerSec, uint16_t blockAlign, uint32_t milliseconds)
+    {
+        uint64_t frames = (uint64_t)samplesPerSec * milliseconds / 1000;
+        return (uint32_t)((frames == 0 ? 1 : frames) * blockAlign);
+    }
+
+    // Starts the pump thread. 'chunkSize' is the size of each write to the push stream, it should be
+    // a multiple of the sample frame size (see ChunkSizeFor). 'bufferCapacity' bounds the audio queued
+    // between the producer and the push stream.
+    PushStreamPump(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream,
+        uint32_t chunkSize, size_t bufferCapacity)
+        : m_pushStream(pushStream), m_chunkSize(chunkSize), m_ring(bufferCapacity)
+    {
+        if (pushStream == nullptr)
+        {
+            throw std::invalid_argument("Push stream is null");
+        }
+        if (chunkSize == 0 || chunkSize > m_ring.Capacity())
+        {
+            throw std::invalid_argument("Chunk size must be between 1 byte and the buffer capacity");
+        }
+        m_thread = std::thread(&PushStreamPump::Run, this);
+    }
+
+    ~PushStreamPump()
+    {
+        Close();
+    }
+
+    PushStreamPump(const PushStreamPump&) = delete;
+    PushStreamPump& operator=(const PushStreamPump&) = delete;
+
+    // Queues audio for the push stream. Only one thread may call Write().
+    // Waits while the buffer is full, so a slow consumer applies back pressure to the producer.
+    void Write(const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            size_t written = m_ring.Write(data, size);
+            data += written;
+            size -= written;
+            if (written > 0 && m_ring.Size() >= m_chunkSize)
+            {
+                Notify(m_pumpWaiting, m_chunkReady);
+            }
+            if (size > 0)
+            {
+                Wait(m_producerWaiting, m_spaceReady, [this]() { return m_ring.Size() < m_ring.Capacity(); });
+            }
+        }
+    }
+
+    // Flushes the queued audio, closes the push stream and stops the pump thread.
+    void Close()
+    {
+        if (m_thread.joinable())
+        {
+            m_closing.store(true, std::memory_order_release);
+            Notify(m_pumpWaiting, m_chunkReady);
+            m_thread.join();
+        }
+    }
+
+    // Returns the largest number of bytes that has been queued at once.
+    size_t HighWaterMark() const
+    {
+        return m_ring.HighWaterMark();
+    }
+
+    size_t Capacity() const
+    {
+        return m_ring.Capacity();
+    }
+
+private:
+    // Blocks until 'ready' returns true. 'waiting' is set while it blocks, for Notify().
+    template <class Predicate>
+    void Wait(std::atomic<bool>& waiting, std::condition_variable& condition, Predicate ready)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        waiting.store(true);
+        // Orders the store above before the loads of 'ready', paired with the fence in Notify(): either this side
+        // sees the other side's progress, or the other side sees 'waiting' and wakes it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait(lock, ready);
+        waiting.store(false);
+    }
+
+    // Wakes the other side if it is blocked in Wait(), called after making progress it waits for.
+    void Notify(const std::atomic<bool>& waiting, std::condition_variable& condition)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            condition.notify_one();
+        }
+    }
+
+    void Run()
+    {
+        if (TraceRecorder::IsEnabled())
+        {
+            TraceRecorder::SetThreadName("PushStreamPump");
+        }
+        std::vector<uint8_t> chunk(m_chunkSize);
+        while (true)
+        {
+            // Reads the closing flag before the buffer size, so that all audio written before Close() is seen.
+            bool closing = m_closing.load(std::memory_order_acquire);
+            if (m_ring.Size() >= m_chunkSize || closing)
+            {
+                size_t read = m_ring.Read(chunk.data(), chunk.size());
+                if (read > 0)
+                {
+                    Notify(m_producerWaiting, m_spaceReady);
+                    TraceSpan span("push", "PushAudioInputStream::Write", "size", (int64_t)read);
+                    m_pushStream->Write(chunk.data(), (uint32_t)read);
+                }
+                else if (closing)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                Wait(m_pumpWaiting, m_chunkReady, [this]()
+                {
+                    return m_ring.Size() >= m_chunkSize || m_closing.load(std::memory_order_acquire);
+                });
+            }
+        }
+        m_pushStream->Close();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_pushStream;
+    uint32_t m_chunkSize;
+    SpscRingBuffer m_ring;
+    std::atomic<bool> m_closing{ false };
+
+    std::mutex m_mutex;
+    // The pump thread waits for a full chunk or Close(), the producer for free space.
+    std::condition_variable m_chunkReady;
+    std::condition_variable m_spaceReady;
+    std::atomic<bool> m_pumpWaiting{ false };
+    std::atomic<bool> m_producerWaiting{ false };
+    std::thread m_thread;
+};
@@ -0,0 +1,513 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counter that is incremented from many threads without contention. Each thread adds to one of
+// several shards on its own cache line, the shards are only summed up when the value is read.
+class ShardedCounter final
+{
+public:
+    void Add(uint64_t value = 1)
+    {
+        m_shards[ShardIndex()].Value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const
+    {
+        uint64_t sum = 0;
+        for (const auto& shard : m_shards)
+        {
+            sum += shard.Value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    static constexpr size_t shardCount = 8;
+
+    // Threads are assigned to shards round-robin the first time they increment any counter.
+    static size_t ShardIndex()
+    {
+        static std::atomic<size_t> nextThread{ 0 };
+        thread_local size_t index = nextThread++ % shardCount;
+        return index;
+    }
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> Value{ 0 };
+    };
+
+    std::array<Shard, shardCount> m_shards;
+};
+
+// Histogram of millisecond values with fixed bucket bounds, in the cumulative form used by Prometheus.
+class LatencyHistogram final
+{
+public:
+    static constexpr size_t bucketCount = 10;
+
+    // Upper bounds of the buckets in milliseconds, the last bucket has no upper bound.
+    static const std::array<double, bucketCount - 1>& Bounds()
+    {
+        static const std::array<double, bucketCount - 1> bounds{ { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000 } };
+        return bounds;
+    }
+
+    void Record(double milliseconds)
+    {
+        const auto& bounds = Bounds();
+        size_t bucket = 0;
+        while (bucket < bounds.size() && milliseconds > bounds[bucket])
+        {
+            bucket++;
+        }
+        m_buckets[bucket].Add();
+        // The sum is kept in microseconds, so that it can be an integer counter.
+        m_sumMicroseconds.Add((uint64_t)(milliseconds > 0 ? milliseconds * 1000 : 0));
+    }
+
+    // Number of values in the given bucket, not cumulative.
+    uint64_t BucketValue(size_t bucket) const
+    {
+        return m_buckets[bucket].Value();
+    }
+
+    uint64_t Count() const
+    {
+        uint64_t count = 0;
+        for (const auto& bucket : m_buckets)
+        {
+            count += bucket.Value();
+        }
+        return count;
+    }
+
+    double SumMilliseconds() const
+    {
+        return m_sumMicroseconds.Value() / 1000.0;
+    }
+
+private:
+    std::array<ShardedCounter, bucketCount> m_buckets;
+    ShardedCounter m_sumMicroseconds;
+};
+
+// Collects metrics from the events of speech, translation, intent recognizers and conversation transcribers,
+// without changing the event handlers of the samples: Attach() connects handlers of its own.
+// The handlers only increment counters, so they add next to nothing to the SDK callback threads.
+//
+// Recorded are the number of sessions, partial and final results and cancellations by error code,
+// the time from session start to the first partial result, and the lag between wall-clock time and
+// the end of the recognized audio, which grows when the service falls behind real-time input.
+// For input faster than real time (e.g. files) the lag is clamped to 0.
+class RecognizerMetrics final
+{
+public:
+    // 'recognizerName' is added as the "recognizer" label to all exported metrics.
+    explicit RecognizerMetrics(const std::string& recognizerName)
+        : m_state(std::make_shared<State>())
+    {
+        m_state->Name = recognizerName;
+        m_state->StartTime = std::chrono::system_clock::now();
+    }
+
+    RecognizerMetrics(const RecognizerMetrics&) = delete;
+    RecognizerMetrics& operator=(const RecognizerMetrics&) = delete;
+
+    // Attaches to a SpeechRecognizer, TranslationRecognizer or IntentRecognizer.
+    // The handlers hold a reference to the metrics state, so the recognizer may outlive this object.
+    template <class RecognizerT>
+    void Attach(const std::shared_ptr<RecognizerT>& recognizer)
+    {
+        auto session = AttachSession(*recognizer);
+        recognizer->Recognizing.Connect([session](const auto& e)
+        {
+            session->OnPartialResult(e.Result->Offset(), e.Result->Duration());
+        });
+        recognizer->Recognized.Connect([session](const auto& e)
+        {
+            session->OnFinalResult(e.Result->Offset(), e.Result->Duration(), e.Result->Reason == Microsoft::CognitiveServices::Speech::ResultReason::NoMatch);
+        });
+    }
+
+    // Attaches to a ConversationTranscriber, which raises Transcribing and Transcribed instead of Recognizing and Recognized.
+    void Attach(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Transcription::ConversationTranscriber>& transcriber)
+    {
+        auto session = AttachSession(*transcriber);
+        transcriber->Transcribing.Connect([session](const auto& e)
+        {
+            session->OnPartialResult(e.Result->Offset(), e.Result->Duration());
+        });
+        transcriber->Transcribed.Connect([session](const auto& e)
+        {
+            session->OnFinalResult(e.Result->Offset(), e.Result->Duration(), e.Result->Reason == Microsoft::CognitiveServices::Speech::ResultReason::NoMatch);
+        });
+    }
+
+    // Adds a gauge that is read each time the metrics are written, e.g. the resident memory of the process or the
+    // bytes a helper retains. 'name' is the Prometheus name, its underscores become dots in OTLP. 'value' is
+    // called from the thread that writes the metrics, and what it reads must outlive the exporters of the metrics.
+    void AddGauge(const std::string& name, const std::string& help, std::function<uint64_t()> value)
+    {
+        if (!value)
+        {
+            throw std::invalid_argument("Gauge " + name + " has no value");
+        }
+        std::lock_guard<std::mutex> lock(m_state->GaugesMutex);
+        m_state->Gauges.push_back(Gauge{ name, help, std::move(value) });
+    }
+
+    // Writes the metrics in the Prometheus text exposition format.
+    void WritePrometheus(std::ostream& os) const
+    {
+        const State& s = *m_state;
+        const std::string label = "recognizer=\"" + s.Name + "\"";
+
+        WritePrometheusCounter(os, "speech_sessions_started_total", "Recognition sessions started.", label, s.SessionsStarted.Value());
+        WritePrometheusCounter(os, "speech_sessions_stopped_total", "Recognition sessions stopped.", label, s.SessionsStopped.Value());
+        WritePrometheusCounter(os, "speech_partial_results_total", "Recognizing or Transcribing events.", label, s.PartialResults.Value());
+        WritePrometheusCounter(os, "speech_final_results_total", "Recognized or Transcribed events with recognized speech.", label, s.FinalResults.Value());
+        WritePrometheusCounter(os, "speech_no_match_results_total", "Final results without recognized speech.", label, s.NoMatchResults.Value());
+
+        os << "# HELP speech_cancellations_total Canceled events by error code.\n# TYPE speech_cancellations_total counter\n";
+        for (size_t code = 0; code < s.Cancellations.size(); code++)
+        {
+            uint64_t value = s.Cancellations[code].Value();
+            if (value > 0)
+            {
+                os << "speech_cancellations_total{" << label << ",code=\"" << ErrorCodeName(code) << "\"} " << value << "\n";
+            }
+        }
+
+        WritePrometheusHistogram(os, "speech_first_partial_latency_ms", "Time from session start to the first partial result.", label, s.FirstPartialLatency);
+        WritePrometheusHistogram(os, "speech_audio_lag_ms", "Wall-clock time since session start minus the end offset of the result audio.", label, s.AudioLag);
+
+        std::lock_guard<std::mutex> lock(s.GaugesMutex);
+        for (const auto& gauge : s.Gauges)
+        {
+            os << "# HELP " << gauge.Name << " " << gauge.Help << "\n# TYPE " << gauge.Name << " gauge\n";
+            os << gauge.Name << "{" << label << "} " << gauge.Value() << "\n";
+        }
+    }
+
+    // Writes the metrics as an OTLP/JSON metrics request, which an OpenTelemetry collector accepts on
+    // its /v1/metrics endpoint. Counters are cumulative sums since this object was created.
+    void WriteOpenTelemetryJson(std::ostream& os) const
+    {
+        const State& s = *m_state;
+        const auto start = UnixNanoseconds(s.StartTime);
+        const auto now = UnixNanoseconds(std::chrono::system_clock::now());
+        const std::string point = "\"startTimeUnixNano\":\"" + start + "\",\"timeUnixNano\":\"" + now + "\"";
+        const std::string attribute = "{\"key\":\"recognizer\",\"value\":{\"stringValue\":\"" + s.Name + "\"}}";
+
+        os << "{\"resourceMetrics\":[{\"scopeMetrics\":[{\"scope\":{\"name\":\"speech_sdk_samples\"},\"metrics\":[";
+        WriteOtlpSum(os, "speech.sessions.started", point, attribute, s.SessionsStarted.Value());
+        os << ",";
+        WriteOtlpSum(os, "speech.sessions.stopped", point, attribute, s.SessionsStopped.Value());
+        os << ",";
+        WriteOtlpSum(os, "speech.partial_results", point, attribute, s.PartialResults.Value());
+        os << ",";
+        WriteOtlpSum(os, "speech.final_results", point, attribute, s.FinalResults.Value());
+        os << ",";
+        WriteOtlpSum(os, "speech.no_match_results", point, attribute, s.NoMatchResults.Value());
+        for (size_t code = 0; code < s.Cancellations.size(); code++)
+        {
+            uint64_t value = s.Cancellations[code].Value();
+            if (value > 0)
+            {
+                os << ",";
+                WriteOtlpSum(os, "speech.cancellations", point,
+                    attribute + ",{\"key\":\"code\",\"value\":{\"stringValue\":\"" + ErrorCodeName(code) + "\"}}", value);
+            }
+        }
+        os << ",";
+        WriteOtlpHistogram(os, "speech.first_partial_latency", point, attribute, s.FirstPartialLatency);
+        os << ",";
+        WriteOtlpHistogram(os, "speech.audio_lag", point, attribute, s.AudioLag);
+
+        std::lock_guard<std::mutex> lock(s.GaugesMutex);
+        for (const auto& gauge : s.Gauges)
+        {
+            std::string name = gauge.Name;
+            std::replace(name.begin(), name.end(), '_', '.');
+            os << ",{\"name\":\"" << name << "\",\"gauge\":{\"dataPoints\":[{\"attributes\":[" << attribute << "],"
+               << "\"timeUnixNano\":\"" << now << "\",\"asInt\":\"" << gauge.Value() << "\"}]}}";
+        }
+        os << "]}]}]}";
+    }
+
+private:
+    static constexpr uint64_t ticksPerMillisecond = 10000;
+
+    struct Gauge
+    {
+        std::string Name;
+        std::string Help;
+        std::function<uint64_t()> Value;
+    };
+
+    // Metrics shared by all attached recognizers.
+    struct State
+    {
+        std::string Name;
+        std::chrono::system_clock::time_point StartTime;
+
+        ShardedCounter SessionsStarted;
+        ShardedCounter SessionsStopped;
+        ShardedCounter PartialResults;
+        ShardedCounter FinalResults;
+        ShardedCounter NoMatchResults;
+        // Indexed by CancellationErrorCode, the last entry counts unknown codes.
+        std::array<ShardedCounter, 16> Cancellations;
+        LatencyHistogram FirstPartialLatency;
+        LatencyHistogram AudioLag;
+        mutable std::mutex GaugesMutex;
+        std::vector<Gauge> Gauges;
+    };
+
+    // Per-recognizer state, a recognizer runs one session at a time.
+    struct Session
+    {
+        std::shared_ptr<State> Metrics;
+        std::atomic<int64_t> StartNanoseconds{ 0 };
+        std::atomic<bool> SeenPartialResult{ false };
+
+        double MillisecondsSinceStart() const
+        {
+            auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            return (now - StartNanoseconds.load(std::memory_order_relaxed)) / 1e6;
+        }
+
+        void OnSessionStarted()
+        {
+            StartNanoseconds.store(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(),
+                std::memory_order_relaxed);
+            SeenPartialResult.store(false, std::memory_order_relaxed);
+            Metrics->SessionsStarted.Add();
+        }
+
+        void OnPartialResult(uint64_t offset, uint64_t duration)
+        {
+            Metrics->PartialResults.Add();
+            if (!SeenPartialResult.exchange(true, std::memory_order_relaxed))
+            {
+                Metrics->FirstPartialLatency.Record(MillisecondsSinceStart());
+            }
+            RecordLag(offset, duration);
+        }
+
+        void OnFinalResult(uint64_t offset, uint64_t duration, bool noMatch)
+        {
+            (noMatch ? Metrics->NoMatchResults : Metrics->FinalResults).Add();
+            RecordLag(offset, duration);
+        }
+
+        void RecordLag(uint64_t offset, uint64_t duration)
+        {
+            double lag = MillisecondsSinceStart() - (double)(offset + duration) / ticksPerMillisecond;
+            Metrics->AudioLag.Record(lag > 0 ? lag : 0);
+        }
+    };
+
+    template <class RecognizerT>
+    std::shared_ptr<Session> AttachSession(RecognizerT& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto session = std::make_shared<Session>();
+        session->Metrics = m_state;
+        recognizer.SessionStarted.Connect([session](const SessionEventArgs&)
+        {
+            session->OnSessionStarted();
+        });
+        recognizer.SessionStopped.Connect([session](const SessionEventArgs&)
+        {
+            session->Metrics->SessionsStopped.Add();
+        });
+        recognizer.Canceled.Connect([session](const auto& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                auto& cancellations = session->Metrics->Cancellations;
+                size_t code = (size_t)e.ErrorCode;
+                cancellations[code < cancellations.size() ? code : cancellations.size() - 1].Add();
+            }
+        });
+        return session;
+    }
+
+    static std::string ErrorCodeName(size_t code)
+    {
+        using Microsoft::CognitiveServices::Speech::CancellationErrorCode;
+
+        switch ((CancellationErrorCode)code)
+        {
+        case CancellationErrorCode::NoError: return "NoError";
+        case CancellationErrorCode::AuthenticationFailure: return "AuthenticationFailure";
+        case CancellationErrorCode::BadRequest: return "BadRequest";
+        case CancellationErrorCode::TooManyRequests: return "TooManyRequests";
+        case CancellationErrorCode::Forbidden: return "Forbidden";
+        case CancellationErrorCode::ConnectionFailure: return "ConnectionFailure";
+        case CancellationErrorCode::ServiceTimeout: return "ServiceTimeout";
+        case CancellationErrorCode::ServiceError: return "ServiceError";
+        case CancellationErrorCode::ServiceUnavailable: return "ServiceUnavailable";
+        case CancellationErrorCode::RuntimeError: return "RuntimeError";
+        default: return std::to_string(code);
+        }
+    }
+
+    static std::string UnixNanoseconds(std::chrono::system_clock::time_point time)
+    {
+        return std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+    }
+
+    static void WritePrometheusCounter(std::ostream& os, const char* name, const char* help, const std::string& label, uint64_t value)
+    {
+        os << "# HELP " << name << " " << help << "\n# TYPE " << name << " counter\n";
+        os << name << "{" << label << "} " << value << "\n";
+    }
+
+    static void WritePrometheusHistogram(std::ostream& os, const char* name, const char* help, const std::string& label, const LatencyHistogram& histogram)
+    {
+        os << "# HELP " << name << " " << help << "\n# TYPE " << name << " histogram\n";
+        const auto& bounds = LatencyHistogram::Bounds();
+        uint64_t cumulative = 0;
+        for (size_t bucket = 0; bucket < LatencyHistogram::bucketCount; bucket++)
+        {
+            cumulative += histogram.BucketValue(bucket);
+            os << name << "_bucket{" << label << ",le=\"";
+            if (bucket < bounds.size())
+            {
+                os << bounds[bucket];
+            }
+            else
+            {
+                os << "+Inf";
+            }
+            os << "\"} " << cumulative << "\n";
+        }
+        os << name << "_sum{" << label << "} " << histogram.SumMilliseconds() << "\n";
+        os << name << "_count{" << label << "} " << cumulative << "\n";
+    }
+
+    static void WriteOtlpSum(std::ostream& os, const char* name, const std::string& point, const std::string& attributes, uint64_t value)
+    {
+        os << "{\"name\":\"" << name << "\",\"sum\":{\"aggregationTemporality\":2,\"isMonotonic\":true,\"dataPoints\":[{"
+           << "\"attributes\":[" << attributes << "]," << point << ",\"asInt\":\"" << value << "\"}]}}";
+    }
+
+    static void WriteOtlpHistogram(std::ostream& os, const char* name, const std::string& point, const std::string& attributes, const LatencyHistogram& histogram)
+    {
+        const auto& bounds = LatencyHistogram::Bounds();
+        std::ostringstream buckets;
+        std::ostringstream explicitBounds;
+        uint64_t count = 0;
+        for (size_t bucket = 0; bucket < LatencyHistogram::bucketCount; bucket++)
+        {
+            uint64_t value = histogram.BucketValue(bucket);
+            count += value;
+            buckets << (bucket == 0 ? "" : ",") << "\"" << value << "\"";
+            if (bucket < bounds.size())
+            {
+                explicitBounds << (bucket == 0 ? "" : ",") << bounds[bucket];
+            }
+        }
+        os << "{\"name\":\"" << name << "\",\"unit\":\"ms\",\"histogram\":{\"aggregationTemporality\":2,\"dataPoints\":[{"
+           << "\"attributes\":[" << attributes << "]," << point
+           << ",\"count\":\"" << count << "\",\"sum\":" << histogram.SumMilliseconds()
+           << ",\"bucketCounts\":[" << buckets.str() << "],\"explicitBounds\":[" << explicitBounds.str() << "]}]}}";
+    }
+
+    std::shared_ptr<State> m_state;
+};
+
+// Exports the metrics of a RecognizerMetrics object at a fixed interval from a background thread,
+// and once more when it is destroyed, so the last values are not lost.
+class MetricsExporter final
+{
+public:
+    enum class Format { Prometheus, OpenTelemetryJson };
+
+    // Receives the exported text, e.g. to write it to a file scraped by a Prometheus node exporter,
+    // or to post it to an OpenTelemetry collector.
+    using Sink = std::function<void(const std::string&)>;
+
+    MetricsExporter(const RecognizerMetrics& metrics, Format format, std::chrono::milliseconds interval, Sink sink)
+        : m_metrics(metrics), m_format(format), m_interval(interval), m_sink(std::move(sink))
+    {
+        if (!m_sink)
+        {
+            throw std::invalid_argument("Metrics sink is empty");
+        }
+        m_thread = std::thread(&MetricsExporter::Run, this);
+    }
+
+    ~MetricsExporter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_stopped.notify_one();
+        m_thread.join();
+    }
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            bool stopping = m_stopped.wait_for(lock, m_interval, [this]() { return m_stopping; });
+            Export();
+            if (stopping)
+            {
+                break;
+            }
+        }
+    }
+
+    void Export()
+    {
+        std::ostringstream os;
+        if (m_format == Format::Prometheus)
+        {
+            m_metrics.WritePrometheus(os);
+        }
+        else
+        {
+            m_metrics.WriteOpenTelemetryJson(os);
+        }
+        m_sink(os.str());
+    }
+
+    const RecognizerMetrics& m_metrics;
+    Format m_format;
+    std::chrono::milliseconds m_interval;
+    Sink m_sink;
+    std::mutex m_mutex;
+    std::condition_variable m_stopped;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
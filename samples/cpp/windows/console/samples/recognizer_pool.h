@@ -0,0 +1,403 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// Identifies a set of interchangeable recognizers.
+struct RecognizerPoolKey
+{
+    std::string Region;
+    std::string Language;
+    // Endpoint id of a customized model, empty for the base model.
+    std::string EndpointId;
+
+    bool operator<(const RecognizerPoolKey& other) const
+    {
+        return std::tie(Region, Language, EndpointId) < std::tie(other.Region, other.Language, other.EndpointId);
+    }
+};
+
+// Keeps speech recognizers with their service connection opened ahead of time, so that the first
+// utterance of a caller does not pay for connection setup and TLS handshake.
+// Recognizers are leased out with Acquire() and come back to the pool when the lease is destroyed,
+// or, if a recognition session was started and has not stopped at that time, once it has raised SessionStopped.
+class RecognizerPool final
+{
+    struct Entry;
+    struct State;
+
+public:
+    // Creates the audio input of a new recognizer, e.g. AudioConfig::FromDefaultMicrophoneInput.
+    using AudioConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>()>;
+
+    // Exclusive use of a pooled recognizer. Event handlers connected by the holder are disconnected
+    // before the recognizer is leased out again. Sessions are started with the lease's RecognizeOnceAsync() and
+    // StartContinuousRecognitionAsync(), or with MarkSessionRequested() called before starting them otherwise,
+    // so that the pool knows about the session before its SessionStarted event arrives.
+    class Lease final
+    {
+    public:
+        Lease(Lease&& other) = default;
+        Lease& operator=(Lease&& other)
+        {
+            Release();
+            m_entry = std::move(other.m_entry);
+            m_state = std::move(other.m_state);
+            return *this;
+        }
+
+        ~Lease()
+        {
+            Release();
+        }
+
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer>& operator->() const
+        {
+            return m_entry->Recognizer;
+        }
+
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer>& Get() const
+        {
+            return m_entry->Recognizer;
+        }
+
+        // Returns the audio input the recognizer was created with by the pool's audio config factory.
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>& AudioInput() const
+        {
+            return m_entry->AudioInput;
+        }
+
+        std::future<std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognitionResult>> RecognizeOnceAsync()
+        {
+            MarkSessionRequested();
+            try
+            {
+                return m_entry->Recognizer->RecognizeOnceAsync();
+            }
+            catch (...)
+            {
+                CancelSessionRequest();
+                throw;
+            }
+        }
+
+        std::future<void> StartContinuousRecognitionAsync()
+        {
+            MarkSessionRequested();
+            try
+            {
+                return m_entry->Recognizer->StartContinuousRecognitionAsync();
+            }
+            catch (...)
+            {
+                CancelSessionRequest();
+                throw;
+            }
+        }
+
+        // Tells the pool that a session is about to be started on the recognizer, e.g. keyword recognition,
+        // so that a release before its SessionStarted event does not hand out the running recognizer again.
+        // The session counts as running until it raises SessionStopped.
+        void MarkSessionRequested()
+        {
+            if (auto state = m_state.lock())
+            {
+                std::lock_guard<std::mutex> lock(state->Mutex);
+                m_entry->RequestedSessions++;
+            }
+        }
+
+        // Returns the recognizer to the pool before the lease is destroyed.
+        void Release()
+        {
+            // Declared before the lock, recognizers dropped from a full pool are destroyed after it is released.
+            std::vector<std::shared_ptr<Entry>> dropped;
+            auto state = m_state.lock();
+            if (m_entry != nullptr && state != nullptr)
+            {
+                std::lock_guard<std::mutex> lock(state->Mutex);
+                m_entry->Leased = false;
+                if (m_entry->IsBusy())
+                {
+                    // Keeps the recognizer alive until its session stops, it is recycled by the next Acquire().
+                    state->Draining.push_back(m_entry);
+                }
+                else
+                {
+                    state->Recycle(m_entry, dropped);
+                }
+            }
+            m_entry.reset();
+            m_state.reset();
+        }
+
+    private:
+        friend class RecognizerPool;
+
+        // Undoes MarkSessionRequested() for a session that failed to start.
+        void CancelSessionRequest()
+        {
+            if (auto state = m_state.lock())
+            {
+                std::lock_guard<std::mutex> lock(state->Mutex);
+                if (m_entry->RequestedSessions > 0)
+                {
+                    m_entry->RequestedSessions--;
+                }
+            }
+        }
+
+        Lease(std::shared_ptr<Entry> entry, std::weak_ptr<State> state)
+            : m_entry(std::move(entry)), m_state(std::move(state))
+        {
+        }
+
+        std::shared_ptr<Entry> m_entry;
+        std::weak_ptr<State> m_state;
+    };
+
+    // Creates a pool that keeps up to 'recognizersPerKey' idle recognizers for each key.
+    RecognizerPool(const std::string& subscriptionKey, size_t recognizersPerKey, AudioConfigFactory audioConfigFactory)
+        : m_subscriptionKey(subscriptionKey), m_state(std::make_shared<State>())
+    {
+        if (subscriptionKey.empty())
+        {
+            throw std::invalid_argument("Subscription key is empty");
+        }
+        if (!audioConfigFactory)
+        {
+            throw std::invalid_argument("Audio config factory is empty");
+        }
+        m_state->Capacity = recognizersPerKey;
+        m_audioConfigFactory = std::move(audioConfigFactory);
+    }
+
+    RecognizerPool(const RecognizerPool&) = delete;
+    RecognizerPool& operator=(const RecognizerPool&) = delete;
+
+    // Creates recognizers for 'key' and opens their connections until 'count' are idle, bounded by the pool capacity.
+    void Warm(const RecognizerPoolKey& key, size_t count)
+    {
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_state->Mutex);
+                if (m_state->Idle[key].size() >= std::min(count, m_state->Capacity))
+                {
+                    return;
+                }
+            }
+            // Connects outside of the lock, opening a connection takes a network round trip.
+            auto entry = CreateEntry(key);
+            std::vector<std::shared_ptr<Entry>> dropped;
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            m_state->Recycle(entry, dropped);
+        }
+    }
+
+    // Leases an idle recognizer for 'key', or creates a new one if none is idle.
+    Lease Acquire(const RecognizerPoolKey& key)
+    {
+        std::shared_ptr<Entry> entry;
+        std::vector<std::shared_ptr<Entry>> dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            m_state->SweepDraining(dropped);
+            auto& idle = m_state->Idle[key];
+            if (!idle.empty())
+            {
+                entry = idle.front();
+                idle.pop_front();
+                entry->Leased = true;
+            }
+        }
+
+        if (entry == nullptr)
+        {
+            entry = CreateEntry(key);
+            entry->Leased = true;
+        }
+        else
+        {
+            // Drops the handlers of the previous holder, then re-opens the connection if the service closed it while idle.
+            ResetEventHandlers(entry);
+            if (!entry->Connected)
+            {
+                entry->Connection->Open(false);
+            }
+        }
+        return Lease(entry, m_state);
+    }
+
+    // Returns the number of idle recognizers for 'key'.
+    size_t IdleCount(const RecognizerPoolKey& key) const
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        auto it = m_state->Idle.find(key);
+        return it == m_state->Idle.end() ? 0 : it->second.size();
+    }
+
+private:
+    struct Entry
+    {
+        RecognizerPoolKey Key;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognizer> Recognizer;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig> AudioInput;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Connection> Connection;
+        std::atomic<bool> Connected{ false };
+
+        // Guarded by State::Mutex.
+        bool Leased = false;
+        bool InSession = false;
+        // Sessions requested through the lease that have not raised SessionStopped yet.
+        size_t RequestedSessions = 0;
+
+        // Whether a session is running or about to start, called with State::Mutex held.
+        bool IsBusy() const
+        {
+            return InSession || RequestedSessions > 0;
+        }
+    };
+
+    struct State
+    {
+        std::mutex Mutex;
+        size_t Capacity = 0;
+        std::map<RecognizerPoolKey, std::deque<std::shared_ptr<Entry>>> Idle;
+        // Released while their session was still running.
+        std::vector<std::shared_ptr<Entry>> Draining;
+
+        // Puts an entry back to the idle list, or moves it to 'dropped' if the list is full. Must be called with
+        // Mutex held. The caller releases 'dropped' after the lock: destroying a recognizer waits for its event
+        // handlers, which take the lock.
+        void Recycle(const std::shared_ptr<Entry>& entry, std::vector<std::shared_ptr<Entry>>& dropped)
+        {
+            auto& idle = Idle[entry->Key];
+            if (idle.size() < Capacity)
+            {
+                idle.push_back(entry);
+            }
+            else
+            {
+                dropped.push_back(entry);
+            }
+        }
+
+        // Recycles the draining entries whose session has stopped. Must be called with Mutex held.
+        // This is not done from the SessionStopped handler, as dropping the last reference there
+        // would destroy the recognizer from within its own callback.
+        void SweepDraining(std::vector<std::shared_ptr<Entry>>& dropped)
+        {
+            for (auto it = Draining.begin(); it != Draining.end();)
+            {
+                if ((*it)->IsBusy())
+                {
+                    ++it;
+                    continue;
+                }
+                Recycle(*it, dropped);
+                it = Draining.erase(it);
+            }
+        }
+    };
+
+    std::shared_ptr<Entry> CreateEntry(const RecognizerPoolKey& key)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto config = SpeechConfig::FromSubscription(m_subscriptionKey, key.Region);
+        config->SetSpeechRecognitionLanguage(key.Language);
+        if (!key.EndpointId.empty())
+        {
+            config->SetEndpointId(key.EndpointId);
+        }
+
+        auto entry = std::make_shared<Entry>();
+        entry->Key = key;
+        entry->AudioInput = m_audioConfigFactory();
+        entry->Recognizer = SpeechRecognizer::FromConfig(config, entry->AudioInput);
+        entry->Connection = Connection::FromRecognizer(entry->Recognizer);
+
+        // The entry does not own itself, the handlers only hold weak references.
+        std::weak_ptr<Entry> weakEntry = entry;
+        entry->Connection->Connected.Connect([weakEntry](const ConnectionEventArgs&)
+        {
+            if (auto e = weakEntry.lock())
+            {
+                e->Connected = true;
+            }
+        });
+        entry->Connection->Disconnected.Connect([weakEntry](const ConnectionEventArgs&)
+        {
+            if (auto e = weakEntry.lock())
+            {
+                e->Connected = false;
+            }
+        });
+        ConnectSessionHandlers(entry);
+
+        // Opens the connection for single-shot recognition, which is what short command utterances use.
+        entry->Connection->Open(false);
+        return entry;
+    }
+
+    // Disconnects all handlers from the recognizer, then connects the pool's own session handlers again.
+    void ResetEventHandlers(const std::shared_ptr<Entry>& entry)
+    {
+        auto& recognizer = entry->Recognizer;
+        recognizer->Recognizing.DisconnectAll();
+        recognizer->Recognized.DisconnectAll();
+        recognizer->Canceled.DisconnectAll();
+        recognizer->SessionStarted.DisconnectAll();
+        recognizer->SessionStopped.DisconnectAll();
+        recognizer->SpeechStartDetected.DisconnectAll();
+        recognizer->SpeechEndDetected.DisconnectAll();
+        ConnectSessionHandlers(entry);
+    }
+
+    // Tracks whether a recognition session is running.
+    void ConnectSessionHandlers(const std::shared_ptr<Entry>& entry)
+    {
+        std::weak_ptr<Entry> weakEntry = entry;
+        std::weak_ptr<State> weakState = m_state;
+        entry->Recognizer->SessionStarted.Connect([weakEntry, weakState](const Microsoft::CognitiveServices::Speech::SessionEventArgs&)
+        {
+            auto e = weakEntry.lock();
+            auto state = weakState.lock();
+            if (e != nullptr && state != nullptr)
+            {
+                std::lock_guard<std::mutex> lock(state->Mutex);
+                e->InSession = true;
+            }
+        });
+        entry->Recognizer->SessionStopped.Connect([weakEntry, weakState](const Microsoft::CognitiveServices::Speech::SessionEventArgs&)
+        {
+            auto e = weakEntry.lock();
+            auto state = weakState.lock();
+            if (e != nullptr && state != nullptr)
+            {
+                std::lock_guard<std::mutex> lock(state->Mutex);
+                e->InSession = false;
+                if (e->RequestedSessions > 0)
+                {
+                    e->RequestedSessions--;
+                }
+            }
+        });
+    }
+
+    std::string m_subscriptionKey;
+    AudioConfigFactory m_audioConfigFactory;
+    std::shared_ptr<State> m_state;
+};
@@ -0,0 +1,376 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "recognizer_pool.h"
+
+// Routes recognizers and synthesizers to the fastest healthy one of several regions of a subscription, e.g.
+// "westeurope", "northeurope" and "francecentral" for callers in the EU.
+//
+// Each region keeps an exponentially weighted moving average (EWMA) of its latency, the time from session start
+// to the first result, and of its error rate, the share of sessions canceled with an error. The handlers that
+// measure them are connected to every recognizer and synthesizer the router hands out. Other instrumentation can
+// feed its own samples with RecordLatency(), RecordSuccess() and RecordError().
+//
+// A region whose error rate reaches the threshold is unhealthy: work queued after that goes to the next region
+// until a cooldown has passed, then the region is tried again. Regions that have not been measured yet count with
+// an assumed latency, so they are tried once the measured ones are slower than that. Recognizers come from a
+// RecognizerPool, and WarmStandby() opens connections in the runner-up region ahead of time, so that failing over
+// does not add connection setup to the first utterance there.
+class RegionRouter final
+{
+public:
+    struct Options
+    {
+        // The weight of a new sample in the averages.
+        double Smoothing = 0.3;
+        // The error rate at which a region is taken out of rotation, and for how long.
+        double ErrorThreshold = 0.5;
+        std::chrono::seconds Cooldown = std::chrono::seconds(30);
+        // The latency assumed for a region that has no samples yet.
+        double InitialLatencyMs = 250;
+        // Idle recognizers kept per region and language.
+        size_t RecognizersPerRegion = 2;
+    };
+
+    struct RegionStatistics
+    {
+        std::string Region;
+        double LatencyMs = 0;
+        double ErrorRate = 0;
+        // Final results and synthesis completions, and cancellations with an error.
+        uint64_t Requests = 0;
+        uint64_t Errors = 0;
+        bool Healthy = true;
+    };
+
+    // A recognizer leased from the region it was routed to.
+    struct RoutedRecognizer
+    {
+        RecognizerPool::Lease Recognizer;
+        std::string Region;
+    };
+
+    struct RoutedSynthesizer
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> Synthesizer;
+        std::string Region;
+    };
+
+    RegionRouter(const std::string& subscriptionKey, const std::vector<std::string>& regions, RecognizerPool::AudioConfigFactory audioConfigFactory)
+        : RegionRouter(subscriptionKey, regions, std::move(audioConfigFactory), Options())
+    {
+    }
+
+    // 'regions' are in order of preference, which decides between regions of the same latency.
+    RegionRouter(const std::string& subscriptionKey, const std::vector<std::string>& regions, RecognizerPool::AudioConfigFactory audioConfigFactory,
+        const Options& options)
+        : m_subscriptionKey(subscriptionKey),
+          m_pool(subscriptionKey, options.RecognizersPerRegion, std::move(audioConfigFactory)),
+          m_state(std::make_shared<State>())
+    {
+        if (regions.empty())
+        {
+            throw std::invalid_argument("At least one region is needed");
+        }
+        if (options.Smoothing <= 0 || options.Smoothing > 1)
+        {
+            throw std::invalid_argument("Smoothing must be in (0, 1]");
+        }
+        m_state->Settings = options;
+        for (const auto& region : regions)
+        {
+            Region entry;
+            entry.Statistics.Region = region;
+            entry.Statistics.LatencyMs = options.InitialLatencyMs;
+            m_state->Regions.push_back(entry);
+        }
+    }
+
+    RegionRouter(const RegionRouter&) = delete;
+    RegionRouter& operator=(const RegionRouter&) = delete;
+
+    // Returns the healthy region of the lowest latency other than 'avoid', e.g. the region a request has just failed
+    // in. If no other region is healthy, returns the one whose cooldown ends first.
+    std::string Pick(const std::string& avoid = std::string()) const
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        return m_state->Pick(avoid, Clock::now());
+    }
+
+    // Leases a recognizer for 'language' in the region returned by Pick(avoid).
+    RoutedRecognizer Acquire(const std::string& language, const std::string& avoid = std::string())
+    {
+        const std::string region = Pick(avoid);
+        RoutedRecognizer routed{ m_pool.Acquire(RecognizerPoolKey{ region, language, "" }), region };
+        // The pool disconnects these handlers when the recognizer is leased again.
+        Attach(*routed.Recognizer.Get(), region);
+        return routed;
+    }
+
+    // Creates a synthesizer in the region returned by Pick(avoid), 'configure' may set the voice or output format.
+    RoutedSynthesizer CreateSynthesizer(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>& audioConfig,
+        const std::function<void(Microsoft::CognitiveServices::Speech::SpeechConfig&)>& configure = nullptr,
+        const std::string& avoid = std::string())
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        const std::string region = Pick(avoid);
+        auto config = SpeechConfig::FromSubscription(m_subscriptionKey, region);
+        if (configure)
+        {
+            configure(*config);
+        }
+        auto synthesizer = SpeechSynthesizer::FromConfig(config, audioConfig);
+        auto session = std::make_shared<Session>(m_state, region);
+        synthesizer->SynthesisStarted.Connect([session](const SpeechSynthesisEventArgs&)
+        {
+            session->OnStarted();
+        });
+        synthesizer->Synthesizing.Connect([session](const SpeechSynthesisEventArgs&)
+        {
+            session->OnFirstResult();
+        });
+        synthesizer->SynthesisCompleted.Connect([session](const SpeechSynthesisEventArgs&)
+        {
+            session->OnFirstResult();
+            session->OnCompleted(false);
+        });
+        synthesizer->SynthesisCanceled.Connect([session](const SpeechSynthesisEventArgs& e)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(e.Result);
+            session->OnCompleted(cancellation->Reason == CancellationReason::Error);
+        });
+        return RoutedSynthesizer{ synthesizer, region };
+    }
+
+    // Opens connections for 'language' in the best region and in the runner-up, so that either serves the next
+    // request without connection setup. Returns the runner-up, empty if there is only one region.
+    std::string WarmStandby(const std::string& language, size_t count = 1)
+    {
+        const std::string primary = Pick();
+        // With the primary avoided, Pick() falls back to it when it is the only region.
+        std::string standby = Pick(primary);
+        if (standby == primary)
+        {
+            standby.clear();
+        }
+        m_pool.Warm(RecognizerPoolKey{ primary, language, "" }, count);
+        if (!standby.empty())
+        {
+            m_pool.Warm(RecognizerPoolKey{ standby, language, "" }, count);
+        }
+        return standby;
+    }
+
+    void RecordLatency(const std::string& region, double milliseconds)
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        if (Region* entry = m_state->Find(region))
+        {
+            m_state->AddLatency(*entry, milliseconds);
+        }
+    }
+
+    void RecordSuccess(const std::string& region)
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        if (Region* entry = m_state->Find(region))
+        {
+            m_state->AddOutcome(*entry, false, Clock::now());
+        }
+    }
+
+    void RecordError(const std::string& region)
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        if (Region* entry = m_state->Find(region))
+        {
+            m_state->AddOutcome(*entry, true, Clock::now());
+        }
+    }
+
+    // Returns the statistics of the regions, in the order they were given.
+    std::vector<RegionStatistics> GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        const auto now = Clock::now();
+        std::vector<RegionStatistics> statistics;
+        for (const auto& region : m_state->Regions)
+        {
+            statistics.push_back(region.Statistics);
+            statistics.back().Healthy = region.UnhealthyUntil <= now;
+        }
+        return statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Region
+    {
+        RegionStatistics Statistics;
+        Clock::time_point UnhealthyUntil;
+        bool Measured = false;
+    };
+
+    struct State
+    {
+        std::mutex Mutex;
+        Options Settings;
+        std::vector<Region> Regions;
+
+        Region* Find(const std::string& name)
+        {
+            auto it = std::find_if(Regions.begin(), Regions.end(), [&name](const Region& r) { return r.Statistics.Region == name; });
+            return it == Regions.end() ? nullptr : &*it;
+        }
+
+        const Region* Find(const std::string& name) const
+        {
+            auto it = std::find_if(Regions.begin(), Regions.end(), [&name](const Region& r) { return r.Statistics.Region == name; });
+            return it == Regions.end() ? nullptr : &*it;
+        }
+
+        std::string Pick(const std::string& avoid, Clock::time_point now) const
+        {
+            const Region* best = nullptr;
+            const Region* soonest = nullptr;
+            for (const auto& region : Regions)
+            {
+                if (soonest == nullptr || region.UnhealthyUntil < soonest->UnhealthyUntil)
+                {
+                    soonest = &region;
+                }
+                if (region.Statistics.Region == avoid || region.UnhealthyUntil > now)
+                {
+                    continue;
+                }
+                // Strictly lower, so that earlier regions win ties.
+                if (best == nullptr || region.Statistics.LatencyMs < best->Statistics.LatencyMs)
+                {
+                    best = &region;
+                }
+            }
+            if (best == nullptr)
+            {
+                // No other region is healthy: stays with 'avoid' if it is, otherwise takes the one that is back first.
+                const Region* avoided = Find(avoid);
+                best = avoided != nullptr && avoided->UnhealthyUntil <= now ? avoided : soonest;
+            }
+            return best->Statistics.Region;
+        }
+
+        void AddLatency(Region& region, double milliseconds)
+        {
+            auto& statistics = region.Statistics;
+            const double alpha = Settings.Smoothing;
+            // The first sample replaces the assumed latency.
+            statistics.LatencyMs = region.Measured ? alpha * milliseconds + (1 - alpha) * statistics.LatencyMs : milliseconds;
+            region.Measured = true;
+        }
+
+        void AddOutcome(Region& region, bool error, Clock::time_point now)
+        {
+            auto& statistics = region.Statistics;
+            const double alpha = Settings.Smoothing;
+            statistics.Requests++;
+            statistics.Errors += error ? 1 : 0;
+            statistics.ErrorRate = alpha * (error ? 1.0 : 0.0) + (1 - alpha) * statistics.ErrorRate;
+            if (error && statistics.ErrorRate >= Settings.ErrorThreshold && region.UnhealthyUntil <= now)
+            {
+                region.UnhealthyUntil = now + Settings.Cooldown;
+                // Back in rotation after the cooldown on probation, one more error takes it out again.
+                statistics.ErrorRate = Settings.ErrorThreshold * (1 - alpha);
+            }
+        }
+    };
+
+    // Measures one recognizer or synthesizer, which runs one session at a time.
+    struct Session
+    {
+        Session(std::shared_ptr<State> state, std::string region)
+            : Router(std::move(state)), Region(std::move(region))
+        {
+        }
+
+        void OnStarted()
+        {
+            StartNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count(),
+                std::memory_order_relaxed);
+            SeenResult.store(false, std::memory_order_relaxed);
+        }
+
+        void OnFirstResult()
+        {
+            if (SeenResult.exchange(true, std::memory_order_relaxed))
+            {
+                return;
+            }
+            const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+            std::lock_guard<std::mutex> lock(Router->Mutex);
+            if (auto* region = Router->Find(Region))
+            {
+                Router->AddLatency(*region, (now - StartNanoseconds.load(std::memory_order_relaxed)) / 1e6);
+            }
+        }
+
+        void OnCompleted(bool error)
+        {
+            std::lock_guard<std::mutex> lock(Router->Mutex);
+            if (auto* region = Router->Find(Region))
+            {
+                Router->AddOutcome(*region, error, Clock::now());
+            }
+        }
+
+        std::shared_ptr<State> Router;
+        const std::string Region;
+        std::atomic<int64_t> StartNanoseconds{ 0 };
+        std::atomic<bool> SeenResult{ false };
+    };
+
+    void Attach(Microsoft::CognitiveServices::Speech::SpeechRecognizer& recognizer, const std::string& region)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto session = std::make_shared<Session>(m_state, region);
+        recognizer.SessionStarted.Connect([session](const SessionEventArgs&)
+        {
+            session->OnStarted();
+        });
+        recognizer.Recognizing.Connect([session](const SpeechRecognitionEventArgs&)
+        {
+            session->OnFirstResult();
+        });
+        recognizer.Recognized.Connect([session](const SpeechRecognitionEventArgs&)
+        {
+            session->OnFirstResult();
+            session->OnCompleted(false);
+        });
+        recognizer.Canceled.Connect([session](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                session->OnCompleted(true);
+            }
+        });
+    }
+
+    const std::string m_subscriptionKey;
+    RecognizerPool m_pool;
+    std::shared_ptr<State> m_state;
+};
@@ -0,0 +1,304 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "session_completion.h"
+#include "wav_file_reader.h"
+
+// Recognizes a long stream with continuous recognition, and survives sessions that are canceled with an error,
+// e.g. by a transient network failure an hour into a call. The audio sent since the end of the last recognized
+// phrase is kept in a replay buffer. When a session is canceled, a new one is started after a backoff delay and
+// first receives the buffered audio, then the rest of the stream. Offsets of the new session are rebased to the
+// stream, and phrases that end before the last recognized one are dropped, so that no audio is recognized twice
+// and none is skipped.
+//
+// The buffer only holds audio that has not been recognized yet, normally less than one utterance. It is bounded,
+// if recognition falls behind by more than the bound, the oldest audio is dropped and counted as lost.
+class ResilientRecognizer final
+{
+public:
+    struct Options
+    {
+        // The most audio kept for replay.
+        std::chrono::seconds MaxReplay = std::chrono::seconds(60);
+        // Gives up after this many sessions in a row are canceled without recognizing anything.
+        int MaxAttempts = 5;
+        // The delay before the first retry, doubled on each failure in a row up to the maximum.
+        std::chrono::milliseconds RetryDelay = std::chrono::milliseconds(500);
+        std::chrono::milliseconds MaxRetryDelay = std::chrono::seconds(30);
+    };
+
+    // A recognized phrase, with offset and duration in ticks from the start of the stream.
+    struct Phrase
+    {
+        uint64_t Offset;
+        uint64_t Duration;
+        std::string Text;
+    };
+
+    struct Outcome
+    {
+        // The number of sessions that were started again after a cancellation.
+        int Reconnects = 0;
+        // Audio that was dropped from the replay buffer before it was recognized, in bytes.
+        uint64_t LostBytes = 0;
+        // Empty unless recognition gave up.
+        std::string Error;
+    };
+
+    // Reads up to 'size' bytes of the stream, returns 0 at its end, also when called again after the end. Called from
+    // the SDK's threads, one at a time.
+    using AudioReader = std::function<int(uint8_t* dataBuffer, uint32_t size)>;
+
+    // Called with each phrase, in order, from the SDK's event threads.
+    using PhraseHandler = std::function<void(const Phrase& phrase)>;
+
+    ResilientRecognizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const WavFileReader::WAVEFORMAT& format)
+        : ResilientRecognizer(std::move(config), format, Options())
+    {
+    }
+
+    ResilientRecognizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const WavFileReader::WAVEFORMAT& format,
+        const Options& options)
+        : m_config(std::move(config)), m_format(format), m_options(options)
+    {
+        if (m_config == nullptr)
+        {
+            throw std::invalid_argument("Speech config must be set");
+        }
+        if (format.AvgBytesPerSec == 0 || format.BlockAlign == 0)
+        {
+            throw std::invalid_argument("Audio format has no byte rate");
+        }
+        if (options.MaxAttempts < 1)
+        {
+            throw std::invalid_argument("At least one attempt is needed");
+        }
+    }
+
+    ResilientRecognizer(const ResilientRecognizer&) = delete;
+    ResilientRecognizer& operator=(const ResilientRecognizer&) = delete;
+
+    // Recognizes the stream until it ends, or until sessions have been canceled MaxAttempts times in a row.
+    Outcome Recognize(const AudioReader& read, const PhraseHandler& onPhrase)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        Outcome outcome;
+        Replay replay(read, m_format, (uint64_t)m_options.MaxReplay.count() * m_format.AvgBytesPerSec);
+        auto delay = m_options.RetryDelay;
+        int failures = 0;
+        while (true)
+        {
+            // Each session starts at the end of the last recognized phrase, its offsets are relative to that.
+            const uint64_t start = replay.Rewind();
+            const uint64_t sessionOffset = TicksAt(start);
+            auto input = std::make_shared<SessionInput>(replay);
+            auto stream = AudioInputStream::CreatePullStream(
+                AudioStreamFormat::GetWaveFormatPCM(m_format.SamplesPerSec, (uint8_t)m_format.BitsPerSample, (uint8_t)m_format.Channels), input);
+            auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(stream));
+            auto completion = SessionCompletion::Track(*recognizer);
+
+            std::atomic<bool> recognized{ false };
+            recognizer->Recognized.Connect([this, &replay, &recognized, &onPhrase, sessionOffset](const SpeechRecognitionEventArgs& e)
+            {
+                if (e.Result->Reason != ResultReason::RecognizedSpeech && e.Result->Reason != ResultReason::NoMatch)
+                {
+                    return;
+                }
+                recognized = true;
+                const uint64_t offset = sessionOffset + e.Result->Offset();
+                const uint64_t end = offset + e.Result->Duration();
+                // Audio up to the end of the phrase is not needed again, even if the session fails later.
+                const bool replayed = !replay.Commit(BytesAt(end));
+                if (replayed || e.Result->Reason != ResultReason::RecognizedSpeech)
+                {
+                    return;
+                }
+                onPhrase(Phrase{ offset, e.Result->Duration(), e.Result->Text });
+            });
+
+            recognizer->StartContinuousRecognitionAsync().get();
+            auto session = completion.Wait();
+            recognizer->StopContinuousRecognitionAsync().get();
+            // The SDK may hold on to the stream, later reads must not take audio meant for the next session.
+            input->Close();
+
+            if (!session.Canceled)
+            {
+                break;
+            }
+            failures = recognized ? 1 : failures + 1;
+            if (recognized)
+            {
+                delay = m_options.RetryDelay;
+            }
+            if (failures >= m_options.MaxAttempts)
+            {
+                outcome.Error = session.ErrorDetails;
+                break;
+            }
+            std::this_thread::sleep_for(delay);
+            delay = std::min(delay * 2, m_options.MaxRetryDelay);
+            outcome.Reconnects++;
+        }
+        outcome.LostBytes = replay.LostBytes();
+        return outcome;
+    }
+
+private:
+    // The audio read from the stream that has not been recognized yet, and the position of each session in it.
+    class Replay final
+    {
+    public:
+        Replay(const AudioReader& read, const WavFileReader::WAVEFORMAT& format, uint64_t capacity)
+            : m_read(read), m_blockAlign(format.BlockAlign), m_capacity(std::max<uint64_t>(capacity, format.BlockAlign))
+        {
+        }
+
+        // Starts a session at the first byte that has not been recognized, and returns its position in the stream.
+        uint64_t Rewind()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_position = m_start;
+            return m_start;
+        }
+
+        // Releases the audio before 'end', a position in the stream. Returns false if it was already released,
+        // i.e. the phrase ending there was recognized by an earlier session.
+        bool Commit(uint64_t end)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (end <= m_committed && m_committed != 0)
+            {
+                return false;
+            }
+            m_committed = end;
+            const uint64_t drop = std::min<uint64_t>(end > m_start ? end - m_start : 0, m_audio.size());
+            m_audio.erase(m_audio.begin(), m_audio.begin() + (size_t)drop);
+            m_start += drop;
+            return true;
+        }
+
+        // Returns buffered audio first, then reads the stream.
+        int Read(uint8_t* dataBuffer, uint32_t size)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            const uint64_t end = m_start + m_audio.size();
+            if (m_position < m_start)
+            {
+                // The session's audio has been released while it was read, e.g. audio that was lost.
+                m_position = m_start;
+            }
+            if (m_position < end)
+            {
+                const size_t count = (size_t)std::min<uint64_t>(size, end - m_position);
+                const auto begin = m_audio.begin() + (size_t)(m_position - m_start);
+                std::copy(begin, begin + count, dataBuffer);
+                m_position += count;
+                return (int)count;
+            }
+            lock.unlock();
+
+            // The stream is only read by one session at a time, and is not read under the lock.
+            const int read = m_read(dataBuffer, size);
+            if (read <= 0)
+            {
+                return read;
+            }
+            lock.lock();
+            m_audio.insert(m_audio.end(), dataBuffer, dataBuffer + read);
+            m_position += (uint64_t)read;
+            if (m_audio.size() > m_capacity)
+            {
+                // Drops whole sample frames, so that the replay stays frame aligned.
+                uint64_t drop = m_audio.size() - m_capacity;
+                drop += (m_blockAlign - drop % m_blockAlign) % m_blockAlign;
+                drop = std::min<uint64_t>(drop, m_audio.size());
+                m_audio.erase(m_audio.begin(), m_audio.begin() + (size_t)drop);
+                m_start += drop;
+                m_lostBytes += drop;
+            }
+            return read;
+        }
+
+        uint64_t LostBytes() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_lostBytes;
+        }
+
+    private:
+        const AudioReader& m_read;
+        const uint64_t m_blockAlign;
+        const uint64_t m_capacity;
+        mutable std::mutex m_mutex;
+        std::deque<uint8_t> m_audio;
+        // The position of the first buffered byte in the stream.
+        uint64_t m_start = 0;
+        // The end of the last recognized phrase.
+        uint64_t m_committed = 0;
+        // The next byte the current session reads.
+        uint64_t m_position = 0;
+        uint64_t m_lostBytes = 0;
+    };
+
+    // The pull stream of one session, it ends when the session is over.
+    class SessionInput final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        explicit SessionInput(Replay& replay)
+            : m_replay(replay)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_closed ? 0 : m_replay.Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+
+    private:
+        Replay& m_replay;
+        // Held while reading, so that no read is in progress once the input is closed.
+        std::mutex m_mutex;
+        bool m_closed = false;
+    };
+
+    // Returns the position of a time in the stream, in bytes rounded down to whole sample frames.
+    uint64_t BytesAt(uint64_t ticks) const
+    {
+        const uint64_t bytes = ticks / 10000 * m_format.AvgBytesPerSec / 1000;
+        return bytes - bytes % m_format.BlockAlign;
+    }
+
+    uint64_t TicksAt(uint64_t bytes) const
+    {
+        return bytes * 10000000 / m_format.AvgBytesPerSec;
+    }
+
+    const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const WavFileReader::WAVEFORMAT m_format;
+    const Options m_options;
+};
@@ -0,0 +1,347 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A result event in a form that can be written by any backend, e.g. Event="RECOGNIZED" with the recognized text
+// and additional fields such as the offset, the translations or the cancellation details.
+struct ResultRecord
+{
+    std::string Event;
+    std::string Text;
+    std::vector<std::pair<std::string, std::string>> Fields;
+
+    ResultRecord& Add(const std::string& name, const std::string& value)
+    {
+        Fields.emplace_back(name, value);
+        return *this;
+    }
+
+    ResultRecord& Add(const std::string& name, uint64_t value)
+    {
+        return Add(name, std::to_string(value));
+    }
+};
+
+// Writes result records somewhere. Backends are only called from the writer thread of an AsyncResultSink.
+class ResultSinkBackend
+{
+public:
+    virtual ~ResultSinkBackend() = default;
+    virtual void Write(const ResultRecord& record) = 0;
+    // Called once after each batch of records.
+    virtual void Flush() = 0;
+};
+
+// Writes records as human-readable text, in the same shape the samples print their results:
+//   RECOGNIZED: Text=...
+//     Offset=...
+class TextResultBackend final : public ResultSinkBackend
+{
+public:
+    // Writes to the given stream, which must outlive the backend.
+    explicit TextResultBackend(std::ostream& os = std::cout)
+        : m_os(os)
+    {
+    }
+
+    void Write(const ResultRecord& record) override
+    {
+        m_os << record.Event << ":";
+        if (!record.Text.empty())
+        {
+            m_os << " Text=" << record.Text;
+        }
+        m_os << "\n";
+        for (const auto& field : record.Fields)
+        {
+            m_os << "  " << field.first << "=" << field.second << "\n";
+        }
+    }
+
+    void Flush() override
+    {
+        m_os.flush();
+    }
+
+private:
+    std::ostream& m_os;
+};
+
+// Writes one json object per record and line: {"event":"...","text":"...","fields":{"name":"value",...}}.
+class JsonLinesResultBackend final : public ResultSinkBackend
+{
+public:
+    // Writes to the given stream, which must outlive the backend.
+    explicit JsonLinesResultBackend(std::ostream& os = std::cout)
+        : m_os(&os)
+    {
+    }
+
+    // Writes to a file, existing content is replaced.
+    explicit JsonLinesResultBackend(const std::string& fileName)
+        : m_file(new std::ofstream(fileName, std::ios::trunc)), m_os(m_file.get())
+    {
+        if (!*m_file)
+        {
+            throw std::runtime_error("Cannot open result file " + fileName);
+        }
+    }
+
+    void Write(const ResultRecord& record) override
+    {
+        std::ostream& os = *m_os;
+        os << "{\"event\":\"" << Escape(record.Event) << "\",\"text\":\"" << Escape(record.Text) << "\",\"fields\":{";
+        for (size_t i = 0; i < record.Fields.size(); i++)
+        {
+            os << (i == 0 ? "" : ",") << "\"" << Escape(record.Fields[i].first) << "\":\"" << Escape(record.Fields[i].second) << "\"";
+        }
+        os << "}}\n";
+    }
+
+    void Flush() override
+    {
+        m_os->flush();
+    }
+
+    // Escapes a UTF-8 string for use inside a json string literal.
+    static std::string Escape(const std::string& value)
+    {
+        std::string escaped;
+        escaped.reserve(value.size());
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    char code[7];
+                    snprintf(code, sizeof(code), "\\u%04x", (unsigned)c);
+                    escaped += code;
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+        }
+        return escaped;
+    }
+
+private:
+    std::unique_ptr<std::ofstream> m_file;
+    std::ostream* m_os;
+};
+
+// Writes records as a table with one line per record and a fixed set of columns, separated by a delimiter,
+// e.g. for loading the results into a spreadsheet or a columnar store. A column is "Event", "Text" or the name
+// of a field, records without that field leave the cell empty. The first line holds the column names.
+class DelimitedResultBackend final : public ResultSinkBackend
+{
+public:
+    // Writes to a file, existing content is replaced.
+    DelimitedResultBackend(const std::string& fileName, std::vector<std::string> columns, char delimiter = '\t')
+        : m_file(fileName, std::ios::trunc), m_columns(std::move(columns)), m_delimiter(delimiter)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot open result file " + fileName);
+        }
+        for (size_t i = 0; i < m_columns.size(); i++)
+        {
+            m_file << (i == 0 ? "" : std::string(1, m_delimiter)) << m_columns[i];
+        }
+        m_file << "\n";
+    }
+
+    void Write(const ResultRecord& record) override
+    {
+        for (size_t i = 0; i < m_columns.size(); i++)
+        {
+            if (i != 0)
+            {
+                m_file << m_delimiter;
+            }
+            const std::string& column = m_columns[i];
+            if (column == "Event")
+            {
+                WriteCell(record.Event);
+            }
+            else if (column == "Text")
+            {
+                WriteCell(record.Text);
+            }
+            else
+            {
+                for (const auto& field : record.Fields)
+                {
+                    if (field.first == column)
+                    {
+                        WriteCell(field.second);
+                        break;
+                    }
+                }
+            }
+        }
+        m_file << "\n";
+    }
+
+    void Flush() override
+    {
+        m_file.flush();
+    }
+
+private:
+    // Delimiters and line breaks in a value are replaced by spaces, so that every record stays on one line.
+    void WriteCell(const std::string& value)
+    {
+        for (char c : value)
+        {
+            m_file << (c == m_delimiter || c == '\n' || c == '\r' ? ' ' : c);
+        }
+    }
+
+    std::ofstream m_file;
+    const std::vector<std::string> m_columns;
+    const char m_delimiter;
+};
+
+// Takes result records from the event handlers of any number of recognizers and writes them to a backend
+// from a background thread. Event handlers run on the SDK's callback threads, if they wrote to the console
+// directly, a slow terminal or pipe would delay the next event.
+// The queue between the handlers and the writer is bounded. When it is full, Post() either drops the
+// record or waits for free space, depending on the overflow policy.
+class AsyncResultSink final
+{
+public:
+    enum class OverflowPolicy { Drop, Block };
+
+    AsyncResultSink(std::unique_ptr<ResultSinkBackend> backend, size_t capacity = 1024, OverflowPolicy policy = OverflowPolicy::Drop)
+        : m_backend(std::move(backend)), m_capacity(capacity), m_policy(policy)
+    {
+        if (m_backend == nullptr)
+        {
+            throw std::invalid_argument("Result sink backend is null");
+        }
+        if (capacity == 0)
+        {
+            throw std::invalid_argument("Result sink capacity must be at least 1");
+        }
+        m_queue.reserve(capacity);
+        m_thread = std::thread(&AsyncResultSink::Run, this);
+    }
+
+    ~AsyncResultSink()
+    {
+        Close();
+    }
+
+    AsyncResultSink(const AsyncResultSink&) = delete;
+    AsyncResultSink& operator=(const AsyncResultSink&) = delete;
+
+    // Queues a record for writing. Can be called from any thread. Returns false if the record was dropped
+    // because the queue is full, or because the sink is closed.
+    bool Post(ResultRecord record)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_policy == OverflowPolicy::Block)
+        {
+            m_notFull.wait(lock, [this]() { return m_queue.size() < m_capacity || m_closing; });
+        }
+        if (m_closing || m_queue.size() >= m_capacity)
+        {
+            m_dropped++;
+            return false;
+        }
+        m_queue.push_back(std::move(record));
+        // Only the transition from empty needs to wake the writer, it drains the whole queue at once.
+        if (m_queue.size() == 1)
+        {
+            m_notEmpty.notify_one();
+        }
+        return true;
+    }
+
+    // Writes all queued records and stops the writer thread. Records posted after Close() are dropped.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closing)
+            {
+                return;
+            }
+            m_closing = true;
+        }
+        m_notEmpty.notify_one();
+        m_notFull.notify_all();
+        m_thread.join();
+    }
+
+    // Returns the number of records that have been dropped so far.
+    uint64_t Dropped() const
+    {
+        return m_dropped;
+    }
+
+private:
+    void Run()
+    {
+        std::vector<ResultRecord> batch;
+        batch.reserve(m_capacity);
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_notEmpty.wait(lock, [this]() { return !m_queue.empty() || m_closing; });
+                if (m_queue.empty())
+                {
+                    break;
+                }
+                // Takes all queued records, so the handlers are not blocked while the batch is written.
+                batch.swap(m_queue);
+            }
+            m_notFull.notify_all();
+
+            for (const auto& record : batch)
+            {
+                m_backend->Write(record);
+            }
+            m_backend->Flush();
+            batch.clear();
+        }
+        m_backend->Flush();
+    }
+
+    std::unique_ptr<ResultSinkBackend> m_backend;
+    const size_t m_capacity;
+    const OverflowPolicy m_policy;
+
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::vector<ResultRecord> m_queue;
+    bool m_closing = false;
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::thread m_thread;
+};
@@ -0,0 +1,250 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Transcribes a long WAV file by splitting it into segments at silence boundaries and
+// recognizing the segments concurrently, each with its own SpeechRecognizer.
+class SegmentedTranscriber final
+{
+public:
+    // A range of sample frames in the audio data of the file.
+    struct Segment
+    {
+        uint64_t StartSample;
+        uint64_t SampleCount;
+    };
+
+    // A recognized phrase, with offset and duration in ticks relative to the start of the file.
+    struct Phrase
+    {
+        uint64_t Offset;
+        uint64_t Duration;
+        std::string Text;
+    };
+
+    // Creates a transcriber that runs no more than 'maxParallelism' recognizers at a time.
+    SegmentedTranscriber(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const std::string& audioFileName, size_t maxParallelism)
+        : m_config(config), m_audioFileName(audioFileName), m_maxParallelism(maxParallelism)
+    {
+        if (config == nullptr)
+        {
+            throw std::invalid_argument("Speech config is null");
+        }
+        if (maxParallelism == 0)
+        {
+            throw std::invalid_argument("Parallelism must be at least 1");
+        }
+    }
+
+    // Splits the audio data into 'segmentCount' segments of about equal length. Each boundary is moved to
+    // the quietest 10 ms window near its nominal position, so that words are not cut in half.
+    // Only 16-bit PCM is inspected for silence, other formats are split at the nominal positions.
+    std::vector<Segment> Split(size_t segmentCount) const
+    {
+        if (segmentCount == 0)
+        {
+            throw std::invalid_argument("Segment count must be at least 1");
+        }
+
+        WavFileReader reader(m_audioFileName);
+        const auto& format = reader.Format();
+        const uint64_t totalSamples = reader.SampleCount();
+        const uint64_t nominalLength = totalSamples / segmentCount;
+        // WAVE_FORMAT_PCM, or WAVE_FORMAT_EXTENSIBLE which is used for multi-channel PCM.
+        const bool canDetectSilence = (format.FormatTag == 1 || format.FormatTag == 0xFFFE) && format.BitsPerSample == 16;
+
+        // Searches up to a second or a quarter of a segment on either side of the nominal boundary.
+        const uint64_t windowSamples = std::max<uint64_t>(format.SamplesPerSec / 100, 1);
+        const uint64_t searchRadius = std::min<uint64_t>(format.SamplesPerSec, nominalLength / 4);
+
+        std::vector<uint64_t> boundaries{ 0 };
+        for (size_t i = 1; i < segmentCount && nominalLength > 0; i++)
+        {
+            uint64_t nominal = nominalLength * i;
+            uint64_t boundary = canDetectSilence
+                ? FindQuietestWindow(reader, nominal - searchRadius, nominal + searchRadius, windowSamples)
+                : nominal;
+            // Keeps boundaries strictly increasing.
+            if (boundary > boundaries.back() && boundary < totalSamples)
+            {
+                boundaries.push_back(boundary);
+            }
+        }
+        boundaries.push_back(totalSamples);
+
+        std::vector<Segment> segments;
+        for (size_t i = 0; i + 1 < boundaries.size(); i++)
+        {
+            segments.push_back(Segment{ boundaries[i], boundaries[i + 1] - boundaries[i] });
+        }
+        return segments;
+    }
+
+    // Recognizes all segments and returns the phrases of the whole file ordered by offset.
+    // The result does not depend on the parallelism level, as every segment is recognized independently
+    // and the results are merged in segment order.
+    // Throws std::runtime_error if the recognition of any segment is canceled with an error.
+    std::vector<Phrase> Transcribe(size_t segmentCount) const
+    {
+        const std::vector<Segment> segments = Split(segmentCount);
+        std::vector<std::vector<Phrase>> segmentPhrases(segments.size());
+        std::vector<std::string> segmentErrors(segments.size());
+
+        // Workers pick the next segment from a shared counter until all segments are taken.
+        std::atomic<size_t> nextSegment{ 0 };
+        auto worker = [&]()
+        {
+            for (size_t index = nextSegment++; index < segments.size(); index = nextSegment++)
+            {
+                try
+                {
+                    RecognizeSegment(segments[index], segmentPhrases[index], segmentErrors[index]);
+                }
+                catch (const std::exception& e)
+                {
+                    segmentErrors[index] = e.what();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        const size_t workerCount = std::min(m_maxParallelism, segments.size());
+        for (size_t i = 0; i < workerCount; i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+
+        std::vector<Phrase> transcript;
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            if (!segmentErrors[i].empty())
+            {
+                throw std::runtime_error("Recognition of segment " + std::to_string(i) + " failed: " + segmentErrors[i]);
+            }
+            transcript.insert(transcript.end(), segmentPhrases[i].begin(), segmentPhrases[i].end());
+        }
+        // Segments are already in order, a stable sort only fixes up phrases that overlap a boundary.
+        std::stable_sort(transcript.begin(), transcript.end(), [](const Phrase& a, const Phrase& b) { return a.Offset < b.Offset; });
+        return transcript;
+    }
+
+private:
+    static constexpr uint64_t ticksPerSecond = 10000000;
+    static constexpr uint32_t pushBufferSize = 3200;
+
+    // Returns the start of the 10 ms window with the lowest energy in [begin, end).
+    static uint64_t FindQuietestWindow(WavFileReader& reader, uint64_t begin, uint64_t end, uint64_t windowSamples)
+    {
+        const auto& format = reader.Format();
+        std::vector<uint8_t> buffer((size_t)(windowSamples * format.BlockAlign));
+        uint64_t quietest = (begin + end) / 2;
+        uint64_t lowestEnergy = UINT64_MAX;
+
+        reader.Seek(begin);
+        for (uint64_t window = begin; window + windowSamples <= end; window += windowSamples)
+        {
+            int read = reader.Read(buffer.data(), (uint32_t)buffer.size());
+            if (read <= 0)
+            {
+                break;
+            }
+            uint64_t energy = 0;
+            const int16_t* samples = reinterpret_cast<const int16_t*>(buffer.data());
+            for (int i = 0; i < read / 2; i++)
+            {
+                energy += (uint64_t)((int64_t)samples[i] * samples[i]);
+            }
+            if (energy < lowestEnergy)
+            {
+                lowestEnergy = energy;
+                quietest = window;
+            }
+        }
+        return quietest;
+    }
+
+    void RecognizeSegment(const Segment& segment, std::vector<Phrase>& phrases, std::string& error) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        // Each worker has its own reader, readers are not shared between threads.
+        WavFileReader reader(m_audioFileName);
+        const auto& format = reader.Format();
+        const uint64_t segmentOffset = segment.StartSample * ticksPerSecond / format.SamplesPerSec;
+
+        auto pushStream = AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels));
+        auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(pushStream));
+
+        std::mutex phrasesMutex;
+        std::promise<void> recognitionEnd;
+        std::once_flag endOnce;
+        auto signalEnd = [&]() { std::call_once(endOnce, [&]() { recognitionEnd.set_value(); }); };
+
+        recognizer->Recognized.Connect([&](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+            {
+                std::lock_guard<std::mutex> lock(phrasesMutex);
+                phrases.push_back(Phrase{ e.Result->Offset() + segmentOffset, e.Result->Duration(), e.Result->Text });
+            }
+        });
+
+        recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                std::lock_guard<std::mutex> lock(phrasesMutex);
+                error = e.ErrorDetails;
+                signalEnd();
+            }
+        });
+
+        recognizer->SessionStopped.Connect([&](const SessionEventArgs&)
+        {
+            signalEnd();
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+
+        // Pushes the audio of the segment, then closes the stream to let the recognizer finish.
+        reader.Seek(segment.StartSample);
+        uint64_t remaining = segment.SampleCount * format.BlockAlign;
+        std::vector<uint8_t> buffer(pushBufferSize);
+        while (remaining > 0)
+        {
+            uint32_t toRead = remaining < buffer.size() ? (uint32_t)remaining : (uint32_t)buffer.size();
+            int read = reader.Read(buffer.data(), toRead);
+            if (read <= 0)
+            {
+                break;
+            }
+            pushStream->Write(buffer.data(), (uint32_t)read);
+            remaining -= (uint64_t)read;
+        }
+        pushStream->Close();
+
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    std::string m_audioFileName;
+    size_t m_maxParallelism;
+};
@@ -0,0 +1,277 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SESSION_COMPLETION_COROUTINES
+#endif
+#endif
+
+// How a recognition session ended.
+struct SessionOutcome
+{
+    // True if the session was canceled with an error.
+    bool Canceled = false;
+    Microsoft::CognitiveServices::Speech::CancellationErrorCode ErrorCode = Microsoft::CognitiveServices::Speech::CancellationErrorCode::NoError;
+    std::string ErrorDetails;
+};
+
+// Runs work on a function of the caller's choice, e.g. a thread pool. Continuations of a SessionCompletion run
+// directly on the SDK's event thread if no executor is given.
+using SessionExecutor = std::function<void(std::function<void()>)>;
+
+// Runs posted work one item at a time on a single thread, so the continuations of many sessions need no locks.
+class SerialExecutor final
+{
+public:
+    SerialExecutor()
+        : m_thread(&SerialExecutor::Run, this)
+    {
+    }
+
+    ~SerialExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closing = true;
+        }
+        m_changed.notify_one();
+        m_thread.join();
+    }
+
+    SerialExecutor(const SerialExecutor&) = delete;
+    SerialExecutor& operator=(const SerialExecutor&) = delete;
+
+    void Post(std::function<void()> work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_work.push_back(std::move(work));
+        }
+        m_changed.notify_one();
+    }
+
+    // Returns an executor that posts to this one, which must outlive it.
+    SessionExecutor AsExecutor()
+    {
+        return [this](std::function<void()> work) { Post(std::move(work)); };
+    }
+
+private:
+    // Runs all work posted before the executor is destroyed.
+    void Run()
+    {
+        while (true)
+        {
+            std::function<void()> work;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this]() { return m_closing || !m_work.empty(); });
+                if (m_work.empty())
+                {
+                    return;
+                }
+                work = std::move(m_work.front());
+                m_work.pop_front();
+            }
+            work();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<std::function<void()>> m_work;
+    bool m_closing = false;
+    std::thread m_thread;
+};
+
+// Completes once when a recognition session ends. It replaces a promise<void> that is set from both Canceled and
+// SessionStopped: the session ends with whichever comes first, and completing again is ignored instead of throwing.
+//
+// A completion is a handle to shared state, copies refer to the same completion, so it can be captured by value in
+// event handlers. Besides waiting for it, continuations can be attached that run when it completes, alone or on an
+// executor, so that one thread can follow any number of sessions. With C++20 coroutines it can also be co_awaited.
+class SessionCompletion final
+{
+public:
+    using Continuation = std::function<void(const SessionOutcome& outcome)>;
+
+    SessionCompletion()
+        : m_state(std::make_shared<State>())
+    {
+    }
+
+    // Returns a completion that is completed by the recognizer's SessionStopped event, or by its Canceled event
+    // if the session is canceled with an error. Works with all recognizers and transcribers.
+    template <class Recognizer>
+    static SessionCompletion Track(Recognizer& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        SessionCompletion completion;
+        recognizer.Canceled.Connect([completion](const auto& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                SessionOutcome outcome;
+                outcome.Canceled = true;
+                outcome.ErrorCode = e.ErrorCode;
+                outcome.ErrorDetails = e.ErrorDetails;
+                completion.Complete(std::move(outcome));
+            }
+        });
+        recognizer.SessionStopped.Connect([completion](const SessionEventArgs&)
+        {
+            completion.Complete();
+        });
+        return completion;
+    }
+
+    // Completes the session and runs the continuations. Returns false, and does nothing, if it was already completed.
+    bool Complete(SessionOutcome outcome = SessionOutcome()) const
+    {
+        std::vector<std::pair<Continuation, SessionExecutor>> continuations;
+        {
+            std::lock_guard<std::mutex> lock(m_state->Mutex);
+            if (m_state->Completed)
+            {
+                return false;
+            }
+            m_state->Completed = true;
+            m_state->Outcome = std::move(outcome);
+            continuations.swap(m_state->Continuations);
+        }
+        m_state->Changed.notify_all();
+        for (auto& continuation : continuations)
+        {
+            Run(std::move(continuation.first), continuation.second);
+        }
+        return true;
+    }
+
+    bool IsComplete() const
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        return m_state->Completed;
+    }
+
+    // Runs the continuation when the session completes, right away if it already has. It runs on the thread that
+    // completes the session unless an executor is given.
+    void OnComplete(Continuation continuation, SessionExecutor executor = nullptr) const
+    {
+        if (!TryAdd(continuation, executor))
+        {
+            Run(std::move(continuation), executor);
+        }
+    }
+
+    // Blocks the calling thread until the session completes, for samples that follow a single session.
+    SessionOutcome Wait() const
+    {
+        std::unique_lock<std::mutex> lock(m_state->Mutex);
+        m_state->Changed.wait(lock, [this]() { return m_state->Completed; });
+        return m_state->Outcome;
+    }
+
+#ifdef SESSION_COMPLETION_COROUTINES
+    class Awaiter;
+
+    // co_await on a completion suspends the coroutine until the session completes, and resumes it on the completing
+    // thread, or on the executor given to On().
+    Awaiter operator co_await() const;
+    Awaiter On(SessionExecutor executor) const;
+#endif
+
+private:
+    struct State
+    {
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        bool Completed = false;
+        SessionOutcome Outcome;
+        std::vector<std::pair<Continuation, SessionExecutor>> Continuations;
+    };
+
+    // Returns false if the session has already completed, the continuation is then not kept.
+    bool TryAdd(const Continuation& continuation, const SessionExecutor& executor) const
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        if (m_state->Completed)
+        {
+            return false;
+        }
+        m_state->Continuations.emplace_back(continuation, executor);
+        return true;
+    }
+
+    void Run(Continuation continuation, const SessionExecutor& executor) const
+    {
+        // The outcome does not change once completed, so it is read without the lock.
+        auto state = m_state;
+        if (executor)
+        {
+            executor([state, continuation]() { continuation(state->Outcome); });
+        }
+        else
+        {
+            continuation(state->Outcome);
+        }
+    }
+
+    std::shared_ptr<State> m_state;
+};
+
+#ifdef SESSION_COMPLETION_COROUTINES
+class SessionCompletion::Awaiter final
+{
+public:
+    Awaiter(SessionCompletion completion, SessionExecutor executor)
+        : m_completion(std::move(completion)), m_executor(std::move(executor))
+    {
+    }
+
+    bool await_ready() const
+    {
+        return m_completion.IsComplete();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        return m_completion.TryAdd([handle](const SessionOutcome&) { handle.resume(); }, m_executor);
+    }
+
+    SessionOutcome await_resume() const
+    {
+        return m_completion.Wait();
+    }
+
+private:
+    SessionCompletion m_completion;
+    SessionExecutor m_executor;
+};
+
+inline SessionCompletion::Awaiter SessionCompletion::operator co_await() const
+{
+    return Awaiter(*this, nullptr);
+}
+
+inline SessionCompletion::Awaiter SessionCompletion::On(SessionExecutor executor) const
+{
+    return Awaiter(*this, std::move(executor));
+}
+#endif
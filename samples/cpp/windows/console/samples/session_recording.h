@@ -0,0 +1,437 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class RecordedEventKind : uint8_t
+{
+    SessionStarted = 1,
+    SessionStopped = 2,
+    Recognizing = 3,
+    Recognized = 4,
+    NoMatch = 5,
+    Canceled = 6,
+    SynthesisStarted = 7,
+    Synthesizing = 8,
+    SynthesisCompleted = 9
+};
+
+// An event of a recorded session. Offset and duration are in ticks as in the result. 'Speaker' is the user id of a
+// conversation transcription, 'Code' the error code of a cancellation, whose details are in 'Text'. 'AudioSize' is
+// the size of a synthesized chunk, 'Audio' its data if the recording kept it, otherwise as many zero bytes.
+struct RecordedEvent
+{
+    RecordedEventKind Kind = RecordedEventKind::SessionStarted;
+    // Microseconds since the first event of the recording.
+    uint64_t Time = 0;
+    uint64_t Offset = 0;
+    uint64_t Duration = 0;
+    uint32_t Code = 0;
+    std::string Text;
+    std::string Speaker;
+    uint32_t AudioSize = 0;
+    std::vector<uint8_t> Audio;
+};
+
+// The layout of a recording: the magic "SREC", a version and flags, then one record per event, with all numbers as
+// LEB128 varints, so that a record of a partial result takes a few bytes plus its text. Times are stored as the
+// difference to the previous event.
+namespace SessionRecordingFormat
+{
+    const char magic[4] = { 'S', 'R', 'E', 'C' };
+    const uint32_t version = 1;
+    const uint32_t audioFlag = 1;
+
+    inline void AppendVarint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += (char)((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += (char)value;
+    }
+
+    // Throws std::runtime_error at the end of the data.
+    inline uint64_t ReadVarint(const std::string& in, size_t& position)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (position >= in.size())
+            {
+                throw std::runtime_error("Session recording is truncated");
+            }
+            const uint8_t byte = (uint8_t)in[position++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+        throw std::runtime_error("Session recording has an invalid number");
+    }
+
+    inline std::string ReadBytes(const std::string& in, size_t& position, uint64_t size)
+    {
+        if (size > in.size() - position)
+        {
+            throw std::runtime_error("Session recording is truncated");
+        }
+        std::string bytes = in.substr(position, (size_t)size);
+        position += (size_t)size;
+        return bytes;
+    }
+}
+
+// Records the events of real sessions, with their timing, to replay them with SessionReplayer into the handler code
+// of an application, e.g. to benchmark the processing of partial results without calls to the service.
+//
+// Attach() connects handlers of its own, next to those of the application. Synthesized audio is left out unless
+// Options::RecordAudio is set, the replay then passes chunks of zeros of the recorded sizes.
+class SessionRecorder final
+{
+public:
+    struct Options
+    {
+        bool RecordAudio = false;
+    };
+
+    SessionRecorder()
+        : SessionRecorder(Options())
+    {
+    }
+
+    explicit SessionRecorder(const Options& options)
+        : m_state(std::make_shared<State>())
+    {
+        m_state->RecordAudio = options.RecordAudio;
+    }
+
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    // Attaches to a SpeechRecognizer, TranslationRecognizer or IntentRecognizer. The handlers hold a reference to
+    // the recorded events, so the recognizer may outlive this object.
+    template <class RecognizerT>
+    void Attach(const std::shared_ptr<RecognizerT>& recognizer)
+    {
+        AttachSession(*recognizer);
+        auto state = m_state;
+        recognizer->Recognizing.Connect([state](const auto& e)
+        {
+            state->AddResult(RecordedEventKind::Recognizing, *e.Result, std::string());
+        });
+        recognizer->Recognized.Connect([state](const auto& e)
+        {
+            state->AddResult(Final(*e.Result), *e.Result, std::string());
+        });
+    }
+
+    // Attaches to a ConversationTranscriber, its results are recorded with the user id as the speaker.
+    void Attach(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Transcription::ConversationTranscriber>& transcriber)
+    {
+        AttachSession(*transcriber);
+        auto state = m_state;
+        transcriber->Transcribing.Connect([state](const auto& e)
+        {
+            state->AddResult(RecordedEventKind::Recognizing, *e.Result, e.Result->UserId);
+        });
+        transcriber->Transcribed.Connect([state](const auto& e)
+        {
+            state->AddResult(Final(*e.Result), *e.Result, e.Result->UserId);
+        });
+    }
+
+    void Attach(const std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer>& synthesizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto state = m_state;
+        synthesizer->SynthesisStarted.Connect([state](const SpeechSynthesisEventArgs&)
+        {
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::SynthesisStarted;
+            state->Add(std::move(event));
+        });
+        synthesizer->Synthesizing.Connect([state](const SpeechSynthesisEventArgs& e)
+        {
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::Synthesizing;
+            auto audio = e.Result->GetAudioData();
+            event.AudioSize = (uint32_t)audio->size();
+            if (state->RecordAudio)
+            {
+                event.Audio = *audio;
+            }
+            state->Add(std::move(event));
+        });
+        synthesizer->SynthesisCompleted.Connect([state](const SpeechSynthesisEventArgs&)
+        {
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::SynthesisCompleted;
+            state->Add(std::move(event));
+        });
+        synthesizer->SynthesisCanceled.Connect([state](const SpeechSynthesisEventArgs& e)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(e.Result);
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::Canceled;
+            event.Code = (uint32_t)cancellation->ErrorCode;
+            event.Text = cancellation->ErrorDetails;
+            state->Add(std::move(event));
+        });
+    }
+
+    // Returns the number of events recorded so far.
+    size_t Count() const
+    {
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        return m_state->Events.size();
+    }
+
+    // Writes the events recorded so far. Throws std::runtime_error if the file cannot be written.
+    void Save(const std::string& fileName) const
+    {
+        using namespace SessionRecordingFormat;
+
+        std::string data(magic, sizeof(magic));
+        std::lock_guard<std::mutex> lock(m_state->Mutex);
+        AppendVarint(data, version);
+        AppendVarint(data, m_state->RecordAudio ? audioFlag : 0);
+        uint64_t time = 0;
+        for (const auto& event : m_state->Events)
+        {
+            data += (char)event.Kind;
+            AppendVarint(data, event.Time - time);
+            time = event.Time;
+            AppendVarint(data, event.Offset);
+            AppendVarint(data, event.Duration);
+            AppendVarint(data, event.Code);
+            AppendVarint(data, event.Text.size());
+            data += event.Text;
+            AppendVarint(data, event.Speaker.size());
+            data += event.Speaker;
+            AppendVarint(data, event.AudioSize);
+            if (m_state->RecordAudio)
+            {
+                data.append(event.Audio.begin(), event.Audio.end());
+            }
+        }
+
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), (std::streamsize)data.size());
+        file.close();
+        if (!file)
+        {
+            throw std::runtime_error("Cannot write session recording " + fileName);
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Recorded events, shared with the handlers. A recorder may be attached to a recognizer and a synthesizer at
+    // once, so additions lock.
+    struct State
+    {
+        std::mutex Mutex;
+        bool RecordAudio = false;
+        bool Started = false;
+        Clock::time_point Start;
+        std::vector<RecordedEvent> Events;
+
+        void Add(RecordedEvent event)
+        {
+            const auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(Mutex);
+            if (!Started)
+            {
+                Started = true;
+                Start = now;
+            }
+            // Events of different objects may be stamped out of order by a few microseconds, times never go back.
+            const uint64_t time = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - Start).count();
+            event.Time = Events.empty() || time > Events.back().Time ? time : Events.back().Time;
+            Events.push_back(std::move(event));
+        }
+
+        void AddResult(RecordedEventKind kind, const Microsoft::CognitiveServices::Speech::RecognitionResult& result, const std::string& speaker)
+        {
+            RecordedEvent event;
+            event.Kind = kind;
+            event.Offset = result.Offset();
+            event.Duration = result.Duration();
+            event.Text = result.Text;
+            event.Speaker = speaker;
+            Add(std::move(event));
+        }
+    };
+
+    static RecordedEventKind Final(const Microsoft::CognitiveServices::Speech::RecognitionResult& result)
+    {
+        return result.Reason == Microsoft::CognitiveServices::Speech::ResultReason::NoMatch ? RecordedEventKind::NoMatch : RecordedEventKind::Recognized;
+    }
+
+    template <class RecognizerT>
+    void AttachSession(RecognizerT& recognizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto state = m_state;
+        recognizer.SessionStarted.Connect([state](const SessionEventArgs&)
+        {
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::SessionStarted;
+            state->Add(std::move(event));
+        });
+        recognizer.SessionStopped.Connect([state](const SessionEventArgs&)
+        {
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::SessionStopped;
+            state->Add(std::move(event));
+        });
+        recognizer.Canceled.Connect([state](const auto& e)
+        {
+            RecordedEvent event;
+            event.Kind = RecordedEventKind::Canceled;
+            event.Code = (uint32_t)e.ErrorCode;
+            event.Text = e.ErrorDetails;
+            state->Add(std::move(event));
+        });
+    }
+
+    std::shared_ptr<State> m_state;
+};
+
+// Replays a recording of SessionRecorder into handler code, on the calling thread and one event at a time, as the
+// SDK raises the events of one recognizer. At speed 1 every event is passed at its recorded time, at speed 0 as
+// fast as the handler takes it, which measures the throughput of the handler alone. The replay is the same on
+// every run, so that results of two builds can be compared.
+class SessionReplayer final
+{
+public:
+    using Handler = std::function<void(const RecordedEvent& event)>;
+
+    struct Statistics
+    {
+        uint64_t Events = 0;
+        // The time the replay took, and the part of it spent in the handler.
+        double ElapsedMs = 0;
+        double HandlerMs = 0;
+        // The longest an event was passed after its time, because the handler took longer than the gap before it.
+        double MaxLateMs = 0;
+
+        double EventsPerSecond() const
+        {
+            return HandlerMs > 0 ? Events * 1000.0 / HandlerMs : 0;
+        }
+    };
+
+    // Reads a recording. Throws std::runtime_error if it cannot be read or is not a valid recording.
+    explicit SessionReplayer(const std::string& fileName)
+    {
+        using namespace SessionRecordingFormat;
+
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open session recording " + fileName);
+        }
+        const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(magic) || memcmp(data.data(), magic, sizeof(magic)) != 0)
+        {
+            throw std::runtime_error(fileName + " is not a session recording");
+        }
+        size_t position = sizeof(magic);
+        if (ReadVarint(data, position) != version)
+        {
+            throw std::runtime_error(fileName + " is a session recording of an unknown version");
+        }
+        const bool audio = (ReadVarint(data, position) & audioFlag) != 0;
+        uint64_t time = 0;
+        while (position < data.size())
+        {
+            RecordedEvent event;
+            event.Kind = (RecordedEventKind)data[position++];
+            time += ReadVarint(data, position);
+            event.Time = time;
+            event.Offset = ReadVarint(data, position);
+            event.Duration = ReadVarint(data, position);
+            event.Code = (uint32_t)ReadVarint(data, position);
+            event.Text = ReadBytes(data, position, ReadVarint(data, position));
+            event.Speaker = ReadBytes(data, position, ReadVarint(data, position));
+            event.AudioSize = (uint32_t)ReadVarint(data, position);
+            if (audio)
+            {
+                const std::string bytes = ReadBytes(data, position, event.AudioSize);
+                event.Audio.assign(bytes.begin(), bytes.end());
+            }
+            else
+            {
+                event.Audio.assign(event.AudioSize, 0);
+            }
+            m_events.push_back(std::move(event));
+        }
+    }
+
+    const std::vector<RecordedEvent>& Events() const
+    {
+        return m_events;
+    }
+
+    // Passes all events to 'handler', 'speed' is the pace relative to the recording, 0 for no pacing.
+    Statistics Replay(const Handler& handler, double speed = 0) const
+    {
+        if (speed < 0)
+        {
+            throw std::invalid_argument("Speed must not be negative");
+        }
+        using Clock = std::chrono::steady_clock;
+        Statistics statistics;
+        const auto start = Clock::now();
+        Clock::duration handlerTime(0);
+        for (const auto& event : m_events)
+        {
+            if (speed > 0)
+            {
+                const auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(event.Time / speed));
+                const auto now = Clock::now();
+                if (now < due)
+                {
+                    std::this_thread::sleep_until(due);
+                }
+                else
+                {
+                    statistics.MaxLateMs = std::max(statistics.MaxLateMs, std::chrono::duration<double, std::milli>(now - due).count());
+                }
+            }
+            const auto before = Clock::now();
+            handler(event);
+            handlerTime += Clock::now() - before;
+            statistics.Events++;
+        }
+        statistics.ElapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        statistics.HandlerMs = std::chrono::duration<double, std::milli>(handlerTime).count();
+        return statistics;
+    }
+
+private:
+    std::vector<RecordedEvent> m_events;
+};
@@ -0,0 +1,244 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Voice activity pre-filter between a WavFileReader and a push stream. It shortens long runs of silence,
+// so less audio is sent to and billed by the service, and keeps a map from the offsets of the filtered
+// audio back to the offsets of the original audio, so that result offsets still point into the file.
+//
+// Audio is classified in 10 ms frames by its mean amplitude and zero-crossing rate. A silent run keeps its
+// first KeptSilenceMs and last PreRollMs milliseconds and the rest of it is dropped. That leaves the service
+// enough silence to end a phrase, and keeps the quiet onset of the next word.
+// Only 16-bit PCM is filtered, other formats pass through unchanged.
+class SilenceFilter final
+{
+public:
+    struct Options
+    {
+        // Frames with a mean amplitude below this level count as silence, in 16-bit sample units.
+        int32_t EnergyThreshold = 300;
+        // Frames slightly above the silence level, but with many zero crossings (e.g. fricatives), count as speech.
+        int32_t LowEnergyThreshold = 100;
+        double ZeroCrossingRate = 0.25;
+        uint32_t KeptSilenceMs = 500;
+        uint32_t PreRollMs = 200;
+    };
+
+    explicit SilenceFilter(const WavFileReader::WAVEFORMAT& format)
+        : SilenceFilter(format, Options())
+    {
+    }
+
+    SilenceFilter(const WavFileReader::WAVEFORMAT& format, const Options& options)
+        : m_format(format), m_options(options)
+    {
+        if (format.BlockAlign == 0 || format.SamplesPerSec == 0)
+        {
+            throw std::invalid_argument("Invalid audio format");
+        }
+        m_enabled = (format.FormatTag == 1 || format.FormatTag == 0xFFFE) && format.BitsPerSample == 16;
+        m_frameSize = std::max<uint32_t>(format.SamplesPerSec / 100, 1) * format.BlockAlign;
+        m_keptSilenceFrames = options.KeptSilenceMs / 10;
+        m_preRollFrames = options.PreRollMs / 10;
+        m_map.push_back(MapEntry{ 0, 0 });
+    }
+
+    SilenceFilter(const SilenceFilter&) = delete;
+    SilenceFilter& operator=(const SilenceFilter&) = delete;
+
+    // Filters 'size' bytes of audio and appends the audio to keep to 'output'. Audio that does not fill
+    // a whole frame is held back until the next call or Flush().
+    void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+    {
+        if (!m_enabled)
+        {
+            Emit(data, size, m_inputBytes, output);
+            m_inputBytes += size;
+            return;
+        }
+
+        m_pending.insert(m_pending.end(), data, data + size);
+        size_t offset = 0;
+        while (m_pending.size() - offset >= m_frameSize)
+        {
+            ProcessFrame(m_pending.data() + offset, output);
+            offset += m_frameSize;
+        }
+        m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+    }
+
+    // Appends the held back audio to 'output', call it at the end of the audio.
+    void Flush(std::vector<uint8_t>& output)
+    {
+        EmitPreRoll(output);
+        Emit(m_pending.data(), m_pending.size(), m_inputBytes, output);
+        m_inputBytes += m_pending.size();
+        m_pending.clear();
+    }
+
+    // Translates an offset in ticks within the filtered audio, e.g. a result offset reported by the service,
+    // to the offset within the original audio. Can be called from any thread, e.g. from event handlers.
+    uint64_t ToOriginalTicks(uint64_t filteredTicks) const
+    {
+        const uint64_t filteredBytes = TicksToBytes(filteredTicks);
+        std::lock_guard<std::mutex> lock(m_mapMutex);
+        // Finds the last entry that starts at or before the offset.
+        auto it = std::upper_bound(m_map.begin(), m_map.end(), filteredBytes,
+            [](uint64_t value, const MapEntry& entry) { return value < entry.FilteredOffset; });
+        --it;
+        return BytesToTicks(it->OriginalOffset + (filteredBytes - it->FilteredOffset));
+    }
+
+    // Returns the duration of the audio that has been dropped so far, in ticks.
+    uint64_t DroppedTicks() const
+    {
+        std::lock_guard<std::mutex> lock(m_mapMutex);
+        return BytesToTicks(m_droppedBytes);
+    }
+
+private:
+    static constexpr uint64_t ticksPerSecond = 10000000;
+
+    // Start of a run of audio that has been kept, after audio was dropped before it.
+    struct MapEntry
+    {
+        uint64_t FilteredOffset;
+        uint64_t OriginalOffset;
+    };
+
+    struct Frame
+    {
+        uint64_t OriginalOffset;
+        std::vector<uint8_t> Data;
+    };
+
+    void ProcessFrame(const uint8_t* frame, std::vector<uint8_t>& output)
+    {
+        const uint64_t frameOffset = m_inputBytes;
+        m_inputBytes += m_frameSize;
+
+        if (!IsSilent(frame))
+        {
+            m_silentFrames = 0;
+            EmitPreRoll(output);
+            Emit(frame, m_frameSize, frameOffset, output);
+            return;
+        }
+
+        if (++m_silentFrames <= m_keptSilenceFrames)
+        {
+            Emit(frame, m_frameSize, frameOffset, output);
+            return;
+        }
+
+        // Beyond the kept silence, the latest frames are held as pre-roll, older frames are dropped.
+        m_preRoll.push_back(Frame{ frameOffset, std::vector<uint8_t>(frame, frame + m_frameSize) });
+        if (m_preRoll.size() > m_preRollFrames)
+        {
+            m_preRoll.pop_front();
+            std::lock_guard<std::mutex> lock(m_mapMutex);
+            m_droppedBytes += m_frameSize;
+        }
+    }
+
+    void EmitPreRoll(std::vector<uint8_t>& output)
+    {
+        for (const auto& frame : m_preRoll)
+        {
+            Emit(frame.Data.data(), frame.Data.size(), frame.OriginalOffset, output);
+        }
+        m_preRoll.clear();
+    }
+
+    // Writes kept audio to the output. Audio that does not follow the previously kept audio in the
+    // original stream starts a new map entry.
+    void Emit(const uint8_t* data, size_t size, uint64_t originalOffset, std::vector<uint8_t>& output)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        output.insert(output.end(), data, data + size);
+        std::lock_guard<std::mutex> lock(m_mapMutex);
+        if (originalOffset != m_originalEnd)
+        {
+            m_map.push_back(MapEntry{ m_outputBytes, originalOffset });
+        }
+        m_outputBytes += size;
+        m_originalEnd = originalOffset + size;
+    }
+
+    // Classifies a frame by its mean absolute amplitude and the zero-crossing rate of the first channel.
+    // The loops have no branches in their bodies, so that compilers can vectorize them.
+    bool IsSilent(const uint8_t* frame) const
+    {
+        const int16_t* samples = reinterpret_cast<const int16_t*>(frame);
+        const size_t sampleCount = m_frameSize / 2;
+        int64_t amplitude = 0;
+        for (size_t i = 0; i < sampleCount; i++)
+        {
+            int32_t sample = samples[i];
+            amplitude += sample < 0 ? -sample : sample;
+        }
+        const int64_t meanAmplitude = amplitude / (int64_t)sampleCount;
+        if (meanAmplitude >= m_options.EnergyThreshold)
+        {
+            return false;
+        }
+        if (meanAmplitude < m_options.LowEnergyThreshold)
+        {
+            return true;
+        }
+
+        const size_t channels = m_format.Channels == 0 ? 1 : m_format.Channels;
+        const size_t frames = sampleCount / channels;
+        size_t crossings = 0;
+        for (size_t i = 1; i < frames; i++)
+        {
+            crossings += (samples[(i - 1) * channels] < 0) != (samples[i * channels] < 0);
+        }
+        return frames < 2 || (double)crossings / (frames - 1) < m_options.ZeroCrossingRate;
+    }
+
+    uint64_t TicksToBytes(uint64_t ticks) const
+    {
+        uint64_t frames = ticks * m_format.SamplesPerSec / ticksPerSecond;
+        return frames * m_format.BlockAlign;
+    }
+
+    uint64_t BytesToTicks(uint64_t bytes) const
+    {
+        uint64_t frames = bytes / m_format.BlockAlign;
+        return frames * ticksPerSecond / m_format.SamplesPerSec;
+    }
+
+    WavFileReader::WAVEFORMAT m_format;
+    Options m_options;
+    bool m_enabled;
+    uint32_t m_frameSize;
+    uint32_t m_keptSilenceFrames;
+    uint32_t m_preRollFrames;
+
+    std::vector<uint8_t> m_pending;
+    std::deque<Frame> m_preRoll;
+    uint32_t m_silentFrames = 0;
+    // Bytes taken in, not counting the pending bytes that do not fill a frame yet.
+    uint64_t m_inputBytes = 0;
+
+    // The offset map and the byte counts it is built from. Guarded by m_mapMutex, which is only needed
+    // because ToOriginalTicks() and DroppedTicks() may be called from other threads.
+    uint64_t m_outputBytes = 0;
+    uint64_t m_originalEnd = 0;
+    uint64_t m_droppedBytes = 0;
+    std::vector<MapEntry> m_map;
+    mutable std::mutex m_mapMutex;
+};
@@ -0,0 +1,279 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Text independent identification profiles by speaker name, kept in a file so that speakers are enrolled once
+// and not on every run. Profiles live in the service until they are removed, the file only maps names to
+// profile ids. The identification model of all profiles is built once and reused until the profiles change.
+class SpeakerProfileRegistry final
+{
+public:
+    // Creates the audio input to enroll a speaker with, e.g. a pull stream of a wav file.
+    using AudioConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>()>;
+
+    // Loads the names and profile ids of 'fileName', if it exists.
+    SpeakerProfileRegistry(std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient> client, const std::string& fileName, const std::string& locale = "en-us")
+        : m_client(std::move(client)), m_fileName(fileName), m_locale(locale)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        if (m_client == nullptr)
+        {
+            throw std::invalid_argument("Client is null");
+        }
+        std::ifstream file(m_fileName);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t tab = line.find('\t');
+            if (tab != std::string::npos && tab + 1 < line.size())
+            {
+                m_profiles[line.substr(0, tab)] = VoiceProfile::FromId(line.substr(tab + 1), VoiceProfileType::TextIndependentIdentification);
+            }
+        }
+    }
+
+    SpeakerProfileRegistry(const SpeakerProfileRegistry&) = delete;
+    SpeakerProfileRegistry& operator=(const SpeakerProfileRegistry&) = delete;
+
+    // Returns the profile of a speaker, and creates and enrolls it with the audio of 'createAudio' if the speaker
+    // is not registered yet. Throws std::runtime_error if the enrollment fails or needs more audio.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile> GetOrEnroll(const std::string& name, const AudioConfigFactory& createAudio)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        if (name.empty() || name.find_first_of("\t\n") != std::string::npos)
+        {
+            throw std::invalid_argument("Speaker name must not be empty or contain tabs or line breaks");
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_profiles.find(name);
+            if (it != m_profiles.end())
+            {
+                return it->second;
+            }
+        }
+
+        auto profile = m_client->CreateProfileAsync(VoiceProfileType::TextIndependentIdentification, m_locale).get();
+        auto result = m_client->EnrollProfileAsync(profile, createAudio()).get();
+        if (result->Reason != ResultReason::EnrolledVoiceProfile)
+        {
+            std::string error = "Speaker " + name + " needs more audio to enroll";
+            if (result->Reason == ResultReason::Canceled)
+            {
+                error = "Cannot enroll speaker " + name + ": " + VoiceProfileEnrollmentCancellationDetails::FromResult(result)->ErrorDetails;
+            }
+            // The profile is of no use without enrollment, so that it is not left behind in the service.
+            m_client->DeleteProfileAsync(profile).get();
+            throw std::runtime_error(error);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_profiles[name] = profile;
+        m_model = nullptr;
+        Save();
+        return profile;
+    }
+
+    // Deletes the profile of a speaker in the service and removes it from the registry.
+    void Remove(const std::string& name)
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile> profile;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_profiles.find(name);
+            if (it == m_profiles.end())
+            {
+                return;
+            }
+            profile = it->second;
+            m_profiles.erase(it);
+            m_model = nullptr;
+            Save();
+        }
+        m_client->DeleteProfileAsync(profile).get();
+    }
+
+    // Returns the name of the speaker of a profile id, e.g. of an identification result, or an empty string.
+    std::string NameOf(const std::string& profileId) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_profiles)
+        {
+            if (entry.second->GetId() == profileId)
+            {
+                return entry.first;
+            }
+        }
+        return std::string();
+    }
+
+    size_t Count() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_profiles.size();
+    }
+
+    // Returns the identification model of all registered speakers. Throws std::runtime_error if there are none.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::SpeakerIdentificationModel> Model()
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_model == nullptr)
+        {
+            if (m_profiles.empty())
+            {
+                throw std::runtime_error("No speaker is registered");
+            }
+            std::vector<std::shared_ptr<VoiceProfile>> profiles;
+            for (const auto& entry : m_profiles)
+            {
+                profiles.push_back(entry.second);
+            }
+            m_model = SpeakerIdentificationModel::FromProfiles(profiles);
+        }
+        return m_model;
+    }
+
+private:
+    // Writes a new file and renames it, so that a crash never leaves a partly written registry. Called with the lock held.
+    void Save() const
+    {
+        const std::string temporaryFileName = m_fileName + ".tmp";
+        {
+            std::ofstream file(temporaryFileName, std::ios::trunc);
+            for (const auto& entry : m_profiles)
+            {
+                file << entry.first << '\t' << entry.second->GetId() << "\n";
+            }
+            if (!file)
+            {
+                throw std::runtime_error("Cannot write " + temporaryFileName);
+            }
+        }
+        std::remove(m_fileName.c_str());
+        if (std::rename(temporaryFileName.c_str(), m_fileName.c_str()) != 0)
+        {
+            throw std::runtime_error("Cannot write " + m_fileName);
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfileClient> m_client;
+    const std::string m_fileName;
+    const std::string m_locale;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile>> m_profiles;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::SpeakerIdentificationModel> m_model;
+};
+
+// Identifies the speakers of many audio clips against one identification model, with a fixed number of
+// recognitions running at the same time.
+class SpeakerBatchIdentifier final
+{
+public:
+    // Creates the audio input of a clip, e.g. AudioConfig::FromWavFileInput.
+    using AudioConfigFactory = std::function<std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::AudioConfig>(const std::string& clip)>;
+
+    struct Identification
+    {
+        std::string Clip;
+        // Empty if no speaker was identified.
+        std::string ProfileId;
+        float Score = 0;
+        // Empty on success.
+        std::string Error;
+    };
+
+    SpeakerBatchIdentifier(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, size_t concurrency = 4)
+        : m_config(std::move(config)), m_concurrency(concurrency)
+    {
+        if (m_config == nullptr)
+        {
+            throw std::invalid_argument("Config is null");
+        }
+        if (concurrency == 0)
+        {
+            throw std::invalid_argument("Concurrency must be at least 1");
+        }
+    }
+
+    // Identifies the speaker of each clip, and returns the results in the order of the clips.
+    std::vector<Identification> Identify(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::SpeakerIdentificationModel>& model,
+        const std::vector<std::string>& clips, const AudioConfigFactory& createAudio) const
+    {
+        std::vector<Identification> results(clips.size());
+        std::atomic<size_t> next{ 0 };
+        auto work = [&]()
+        {
+            for (size_t index = next++; index < clips.size(); index = next++)
+            {
+                results[index] = IdentifyOne(model, clips[index], createAudio);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min(m_concurrency, clips.size()); i++)
+        {
+            workers.emplace_back(work);
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return results;
+    }
+
+private:
+    Identification IdentifyOne(const std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::SpeakerIdentificationModel>& model,
+        const std::string& clip, const AudioConfigFactory& createAudio) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Speaker;
+
+        Identification identification;
+        identification.Clip = clip;
+        try
+        {
+            auto recognizer = SpeakerRecognizer::FromConfig(m_config, createAudio(clip));
+            auto result = recognizer->RecognizeOnceAsync(model).get();
+            if (result->Reason == ResultReason::RecognizedSpeakers)
+            {
+                identification.ProfileId = result->ProfileId;
+                identification.Score = result->GetScore();
+            }
+            else if (result->Reason == ResultReason::Canceled)
+            {
+                const auto details = SpeakerRecognitionCancellationDetails::FromResult(result)->ErrorDetails;
+                identification.Error = details.empty() ? "Identification canceled" : details;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            identification.Error = e.what();
+        }
+        return identification;
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    const size_t m_concurrency;
+};
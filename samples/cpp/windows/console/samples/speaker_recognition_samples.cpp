@@ -10,6 +10,9 @@
 #include <vector>
 #include <speechapi_cxx.h>
 #include "wav_file_reader.h"
+#include "push_stream_pump.h"
+#include "speaker_profile_registry.h"
+#include "speaker_verification_engine.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -225,6 +228,112 @@ void SpeakerIdentificationWithMicrophone()
     }
 }
 
+// Speaker identification of many clips with profiles that are enrolled once and kept in a registry file.
+void SpeakerIdentificationBatchWithProfileRegistry()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a VoiceProfileClient to create voice profiles and train voice profiles.
+    auto client = VoiceProfileClient::FromConfig(config);
+
+    // The speakers are enrolled on the first run only, later runs take their profile ids from "speakers.registry".
+    SpeakerProfileRegistry registry(client, "speakers.registry");
+    auto pullStreamOf = [](const string& fileName)
+    {
+        return AudioConfig::FromStreamInput(AudioInputStream::CreatePullStream(make_shared<AudioInputFromFileCallback>(fileName)));
+    };
+    vector<string> clips;
+    try
+    {
+        for (const auto& speaker : vector<pair<string, string>>{ { "SpeechSdk", "aboutSpeechSdk.wav" }, { "SpeechService", "speechService.wav" } })
+        {
+            auto profile = registry.GetOrEnroll(speaker.first, [&]() { return pullStreamOf(audioDirName + speaker.second); });
+            cout << "Speaker " << speaker.first << " has the profile " << profile->GetId() << endl;
+            clips.push_back(audioDirName + speaker.second);
+        }
+    }
+    catch (const runtime_error& e)
+    {
+        cout << "CANCELED: " << e.what() << endl;
+        cout << "CANCELED: Did you update the subscription info?" << endl;
+        return;
+    }
+    clips.push_back(audioDirName + "wikipediaOcelot.wav");
+
+    // All clips are identified against the same model, four at a time.
+    SpeakerBatchIdentifier identifier(config, 4);
+    for (const auto& identification : identifier.Identify(registry.Model(), clips, pullStreamOf))
+    {
+        if (!identification.Error.empty())
+        {
+            cout << identification.Clip << ": CANCELED: " << identification.Error << endl;
+        }
+        else if (identification.ProfileId.empty())
+        {
+            cout << identification.Clip << ": no speaker identified" << endl;
+        }
+        else
+        {
+            cout << identification.Clip << ": speaker " << registry.NameOf(identification.ProfileId) << " with similarity score " << identification.Score << endl;
+        }
+    }
+}
+
+// Speaker verification of one caller against several candidate profiles at the same time.
+void SpeakerVerificationAgainstCandidateProfiles()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a VoiceProfileClient to create voice profiles and train voice profiles.
+    auto client = VoiceProfileClient::FromConfig(config);
+
+    // Creates and enrolls a text independent verification profile for each candidate.
+    vector<shared_ptr<VoiceProfile>> candidates;
+    for (const auto& fileName : { "aboutSpeechSdk.wav", "speechService.wav" })
+    {
+        auto profile = client->CreateProfileAsync(VoiceProfileType::TextIndependentVerification, "en-us").get();
+        auto pullStream = AudioInputStream::CreatePullStream(make_shared<AudioInputFromFileCallback>(audioDirName + fileName));
+        auto result = client->EnrollProfileAsync(profile, AudioConfig::FromStreamInput(pullStream)).get();
+        if (result->Reason != ResultReason::EnrolledVoiceProfile)
+        {
+            cout << "Cannot enroll the profile " << profile->GetId() << " with " << fileName << endl;
+            cout << "CANCELED: Did you update the subscription info?" << endl;
+            return;
+        }
+        cout << "Enrolled the profile " << profile->GetId() << " with " << fileName << endl;
+        candidates.push_back(profile);
+    }
+
+    // The caller audio is read once and verified against all candidates at the same time.
+    // Policy::FirstAccepted would return as soon as any candidate is accepted.
+    auto caller = CallerAudio::FromWavFile(audioDirName + "speechService.wav");
+    SpeakerVerificationEngine engine(config);
+    auto outcome = engine.Verify(caller, candidates, SpeakerVerificationEngine::Policy::AllResults);
+    for (const auto& verification : outcome.Results)
+    {
+        if (!verification.Error.empty())
+        {
+            cout << "CANCELED " << verification.ProfileId << " ErrorDetails= " << verification.Error << endl;
+        }
+        else
+        {
+            cout << (verification.Accepted ? "Accepted" : "Rejected") << " the profile " << verification.ProfileId << ". The score is " << verification.Score << endl;
+        }
+    }
+    if (outcome.Accepted)
+    {
+        cout << "The caller is verified as " << outcome.BestProfileId << " with the score " << outcome.BestScore << endl;
+    }
+    else
+    {
+        cout << "The caller matches none of the candidates." << endl;
+    }
+}
+
 // helper function for speaker verification.
 void VerifyVoiceProfileFromMicrophone(const shared_ptr<SpeechConfig>& config, const shared_ptr<VoiceProfile>& profile)
 {
@@ -265,17 +374,22 @@ int PushData(const string& filename, shared_ptr<PushAudioInputStream>& pushStrea
     {
         WavFileReader reader(filename);
 
+        // Queues the audio in a ring buffer of 1 second, a pump thread writes it to the push stream in chunks of 100 ms.
+        const auto& format = reader.Format();
+        PushStreamPump pump(pushStream, PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100),
+            PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 1000));
+
         vector<uint8_t> buffer(1000);
         // Read data and push them into the stream
         int readSamples = 0;
         while ((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
         {
-            // Push a buffer into the stream
-            pushStream->Write(buffer.data(), readSamples);
+            // Queue a buffer for the stream
+            pump.Write(buffer.data(), readSamples);
         }
 
-        // Close the push stream.
-        pushStream->Close();
+        // Flush the queued audio and close the push stream.
+        pump.Close();
     }
     catch (const exception& e)
     {
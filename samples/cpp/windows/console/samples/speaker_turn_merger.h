@@ -0,0 +1,188 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// A run of consecutive segments of one speaker, e.g. a paragraph of meeting minutes. Times are in ticks of 100 ns.
+struct SpeakerTurn
+{
+    std::string UserId;
+    uint64_t Offset = 0;
+    uint64_t Duration = 0;
+    std::string Text;
+    // The number of transcribed segments merged into the turn.
+    size_t Segments = 0;
+};
+
+// Merges the transcribed segments of a conversation into speaker turns while the conversation goes on. Segments
+// of different speakers can arrive out of order by offset, e.g. when two people talk at the same time, so they
+// are held in a window until no segment with an earlier offset can still arrive: the window ends the reorder
+// interval before the latest end of audio seen so far. A turn is handed to the handler once a later segment of
+// another speaker has left the window, or the gap to its end is too long for the speaker to continue it.
+//
+// The window is bounded by the reorder interval and a number of segments, and a turn by its length, so memory
+// does not grow with the length of the meeting. A segment that arrives after the window has passed its offset is
+// merged in arrival order and counted by LateSegments(), a larger reorder interval avoids that.
+//
+// The events of one transcriber are raised one at a time, so the merger does not lock.
+class SpeakerTurnMerger final
+{
+public:
+    using TurnHandler = std::function<void(const SpeakerTurn& turn)>;
+
+    struct Options
+    {
+        // How far out of order by offset segments may arrive and still be placed right.
+        uint64_t ReorderTicks = 3 * 10000000ull;
+        // The longest pause between two segments of a speaker that continues the turn.
+        uint64_t MaxGapTicks = 2 * 10000000ull;
+        // The longest turn, a monologue is split into turns of at most this length.
+        uint64_t MaxTurnTicks = 120 * 10000000ull;
+        // The most segments held in the window, older ones are merged early if it is exceeded.
+        size_t MaxPendingSegments = 64;
+    };
+
+    explicit SpeakerTurnMerger(TurnHandler handler)
+        : SpeakerTurnMerger(std::move(handler), Options())
+    {
+    }
+
+    SpeakerTurnMerger(TurnHandler handler, const Options& options)
+        : m_handler(std::move(handler)), m_options(options)
+    {
+        if (!m_handler)
+        {
+            throw std::invalid_argument("Turn handler must be set");
+        }
+        if (options.MaxPendingSegments == 0)
+        {
+            throw std::invalid_argument("The window must hold at least one segment");
+        }
+    }
+
+    // Adds a transcribed segment. Results that are not recognized speech are ignored.
+    void Add(const Microsoft::CognitiveServices::Speech::Transcription::ConversationTranscriptionResult& result)
+    {
+        if (result.Reason == Microsoft::CognitiveServices::Speech::ResultReason::RecognizedSpeech && !result.Text.empty())
+        {
+            Add(result.UserId, result.Offset(), result.Duration(), result.Text);
+        }
+    }
+
+    void Add(const std::string& userId, uint64_t offset, uint64_t duration, const std::string& text)
+    {
+        SpeakerTurn segment;
+        segment.UserId = userId;
+        segment.Offset = offset;
+        segment.Duration = duration;
+        segment.Text = text;
+        segment.Segments = 1;
+
+        if (offset < m_watermark)
+        {
+            // The window has moved past it, segments after it are merged already.
+            m_lateSegments++;
+            Merge(std::move(segment));
+            return;
+        }
+        m_latestEnd = std::max(m_latestEnd, offset + duration);
+        m_pending.emplace(offset, std::move(segment));
+
+        Advance(m_latestEnd > m_options.ReorderTicks ? m_latestEnd - m_options.ReorderTicks : 0);
+        while (m_pending.size() > m_options.MaxPendingSegments)
+        {
+            Advance(m_pending.begin()->first + 1);
+        }
+    }
+
+    // Merges the segments in the window and hands out the last turn, e.g. at the end of the meeting.
+    // The merger can be used for another conversation afterwards.
+    void Flush()
+    {
+        for (auto& pending : m_pending)
+        {
+            Merge(std::move(pending.second));
+        }
+        m_pending.clear();
+        EmitTurn();
+        m_watermark = 0;
+        m_latestEnd = 0;
+    }
+
+    // Returns the number of segments that arrived after the window had passed their offset.
+    uint64_t LateSegments() const
+    {
+        return m_lateSegments;
+    }
+
+private:
+    // Merges the segments that start before 'watermark', no earlier segment is expected any more.
+    void Advance(uint64_t watermark)
+    {
+        if (watermark <= m_watermark)
+        {
+            return;
+        }
+        m_watermark = watermark;
+        while (!m_pending.empty() && m_pending.begin()->first < watermark)
+        {
+            Merge(std::move(m_pending.begin()->second));
+            m_pending.erase(m_pending.begin());
+        }
+        // Segments still to come start at the watermark or later, too late to continue the turn.
+        if (m_hasTurn && End(m_turn) + m_options.MaxGapTicks < watermark)
+        {
+            EmitTurn();
+        }
+    }
+
+    void Merge(SpeakerTurn&& segment)
+    {
+        if (m_hasTurn && segment.UserId == m_turn.UserId && segment.Offset <= End(m_turn) + m_options.MaxGapTicks
+            && std::max(End(m_turn), End(segment)) - m_turn.Offset <= m_options.MaxTurnTicks)
+        {
+            m_turn.Duration = std::max(End(m_turn), End(segment)) - m_turn.Offset;
+            m_turn.Text += ' ';
+            m_turn.Text += segment.Text;
+            m_turn.Segments++;
+            return;
+        }
+        EmitTurn();
+        m_turn = std::move(segment);
+        m_hasTurn = true;
+    }
+
+    void EmitTurn()
+    {
+        if (m_hasTurn)
+        {
+            m_hasTurn = false;
+            m_handler(m_turn);
+        }
+    }
+
+    static uint64_t End(const SpeakerTurn& turn)
+    {
+        return turn.Offset + turn.Duration;
+    }
+
+    const TurnHandler m_handler;
+    const Options m_options;
+    // Segments in the window, by offset.
+    std::multimap<uint64_t, SpeakerTurn> m_pending;
+    uint64_t m_watermark = 0;
+    uint64_t m_latestEnd = 0;
+    SpeakerTurn m_turn;
+    bool m_hasTurn = false;
+    uint64_t m_lateSegments = 0;
+};
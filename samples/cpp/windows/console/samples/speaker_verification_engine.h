@@ -0,0 +1,214 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Audio of a caller, read from a wav file once and shared read-only by all recognizers it is verified with.
+struct CallerAudio
+{
+    WavFileReader::WAVEFORMAT Format;
+    std::shared_ptr<const std::vector<uint8_t>> Data;
+
+    static CallerAudio FromWavFile(const std::string& fileName)
+    {
+        WavFileReader reader(fileName);
+        auto data = std::make_shared<std::vector<uint8_t>>((size_t)(reader.SampleCount() * reader.Format().BlockAlign));
+        size_t size = 0;
+        int count = 0;
+        while (size < data->size() && (count = reader.Read(data->data() + size, (uint32_t)std::min<size_t>(data->size() - size, 1 << 20))) > 0)
+        {
+            size += (size_t)count;
+        }
+        data->resize(size);
+        return CallerAudio{ reader.Format(), data };
+    }
+};
+
+// Verifies the audio of one caller against several candidate profiles at the same time, one speaker recognizer
+// per profile. The audio is read once, and each recognizer pulls it from the shared buffer with its own read
+// position, so no recognizer gets its own copy of the audio.
+class SpeakerVerificationEngine final
+{
+public:
+    enum class Policy
+    {
+        // Returns as soon as one profile is accepted, or when all profiles have been rejected.
+        FirstAccepted,
+        // Waits for the results of all profiles.
+        AllResults
+    };
+
+    struct ProfileVerification
+    {
+        std::string ProfileId;
+        bool Accepted = false;
+        float Score = 0;
+        // Empty unless the verification was canceled.
+        std::string Error;
+    };
+
+    struct Outcome
+    {
+        bool Accepted = false;
+        // The accepted profile with the highest score, empty if no profile was accepted.
+        std::string BestProfileId;
+        float BestScore = 0;
+        // The results that had arrived when Verify() returned, in the order they arrived.
+        std::vector<ProfileVerification> Results;
+    };
+
+    explicit SpeakerVerificationEngine(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config)
+        : m_config(std::move(config))
+    {
+        if (m_config == nullptr)
+        {
+            throw std::invalid_argument("Config is null");
+        }
+    }
+
+    // Waits for verifications that are still running after a FirstAccepted result.
+    ~SpeakerVerificationEngine()
+    {
+        JoinWorkers();
+    }
+
+    SpeakerVerificationEngine(const SpeakerVerificationEngine&) = delete;
+    SpeakerVerificationEngine& operator=(const SpeakerVerificationEngine&) = delete;
+
+    Outcome Verify(const CallerAudio& audio, const std::vector<std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile>>& profiles, Policy policy)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (audio.Data == nullptr || profiles.empty())
+        {
+            throw std::invalid_argument("Audio and at least one profile are required");
+        }
+        JoinWorkers();
+
+        // Outlives this call if it returns on the first accepted profile.
+        auto state = std::make_shared<State>();
+        for (const auto& profile : profiles)
+        {
+            auto format = Audio::AudioStreamFormat::GetWaveFormatPCM(audio.Format.SamplesPerSec, (uint8_t)audio.Format.BitsPerSample, (uint8_t)audio.Format.Channels);
+            auto stream = Audio::AudioInputStream::CreatePullStream(format, std::make_shared<SharedAudioCallback>(audio.Data));
+            auto recognizer = Speaker::SpeakerRecognizer::FromConfig(m_config, Audio::AudioConfig::FromStreamInput(stream));
+            m_workers.emplace_back([state, recognizer, profile]()
+            {
+                auto verification = VerifyOne(*recognizer, profile);
+                {
+                    std::lock_guard<std::mutex> lock(state->Mutex);
+                    state->Results.push_back(std::move(verification));
+                }
+                state->Changed.notify_all();
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(state->Mutex);
+        state->Changed.wait(lock, [&]()
+        {
+            return state->Results.size() == profiles.size()
+                || (policy == Policy::FirstAccepted && std::any_of(state->Results.begin(), state->Results.end(), [](const ProfileVerification& v) { return v.Accepted; }));
+        });
+
+        Outcome outcome;
+        outcome.Results = state->Results;
+        for (const auto& verification : outcome.Results)
+        {
+            if (verification.Accepted && (!outcome.Accepted || verification.Score > outcome.BestScore))
+            {
+                outcome.Accepted = true;
+                outcome.BestProfileId = verification.ProfileId;
+                outcome.BestScore = verification.Score;
+            }
+        }
+        return outcome;
+    }
+
+private:
+    struct State
+    {
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        std::vector<ProfileVerification> Results;
+    };
+
+    // Reads the shared audio from its own position.
+    class SharedAudioCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        explicit SharedAudioCallback(std::shared_ptr<const std::vector<uint8_t>> data)
+            : m_data(std::move(data))
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            const size_t count = std::min<size_t>(size, m_data->size() - m_position);
+            memcpy(dataBuffer, m_data->data() + m_position, count);
+            m_position += count;
+            return (int)count;
+        }
+
+        void Close() override
+        {
+            m_position = m_data->size();
+        }
+
+    private:
+        std::shared_ptr<const std::vector<uint8_t>> m_data;
+        size_t m_position = 0;
+    };
+
+    static ProfileVerification VerifyOne(Microsoft::CognitiveServices::Speech::Speaker::SpeakerRecognizer& recognizer,
+        const std::shared_ptr<Microsoft::CognitiveServices::Speech::Speaker::VoiceProfile>& profile)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        ProfileVerification verification;
+        verification.ProfileId = profile->GetId();
+        try
+        {
+            auto result = recognizer.RecognizeOnceAsync(Speaker::SpeakerVerificationModel::FromProfile(profile)).get();
+            if (result->Reason == ResultReason::RecognizedSpeaker || result->Reason == ResultReason::NoMatch)
+            {
+                verification.Accepted = result->Reason == ResultReason::RecognizedSpeaker;
+                verification.Score = result->GetScore();
+            }
+            else if (result->Reason == ResultReason::Canceled)
+            {
+                const auto details = Speaker::SpeakerRecognitionCancellationDetails::FromResult(result)->ErrorDetails;
+                verification.Error = details.empty() ? "Verification canceled" : details;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            verification.Error = e.what();
+        }
+        return verification;
+    }
+
+    void JoinWorkers()
+    {
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_workers.clear();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    std::vector<std::thread> m_workers;
+};
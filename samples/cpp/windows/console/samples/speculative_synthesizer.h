@@ -0,0 +1,314 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "synthesis_cache.h"
+
+// Synthesizes the prompts a dialog is likely to play next before it plays them, e.g. the two or three branches
+// of an IVR menu while the caller answers, so that the chosen one plays without waiting for the service.
+//
+// Predict() names the likely prompts, most likely first. A background thread synthesizes them one at a time
+// through the SynthesisCache, while the scheduler is resumed, i.e. during idle time such as while the caller
+// speaks. Synthesized predictions are held until they are played or replaced, within a byte budget: the least
+// likely ones are released first when it is exceeded, and no new prediction is started while it is full.
+// SpeakText() plays a prompt, from a prediction if there is one, and releases the predictions it did not use.
+// Queued predictions are canceled, one in flight completes and its audio stays in the cache.
+class SpeculativeSynthesizer final
+{
+public:
+    struct Options
+    {
+        // The most audio held for predictions that have not been played.
+        size_t MaxReadyBytes = 8 * 1024 * 1024;
+        // The most prompts predicted at once, further ones are ignored.
+        size_t MaxPredictions = 3;
+    };
+
+    struct Statistics
+    {
+        // Prompts played from a prediction, and prompts that had not been predicted or were not ready.
+        uint64_t Hits = 0;
+        uint64_t Misses = 0;
+        // Predictions synthesized, and those released without being played, with their audio.
+        uint64_t Speculated = 0;
+        uint64_t Wasted = 0;
+        uint64_t WastedBytes = 0;
+        // Predictions released before they were started.
+        uint64_t Canceled = 0;
+    };
+
+    explicit SpeculativeSynthesizer(SynthesisCache& cache)
+        : SpeculativeSynthesizer(cache, Options())
+    {
+    }
+
+    // Starts paused, call Resume() when the synthesizer would otherwise be idle.
+    SpeculativeSynthesizer(SynthesisCache& cache, const Options& options)
+        : m_cache(cache), m_options(options)
+    {
+        if (options.MaxPredictions == 0)
+        {
+            throw std::invalid_argument("At least one prompt must be predicted");
+        }
+        m_thread = std::thread(&SpeculativeSynthesizer::Run, this);
+    }
+
+    ~SpeculativeSynthesizer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closing = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+    }
+
+    SpeculativeSynthesizer(const SpeculativeSynthesizer&) = delete;
+    SpeculativeSynthesizer& operator=(const SpeculativeSynthesizer&) = delete;
+
+    // Replaces the predicted prompts, most likely first. Prompts that were predicted before keep their audio.
+    void Predict(const std::vector<std::string>& prompts)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<Prediction> predictions;
+            for (size_t i = 0; i < prompts.size() && predictions.size() < m_options.MaxPredictions; i++)
+            {
+                auto it = Find(prompts[i]);
+                if (it != m_predictions.end())
+                {
+                    predictions.push_back(std::move(*it));
+                    m_predictions.erase(it);
+                }
+                else if (std::none_of(predictions.begin(), predictions.end(), [&prompts, i](const Prediction& p) { return p.Text == prompts[i]; }))
+                {
+                    predictions.push_back(Prediction{ prompts[i], State::Queued, nullptr });
+                }
+            }
+            ReleaseAll();
+            m_predictions = std::move(predictions);
+        }
+        m_changed.notify_all();
+    }
+
+    // Lets the background thread synthesize predictions, e.g. while the caller speaks.
+    void Resume()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_paused = false;
+        }
+        m_changed.notify_all();
+    }
+
+    // Stops starting predictions, e.g. while a prompt plays. A prediction in flight completes.
+    void Pause()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paused = true;
+    }
+
+    // Returns the audio of the prompt, from its prediction if it was predicted, and releases all other predictions.
+    // Throws std::runtime_error if the prompt has to be synthesized and synthesis fails.
+    std::shared_ptr<CachedAudioStream> SpeakText(const std::string& text)
+    {
+        std::shared_ptr<CachedAudioStream> audio;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto it = Find(text);
+            const State status = it != m_predictions.end() ? it->Status : State::Queued;
+            if (status == State::Ready)
+            {
+                audio = std::move(it->Audio);
+                m_readyBytes -= audio->GetAudioData().size();
+            }
+            else if (status == State::InFlight)
+            {
+                // Waits for the synthesis in flight instead of starting the same one again.
+                m_claimed = text;
+                m_claimPending = true;
+            }
+            if (it != m_predictions.end() && status != State::Queued)
+            {
+                m_predictions.erase(it);
+            }
+            ReleaseAll();
+            m_changed.notify_all();
+
+            if (status == State::InFlight)
+            {
+                m_changed.wait(lock, [this]() { return !m_claimPending; });
+                audio = std::move(m_claimedAudio);
+            }
+            // Only counted as a hit if the prediction has audio, a failed one is synthesized again below.
+            if (audio != nullptr)
+            {
+                m_statistics.Hits++;
+            }
+            else
+            {
+                m_statistics.Misses++;
+            }
+        }
+        return audio != nullptr ? audio : m_cache.SpeakText(text);
+    }
+
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    enum class State
+    {
+        Queued,
+        InFlight,
+        Ready
+    };
+
+    struct Prediction
+    {
+        std::string Text;
+        State Status;
+        std::shared_ptr<CachedAudioStream> Audio;
+    };
+
+    // Called with the lock held.
+    std::vector<Prediction>::iterator Find(const std::string& text)
+    {
+        return std::find_if(m_predictions.begin(), m_predictions.end(), [&text](const Prediction& p) { return p.Text == text; });
+    }
+
+    // Releases the predictions, called with the lock held.
+    void ReleaseAll()
+    {
+        for (auto& prediction : m_predictions)
+        {
+            Release(prediction);
+        }
+        m_predictions.clear();
+    }
+
+    void Release(Prediction& prediction)
+    {
+        if (prediction.Status == State::Queued)
+        {
+            m_statistics.Canceled++;
+        }
+        else if (prediction.Status == State::Ready)
+        {
+            const size_t size = prediction.Audio->GetAudioData().size();
+            m_readyBytes -= size;
+            m_statistics.Wasted++;
+            m_statistics.WastedBytes += size;
+            prediction.Audio = nullptr;
+        }
+        // A prediction in flight is counted as wasted when it completes and is no longer predicted.
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            std::vector<Prediction>::iterator next;
+            m_changed.wait(lock, [this, &next]()
+            {
+                if (m_closing)
+                {
+                    return true;
+                }
+                next = std::find_if(m_predictions.begin(), m_predictions.end(), [](const Prediction& p) { return p.Status == State::Queued; });
+                return !m_paused && next != m_predictions.end() && m_readyBytes < m_options.MaxReadyBytes;
+            });
+            if (m_closing)
+            {
+                return;
+            }
+            next->Status = State::InFlight;
+            const std::string text = next->Text;
+            lock.unlock();
+
+            std::shared_ptr<CachedAudioStream> audio;
+            try
+            {
+                audio = m_cache.SpeakText(text);
+            }
+            catch (const std::exception&)
+            {
+                // The prompt is synthesized again if it is played, the error is reported then.
+            }
+
+            lock.lock();
+            if (m_claimPending && text == m_claimed)
+            {
+                // Handed to SpeakText(), which waits for this synthesis, whether it succeeded or failed.
+                m_claimPending = false;
+                m_claimed.clear();
+                if (audio != nullptr)
+                {
+                    m_statistics.Speculated++;
+                }
+                m_claimedAudio = std::move(audio);
+                m_changed.notify_all();
+                continue;
+            }
+            auto it = Find(text);
+            if (it == m_predictions.end() || audio == nullptr)
+            {
+                if (audio != nullptr)
+                {
+                    m_statistics.Wasted++;
+                    m_statistics.WastedBytes += audio->GetAudioData().size();
+                }
+                else if (it != m_predictions.end())
+                {
+                    m_predictions.erase(it);
+                }
+                continue;
+            }
+            m_statistics.Speculated++;
+            it->Status = State::Ready;
+            it->Audio = std::move(audio);
+            m_readyBytes += it->Audio->GetAudioData().size();
+            // Keeps the most likely predictions within the budget.
+            for (size_t i = m_predictions.size(); i > 0 && m_readyBytes > m_options.MaxReadyBytes; i--)
+            {
+                if (m_predictions[i - 1].Status == State::Ready)
+                {
+                    Release(m_predictions[i - 1]);
+                    m_predictions.erase(m_predictions.begin() + (i - 1));
+                }
+            }
+        }
+    }
+
+    SynthesisCache& m_cache;
+    const Options m_options;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // Most likely first.
+    std::vector<Prediction> m_predictions;
+    // A prediction in flight that SpeakText() waits for, and its audio once it completes, null if it failed.
+    std::string m_claimed;
+    bool m_claimPending = false;
+    std::shared_ptr<CachedAudioStream> m_claimedAudio;
+    size_t m_readyBytes = 0;
+    bool m_paused = true;
+    bool m_closing = false;
+    Statistics m_statistics;
+    std::thread m_thread;
+};
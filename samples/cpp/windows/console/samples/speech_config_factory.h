@@ -0,0 +1,410 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <winhttp.h>
+#pragma comment(lib, "winhttp.lib")
+#endif
+
+// Exchanges a subscription key for an authorization token at the token endpoint of the region,
+// https://<region>.api.cognitive.microsoft.com/sts/v1.0/issueToken. The token is valid for 10 minutes.
+class IssueTokenClient final
+{
+public:
+    // True if the client is implemented on this platform, it uses WinHTTP on Windows. Elsewhere pass your own
+    // token fetcher to SpeechConfigFactory, e.g. one built on libcurl.
+    static bool IsAvailable()
+    {
+#ifdef _WIN32
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Returns a new token. Throws std::runtime_error if the request fails.
+    static std::string Fetch(const std::string& region, const std::string& subscriptionKey)
+    {
+#ifdef _WIN32
+        using Handle = std::unique_ptr<void, decltype(&WinHttpCloseHandle)>;
+        // The region and the key are ASCII.
+        const std::wstring host(region.begin(), region.end());
+        const std::wstring key(subscriptionKey.begin(), subscriptionKey.end());
+
+        Handle session(WinHttpOpen(L"SpeechSDKSamples/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0), &WinHttpCloseHandle);
+        Handle connection(session ? WinHttpConnect(session.get(), (host + L".api.cognitive.microsoft.com").c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0) : nullptr, &WinHttpCloseHandle);
+        Handle request(connection ? WinHttpOpenRequest(connection.get(), L"POST", L"/sts/v1.0/issueToken", nullptr, WINHTTP_NO_REFERER,
+            WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE) : nullptr, &WinHttpCloseHandle);
+        if (!request)
+        {
+            throw std::runtime_error("Cannot create the token request, error " + std::to_string(GetLastError()));
+        }
+
+        const std::wstring headers = L"Ocp-Apim-Subscription-Key: " + key + L"\r\n";
+        if (!WinHttpSendRequest(request.get(), headers.c_str(), (DWORD)-1L, WINHTTP_NO_REQUEST_DATA, 0, 0, 0)
+            || !WinHttpReceiveResponse(request.get(), nullptr))
+        {
+            throw std::runtime_error("Token request failed, error " + std::to_string(GetLastError()));
+        }
+
+        DWORD status = 0;
+        DWORD statusSize = sizeof(status);
+        WinHttpQueryHeaders(request.get(), WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+            &status, &statusSize, WINHTTP_NO_HEADER_INDEX);
+        if (status != 200)
+        {
+            throw std::runtime_error("Token request returned http code " + std::to_string(status));
+        }
+
+        std::string token;
+        DWORD available = 0;
+        while (WinHttpQueryDataAvailable(request.get(), &available) && available > 0)
+        {
+            const size_t start = token.size();
+            token.resize(start + available);
+            DWORD read = 0;
+            if (!WinHttpReadData(request.get(), &token[start], available, &read))
+            {
+                throw std::runtime_error("Cannot read the token, error " + std::to_string(GetLastError()));
+            }
+            token.resize(start + read);
+        }
+        return token;
+#else
+        (void)region;
+        (void)subscriptionKey;
+        throw std::runtime_error("IssueTokenClient is not available on this platform");
+#endif
+    }
+};
+
+// Builds speech configs once per region, recognition language and custom endpoint, and hands out the same config
+// to every caller. Recognizers copy the settings of the config they are created from, so the shared config is a
+// cheap clone: creating a session takes no property parsing and no credential setup. Callers must not change a
+// config they get from the factory, but call Get() with the settings they need.
+//
+// With a token fetcher, configs carry an authorization token instead of the subscription key. Tokens are fetched
+// once per region and refreshed by a background thread before they expire, so no session waits for the token
+// endpoint after the first one of a region. Configs handed out earlier keep the token they were built with, which
+// is enough to start a session. Recognizers that run longer than a token should be passed to KeepAuthorized().
+class SpeechConfigFactory final
+{
+public:
+    // Returns a new authorization token for the region, throws if it cannot be fetched.
+    using TokenFetcher = std::function<std::string(const std::string& region)>;
+
+    struct Options
+    {
+        // How long a token is valid after it was fetched.
+        std::chrono::seconds TokenLifetime = std::chrono::minutes(10);
+        // A token is refreshed this long before it expires.
+        std::chrono::seconds RefreshMargin = std::chrono::minutes(1);
+        // The delay before a failed refresh is retried, while the old token is still valid.
+        std::chrono::seconds RetryDelay = std::chrono::seconds(5);
+    };
+
+    // Configs that carry the subscription key.
+    explicit SpeechConfigFactory(const std::string& subscriptionKey)
+        : m_subscriptionKey(subscriptionKey)
+    {
+        if (subscriptionKey.empty())
+        {
+            throw std::invalid_argument("Subscription key must be set");
+        }
+    }
+
+    // Configs that carry authorization tokens from 'fetchToken'.
+    explicit SpeechConfigFactory(TokenFetcher fetchToken)
+        : SpeechConfigFactory(std::move(fetchToken), Options())
+    {
+    }
+
+    SpeechConfigFactory(TokenFetcher fetchToken, const Options& options)
+        : m_fetchToken(std::move(fetchToken)), m_options(options)
+    {
+        if (!m_fetchToken)
+        {
+            throw std::invalid_argument("Token fetcher must be set");
+        }
+        if (options.RefreshMargin >= options.TokenLifetime)
+        {
+            throw std::invalid_argument("Refresh margin must be shorter than the token lifetime");
+        }
+        m_thread = std::thread(&SpeechConfigFactory::Refresh, this);
+    }
+
+    // Configs that carry tokens issued for a subscription key, fetched with IssueTokenClient.
+    static std::unique_ptr<SpeechConfigFactory> WithIssuedTokens(const std::string& subscriptionKey)
+    {
+        return std::unique_ptr<SpeechConfigFactory>(new SpeechConfigFactory([subscriptionKey](const std::string& region)
+        {
+            return IssueTokenClient::Fetch(region, subscriptionKey);
+        }));
+    }
+
+    ~SpeechConfigFactory()
+    {
+        if (m_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_changed.notify_all();
+            m_thread.join();
+        }
+    }
+
+    SpeechConfigFactory(const SpeechConfigFactory&) = delete;
+    SpeechConfigFactory& operator=(const SpeechConfigFactory&) = delete;
+
+    // Returns the config for a region, and optionally a recognition language and the endpoint id of a custom model.
+    // The first config of a region with tokens waits for the token, all others are returned from the cache.
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> Get(const std::string& region,
+        const std::string& language = "", const std::string& endpointId = "")
+    {
+        const Key key(region, language, endpointId);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = m_configs.find(key);
+        if (it != m_configs.end())
+        {
+            return it->second;
+        }
+        std::string token;
+        if (m_fetchToken)
+        {
+            lock.unlock();
+            token = Token(region);
+            lock.lock();
+        }
+        auto config = Build(key, token);
+        // Another caller may have built it meanwhile, the first one is kept.
+        return m_configs.emplace(key, config).first->second;
+    }
+
+    // Returns the current token of a region, e.g. for the Authorization header of REST requests. Waits for the token
+    // if it has not been fetched yet, throws if the factory has no token fetcher or the token cannot be fetched.
+    std::string Token(const std::string& region)
+    {
+        if (!m_fetchToken)
+        {
+            throw std::logic_error("The factory uses a subscription key, not tokens");
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto& entry = m_regions[region];
+        if (!entry.Token.empty())
+        {
+            return entry.Token;
+        }
+        // Only one caller fetches the first token of a region, the others wait for it.
+        m_changed.wait(lock, [&entry]() { return !entry.Fetching; });
+        if (!entry.Token.empty())
+        {
+            return entry.Token;
+        }
+        entry.Fetching = true;
+        lock.unlock();
+        std::string token;
+        try
+        {
+            token = m_fetchToken(region);
+        }
+        catch (...)
+        {
+            lock.lock();
+            entry.Fetching = false;
+            m_changed.notify_all();
+            throw;
+        }
+        lock.lock();
+        entry.Fetching = false;
+        SetToken(region, token);
+        m_changed.notify_all();
+        return token;
+    }
+
+    // Passes each new token of the region to a running recognizer, synthesizer or other object with
+    // SetAuthorizationToken(), until the object is destroyed. Does nothing for a factory with a subscription key.
+    template <class Authorized>
+    void KeepAuthorized(const std::shared_ptr<Authorized>& authorized, const std::string& region)
+    {
+        if (!m_fetchToken)
+        {
+            return;
+        }
+        std::weak_ptr<Authorized> weak = authorized;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_regions[region].Listeners.push_back([weak](const std::string& token)
+        {
+            auto object = weak.lock();
+            if (object == nullptr)
+            {
+                return false;
+            }
+            object->SetAuthorizationToken(token);
+            return true;
+        });
+    }
+
+    // Returns the number of tokens fetched, and of fetches that failed and were retried.
+    uint64_t TokenFetches() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_fetches;
+    }
+
+    uint64_t TokenFailures() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failures;
+    }
+
+private:
+    using Key = std::tuple<std::string, std::string, std::string>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Region
+    {
+        std::string Token;
+        Clock::time_point RefreshAt;
+        bool Fetching = false;
+        // Return false once their object is gone.
+        std::vector<std::function<bool(const std::string& token)>> Listeners;
+    };
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> Build(const Key& key, const std::string& token) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto config = m_fetchToken ? SpeechConfig::FromAuthorizationToken(token, std::get<0>(key)) : SpeechConfig::FromSubscription(m_subscriptionKey, std::get<0>(key));
+        if (!std::get<1>(key).empty())
+        {
+            config->SetSpeechRecognitionLanguage(std::get<1>(key));
+        }
+        if (!std::get<2>(key).empty())
+        {
+            config->SetEndpointId(std::get<2>(key));
+        }
+        return config;
+    }
+
+    // Stores a new token of a region, and rebuilds the configs of the region with it. Called with the lock held.
+    void SetToken(const std::string& region, const std::string& token)
+    {
+        auto& entry = m_regions[region];
+        entry.Token = token;
+        entry.RefreshAt = Clock::now() + m_options.TokenLifetime - m_options.RefreshMargin;
+        m_fetches++;
+        for (auto& config : m_configs)
+        {
+            if (std::get<0>(config.first) == region)
+            {
+                config.second = Build(config.first, token);
+            }
+        }
+    }
+
+    // Refreshes the token of each region when it is due, off the path of the sessions that use it.
+    void Refresh()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            auto next = Clock::time_point::max();
+            std::string due;
+            for (const auto& region : m_regions)
+            {
+                if (!region.second.Token.empty() && !region.second.Fetching && region.second.RefreshAt < next)
+                {
+                    next = region.second.RefreshAt;
+                    due = region.first;
+                }
+            }
+            if (due.empty() || next > Clock::now())
+            {
+                // Woken early when a region gets its first token, or when the factory is destroyed.
+                if (due.empty())
+                {
+                    m_changed.wait(lock);
+                }
+                else
+                {
+                    m_changed.wait_until(lock, next);
+                }
+                continue;
+            }
+
+            auto& entry = m_regions[due];
+            entry.Fetching = true;
+            lock.unlock();
+            std::string token;
+            try
+            {
+                token = m_fetchToken(due);
+            }
+            catch (const std::exception&)
+            {
+                token.clear();
+            }
+            lock.lock();
+            entry.Fetching = false;
+            if (token.empty())
+            {
+                m_failures++;
+                entry.RefreshAt = Clock::now() + m_options.RetryDelay;
+                continue;
+            }
+            SetToken(due, token);
+            std::vector<std::function<bool(const std::string&)>> listeners;
+            listeners.swap(entry.Listeners);
+            // Tokens are set on the objects outside of the lock, KeepAuthorized() may be called meanwhile.
+            lock.unlock();
+            std::vector<std::function<bool(const std::string&)>> alive;
+            for (auto& listener : listeners)
+            {
+                if (listener(token))
+                {
+                    alive.push_back(std::move(listener));
+                }
+            }
+            lock.lock();
+            auto& refreshed = m_regions[due].Listeners;
+            refreshed.insert(refreshed.end(), alive.begin(), alive.end());
+            m_changed.notify_all();
+        }
+    }
+
+    const std::string m_subscriptionKey;
+    const TokenFetcher m_fetchToken;
+    const Options m_options;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::map<Key, std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig>> m_configs;
+    // std::map keeps entries in place, the refresh thread holds a reference to one while it fetches.
+    std::map<std::string, Region> m_regions;
+    uint64_t m_fetches = 0;
+    uint64_t m_failures = 0;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
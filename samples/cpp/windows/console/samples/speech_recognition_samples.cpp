@@ -8,7 +8,37 @@
 // <toplevel>
 #include <speechapi_cxx.h>
 #include <fstream>
+#include <mutex>
+#include <sstream>
 #include "wav_file_reader.h"
+#include "paced_wav_file_reader.h"
+#include "segmented_transcriber.h"
+#include "push_stream_pump.h"
+#include "silence_filter.h"
+#include "pcm_converter.h"
+#include "recognizer_pool.h"
+#include "recognizer_metrics.h"
+#include "result_sink.h"
+#include "push_stream_multiplexer.h"
+#include "partial_result_debouncer.h"
+#include "session_completion.h"
+#include "keyword_gated_recognizer.h"
+#include "phrase_list_bundle.h"
+#include "pronunciation_batch_scorer.h"
+#include "command_session.h"
+#include "resilient_recognizer.h"
+#include "audio_archive_writer.h"
+#include "opus_push_stream.h"
+#include "transcript_store.h"
+#include "speech_config_factory.h"
+#include "trace_recorder.h"
+#include "low_latency_capture.h"
+#include "blob_pull_stream.h"
+#include "utterance_audio_cache.h"
+#include "long_session_transcript.h"
+#include "process_memory.h"
+#include "region_router.h"
+#include "session_recording.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -60,6 +90,62 @@ void SpeechRecognitionWithMicrophone()
 }
 
 
+// Speech recognition using microphone input captured with small device buffers, for a low latency on kiosks.
+void SpeechRecognitionWithLowLatencyMicrophone()
+{
+    if (!LowLatencyCapture::IsAvailable())
+    {
+        cout << "This build has no low-latency capture, on Linux build the samples with `make ALSA=1` (see low_latency_capture.h)." << std::endl;
+        return;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Periods of 10 ms in a device buffer of 3 periods, most microphones support 16 kHz mono directly.
+    LowLatencyCapture::Options options;
+    options.PeriodMilliseconds = 10;
+    options.Periods = 3;
+    LowLatencyCapture capture(options);
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(capture.Stream()));
+
+    try
+    {
+        capture.Start();
+    }
+    catch (const exception& e)
+    {
+        cout << "Cannot capture from the microphone: " << e.what() << std::endl;
+        return;
+    }
+    cout << "Capturing in periods of " << capture.PeriodFrames() << " frames" << (capture.IsExclusive() ? ", exclusive mode" : "") << "." << std::endl;
+    cout << "Say something...\n";
+
+    auto result = recognizer->RecognizeOnceAsync().get();
+    capture.Close();
+
+    if (result->Reason == ResultReason::RecognizedSpeech)
+    {
+        cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+    }
+    else if (result->Reason == ResultReason::NoMatch)
+    {
+        cout << "NOMATCH: Speech could not be recognized." << std::endl;
+    }
+    else if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = CancellationDetails::FromResult(result);
+        cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+
+    auto latency = capture.CaptureToSendLatency();
+    cout << "Capture to send latency in ms: ";
+    latency.WriteJson(cout);
+    cout << ", overruns: " << capture.Xruns() << std::endl;
+}
+
 // Speech recognition in the specified language, using microphone, and requesting detailed output format.
 void SpeechRecognitionWithLanguageAndUsingDetailedOutputFormat()
 {
@@ -121,8 +207,8 @@ void SpeechContinuousRecognitionWithFile()
     auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
     auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Recognizing.Connect([] (const SpeechRecognitionEventArgs& e)
@@ -154,21 +240,21 @@ void SpeechContinuousRecognitionWithFile()
                  << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
                  << "CANCELED: Did you update the subscription info?" << std::endl;
 
-            recognitionEnd.set_value(); // Notify to stop recognition.
+            recognitionEnd.Complete(); // Notify to stop recognition.
         }
     });
 
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
         cout << "Session stopped.";
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
@@ -272,8 +358,8 @@ void SpeechContinuousRecognitionWithPullStream()
     auto audioInput = AudioConfig::FromStreamInput(pullStream);
     auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Recognizing.Connect([](const SpeechRecognitionEventArgs& e)
@@ -306,7 +392,7 @@ void SpeechContinuousRecognitionWithPullStream()
         case CancellationReason::Error:
             cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
             cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
-            recognitionEnd.set_value();
+            recognitionEnd.Complete();
             break;
 
         default:
@@ -317,14 +403,14 @@ void SpeechContinuousRecognitionWithPullStream()
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
         cout << "Session stopped.";
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().wait();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().wait();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().wait();
@@ -343,8 +429,8 @@ void SpeechContinuousRecognitionWithPushStream()
     auto audioInput = AudioConfig::FromStreamInput(pushStream);
     auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Recognizing.Connect([](const SpeechRecognitionEventArgs& e)
@@ -377,7 +463,7 @@ void SpeechContinuousRecognitionWithPushStream()
         case CancellationReason::Error:
             cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
             cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
-            recognitionEnd.set_value();
+            recognitionEnd.Complete();
             break;
 
         default:
@@ -389,7 +475,7 @@ void SpeechContinuousRecognitionWithPushStream()
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
         cout << "Session stopped.";
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     WavFileReader reader("whatstheweatherlike.wav");
@@ -411,47 +497,49 @@ void SpeechContinuousRecognitionWithPushStream()
     pushStream->Close();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
 }
 
-// Keyword-triggered speech recognition using microphone.
-void KeywordTriggeredSpeechRecognitionWithMicrophone()
+// Speech continuous recognition using push stream input, with long silences shortened before the audio is pushed.
+void SpeechContinuousRecognitionWithPushStreamAndSilenceFilter()
 {
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-    // Creates a speech recognizer using microphone as audio input. The default language is "en-us".
-    auto recognizer = SpeechRecognizer::FromConfig(config);
+    // Creates a push stream
+    auto pushStream = AudioInputStream::CreatePushStream();
 
-    // Promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Creates a speech recognizer from stream input;
+    auto audioInput = AudioConfig::FromStreamInput(pushStream);
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    WavFileReader reader("whatstheweatherlike.wav");
+
+    // Shortens long silences before the audio is pushed, which saves bandwidth and billed audio time.
+    // Result offsets refer to the filtered audio, the filter translates them back to offsets in the file.
+    const auto& format = reader.Format();
+    SilenceFilter silenceFilter(format);
+
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
-    recognizer->Recognizing.Connect([] (const SpeechRecognitionEventArgs& e)
+    recognizer->Recognizing.Connect([](const SpeechRecognitionEventArgs& e)
     {
-        if (e.Result->Reason == ResultReason::RecognizingSpeech)
-        {
-            cout << "RECOGNIZING: Text=" << e.Result->Text << std::endl;
-        }
-        else if (e.Result->Reason == ResultReason::RecognizingKeyword)
-        {
-            cout << "RECOGNIZING KEYWORD: Text=" << e.Result->Text << std::endl;
-        }
+        cout << "Recognizing:" << e.Result->Text << std::endl;
     });
 
-    recognizer->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
+    recognizer->Recognized.Connect([&silenceFilter](const SpeechRecognitionEventArgs& e)
     {
-        if (e.Result->Reason == ResultReason::RecognizedKeyword)
-        {
-            cout << "RECOGNIZED KEYWORD: Text=" << e.Result->Text << std::endl;
-        }
-        else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
         {
-            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl
+                << "  Offset=" << silenceFilter.ToOriginalTicks(e.Result->Offset()) << std::endl
+                << "  Duration=" << e.Result->Duration() << std::endl;
         }
         else if (e.Result->Reason == ResultReason::NoMatch)
         {
@@ -461,199 +549,1409 @@ void KeywordTriggeredSpeechRecognitionWithMicrophone()
 
     recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
     {
-        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
-
-        if (e.Reason == CancellationReason::Error)
+        switch (e.Reason)
         {
-            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
-                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
-                 << "CANCELED: Did you update the subscription info?" << std::endl;
+        case CancellationReason::EndOfStream:
+            cout << "CANCELED: Reach the end of the file." << std::endl;
+            break;
+
+        case CancellationReason::Error:
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            recognitionEnd.Complete();
+            break;
+
+        default:
+            cout << "CANCELED: received unknown reason." << std::endl;
         }
-    });
 
-    recognizer->SessionStarted.Connect([&recognitionEnd](const SessionEventArgs& e)
-    {
-        cout << "SESSIONSTARTED: SessionId=" << e.SessionId << std::endl;
     });
 
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
-        cout << "SESSIONSTOPPED: SessionId=" << e.SessionId << std::endl;
-
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        cout << "Session stopped.";
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
-    // Creates an instance of a keyword recognition model. Update this to
-    // point to the location of your keyword recognition model.
-    auto model = KeywordRecognitionModel::FromFile("YourKeywordRecognitionModelFile.table");
+    // Queues the audio in a ring buffer of 1 second, a pump thread writes it to the push stream in chunks of 100 ms.
+    PushStreamPump pump(pushStream, PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100),
+        PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 1000));
 
-    // The phrase your keyword recognition model triggers on.
-    auto keyword = "YourKeyword";
+    vector<uint8_t> buffer(1000);
+    vector<uint8_t> filtered;
 
-    // Starts continuous recognition. Use StopContinuousRecognitionAsync() to stop recognition.
-    recognizer->StartKeywordRecognitionAsync(model).get();
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().wait();
 
-    cout << "Say something starting with '" << keyword
-         << "' followed by whatever you want..." << std::endl;
+    // Read data and push them into the stream
+    int readSamples = 0;
+    while((readSamples = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    {
+        // Queue the audio that is kept by the filter for the stream
+        filtered.clear();
+        silenceFilter.Process(buffer.data(), readSamples, filtered);
+        pump.Write(filtered.data(), filtered.size());
+    }
+    filtered.clear();
+    silenceFilter.Flush(filtered);
+    pump.Write(filtered.data(), filtered.size());
 
-    // Waits for a single successful keyword-triggered speech recognition (or error).
-    recognitionEnd.get_future().get();
+    // Flush the queued audio and close the push stream.
+    pump.Close();
+    cout << "Push stream buffer high-water mark: " << pump.HighWaterMark() << " of " << pump.Capacity() << " bytes." << std::endl;
+    cout << "Silence not sent to the service: " << silenceFilter.DroppedTicks() / 10000 << " ms." << std::endl;
+
+    // Waits for recognition end.
+    recognitionEnd.Wait();
 
     // Stops recognition.
-    recognizer->StopKeywordRecognitionAsync().get();
+    recognizer->StopContinuousRecognitionAsync().get();
 }
 
-// Speech recognition with auto detection for source language
-void SpeechRecognitionWithSourceLanguageAutoDetection()
+// Speech continuous recognition using pull stream input, which starts a new session where the last one left off
+// if the service cancels it with an error.
+void SpeechContinuousRecognitionWithPullStreamAndReconnect()
 {
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
-    auto speechConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
-
-     // Currently this feature only supports 2 different language candidates
-     // Replace the languages with your languages in BCP-47 format, e.g. fr-FR.
-     // Please see https://docs.microsoft.com/azure/cognitive-services/speech-service/language-support for all supported languages
-     auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "de-DE" });
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-     // The recognizer uses microphone,  to use file or stream as audio input, just construct the audioInput and pass to FromConfig API as the 3rd parameter.
-     // Ex: auto recognizer = SpeechRecognizer::FromConfig(speechConfig, autoDetectSourceLanguageConfig, audioInput);
-     auto recognizer = SpeechRecognizer::FromConfig(speechConfig, autoDetectSourceLanguageConfig);
-     cout << "Say something in either English or German...\n";
+    // Replace with your own audio file name, or read e.g. a network stream instead.
+    WavFileReader reader("katiesteve.wav");
+    ResilientRecognizer recognizer(config, reader.Format());
 
-    // Starts speech recognition, and returns after a single utterance is recognized. The end of a
-    // single utterance is determined by listening for silence at the end or until a maximum of 15
-    // seconds of audio is processed.  The task returns the recognition text as result.
-    // Note: Since RecognizeOnceAsync() returns only a single utterance, it is suitable only for single
-    // shot recognition like command or query.
-    // For long-running multi-utterance recognition, use StartContinuousRecognitionAsync() instead.
-    auto result = recognizer->RecognizeOnceAsync().get();
+    cout << "Recognizing, sessions that are canceled are resumed from the end of the last recognized phrase...\n";
+    auto outcome = recognizer.Recognize(
+        [&reader](uint8_t* dataBuffer, uint32_t size) { return reader.Read(dataBuffer, size); },
+        [](const ResilientRecognizer::Phrase& phrase)
+        {
+            // Offsets are from the start of the file, whichever session recognized the phrase.
+            cout << "RECOGNIZED: Text=" << phrase.Text << " Offset=" << phrase.Offset << " Duration=" << phrase.Duration << std::endl;
+        });
 
-    // Checks result.
-    auto autoDetectSourceLanguageResult = AutoDetectSourceLanguageResult::FromResult(result);
-    auto language = autoDetectSourceLanguageResult->Language;
-    if (result->Reason == ResultReason::RecognizedSpeech)
+    cout << "Recognition ended after " << outcome.Reconnects << " reconnects." << std::endl;
+    if (outcome.LostBytes > 0)
     {
-        cout << "RECOGNIZED: Text=" << result->Text << std::endl;
-        cout << "RECOGNIZED: Language=" << language << std::endl;
+        cout << outcome.LostBytes << " bytes of audio were dropped from the replay buffer before they were recognized." << std::endl;
     }
-    else if (result->Reason == ResultReason::NoMatch)
+    if (!outcome.Error.empty())
     {
-        if (language.empty())
+        cout << "CANCELED: ErrorDetails=" << outcome.Error << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+}
+
+// Speech continuous recognition using pull stream input, with the audio archived to a wav file while it is recognized.
+void SpeechContinuousRecognitionWithPullStreamAndArchive()
+{
+    // Reads the audio of a wav file, in real time to behave like a call.
+    class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        explicit AudioInputFromFileCallback(const string& audioFileName)
+            : m_reader(audioFileName, 1)
         {
-            // serivce cannot detect the source language
-            cout << "NOMATCH: Service cannot detect the source language." << std::endl;
         }
-        else
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
         {
-            // serivce can detect the source language but cannot recongize the speech content
-            cout << "NOMATCH: Service can recognize the speech." << std::endl;
+            return m_reader.Read(dataBuffer, size);
         }
-    }
-    else if (result->Reason == ResultReason::Canceled)
-    {
-        auto cancellation = CancellationDetails::FromResult(result);
-        cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
 
-        if (cancellation->Reason == CancellationReason::Error)
+        void Close() override
         {
-            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
-            cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
-            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            m_reader.Close();
         }
-    }
-}
 
-// Speech recognition with auto detection for source language and using customized model
-void SpeechRecognitionWithSourceLanguageAutoDetectionUsingCustomizedModel()
-{
+    private:
+        PacedWavFileReader m_reader;
+    };
+
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-    std::vector<std::shared_ptr<SourceLanguageConfig>> sourceLanguageConfigs;
-    // Replace the languages with your languages in BCP-47 format, e.g. zh-CN.
-    sourceLanguageConfigs.push_back(SourceLanguageConfig::FromLanguage("en-US"));
-    // Replace the languages with your languages in BCP-47 format, e.g. zh-CN.
-    // Please see https://docs.microsoft.com/azure/cognitive-services/speech-service/language-support for all supported languages
-    // Set the endpoint ID of your customized mode that will be used for fr-FR,  Replace with your own CRIS endpoint ID.
-    sourceLanguageConfigs.push_back(SourceLanguageConfig::FromLanguage("fr-FR", "The Endpoint Id for custom model of fr-FR"));
-    // Construct AutoDetectSourceLanguageConfig with the 2 source language configurations
-    // Currently this feature only supports 2 different language candidates
-    auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromSourceLanguageConfigs(sourceLanguageConfigs);
+    // Replace with your own audio file name.
+    const string audioFileName = "whatstheweatherlike.wav";
+    WavFileReader::WAVEFORMAT format;
+    {
+        WavFileReader reader(audioFileName);
+        format = reader.Format();
+    }
 
-    // Creates a speech recognizer using the auto detect source language config
-    // The recognizer uses microphone,  to use file or stream as audio input, just construct the audioInput and pass to FromConfig API as the 3rd parameter.
-    // Ex: auto recognizer = SpeechRecognizer::FromConfig(speechConfig, autoDetectSourceLanguageConfig, audioInput);
-    auto recognizer = SpeechRecognizer::FromConfig(config, autoDetectSourceLanguageConfig);
-    cout << "Say something in either English or French...\n";
+    // The archive is written by a background thread, reading the call for the recognizer never waits for the disk.
+    // It is declared before the recognizer, so that it is closed after the recognizer has stopped reading.
+    AudioArchiveWriter::Options archiveOptions;
+    archiveOptions.FileEncoding = AudioArchiveWriter::Encoding::MuLaw;
+    AudioArchiveWriter archive("archived_call.wav", format, archiveOptions);
 
-    // Starts speech recognition, and returns after a single utterance is recognized. The end of a
-    // single utterance is determined by listening for silence at the end or until a maximum of 15
-    // seconds of audio is processed.  The task returns the recognition text as result.
-    // Note: Since RecognizeOnceAsync() returns only a single utterance, it is suitable only for single
-    // shot recognition like command or query.
-    // For long-running multi-utterance recognition, use StartContinuousRecognitionAsync() instead.
-    auto result = recognizer->RecognizeOnceAsync().get();
+    auto callback = make_shared<ArchivingPullStreamCallback>(make_shared<AudioInputFromFileCallback>(audioFileName), archive);
+    auto pullStream = AudioInputStream::CreatePullStream(
+        AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), callback);
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
 
-    // Checks result.
-    auto autoDetectSourceLanguageResult = AutoDetectSourceLanguageResult::FromResult(result);
-    auto language = autoDetectSourceLanguageResult->Language;
-    if (result->Reason == ResultReason::RecognizedSpeech)
-    {
-        cout << "RECOGNIZED: Text=" << result->Text << std::endl;
-        cout << "RECOGNIZED: Language=" << language << std::endl;
-    }
-    else if (result->Reason == ResultReason::NoMatch)
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
     {
-        if (language.empty())
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
         {
-            // serivce cannot detect the source language
-            cout << "NOMATCH: Service cannot detect the source language." << std::endl;
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
         }
-        else
+        else if (e.Result->Reason == ResultReason::NoMatch)
         {
-            // serivce can detect the source language but cannot recongize the speech content
-            cout << "NOMATCH: Service can recognize the speech." << std::endl;
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
         }
-    }
-    else if (result->Reason == ResultReason::Canceled)
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    auto outcome = recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+    if (outcome.Canceled)
     {
-        auto cancellation = CancellationDetails::FromResult(result);
-        cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+        cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
 
-        if (cancellation->Reason == CancellationReason::Error)
-        {
-            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
-            cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
-            cout << "CANCELED: Did you update the subscription info?" << std::endl;
-        }
+    // Writes the rest of the audio and the final chunk sizes.
+    archive.Close();
+    cout << "The call was archived to [archived_call.wav]";
+    if (archive.DroppedBytes() > 0)
+    {
+        cout << ", " << archive.DroppedBytes() << " bytes did not fit into the buffer and are missing";
     }
+    cout << "." << std::endl;
 }
 
-// Pronunciation assessment.
-void PronunciationAssessmentWithMicrophone()
+// Speech continuous recognition using push stream input, encoded as Ogg Opus before it is sent to the service.
+void SpeechContinuousRecognitionWithOpusPushStream()
 {
+#ifdef SPEECH_SAMPLES_WITH_OPUS
     // Creates an instance of a speech config with specified subscription key and service region.
     // Replace with your own subscription key and service region (e.g., "westus").
-    // Note: The pronunciation assessment feature is currently only available on en-US language.
     auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
 
-    // The pronunciation assessment service has a longer default end silence timeout (5 seconds) than normal STT
-    // as the pronunciation assessment is widely used in education scenario where kids have longer break in reading.
-    // You can adjust the end silence timeout based on your real scenario.
-    config->SetProperty(PropertyId::SpeechServiceConnection_EndSilenceTimeoutMs, "3000");
+    WavFileReader reader("whatstheweatherlike.wav");
 
-    std::string referenceText = "";
-    // create pronunciation assessment config, set grading system, granularity and if enable miscue based on your requirement.
-    auto pronunciationConfig = PronunciationAssessmentConfig::Create(referenceText,
-        PronunciationAssessmentGradingSystem::HundredMark,
-        PronunciationAssessmentGranularity::Phoneme, true);
+    // Encoders are shared by all streams of the process, and reused when a stream is closed.
+    static OpusEncoderPool encoderPool;
 
-    // Creates a speech recognizer using microphone as audio input.
-    auto recognizer = SpeechRecognizer::FromConfig(config);
+    // 24 kbps instead of the 256 kbps of 16 kHz PCM, at a complexity that leaves CPU for many streams.
+    OpusPushStream::Options options;
+    options.Bitrate = 24000;
+    options.Complexity = 5;
+    OpusPushStream opusStream(encoderPool, reader.Format(), options);
 
-    while (true)
-    {
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(opusStream.Stream()));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    // Encodes the audio as it is pushed, and sends the completed Ogg pages.
+    vector<uint8_t> buffer(3200);
+    int read = 0;
+    while ((read = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    {
+        opusStream.Write(buffer.data(), (size_t)read);
+    }
+    opusStream.Close();
+    cout << "Sent " << opusStream.EncodedBytes() << " bytes of Opus for " << opusStream.PcmBytes()
+        << " bytes of PCM, a compression ratio of " << opusStream.CompressionRatio() << ":1." << std::endl;
+
+    auto outcome = recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+    if (outcome.Canceled)
+    {
+        cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+#else
+    cout << "This sample needs libopus, build the samples with SPEECH_SAMPLES_WITH_OPUS defined (see opus_push_stream.h)." << std::endl;
+#endif
+}
+
+// Speech continuous recognition of a call, stored in a transcript store, and looked up by the time it was said.
+void SpeechContinuousRecognitionWithTranscriptStore()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own audio file name, it is used as the call id.
+    const string callId = "whatstheweatherlike.wav";
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput(callId));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+
+    // Phrases are collected for the whole call, and written as one block of the store.
+    mutex segmentsMutex;
+    vector<TranscriptSegment> segments;
+    recognizer->Recognized.Connect([&segmentsMutex, &segments](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << " Offset=" << e.Result->Offset() << std::endl;
+            TranscriptSegment segment;
+            segment.Offset = e.Result->Offset();
+            segment.Duration = e.Result->Duration();
+            segment.Text = e.Result->Text;
+            lock_guard<mutex> lock(segmentsMutex);
+            segments.push_back(std::move(segment));
+        }
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    auto outcome = recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+    if (outcome.Canceled)
+    {
+        cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        return;
+    }
+
+    // Appends the call to the store, other calls written by earlier runs are kept.
+    {
+        TranscriptStoreWriter writer("transcripts");
+        writer.Write(callId, segments);
+        writer.Close();
+    }
+
+    // Looks up what was said one second into the call, as a review tool would for any call of the store.
+    TranscriptStore store("transcripts");
+    const uint64_t ticks = 10000000;
+    TranscriptSegment said;
+    if (store.Find(callId, ticks, said))
+    {
+        cout << "At 00:00:01 of " << callId << " was said: " << said.Text << std::endl;
+    }
+    else
+    {
+        cout << "Nothing was said at 00:00:01 of " << callId << "." << std::endl;
+    }
+    cout << "The store [transcripts] holds " << store.BlockCount() << " call transcripts." << std::endl;
+}
+
+// Speech recognition of several files with configs from a shared factory, which keeps their authorization tokens fresh.
+void SpeechRecognitionWithConfigFactory()
+{
+    // One factory for the process. Tokens are issued for the subscription key where the token client is available,
+    // otherwise the configs carry the key itself.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    static auto factory = IssueTokenClient::IsAvailable()
+        ? SpeechConfigFactory::WithIssuedTokens("YourSubscriptionKey")
+        : std::unique_ptr<SpeechConfigFactory>(new SpeechConfigFactory("YourSubscriptionKey"));
+
+    const vector<string> fileNames = { "whatstheweatherlike.wav", "whatstheweatherlike.wav", "whatstheweatherlike.wav" };
+    for (const auto& fileName : fileNames)
+    {
+        // Only the first session waits for the token, the others get the cached config.
+        shared_ptr<SpeechConfig> config;
+        try
+        {
+            config = factory->Get("YourServiceRegion", "en-US");
+        }
+        catch (const exception& e)
+        {
+            cout << "Cannot get a speech config: " << e.what() << std::endl;
+            cout << "Did you update the subscription info?" << std::endl;
+            return;
+        }
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput(fileName));
+        auto result = recognizer->RecognizeOnceAsync().get();
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << fileName << ": RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << fileName << ": NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << fileName << ": CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+        }
+    }
+    if (IssueTokenClient::IsAvailable())
+    {
+        cout << "Authorization tokens fetched: " << factory->TokenFetches() << std::endl;
+    }
+}
+
+// Speech continuous recognition using push stream input, with a trace of the audio path and the recognizer's events.
+void SpeechContinuousRecognitionWithTracing()
+{
+    // Records from here on. The trace keeps the last 64k events of each thread.
+    TraceRecorder::Enable();
+    TraceRecorder::SetThreadName("main");
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Reads the file in real time, so that the trace shows the latency of live audio.
+    PacedWavFileReader reader("whatstheweatherlike.wav", 1);
+    const auto& format = reader.Format();
+    auto pushStream = AudioInputStream::CreatePushStream(
+        AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels));
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+
+    // The events carry the offset in the audio they refer to, in milliseconds, next to the time they arrived.
+    recognizer->SessionStarted.Connect([](const SessionEventArgs&)
+    {
+        TraceRecorder::Instant("recognizer", "SessionStarted");
+    });
+    recognizer->SpeechStartDetected.Connect([](const RecognitionEventArgs& e)
+    {
+        TraceRecorder::Instant("recognizer", "SpeechStartDetected", "offsetMs", (int64_t)(e.Offset / 10000));
+    });
+    recognizer->Recognizing.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        TraceRecorder::Instant("recognizer", "Recognizing", "audioEndMs", (int64_t)((e.Result->Offset() + e.Result->Duration()) / 10000));
+    });
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        TraceRecorder::Instant("recognizer", "Recognized", "audioEndMs", (int64_t)((e.Result->Offset() + e.Result->Duration()) / 10000));
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+    });
+    recognizer->SessionStopped.Connect([](const SessionEventArgs&)
+    {
+        TraceRecorder::Instant("recognizer", "SessionStopped");
+    });
+
+    PushStreamPump pump(pushStream, PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100),
+        PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 1000));
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    vector<uint8_t> buffer(PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 20));
+    int read = 0;
+    while ((read = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+    {
+        pump.Write(buffer.data(), (size_t)read);
+    }
+    pump.Close();
+
+    auto outcome = recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+    if (outcome.Canceled)
+    {
+        cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+
+    TraceRecorder::Disable();
+    ofstream trace("trace.json");
+    TraceRecorder::WriteChromeJson(trace);
+    cout << "The trace was written to [trace.json], open it in chrome://tracing or https://ui.perfetto.dev";
+    if (TraceRecorder::Dropped() > 0)
+    {
+        cout << ", " << TraceRecorder::Dropped() << " older events were overwritten";
+    }
+    cout << "." << std::endl;
+}
+
+// Speech continuous recognition of a wav file in a blob, streamed with ranged GETs instead of downloaded first.
+void SpeechContinuousRecognitionWithBlobPullStream()
+{
+    if (!HttpRangeReader::IsAvailable())
+    {
+        cout << "This sample needs an HTTP client, pass your own range fetcher to BlobPullStreamCallback (see blob_pull_stream.h)." << std::endl;
+        return;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with the url of your wav file, e.g. a blob with a SAS token that allows reading it.
+    shared_ptr<BlobPullStreamCallback> callback;
+    try
+    {
+        callback = make_shared<BlobPullStreamCallback>("YourFileUrl");
+    }
+    catch (const exception& e)
+    {
+        cout << "Cannot read the wav header of the blob: " << e.what() << std::endl;
+        return;
+    }
+    const auto& format = callback->Format();
+    auto pullStream = AudioInputStream::CreatePullStream(
+        AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), callback);
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    auto outcome = recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+    if (outcome.Canceled)
+    {
+        cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+    if (!callback->Error().empty())
+    {
+        cout << "The blob could not be read to the end: " << callback->Error() << std::endl;
+    }
+}
+
+// Speech continuous recognition of a session that runs for hours, with the memory it retains bounded.
+void SpeechContinuousRecognitionInLongSession()
+{
+    // Streams a wav file as the pull stream sample does, and keeps the audio for the utterances that are recognized,
+    // at most 30 seconds of it, so that a long stretch without recognized speech does not add up.
+    class BoundedAudioInputCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        BoundedAudioInputCallback(const string& audioFileName, double speed)
+            : m_reader(audioFileName, speed), m_audio(m_reader.Format(),
+                PushStreamPump::ChunkSizeFor(m_reader.Format().SamplesPerSec, m_reader.Format().BlockAlign, 30000))
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            int count = m_reader.Read(dataBuffer, size);
+            if (count > 0)
+            {
+                m_audio.Add(dataBuffer, (size_t)count);
+            }
+            return count;
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+        UtteranceAudioCache& Audio()
+        {
+            return m_audio;
+        }
+
+    private:
+        PacedWavFileReader m_reader;
+        UtteranceAudioCache m_audio;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own audio file name. Set the speed to 1 to stream it in real time, as a live session would.
+    auto callback = make_shared<BoundedAudioInputCallback>("whatstheweatherlike.wav", 0);
+    // The results are written to the store in pages of 256, only the latest 16 and the page being filled stay in memory.
+    TranscriptStoreWriter store("long_sessions");
+    LongSessionTranscript::Options options;
+    options.RecentSegments = 16;
+    const string sessionId = "session-1";
+    LongSessionTranscript transcript(store, sessionId, options);
+
+    // The audio of the last utterance, e.g. to play it back on request. Older utterances are released.
+    mutex lastUtteranceMutex;
+    vector<uint8_t> lastUtterance;
+
+    // Declared after the collectors, so that they outlive the recognizer's event handlers.
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(AudioInputStream::CreatePullStream(callback)));
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+    recognizer->Recognized.Connect([&callback, &transcript, &lastUtteranceMutex, &lastUtterance](const SpeechRecognitionEventArgs& e)
+    {
+        const bool speech = e.Result->Reason == ResultReason::RecognizedSpeech;
+        auto audio = callback->Audio().Take(e.Result->Offset(), e.Result->Duration(), speech);
+        if (!speech)
+        {
+            return;
+        }
+        cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        {
+            lock_guard<mutex> lock(lastUtteranceMutex);
+            lastUtterance.swap(audio);
+        }
+        TranscriptSegment segment;
+        segment.Offset = e.Result->Offset();
+        segment.Duration = e.Result->Duration();
+        segment.Text = e.Result->Text;
+        transcript.Add(std::move(segment));
+    });
+
+    // The memory of the process and what the helpers retain is exported with the recognizer metrics, so that a
+    // dashboard shows it stay flat over the session.
+    RecognizerMetrics metrics("speech");
+    metrics.Attach(recognizer);
+    metrics.AddGauge("speech_process_resident_bytes", "Resident memory of the process.", []() { return ProcessMemory::Current().ResidentBytes; });
+    metrics.AddGauge("speech_process_peak_resident_bytes", "Peak resident memory of the process.", []() { return ProcessMemory::Current().PeakResidentBytes; });
+    metrics.AddGauge("speech_retained_audio_bytes", "Audio kept for utterances not yet recognized.", [&callback]() { return (uint64_t)callback->Audio().RetainedBytes(); });
+    metrics.AddGauge("speech_dropped_audio_bytes", "Audio dropped to stay within the bound.", [&callback]() { return callback->Audio().DroppedBytes(); });
+    metrics.AddGauge("speech_retained_transcript_bytes", "Text of recent results and of the page being filled.", [&transcript]() { return (uint64_t)transcript.RetainedBytes(); });
+    metrics.AddGauge("speech_transcript_pages", "Pages of results written to the store.", [&transcript]() { return (uint64_t)transcript.Pages().size(); });
+
+    SessionOutcome outcome;
+    {
+        // Rewrites the metrics file every 10 seconds, and once more at the end of the session.
+        MetricsExporter exporter(metrics, MetricsExporter::Format::Prometheus, chrono::milliseconds(10000), [](const string& text)
+        {
+            ofstream("long_session_metrics.prom", ios::trunc) << text;
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        outcome = recognitionEnd.Wait();
+        recognizer->StopContinuousRecognitionAsync().get();
+    }
+    if (outcome.Canceled)
+    {
+        cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        return;
+    }
+
+    transcript.Flush();
+    store.Close();
+    const auto memory = ProcessMemory::Current();
+    cout << transcript.SegmentCount() << " results in " << transcript.Pages().size() << " pages of the store [long_sessions], "
+         << "the latest " << transcript.Recent().size() << " in memory.\n"
+         << "Resident memory: " << memory.ResidentBytes / 1024 << " KB, peak " << memory.PeakResidentBytes / 1024 << " KB." << std::endl;
+
+    // A page is looked up as a call of the store, e.g. by a review tool.
+    if (!transcript.Pages().empty())
+    {
+        TranscriptStore reader("long_sessions");
+        const auto firstPage = reader.Range(transcript.PageName(0), 0, transcript.Pages()[0].End);
+        cout << "Page " << transcript.PageName(0) << " starts with: " << (firstPage.empty() ? string() : firstPage[0].Text) << std::endl;
+    }
+}
+
+// Speech continuous recognition whose events are recorded, then replayed into the same handler code to benchmark it.
+void SpeechRecognitionRecordAndReplay()
+{
+    // The handler code under test: partial results are debounced into updates, and all results are formatted by a
+    // result sink. Live events and replayed ones call the same functions, replayed ones with their recorded time,
+    // so that the debouncer decides as it did in the session.
+    class TranscriptHandlers final
+    {
+    public:
+        // The sink blocks instead of dropping records when the replay outpaces it, so every run does the same work.
+        explicit TranscriptHandlers(ostream& os)
+            : m_sink(unique_ptr<ResultSinkBackend>(new TextResultBackend(os)), 1024, AsyncResultSink::OverflowPolicy::Block)
+        {
+        }
+
+        void OnRecognizing(const string& text, PartialResultDebouncer::Clock::time_point time)
+        {
+            PartialResultDebouncer::Delta delta;
+            if (m_debouncer.OnPartial(text, delta, time))
+            {
+                m_sink.Post(ResultRecord{ "Recognizing", delta.Append }.Add("Keep", delta.Keep));
+            }
+        }
+
+        void OnRecognized(const string& text, uint64_t offset, uint64_t duration)
+        {
+            m_debouncer.Reset();
+            m_sink.Post(ResultRecord{ "RECOGNIZED", text }.Add("Offset", offset).Add("Duration", duration));
+        }
+
+        // Waits until the sink has written all records.
+        void Close()
+        {
+            m_sink.Close();
+        }
+
+    private:
+        PartialResultDebouncer m_debouncer;
+        AsyncResultSink m_sink;
+    };
+
+    // Records a real session once. Replace with your own subscription key, service region and audio file name.
+    {
+        auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        TranscriptHandlers handlers(cout);
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+        auto recognitionEnd = SessionCompletion::Track(*recognizer);
+        SessionRecorder recorder;
+        recorder.Attach(recognizer);
+
+        recognizer->Recognizing.Connect([&handlers](const SpeechRecognitionEventArgs& e)
+        {
+            handlers.OnRecognizing(e.Result->Text, PartialResultDebouncer::Clock::now());
+        });
+        recognizer->Recognized.Connect([&handlers](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                handlers.OnRecognized(e.Result->Text, e.Result->Offset(), e.Result->Duration());
+            }
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        auto outcome = recognitionEnd.Wait();
+        recognizer->StopContinuousRecognitionAsync().get();
+        if (outcome.Canceled)
+        {
+            cout << "CANCELED: ErrorDetails=" << outcome.ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            return;
+        }
+        recorder.Save("whatstheweatherlike.srec");
+        cout << "Recorded " << recorder.Count() << " events to [whatstheweatherlike.srec]." << std::endl;
+    }
+
+    // Replays the recording, without the service, as fast as the handlers take it. The output is discarded, so
+    // that only the handlers are measured.
+    SessionReplayer replayer("whatstheweatherlike.srec");
+    const int iterations = 100;
+    SessionReplayer::Statistics total;
+    for (int i = 0; i < iterations; i++)
+    {
+        ostringstream output;
+        TranscriptHandlers handlers(output);
+        auto statistics = replayer.Replay([&handlers](const RecordedEvent& event)
+        {
+            if (event.Kind == RecordedEventKind::Recognizing)
+            {
+                handlers.OnRecognizing(event.Text, PartialResultDebouncer::Clock::time_point(chrono::microseconds(event.Time)));
+            }
+            else if (event.Kind == RecordedEventKind::Recognized)
+            {
+                handlers.OnRecognized(event.Text, event.Offset, event.Duration);
+            }
+        });
+        handlers.Close();
+        total.Events += statistics.Events;
+        total.HandlerMs += statistics.HandlerMs;
+    }
+    cout << "Replayed " << iterations << " times: " << total.Events << " events in " << total.HandlerMs << " ms of handler time, "
+         << (uint64_t)total.EventsPerSecond() << " events per second." << std::endl;
+}
+
+// Speech continuous recognition of a long file, split into segments that are recognized in parallel.
+void SpeechContinuousRecognitionWithSegmentedFile()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Splits the file into 4 segments at silence boundaries and recognizes them with up to 4 recognizers at a time.
+    // Replace with your own audio file name.
+    SegmentedTranscriber transcriber(config, "enrollment_audio_katie.wav", 4);
+
+    try
+    {
+        // The phrases are ordered by offset, which is relative to the start of the file.
+        auto transcript = transcriber.Transcribe(4);
+        for (const auto& phrase : transcript)
+        {
+            cout << "RECOGNIZED: Text=" << phrase.Text << "\n"
+                 << "  Offset=" << phrase.Offset << "\n"
+                 << "  Duration=" << phrase.Duration << std::endl;
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        cout << "CANCELED: " << e.what() << "\n"
+             << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+}
+
+// Speech recognition of several short commands using microphone, with recognizers leased from a pool.
+void SpeechRecognitionWithRecognizerPool()
+{
+    // Creates a pool that keeps up to 2 idle recognizers per region and language, all using the default microphone.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    RecognizerPool pool("YourSubscriptionKey", 2, [] { return AudioConfig::FromDefaultMicrophoneInput(); });
+    RecognizerPoolKey key{ "YourServiceRegion", "en-US", "" };
+
+    // Creates the recognizers and opens their connections ahead of time, so the first command does not wait for connection setup.
+    pool.Warm(key, 2);
+
+    for (int i = 0; i < 3; i++)
+    {
+        // The lease returns the recognizer to the pool when it goes out of scope.
+        auto recognizer = pool.Acquire(key);
+        cout << "Say a command...\n";
+
+        auto result = recognizer.RecognizeOnceAsync().get();
+
+        // Checks result.
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+                break;
+            }
+        }
+    }
+}
+
+// Speech recognition of a queue of voice commands using microphone, routed to the fastest healthy of several regions.
+void SpeechRecognitionWithRegionFailover()
+{
+    // Replace with your own subscription key and the regions of your callers, closest first.
+    RegionRouter router("YourSubscriptionKey", { "westeurope", "northeurope", "francecentral" },
+        [] { return AudioConfig::FromDefaultMicrophoneInput(); });
+
+    // Connects in the best region and in the runner-up, so a failover does not wait for connection setup.
+    const string standby = router.WarmStandby("en-US");
+    if (!standby.empty())
+    {
+        cout << "Standby region: " << standby << "\n";
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        cout << "Say a command...\n";
+        // A command canceled with an error is recognized again in another region, the router counts the error
+        // against its region and stops routing there once errors pile up.
+        string failedRegion;
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            auto routed = router.Acquire("en-US", failedRegion);
+            auto result = routed.Recognizer.RecognizeOnceAsync().get();
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "RECOGNIZED in " << routed.Region << ": Text=" << result->Text << std::endl;
+
+                // Replies from the same routing, e.g. to confirm the command.
+                auto reply = router.CreateSynthesizer(AudioConfig::FromDefaultSpeakerOutput());
+                reply.Synthesizer->SpeakTextAsync("You said " + result->Text).get();
+                break;
+            }
+            if (result->Reason == ResultReason::NoMatch)
+            {
+                cout << "NOMATCH: Speech could not be recognized." << std::endl;
+                break;
+            }
+            auto cancellation = CancellationDetails::FromResult(result);
+            if (cancellation->Reason != CancellationReason::Error)
+            {
+                break;
+            }
+            cout << "CANCELED in " << routed.Region << ": ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            failedRegion = routed.Region;
+        }
+    }
+
+    for (const auto& region : router.GetStatistics())
+    {
+        cout << region.Region << ": latency " << region.LatencyMs << " ms, error rate " << region.ErrorRate
+             << ", " << region.Requests << " requests, " << (region.Healthy ? "healthy" : "unhealthy") << "\n";
+    }
+    cout.flush();
+}
+
+// Speech recognition of a loop of voice commands using microphone, with one recognizer whose connection stays open.
+void SpeechRecognitionCommandLoopWithMicrophone()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The session opens the recognizer's connection right away, and reopens it in the background if it drops
+    // between commands, so that no command waits for connection setup.
+    CommandSession<SpeechRecognizer> session(SpeechRecognizer::FromConfig(config));
+
+    while (true)
+    {
+        cout << "Say a command, or \"stop\" to end...\n";
+        auto result = session.Recognize();
+
+        // Checks result.
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+            if (result->Text == "Stop." || result->Text == "Stop")
+            {
+                break;
+            }
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+                break;
+            }
+        }
+    }
+
+    cout << session.Commands() << " commands, " << session.CommandsWithoutConnection() << " waited for a connection, "
+         << session.Reconnects() << " reconnects in the background." << std::endl;
+}
+
+// Speech recognition of commands using a customized model and its domain phrases, with recognizers leased from a pool.
+void SpeechRecognitionUsingCustomizedModelWithPhraseListBundle()
+{
+    // The domain phrases are built into a bundle once, and attached to every recognizer that uses the model.
+    // Replace with the phrases of your domain, e.g. read from a file.
+    auto phrases = PhraseListBundle::Build({ "Contoso", "Fabrikam Fiber", "Northwind Traders", "Wingtip Toys", "Tailspin Toys" });
+
+    // Replace with your own subscription key, service region (e.g., "westus") and CRIS endpoint ID.
+    RecognizerPool pool("YourSubscriptionKey", 2, [] { return AudioConfig::FromDefaultMicrophoneInput(); });
+    RecognizerPoolKey key{ "YourServiceRegion", "en-US", "YourEndpointId" };
+    pool.Warm(key, 2);
+
+    // Pooled recognizers keep their phrase list, so a recognizer that already has the bundle gets nothing again.
+    PhraseListBinder binder;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == 2)
+        {
+            // A new version of the list, the recognizers only get the new phrase.
+            phrases = phrases->With({ "Adventure Works" });
+        }
+        auto recognizer = pool.Acquire(key);
+        auto added = binder.Attach(recognizer.Get(), phrases);
+        cout << "Say a command... (" << added << " of " << phrases->Phrases().size() << " phrases added to the recognizer)\n";
+
+        auto result = recognizer.RecognizeOnceAsync().get();
+
+        // Checks result.
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+                break;
+            }
+        }
+    }
+    cout << "Phrases added: " << binder.PhrasesSent() << ", not added again: " << binder.PhrasesSkipped() << std::endl;
+}
+
+// Speech continuous recognition with file input, with recognizer metrics exported in the Prometheus text format.
+void SpeechContinuousRecognitionWithMetrics()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput("whatstheweatherlike.wav"));
+
+    // The metrics connect their own event handlers, next to the handlers of the sample below.
+    RecognizerMetrics metrics("speech");
+    metrics.Attach(recognizer);
+
+    SessionCompletion recognitionEnd;
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                 << "CANCELED: Did you update the subscription info?" << std::endl;
+            recognitionEnd.Complete();
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.Complete();
+    });
+
+    {
+        // Rewrites the metrics file every second, e.g. for the textfile collector of a Prometheus node exporter.
+        MetricsExporter exporter(metrics, MetricsExporter::Format::Prometheus, chrono::milliseconds(1000), [](const string& text)
+        {
+            ofstream("recognizer_metrics.prom", ios::trunc) << text;
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        recognitionEnd.Wait();
+        recognizer->StopContinuousRecognitionAsync().get();
+    }
+
+    metrics.WritePrometheus(cout);
+}
+
+// Speech recognition of commands that start with a keyword, with no service connection until the keyword is spoken.
+void KeywordGatedSpeechRecognitionWithFile()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates an instance of a keyword recognition model. Update this to
+    // point to the location of your keyword recognition model.
+    auto model = KeywordRecognitionModel::FromFile("YourKeywordRecognitionModelFile.table");
+
+    // The file stands for the capture of a device, it is read no faster than real time.
+    // Replace with your own audio file name, with the keyword of your model followed by a command.
+    unique_ptr<PacedWavFileReader> capture;
+    try
+    {
+        capture.reset(new PacedWavFileReader("YourKeywordAndCommand.wav"));
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+
+    KeywordGatedRecognizer gate(model, capture->Format(),
+        [config](shared_ptr<AudioConfig> audioConfig) { return SpeechRecognizer::FromConfig(config, audioConfig); },
+        [](const shared_ptr<SpeechRecognitionResult>& result)
+        {
+            if (result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "COMMAND: Text=" << result->Text << std::endl;
+            }
+            else if (result->Reason == ResultReason::NoMatch)
+            {
+                cout << "NOMATCH: Speech after the keyword could not be recognized." << std::endl;
+            }
+            else if (result->Reason == ResultReason::Canceled)
+            {
+                cout << "CANCELED: ErrorDetails=" << CancellationDetails::FromResult(result)->ErrorDetails << std::endl;
+            }
+        });
+
+    cout << "Listening for the keyword..." << std::endl;
+    const auto& format = capture->Format();
+    vector<uint8_t> buffer(PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100));
+    int read;
+    while ((read = capture->Read(buffer.data(), (uint32_t)buffer.size())) > 0)
+    {
+        gate.Write(buffer.data(), (size_t)read);
+    }
+    gate.Stop();
+    cout << "Keywords recognized: " << gate.Keywords() << std::endl;
+}
+
+// Speech continuous recognition of several calls at once, with all push streams fed in real time by two threads.
+void SpeechContinuousRecognitionWithMultiplexedPushStreams()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Each call is simulated by a wav file, in a real deployment the audio would come from the network.
+    const int callCount = 8;
+    PushStreamMultiplexer multiplexer(2);
+    vector<shared_ptr<SpeechRecognizer>> recognizers;
+
+    // The end of every call is handled on one executor thread, instead of one blocked thread per call. The last
+    // call to end completes allDone.
+    SerialExecutor executor;
+    SessionCompletion allDone;
+    int remainingCalls = callCount;
+
+    for (int call = 0; call < callCount; call++)
+    {
+        auto reader = make_shared<WavFileReader>("whatstheweatherlike.wav");
+        const auto& format = reader->Format();
+        auto pushStream = AudioInputStream::CreatePushStream(
+            AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels));
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+
+        recognizer->Recognized.Connect([call](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                cout << "RECOGNIZED (call " << call << "): Text=" << e.Result->Text << std::endl;
+            }
+        });
+
+        // Completes on SessionStopped or on a cancellation with an error, whichever comes first.
+        SessionCompletion::Track(*recognizer).OnComplete([call, recognizer, &remainingCalls, allDone](const SessionOutcome& outcome)
+        {
+            if (outcome.Canceled)
+            {
+                cout << "CANCELED (call " << call << "): ErrorDetails=" << outcome.ErrorDetails << std::endl;
+            }
+            // Runs on the executor thread, so the recognizer can be stopped here, and the count needs no lock.
+            recognizer->StopContinuousRecognitionAsync().get();
+            if (--remainingCalls == 0)
+            {
+                allDone.Complete();
+            }
+        }, executor.AsExecutor());
+        recognizer->StartContinuousRecognitionAsync().get();
+
+        // Writes 100 ms chunks, paced to real time.
+        multiplexer.Add(pushStream, [reader](uint8_t* buffer, uint32_t size) { return reader->Read(buffer, size); },
+            PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 1000), PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100));
+
+        recognizers.push_back(recognizer);
+    }
+
+    multiplexer.WaitAll();
+    allDone.Wait();
+    cout << "All calls done, chunks were written at most "
+         << chrono::duration_cast<chrono::milliseconds>(multiplexer.MaxLateness()).count() << " ms late." << std::endl;
+}
+
+// Speech continuous recognition using pull stream input from a wav file in a format the service does not take directly.
+void SpeechContinuousRecognitionWithConvertedPullStream()
+{
+    // Returns the audio of a wav file converted to mono 16 kHz 16-bit PCM.
+    class ConvertedAudioFromFileCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        ConvertedAudioFromFileCallback(const string& audioFileName)
+            : m_reader(audioFileName, 16000)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader.Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+    private:
+        ConvertingWavFileReader m_reader;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // katiesteve.wav has 8 channels, they are mixed down to mono while the file is read.
+    // Files with other sample rates, 8, 24 or 32-bit samples, float, mu-law or a-law samples work the same way.
+    auto callback = make_shared<ConvertedAudioFromFileCallback>("katiesteve.wav");
+    auto pullStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 1), callback);
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullStream));
+
+    SessionCompletion recognitionEnd;
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << "\n"
+                 << "  Offset=" << e.Result->Offset() << "\n"
+                 << "  Duration=" << e.Result->Duration() << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            recognitionEnd.Complete();
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.Complete();
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+}
+
+// Keyword-triggered speech recognition using microphone.
+void KeywordTriggeredSpeechRecognitionWithMicrophone()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech recognizer using microphone as audio input. The default language is "en-us".
+    auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    // Promise for synchronization of recognition end.
+    SessionCompletion recognitionEnd;
+
+    // Subscribes to events.
+    recognizer->Recognizing.Connect([] (const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizingSpeech)
+        {
+            cout << "RECOGNIZING: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::RecognizingKeyword)
+        {
+            cout << "RECOGNIZING KEYWORD: Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    recognizer->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedKeyword)
+        {
+            cout << "RECOGNIZED KEYWORD: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                 << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+
+    recognizer->SessionStarted.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "SESSIONSTARTED: SessionId=" << e.SessionId << std::endl;
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "SESSIONSTOPPED: SessionId=" << e.SessionId << std::endl;
+
+        recognitionEnd.Complete(); // Notify to stop recognition.
+    });
+
+    // Creates an instance of a keyword recognition model. Update this to
+    // point to the location of your keyword recognition model.
+    auto model = KeywordRecognitionModel::FromFile("YourKeywordRecognitionModelFile.table");
+
+    // The phrase your keyword recognition model triggers on.
+    auto keyword = "YourKeyword";
+
+    // Starts continuous recognition. Use StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartKeywordRecognitionAsync(model).get();
+
+    cout << "Say something starting with '" << keyword
+         << "' followed by whatever you want..." << std::endl;
+
+    // Waits for a single successful keyword-triggered speech recognition (or error).
+    recognitionEnd.Wait();
+
+    // Stops recognition.
+    recognizer->StopKeywordRecognitionAsync().get();
+}
+
+// Speech recognition with auto detection for source language
+void SpeechRecognitionWithSourceLanguageAutoDetection()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto speechConfig = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+     // Currently this feature only supports 2 different language candidates
+     // Replace the languages with your languages in BCP-47 format, e.g. fr-FR.
+     // Please see https://docs.microsoft.com/azure/cognitive-services/speech-service/language-support for all supported languages
+     auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "de-DE" });
+
+     // The recognizer uses microphone,  to use file or stream as audio input, just construct the audioInput and pass to FromConfig API as the 3rd parameter.
+     // Ex: auto recognizer = SpeechRecognizer::FromConfig(speechConfig, autoDetectSourceLanguageConfig, audioInput);
+     auto recognizer = SpeechRecognizer::FromConfig(speechConfig, autoDetectSourceLanguageConfig);
+     cout << "Say something in either English or German...\n";
+
+    // Starts speech recognition, and returns after a single utterance is recognized. The end of a
+    // single utterance is determined by listening for silence at the end or until a maximum of 15
+    // seconds of audio is processed.  The task returns the recognition text as result.
+    // Note: Since RecognizeOnceAsync() returns only a single utterance, it is suitable only for single
+    // shot recognition like command or query.
+    // For long-running multi-utterance recognition, use StartContinuousRecognitionAsync() instead.
+    auto result = recognizer->RecognizeOnceAsync().get();
+
+    // Checks result.
+    auto autoDetectSourceLanguageResult = AutoDetectSourceLanguageResult::FromResult(result);
+    auto language = autoDetectSourceLanguageResult->Language;
+    if (result->Reason == ResultReason::RecognizedSpeech)
+    {
+        cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        cout << "RECOGNIZED: Language=" << language << std::endl;
+    }
+    else if (result->Reason == ResultReason::NoMatch)
+    {
+        if (language.empty())
+        {
+            // serivce cannot detect the source language
+            cout << "NOMATCH: Service cannot detect the source language." << std::endl;
+        }
+        else
+        {
+            // serivce can detect the source language but cannot recongize the speech content
+            cout << "NOMATCH: Service can recognize the speech." << std::endl;
+        }
+    }
+    else if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = CancellationDetails::FromResult(result);
+        cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Speech recognition with auto detection for source language and using customized model
+void SpeechRecognitionWithSourceLanguageAutoDetectionUsingCustomizedModel()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    std::vector<std::shared_ptr<SourceLanguageConfig>> sourceLanguageConfigs;
+    // Replace the languages with your languages in BCP-47 format, e.g. zh-CN.
+    sourceLanguageConfigs.push_back(SourceLanguageConfig::FromLanguage("en-US"));
+    // Replace the languages with your languages in BCP-47 format, e.g. zh-CN.
+    // Please see https://docs.microsoft.com/azure/cognitive-services/speech-service/language-support for all supported languages
+    // Set the endpoint ID of your customized mode that will be used for fr-FR,  Replace with your own CRIS endpoint ID.
+    sourceLanguageConfigs.push_back(SourceLanguageConfig::FromLanguage("fr-FR", "The Endpoint Id for custom model of fr-FR"));
+    // Construct AutoDetectSourceLanguageConfig with the 2 source language configurations
+    // Currently this feature only supports 2 different language candidates
+    auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromSourceLanguageConfigs(sourceLanguageConfigs);
+
+    // Creates a speech recognizer using the auto detect source language config
+    // The recognizer uses microphone,  to use file or stream as audio input, just construct the audioInput and pass to FromConfig API as the 3rd parameter.
+    // Ex: auto recognizer = SpeechRecognizer::FromConfig(speechConfig, autoDetectSourceLanguageConfig, audioInput);
+    auto recognizer = SpeechRecognizer::FromConfig(config, autoDetectSourceLanguageConfig);
+    cout << "Say something in either English or French...\n";
+
+    // Starts speech recognition, and returns after a single utterance is recognized. The end of a
+    // single utterance is determined by listening for silence at the end or until a maximum of 15
+    // seconds of audio is processed.  The task returns the recognition text as result.
+    // Note: Since RecognizeOnceAsync() returns only a single utterance, it is suitable only for single
+    // shot recognition like command or query.
+    // For long-running multi-utterance recognition, use StartContinuousRecognitionAsync() instead.
+    auto result = recognizer->RecognizeOnceAsync().get();
+
+    // Checks result.
+    auto autoDetectSourceLanguageResult = AutoDetectSourceLanguageResult::FromResult(result);
+    auto language = autoDetectSourceLanguageResult->Language;
+    if (result->Reason == ResultReason::RecognizedSpeech)
+    {
+        cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+        cout << "RECOGNIZED: Language=" << language << std::endl;
+    }
+    else if (result->Reason == ResultReason::NoMatch)
+    {
+        if (language.empty())
+        {
+            // serivce cannot detect the source language
+            cout << "NOMATCH: Service cannot detect the source language." << std::endl;
+        }
+        else
+        {
+            // serivce can detect the source language but cannot recongize the speech content
+            cout << "NOMATCH: Service can recognize the speech." << std::endl;
+        }
+    }
+    else if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = CancellationDetails::FromResult(result);
+        cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Pronunciation assessment.
+void PronunciationAssessmentWithMicrophone()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    // Note: The pronunciation assessment feature is currently only available on en-US language.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The pronunciation assessment service has a longer default end silence timeout (5 seconds) than normal STT
+    // as the pronunciation assessment is widely used in education scenario where kids have longer break in reading.
+    // You can adjust the end silence timeout based on your real scenario.
+    config->SetProperty(PropertyId::SpeechServiceConnection_EndSilenceTimeoutMs, "3000");
+
+    std::string referenceText = "";
+    // create pronunciation assessment config, set grading system, granularity and if enable miscue based on your requirement.
+    auto pronunciationConfig = PronunciationAssessmentConfig::Create(referenceText,
+        PronunciationAssessmentGradingSystem::HundredMark,
+        PronunciationAssessmentGranularity::Phoneme, true);
+
+    // Creates a speech recognizer using microphone as audio input.
+    auto recognizer = SpeechRecognizer::FromConfig(config);
+
+    while (true)
+    {
         // Receives reference text from console input.
         cout << "Enter reference text that you want to assess, or enter empty text to exit." << std::endl;
         cout << "> ";
@@ -703,6 +2001,184 @@ void PronunciationAssessmentWithMicrophone()
     }
 }
 
+// Pronunciation assessment of a batch of recorded answers, scored concurrently with pooled recognizers.
+void PronunciationAssessmentBatchWithFiles()
+{
+    // Replace with your own list of answers, one per line: the wav file, a tab, and the reference text.
+    ifstream answers("YourAnswers.tsv");
+    if (!answers)
+    {
+        cout << "Exit due to exception: cannot open the list of answers" << std::endl;
+        return;
+    }
+
+    try
+    {
+        // The phoneme scores of all answers go to one columnar file, see PhonemeScoreWriter for its layout.
+        PhonemeScoreWriter writer("pronunciation_scores.phsc");
+
+        // Scores 4 answers at a time. Replace with your own subscription key and service region (e.g., "westus").
+        // Note: The pronunciation assessment feature is currently only available on en-US language.
+        mutex consoleMutex;
+        PronunciationBatchScorer scorer("YourSubscriptionKey", RecognizerPoolKey{ "YourServiceRegion", "en-US", "" }, 4, writer,
+            [&consoleMutex](const AnswerScore& answer)
+            {
+                lock_guard<mutex> lock(consoleMutex);
+                if (answer.Error.empty())
+                {
+                    cout << "SCORED: " << answer.AudioFileName << " Accuracy score: " << answer.Accuracy << ", Pronunciation score: "
+                         << answer.Pronunciation << ", Completeness score: " << answer.Completeness << ", Fluency score: " << answer.Fluency << std::endl;
+                }
+                else
+                {
+                    cout << "FAILED: " << answer.AudioFileName << " " << answer.Error << std::endl;
+                }
+            });
+
+        string line;
+        while (getline(answers, line))
+        {
+            auto tab = line.find('\t');
+            if (tab != string::npos)
+            {
+                scorer.Add(line.substr(0, tab), line.substr(tab + 1));
+            }
+        }
+        scorer.Finish();
+        writer.Close();
+        cout << "Scored " << scorer.Scored() << " answers, " << scorer.Failed() << " failed, " << writer.Rows() << " phoneme scores written." << std::endl;
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << std::endl;
+    }
+}
+
+// Speech continuous recognition using pull stream input paced in real time, with the partials sent as deltas.
+void SpeechContinuousRecognitionWithPacedPullStream()
+{
+    // First, define your own pull audio input stream callback class that implements the
+    // PullAudioInputStreamCallback interface. The sample here illustrates how to define such
+    // a callback that reads audio data from a wav file.
+    // AudioInputFromFileCallback implements PullAudioInputStreamCallback interface, and uses a wav file as source
+    class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        // Constructor that creates an input stream from a file.
+        // 'speed' paces the reads relative to real time, 1 behaves like live audio and 0 reads as fast as possible.
+        AudioInputFromFileCallback(const string& audioFileName, double speed)
+            : m_reader(audioFileName, speed)
+        {
+        }
+
+        // Implements AudioInputStream::Read() which is called to get data from the audio stream.
+        // It copies data available in the stream to 'dataBuffer', but no more than 'size' bytes.
+        // If the data available is less than 'size' bytes, it is allowed to just return the amount of data that is currently available.
+        // If there is no data, this function must wait until data is available.
+        // It returns the number of bytes that have been copied in 'dataBuffer'.
+        // It returns 0 to indicate that the stream reaches end or is closed.
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            // Spans the time the SDK waits for the read, including the pacing.
+            TraceSpan span("pull", "PullAudioInputStreamCallback::Read", "size", size);
+            return m_reader.Read(dataBuffer, size);
+        }
+        // Implements AudioInputStream::Close() which is called when the stream needs to be closed.
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+    private:
+        PacedWavFileReader m_reader;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a callback that will read audio data from a WAV file.
+    // Currently, the only supported WAV format is mono(single channel), 16 kHZ sample rate, 16 bits per sample.
+    // Replace with your own audio file name.
+    // Streams the file in real time, so that the partials arrive at the pace of live input.
+    auto callback = make_shared<AudioInputFromFileCallback>("whatstheweatherlike.wav", 1);
+    auto pullStream = AudioInputStream::CreatePullStream(callback);
+
+    // Creates a speech recognizer from stream input;
+    auto audioInput = AudioConfig::FromStreamInput(pullStream);
+
+    // Results are written to the console from a background thread, so the event handlers never wait for the terminal.
+    // The sink is declared before the recognizer, so it outlives the recognizer's event handlers.
+    AsyncResultSink sink(unique_ptr<ResultSinkBackend>(new TextResultBackend(cout)));
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
+
+    // Partials are sent as updates of the previous one, at most every 200 ms, instead of the whole hypothesis every time.
+    PartialResultDebouncer debouncer;
+
+    // Subscribes to events.
+    recognizer->Recognizing.Connect([&sink, &debouncer](const SpeechRecognitionEventArgs& e)
+    {
+        PartialResultDebouncer::Delta delta;
+        if (debouncer.OnPartial(e.Result->Text, delta))
+        {
+            sink.Post(ResultRecord{ "Recognizing", delta.Append }.Add("Keep", delta.Keep));
+        }
+    });
+
+    recognizer->Recognized.Connect([&sink, &debouncer] (const SpeechRecognitionEventArgs& e)
+    {
+        debouncer.Reset();
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            sink.Post(ResultRecord{ "RECOGNIZED", e.Result->Text }
+                .Add("Offset", e.Result->Offset())
+                .Add("Duration", e.Result->Duration()));
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            sink.Post(ResultRecord{ "NOMATCH", "" }.Add("Details", "Speech could not be recognized."));
+        }
+    });
+
+    recognizer->Canceled.Connect([&recognitionEnd, &sink](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        switch (e.Reason)
+        {
+        case CancellationReason::EndOfStream:
+            sink.Post(ResultRecord{ "CANCELED", "" }.Add("Details", "Reach the end of the file."));
+            break;
+
+        case CancellationReason::Error:
+            sink.Post(ResultRecord{ "CANCELED", "" }
+                .Add("ErrorCode", (uint64_t)e.ErrorCode)
+                .Add("ErrorDetails", e.ErrorDetails));
+            recognitionEnd.Complete();
+            break;
+
+        default:
+            sink.Post(ResultRecord{ "CANCELED", "" }.Add("Details", "unknown reason ?!"));
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd, &sink](const SessionEventArgs& e)
+    {
+        sink.Post(ResultRecord{ "SESSION STOPPED", "" });
+        recognitionEnd.Complete(); // Notify to stop recognition.
+    });
+
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().wait();
+
+    // Waits for recognition end.
+    recognitionEnd.Wait();
+
+    // Stops recognition.
+    recognizer->StopContinuousRecognitionAsync().wait();
+}
+
 #pragma region Language Detection related samples
 
 void SpeechRecognitionAndLanguageIdWithMicrophone()
@@ -773,8 +2249,8 @@ void SpeechContinuousRecognitionAndLanguageIdWithMultiLingualFile()
     auto audioInput = AudioConfig::FromWavFileInput("en-us_zh-cn.wav");
     auto recognizer = SpeechRecognizer::FromConfig(config, autoDetectSourceLanguageConfig, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Recognizing.Connect([](const SpeechRecognitionEventArgs& e)
@@ -808,21 +2284,21 @@ void SpeechContinuousRecognitionAndLanguageIdWithMultiLingualFile()
                     << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
                     << "CANCELED: Did you update the subscription info?" << std::endl;
 
-                recognitionEnd.set_value(); // Notify to stop recognition.
+                recognitionEnd.Complete(); // Notify to stop recognition.
             }
         });
 
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
         {
             cout << "Session stopped.";
-            recognitionEnd.set_value(); // Notify to stop recognition.
+            recognitionEnd.Complete(); // Notify to stop recognition.
         });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
@@ -6,7 +6,23 @@
 #include "stdafx.h"
 
 #include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
+#include <mutex>
+#include "chunked_synthesizer.h"
+#include "fan_out_audio_output.h"
+#include "latency_stats.h"
+#include "pooled_audio_output.h"
+#include "speculative_synthesizer.h"
+#include "streaming_synthesizer.h"
+#include "synthesis_batch_renderer.h"
+#include "synthesis_cache.h"
+#include "synthesis_event_log.h"
+#include "trace_recorder.h"
+#include "voice_catalog.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -904,3 +920,627 @@ void SpeechSynthesisGetAvailableVoices()
         cout << "CANCELED: Did you update the subscription info?" << std::endl;
     }
 }
+
+// Speech synthesis through a cache, for prompts that are spoken again and again.
+void SpeechSynthesisWithCache()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The voice and the output format are part of the cache key.
+    config->SetSpeechSynthesisVoiceName("en-US-AriaNeural");
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Riff24Khz16BitMonoPcm);
+
+    // Creates a speech synthesizer with a null output stream, the audio is taken from the cache.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Keeps up to 16 MB of audio in memory, and all audio in the "synthesis_cache" directory, so that
+    // prompts are served from disk after a restart of the sample.
+    SynthesisCache::Options options;
+    options.MemoryLimitBytes = 16 * 1024 * 1024;
+    options.Directory = "synthesis_cache";
+    SynthesisCache cache(synthesizer, options);
+
+    while (true)
+    {
+        // Receives a text from console input, enter the same text again to get it from the cache.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        try
+        {
+            auto audio = cache.SpeakText(text);
+            cout << audio->GetAudioData().size() << " bytes of audio data " << (audio->FromCache() ? "served from the cache" : "synthesized")
+                << " for text [" << text << "]" << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            cout << "CANCELED: " << e.what() << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+
+    auto statistics = cache.GetStatistics();
+    cout << "Cache hit rate: " << statistics.HitRate() * 100 << "% (" << statistics.MemoryHits << " from memory, " << statistics.DiskHits
+        << " from disk, " << statistics.Misses << " synthesized)" << std::endl;
+    cout << "Bytes in memory: " << statistics.MemoryBytes << ", written to disk: " << statistics.DiskBytesWritten
+        << ", synthesized: " << statistics.SynthesizedBytes << ", served from the cache: " << statistics.HitBytes << std::endl;
+}
+
+// Speech synthesis streamed to a file while it is synthesized, reporting the time to the first and to the last byte.
+void SpeechSynthesisWithStreamingOutput()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Sets a raw format, so that the chunks are plain samples that can be played or sent as they arrive.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    // Creates a speech synthesizer with a null output stream, the audio is read from an audio data stream instead.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Chunks of 100 ms at 16 kHz, 16-bit mono.
+    StreamingSynthesizer streamingSynthesizer(synthesizer, 3200);
+    LatencyStats firstByte;
+    LatencyStats lastByte;
+
+    while (true)
+    {
+        // Receives a text from console input and synthesizes it to a file, chunk by chunk.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        // The file stands in for an audio device or a network connection, which would start playing with the first chunk.
+        ofstream audioFile("outputaudio.pcm", ios::binary | ios::trunc);
+        try
+        {
+            auto timings = streamingSynthesizer.SpeakText(text, [&audioFile](const uint8_t* data, uint32_t size)
+            {
+                audioFile.write(reinterpret_cast<const char*>(data), size);
+            });
+            firstByte.Add(timings.FirstByteMs);
+            lastByte.Add(timings.LastByteMs);
+            cout << timings.Bytes << " bytes of audio data for text [" << text << "] written to [outputaudio.pcm], first byte after "
+                << timings.FirstByteMs << " ms, last byte after " << timings.LastByteMs << " ms." << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            cout << "CANCELED: " << e.what() << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+
+    if (firstByte.Count() > 0)
+    {
+        cout << "Time to first byte: p50 " << firstByte.Percentile(50) << " ms, p95 " << firstByte.Percentile(95) << " ms" << std::endl;
+        cout << "Time to last byte: p50 " << lastByte.Percentile(50) << " ms, p95 " << lastByte.Percentile(95) << " ms" << std::endl;
+    }
+}
+
+// Speech synthesis of a manifest of texts to audio files, with several synthesizers at the same time.
+void SpeechSynthesisBatchFromManifest()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Riff24Khz16BitMonoPcm);
+
+    // Each line of the manifest is "voice<TAB>output file<TAB>text or SSML", e.g.
+    // en-US-AriaNeural	chapter1_001.wav	It was a bright cold day in April.
+    cout << "Enter the name of the manifest file." << std::endl;
+    cout << "> ";
+    std::string manifestFileName;
+    getline(cin, manifestFileName);
+    if (manifestFileName.empty())
+    {
+        return;
+    }
+
+    // Four synthesizers share a limit of 10 requests per second, lower these to the quota of your subscription.
+    // Run the sample again with the same manifest to continue after it was stopped.
+    SynthesisBatchRenderer::Options options;
+    options.Concurrency = 4;
+    options.RequestsPerSecond = 10;
+    options.CheckpointFileName = manifestFileName + ".checkpoint";
+    SynthesisBatchRenderer renderer(config, options);
+
+    mutex consoleMutex;
+    auto summary = renderer.Run(manifestFileName, [&consoleMutex](const std::string& outputFileName, const std::string& error)
+    {
+        lock_guard<mutex> lock(consoleMutex);
+        if (error.empty())
+        {
+            cout << "Rendered [" << outputFileName << "]" << std::endl;
+        }
+        else
+        {
+            cout << "FAILED: [" << outputFileName << "]: " << error << std::endl;
+        }
+    });
+
+    cout << summary.Rendered << " files rendered, " << summary.Skipped << " already rendered before, " << summary.Failed << " failed." << std::endl;
+}
+
+// Speech synthesis of long text or SSML in chunks of sentences, with the next chunk synthesized while the previous one is played.
+void SpeechSynthesisWithChunkedLongText()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The audio of the chunks is joined into one stream, which needs a raw PCM format.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw24Khz16BitMonoPcm);
+
+    // Creates a speech synthesizer with a null output stream, the audio is passed to a handler instead.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // The first chunk is cut after about 100 characters, later chunks after 600.
+    ChunkedSynthesizer chunkedSynthesizer(synthesizer, 100, 600);
+
+    while (true)
+    {
+        // Receives a long text or SSML from console input.
+        cout << "Enter some long text or SSML that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        // The file stands in for an audio device, which would play each chunk as it arrives.
+        ofstream audioFile("outputaudio.pcm", ios::binary | ios::trunc);
+        mutex consoleMutex;
+        const auto start = chrono::steady_clock::now();
+        bool firstAudio = true;
+
+        ChunkedSynthesizer::Handlers handlers;
+        handlers.Audio = [&](const uint8_t* data, uint32_t size)
+        {
+            if (firstAudio)
+            {
+                lock_guard<mutex> lock(consoleMutex);
+                cout << "First audio after " << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms." << std::endl;
+                firstAudio = false;
+            }
+            audioFile.write(reinterpret_cast<const char*>(data), size);
+        };
+        handlers.OnWordBoundary = [&](const ChunkedSynthesizer::WordBoundary& e)
+        {
+            // The audio offset is in ticks from the start of the whole text, the text offset is a position in the whole text.
+            lock_guard<mutex> lock(consoleMutex);
+            cout << "Word boundary: audio offset " << (e.AudioOffset + 5000) / 10000 << "ms, text offset " << e.TextOffset << ", [" << e.Text << "]" << std::endl;
+        };
+        handlers.OnBookmark = [&](const ChunkedSynthesizer::Bookmark& e)
+        {
+            lock_guard<mutex> lock(consoleMutex);
+            cout << "Bookmark reached: audio offset " << (e.AudioOffset + 5000) / 10000 << "ms, bookmark text [" << e.Text << "]" << std::endl;
+        };
+
+        try
+        {
+            auto chunkCount = chunkedSynthesizer.Speak(text, handlers);
+            cout << "Speech synthesized in " << chunkCount << " chunks, and the audio was saved to [outputaudio.pcm]" << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            cout << "CANCELED: " << e.what() << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Speech synthesis voice selection from a catalog, which is fetched once and kept in a file.
+void SpeechSynthesisVoiceSelectionFromCatalog()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer, which is only used to fetch the list of voices.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // The list is fetched once a day, and the next run of the sample starts from "voices.cache".
+    VoiceCatalog::Options options;
+    options.TimeToLive = chrono::hours(24);
+    options.CacheFileName = "voices.cache";
+    unique_ptr<VoiceCatalog> catalog;
+    try
+    {
+        catalog.reset(new VoiceCatalog(synthesizer, options));
+    }
+    catch (const std::runtime_error& e)
+    {
+        cout << "CANCELED: " << e.what() << std::endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        return;
+    }
+    cout << catalog->Count() << " voices in the catalog." << std::endl;
+
+    while (true)
+    {
+        // Looks up voices without a network call.
+        cout << "Enter a locale (e.g. en-US) and optionally a gender (Female or Male), or a style prefixed by '@' (e.g. @cheerful), or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        VoiceCatalog::VoiceList voices;
+        if (text[0] == '@')
+        {
+            voices = catalog->FindByStyle(text.substr(1));
+        }
+        else
+        {
+            const auto space = text.find(' ');
+            voices = space == string::npos ? catalog->FindByLocale(text) : catalog->FindByLocale(text.substr(0, space), text.substr(space + 1));
+        }
+
+        cout << voices->size() << " voices found:" << std::endl;
+        for (const auto& voice : *voices)
+        {
+            cout << voice->ShortName << " (" << voice->Gender << ", " << voice->Styles.size() << " styles)" << endl;
+        }
+    }
+}
+
+// Speech synthesis with word boundary, viseme and bookmark events recorded to a compact binary log.
+void SpeechSynthesisEventsToBinaryLog()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer with a null output stream, the events are recorded and the audio is not needed.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+    // Room for 64K events is allocated up front, so that the event handlers do not allocate.
+    SynthesisEventLog eventLog(64 * 1024);
+    synthesizer->WordBoundary += [&eventLog](const SpeechSynthesisWordBoundaryEventArgs& e)
+    {
+        eventLog.AddWordBoundary(e.AudioOffset, e.TextOffset, e.WordLength);
+    };
+    synthesizer->VisemeReceived += [&eventLog](const SpeechSynthesisVisemeEventArgs& e)
+    {
+        eventLog.AddViseme(e.AudioOffset, e.VisemeId);
+    };
+    synthesizer->BookmarkReached += [&eventLog](const SpeechSynthesisBookmarkEventArgs& e)
+    {
+        eventLog.AddBookmark(e.AudioOffset, e.Text);
+    };
+
+    const auto ssml = "<speak version='1.0' xml:lang='en-US' xmlns='http://www.w3.org/2001/10/synthesis' xmlns:mstts='http://www.w3.org/2001/mstts'><voice name='Microsoft Server Speech Text to Speech Voice (en-US, AriaNeural)'><bookmark mark='wave'/> Hello there. <bookmark mark='smile'/> Nice to meet you.</voice></speak>";
+
+    cout << "Press Enter to start synthesizing." << std::endl;
+    std::string text;
+    getline(cin, text);
+    const auto result = synthesizer->SpeakSsmlAsync(ssml).get();
+
+    if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+        cout << "CANCELED: Reason=" << static_cast<int>(cancellation->Reason) << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << static_cast<int>(cancellation->ErrorCode) << std::endl;
+            cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+        return;
+    }
+
+    try
+    {
+        eventLog.Save("synthesis_events.bin");
+    }
+    catch (const std::runtime_error& e)
+    {
+        cout << e.what() << std::endl;
+        return;
+    }
+    cout << eventLog.Count() << " events were saved to [synthesis_events.bin], " << eventLog.Dropped() << " were dropped." << std::endl;
+
+    // This is how the animation process reads the log, the mapped file is read in place and not copied.
+    SynthesisEventLogView view;
+    if (!view.Open("synthesis_events.bin"))
+    {
+        cout << "Cannot read [synthesis_events.bin]." << std::endl;
+        return;
+    }
+    for (size_t i = 0; i < view.Count(); i++)
+    {
+        // The unit of the audio offset is tick (1 tick = 100 nanoseconds), divide by 10,000 to convert to milliseconds.
+        cout << view.AudioOffsets()[i] / 10000 << "ms: ";
+        switch (view.Kinds()[i])
+        {
+        case SynthesisEventKind::WordBoundary:
+            cout << "word at text offset " << view.TextOffsets()[i] << ", length " << view.Lengths()[i] << endl;
+            break;
+        case SynthesisEventKind::Viseme:
+            cout << "viseme " << view.VisemeIds()[i] << endl;
+            break;
+        case SynthesisEventKind::Bookmark:
+            cout << "bookmark [" << view.BookmarkText(i) << "]" << endl;
+            break;
+        }
+    }
+}
+
+// Speech synthesis to several outputs at once: the caller, an archive file and a quality monitor.
+void SpeechSynthesisToMultipleSinks()
+{
+    // Writes the audio to a file as it arrives, the archive of the call.
+    class ArchiveFileCallback final : public PushAudioOutputStreamCallback
+    {
+    public:
+        explicit ArchiveFileCallback(const string& fileName)
+            : m_file(fileName, ios::binary)
+        {
+        }
+
+        int Write(uint8_t* dataBuffer, uint32_t size) override
+        {
+            m_file.write(reinterpret_cast<const char*>(dataBuffer), size);
+            return (int)size;
+        }
+
+        void Close() override
+        {
+            m_file.close();
+        }
+
+    private:
+        ofstream m_file;
+    };
+
+    // Tracks the peak level of the 16-bit audio, as a quality monitor would before it sends the audio on.
+    class LevelMonitorCallback final : public PushAudioOutputStreamCallback
+    {
+    public:
+        int Write(uint8_t* dataBuffer, uint32_t size) override
+        {
+            for (uint32_t i = 0; i + 1 < size; i += 2)
+            {
+                const int sample = (int16_t)(dataBuffer[i] | (dataBuffer[i + 1] << 8));
+                m_peak = max(m_peak.load(), abs(sample));
+            }
+            return (int)size;
+        }
+
+        void Close() override
+        {
+        }
+
+        int Peak() const
+        {
+            return m_peak;
+        }
+
+    private:
+        atomic<int> m_peak{ 0 };
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // The caller gets at most 1 second of queued audio (16 kHz 16-bit mono), it drops older audio if it falls behind.
+    // The archive and the monitor keep all audio, and a slow disk does not delay the caller.
+    auto caller = make_shared<PooledAudioOutputCallback>(make_shared<AudioChunkPool>(16 * 1024));
+    auto archive = make_shared<ArchiveFileCallback>("outputaudio.pcm");
+    auto monitor = make_shared<LevelMonitorCallback>();
+    auto fanOut = make_shared<FanOutAudioOutputCallback>();
+    const size_t callerSink = fanOut->AddSink(caller, 32000);
+    const size_t archiveSink = fanOut->AddSink(archive);
+    const size_t monitorSink = fanOut->AddSink(monitor);
+
+    // Creates a speech synthesizer using audio stream output.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, AudioConfig::FromStreamOutput(AudioOutputStream::CreatePushStream(fanOut)));
+
+    while (true)
+    {
+        // Receives a text from console input and synthesize it to all outputs.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        auto result = synthesizer->SpeakTextAsync(text).get();
+
+        // Checks result.
+        if (result->Reason == ResultReason::SynthesizingAudioCompleted)
+        {
+            // Waits until every output has the whole utterance.
+            fanOut->Flush();
+            cout << "Speech synthesized for text [" << text << "], peak level " << monitor->Peak() << "." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+
+    fanOut->Flush();
+    const char* names[] = { "caller", "archive", "monitor" };
+    for (size_t sink : { callerSink, archiveSink, monitorSink })
+    {
+        const auto statistics = fanOut->Statistics(sink);
+        cout << names[sink] << ": " << statistics.Bytes << " bytes, " << statistics.DroppedBytes << " dropped, at most "
+            << statistics.MaxQueuedBytes << " queued." << std::endl;
+    }
+    cout << "The outputs shared " << fanOut->AllocatedChunks() << " audio buffers, the archive was written to [outputaudio.pcm]." << std::endl;
+}
+
+// Speech synthesis of the likely next prompts of a dialog while the caller answers, so that the chosen one plays at once.
+void SpeechSynthesisWithPrefetchedPrompts()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetSpeechSynthesisVoiceName("en-US-AriaNeural");
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Riff24Khz16BitMonoPcm);
+
+    // Creates a speech synthesizer with a null output stream, the audio is taken from the cache.
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+    SynthesisCache cache(synthesizer, SynthesisCache::Options());
+
+    // Holds at most 4 MB of prompts that have not been played yet.
+    SpeculativeSynthesizer::Options options;
+    options.MaxReadyBytes = 4 * 1024 * 1024;
+    SpeculativeSynthesizer speculative(cache, options);
+
+    const string menu = "Welcome. Say billing, or say support.";
+    const string billing = "Connecting you to billing. Please have your account number ready.";
+    const string support = "Connecting you to support. Please describe your problem after the tone.";
+    const string retry = "Sorry, I did not get that. Say billing, or say support.";
+
+    while (true)
+    {
+        try
+        {
+            // The menu is played while the synthesizer is busy, so nothing is synthesized ahead meanwhile.
+            speculative.Pause();
+            auto audio = speculative.SpeakText(menu);
+            cout << "Playing [" << menu << "], " << audio->GetAudioData().size() << " bytes." << std::endl;
+
+            // The answer is one of three prompts, they are synthesized while the caller speaks.
+            speculative.Predict({ billing, support, retry });
+            speculative.Resume();
+
+            // The console input stands for the recognized answer of the caller.
+            cout << "Enter billing or support, or enter empty text to exit." << std::endl;
+            cout << "> ";
+            string answer;
+            getline(cin, answer);
+            if (answer.empty())
+            {
+                break;
+            }
+            const string& next = answer.find("billing") != string::npos ? billing : answer.find("support") != string::npos ? support : retry;
+
+            speculative.Pause();
+            const auto start = chrono::steady_clock::now();
+            audio = speculative.SpeakText(next);
+            const auto milliseconds = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            cout << "Playing [" << next << "], " << audio->GetAudioData().size() << " bytes, ready after " << milliseconds << " ms." << std::endl;
+        }
+        catch (const std::runtime_error& e)
+        {
+            cout << "CANCELED: " << e.what() << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            break;
+        }
+    }
+
+    auto statistics = speculative.GetStatistics();
+    cout << "Prompts played from a prediction: " << statistics.Hits << ", synthesized when played: " << statistics.Misses << std::endl;
+    cout << "Predictions synthesized: " << statistics.Speculated << ", not played: " << statistics.Wasted << " (" << statistics.WastedBytes
+        << " bytes), canceled: " << statistics.Canceled << std::endl;
+}
+
+// Speech synthesis to push audio output stream, collected in pooled chunks and written to a file in one gather write.
+void SpeechSynthesisToPushAudioOutputStreamWithPooledChunks()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates an instance of a callback class inherited from PushAudioOutputStreamCallback, which collects the
+    // audio in chunks of 16 KB from a pool. The pool can be shared by the callbacks of many synthesizers.
+    auto pool = std::make_shared<AudioChunkPool>(16 * 1024);
+    auto callback = std::make_shared<PooledAudioOutputCallback>(pool);
+
+    // Creates an audio out stream from the callback.
+    auto stream = AudioOutputStream::CreatePushStream(callback);
+
+    // Creates a speech synthesizer using audio stream output.
+    auto streamConfig = AudioConfig::FromStreamOutput(stream);
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, streamConfig);
+
+    // Marks the synthesis events on the timeline next to the writes to the callback, when tracing is enabled.
+    synthesizer->SynthesisStarted.Connect([](const SpeechSynthesisEventArgs&)
+    {
+        TraceRecorder::Instant("synthesis", "SynthesisStarted");
+    });
+    synthesizer->Synthesizing.Connect([](const SpeechSynthesisEventArgs& e)
+    {
+        TraceRecorder::Instant("synthesis", "Synthesizing", "size", (int64_t)e.Result->GetAudioLength());
+    });
+    synthesizer->SynthesisCompleted.Connect([](const SpeechSynthesisEventArgs&)
+    {
+        TraceRecorder::Instant("synthesis", "SynthesisCompleted");
+    });
+
+    while (true)
+    {
+        // Receives a text from console input and synthesize it to push audio output stream.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        auto result = synthesizer->SpeakTextAsync(text).get();
+
+        // Checks result.
+        if (result->Reason == ResultReason::SynthesizingAudioCompleted)
+        {
+            cout << "Speech synthesized for text [" << text << "], and the audio was written to output stream." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+
+    cout << "Totally " << callback->Size() << " bytes received in " << callback->Segments().size() << " chunks." << endl;
+
+    // Writes the chunks to a file as they are, with no copy into a single buffer.
+    if (callback->SaveToFile("outputaudio.pcm"))
+    {
+        cout << "Audio data was saved to [outputaudio.pcm]" << endl;
+    }
+}
@@ -0,0 +1,106 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Lock-free byte ring buffer for exactly one producer thread and one consumer thread.
+// Write() must only be called from the producer and Read() only from the consumer.
+class SpscRingBuffer final
+{
+public:
+    // Creates a buffer holding up to 'capacity' bytes, rounded up to the next power of two.
+    explicit SpscRingBuffer(size_t capacity)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument("Ring buffer capacity must be at least 1 byte");
+        }
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // Copies up to 'size' bytes into the buffer without blocking.
+    // Returns the number of bytes written, which is less than 'size' if the buffer is full.
+    size_t Write(const uint8_t* data, size_t size)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t space = Capacity() - (head - tail);
+        const size_t count = size < space ? size : space;
+
+        // Copies in up to two pieces, as the free space may wrap around the end of the buffer.
+        const size_t start = head & m_mask;
+        const size_t first = count < m_buffer.size() - start ? count : m_buffer.size() - start;
+        memcpy(m_buffer.data() + start, data, first);
+        memcpy(m_buffer.data(), data + first, count - first);
+        m_head.store(head + count, std::memory_order_release);
+
+        // Only the producer updates the high-water mark, so a plain load and store is enough.
+        const size_t used = head + count - tail;
+        if (used > m_highWaterMark.load(std::memory_order_relaxed))
+        {
+            m_highWaterMark.store(used, std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    // Copies up to 'size' bytes out of the buffer without blocking.
+    // Returns the number of bytes read, 0 if the buffer is empty.
+    size_t Read(uint8_t* data, size_t size)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t available = head - tail;
+        const size_t count = size < available ? size : available;
+
+        const size_t start = tail & m_mask;
+        const size_t first = count < m_buffer.size() - start ? count : m_buffer.size() - start;
+        memcpy(data, m_buffer.data() + start, first);
+        memcpy(data + first, m_buffer.data(), count - first);
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Returns the number of bytes currently stored. Exact when called from the producer or consumer,
+    // an estimate from any other thread.
+    size_t Size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const
+    {
+        return m_buffer.size();
+    }
+
+    // Returns the largest number of bytes that has been stored at once, useful to size the buffer.
+    size_t HighWaterMark() const
+    {
+        return m_highWaterMark.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<uint8_t> m_buffer;
+    size_t m_mask = 0;
+
+    // Positions only grow, the index into the buffer is taken with m_mask. The producer owns m_head
+    // and the consumer owns m_tail, they sit on separate cache lines to avoid false sharing.
+    alignas(64) std::atomic<size_t> m_head{ 0 };
+    alignas(64) std::atomic<size_t> m_tail{ 0 };
+    alignas(64) std::atomic<size_t> m_highWaterMark{ 0 };
+};
@@ -9,6 +9,9 @@
 #include <speechapi_cxx.h>
 #include <fstream>
 #include "wav_file_reader.h"
+#include "paced_wav_file_reader.h"
+#include "session_completion.h"
+#include "caller_language_detector.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -136,8 +139,8 @@ void StandaloneLanguageDetectionInContinuousModeWithFileInput()
     auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
     auto recognizer = SourceLanguageRecognizer::FromConfig(config, autoDetectSourceLanguageConfig, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Recognized.Connect([] (const SpeechRecognitionEventArgs& e)
@@ -165,21 +168,21 @@ void StandaloneLanguageDetectionInContinuousModeWithFileInput()
                  << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
                  << "CANCELED: Did you update the subscription info?" << std::endl;
 
-            recognitionEnd.set_value(); // Notify to stop recognition.
+            recognitionEnd.Complete(); // Notify to stop recognition.
         }
     });
 
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
     {
         cout << "Session stopped.";
-        recognitionEnd.set_value(); // Notify to stop recognition.
+        recognitionEnd.Complete(); // Notify to stop recognition.
     });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
@@ -203,8 +206,8 @@ void StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput()
     auto audioInput = AudioConfig::FromWavFileInput("en-us_zh-cn.wav");
     auto recognizer = SourceLanguageRecognizer::FromConfig(config, autoDetectSourceLanguageConfig, audioInput);
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Subscribes to events.
     recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
@@ -232,23 +235,75 @@ void StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput()
                     << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
                     << "CANCELED: Did you update the subscription info?" << std::endl;
 
-                recognitionEnd.set_value(); // Notify to stop recognition.
+                recognitionEnd.Complete(); // Notify to stop recognition.
             }
         });
 
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
         {
             cout << "Session stopped.";
-            recognitionEnd.set_value(); // Notify to stop recognition.
+            recognitionEnd.Complete(); // Notify to stop recognition.
         });
 
     // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
     // </StandaloneLanguageDetectionInContinuousModeWithMultiLingualFileInput>
 }
+
+// Standalone language detection of callers, stopping the upload as soon as the language is detected with high
+// confidence, and remembering the language of each caller for repeat calls.
+void StandaloneLanguageDetectionOfCallersWithEarlyExit()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Results as early as possible, so the detection can stop early.
+    config->SetProperty(PropertyId::SpeechServiceConnection_ContinuousLanguageIdPriority, "Latency");
+    auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "de-DE" });
+
+    // Callers are remembered for 30 days.
+    CallerLanguageCache cache;
+    CallerLanguageDetector detector(config, autoDetectSourceLanguageConfig, cache, CallerLanguageDetector::Confidence::High);
+
+    // Two calls of the same caller, the second one is answered from the cache.
+    for (int call = 0; call < 2; call++)
+    {
+        try
+        {
+            // The file stands in for a live call, so it is read in real time.
+            // Replace with your own audio file name and caller id.
+            PacedWavFileReader reader("whatstheweatherlike.wav");
+            auto detection = detector.Detect("+15550100",
+                [&reader](uint8_t* dataBuffer, uint32_t size) { return reader.Read(dataBuffer, size); },
+                reader.Format());
+
+            if (!detection.Error.empty())
+            {
+                cout << "CANCELED: ErrorDetails=" << detection.Error << "\n"
+                     << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+            else if (detection.Language.empty())
+            {
+                cout << "NOMATCH: The language could not be detected." << std::endl;
+            }
+            else
+            {
+                cout << "DETECTED " << detection.Language << (detection.FromCache ? " from the cache" : "")
+                     << ", after " << detection.BytesSent << " bytes of audio" << std::endl;
+            }
+        }
+        catch (const exception& e)
+        {
+            cout << "Exit due to exception: " << e.what() << std::endl;
+            return;
+        }
+    }
+    cout << "Cache hits: " << cache.Hits() << ", misses: " << cache.Misses() << std::endl;
+}
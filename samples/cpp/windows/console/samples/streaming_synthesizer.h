@@ -0,0 +1,100 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Forwards synthesized audio to a sink while it is being synthesized, instead of after the whole result has
+// arrived. Synthesis is started with StartSpeakingTextAsync(), which returns as soon as the first audio is
+// available, and the audio is read from an AudioDataStream chunk by chunk. For a bot, this is the difference
+// between starting to play after the first chunk and after the whole reply.
+class StreamingSynthesizer final
+{
+public:
+    // Receives each chunk of audio as soon as it has been read from the stream.
+    using Sink = std::function<void(const uint8_t* data, uint32_t size)>;
+
+    // Milliseconds from the start of the request to the first and to the last byte passed to the sink.
+    struct Timings
+    {
+        double FirstByteMs = -1;
+        double LastByteMs = -1;
+        uint64_t Bytes = 0;
+    };
+
+    // 'chunkSize' is the most audio passed to the sink at once, smaller chunks reach the sink earlier.
+    explicit StreamingSynthesizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer, uint32_t chunkSize = 4096)
+        : m_synthesizer(std::move(synthesizer)), m_buffer(chunkSize)
+    {
+        if (m_synthesizer == nullptr)
+        {
+            throw std::invalid_argument("Synthesizer is null");
+        }
+        if (chunkSize == 0)
+        {
+            throw std::invalid_argument("Chunk size must be at least 1");
+        }
+    }
+
+    // Synthesizes the text and returns when all audio has been passed to the sink.
+    // Throws std::runtime_error if synthesis is canceled, the sink may have received part of the audio then.
+    Timings SpeakText(const std::string& text, const Sink& sink)
+    {
+        return Speak(text, false, sink);
+    }
+
+    Timings SpeakSsml(const std::string& ssml, const Sink& sink)
+    {
+        return Speak(ssml, true, sink);
+    }
+
+private:
+    Timings Speak(const std::string& input, bool ssml, const Sink& sink)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        const auto start = std::chrono::steady_clock::now();
+        auto millisecondsSinceStart = [start]()
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        auto result = ssml ? m_synthesizer->StartSpeakingSsmlAsync(input).get() : m_synthesizer->StartSpeakingTextAsync(input).get();
+        if (result->Reason == ResultReason::Canceled)
+        {
+            throw std::runtime_error("Synthesis canceled: " + SpeechSynthesisCancellationDetails::FromResult(result)->ErrorDetails);
+        }
+
+        // ReadData() waits for more audio, and returns 0 once synthesis has ended.
+        auto stream = AudioDataStream::FromResult(result);
+        Timings timings;
+        uint32_t read;
+        while ((read = stream->ReadData(m_buffer.data(), (uint32_t)m_buffer.size())) > 0)
+        {
+            if (timings.FirstByteMs < 0)
+            {
+                timings.FirstByteMs = millisecondsSinceStart();
+            }
+            sink(m_buffer.data(), read);
+            timings.Bytes += read;
+        }
+        timings.LastByteMs = millisecondsSinceStart();
+
+        if (stream->GetStatus() == StreamStatus::Canceled)
+        {
+            throw std::runtime_error("Synthesis canceled: " + SpeechSynthesisCancellationDetails::FromStream(stream)->ErrorDetails);
+        }
+        return timings;
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> m_synthesizer;
+    std::vector<uint8_t> m_buffer;
+};
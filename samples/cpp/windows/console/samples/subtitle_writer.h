@@ -0,0 +1,85 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+// Writes a subtitle file cue by cue, as SubRip (.srt) or WebVTT (.vtt), with the times of the recognition results:
+// a cue starts at the result's Offset() and lasts its Duration(), both in ticks of 100 ns. Each cue is flushed
+// when it is added, so the file of a long recording can be watched while it is translated.
+class SubtitleWriter final
+{
+public:
+    enum class Format { SubRip, WebVtt };
+
+    // Throws std::runtime_error if the file cannot be created.
+    SubtitleWriter(const std::string& fileName, Format format)
+        : m_fileName(fileName), m_format(format), m_file(fileName, std::ios::binary | std::ios::trunc)
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot create subtitle file " + fileName);
+        }
+        if (format == Format::WebVtt)
+        {
+            m_file << "WEBVTT\n\n";
+        }
+    }
+
+    SubtitleWriter(const SubtitleWriter&) = delete;
+    SubtitleWriter& operator=(const SubtitleWriter&) = delete;
+
+    // The file extension of a format, with the dot.
+    static const char* Extension(Format format)
+    {
+        return format == Format::SubRip ? ".srt" : ".vtt";
+    }
+
+    // Adds a cue, cues must be added in order. Empty texts are skipped. Throws std::runtime_error if it cannot be written.
+    void Add(uint64_t offset, uint64_t duration, const std::string& text)
+    {
+        if (text.empty())
+        {
+            return;
+        }
+        m_cues++;
+        if (m_format == Format::SubRip)
+        {
+            m_file << m_cues << "\n";
+        }
+        m_file << Timestamp(offset) << " --> " << Timestamp(offset + duration) << "\n" << text << "\n\n";
+        m_file.flush();
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot write to subtitle file " + m_fileName);
+        }
+    }
+
+    size_t Cues() const
+    {
+        return m_cues;
+    }
+
+private:
+    // HH:MM:SS,mmm for SubRip and HH:MM:SS.mmm for WebVTT.
+    std::string Timestamp(uint64_t ticks) const
+    {
+        const uint64_t milliseconds = ticks / 10000;
+        char text[32];
+        snprintf(text, sizeof(text), "%02llu:%02llu:%02llu%c%03llu", (unsigned long long)(milliseconds / 3600000),
+            (unsigned long long)(milliseconds / 60000 % 60), (unsigned long long)(milliseconds / 1000 % 60),
+            m_format == Format::SubRip ? ',' : '.', (unsigned long long)(milliseconds % 1000));
+        return text;
+    }
+
+    const std::string m_fileName;
+    const Format m_format;
+    std::ofstream m_file;
+    size_t m_cues = 0;
+};
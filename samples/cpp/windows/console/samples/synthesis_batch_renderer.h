@@ -0,0 +1,358 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders a manifest of texts to audio files with a fixed number of synthesizers working at the same time.
+//
+// Each line of the manifest is "voice<TAB>output file<TAB>text", where text that starts with "<speak" is SSML
+// and used as is. Empty lines and lines starting with '#' are skipped. Plain text is wrapped in SSML with the
+// voice of its line, so that each synthesizer can render any voice and keeps its connection for all lines.
+//
+// Requests are started no faster than RequestsPerSecond, and throttled requests (TooManyRequests) are retried
+// with exponential backoff, so that the batch stays within the quota of the subscription. Audio files are
+// written on a separate thread, first to "<file>.part" and then renamed, and each rendered file is appended
+// to the checkpoint file. A batch that is run again skips the files in the checkpoint, so it continues where
+// a crashed or stopped run has left off.
+class SynthesisBatchRenderer final
+{
+public:
+    struct Options
+    {
+        size_t Concurrency = 4;
+        double RequestsPerSecond = 10;
+        uint32_t MaxRetries = 5;
+        // Lists the output files that have been rendered, empty to render all files every time.
+        std::string CheckpointFileName;
+    };
+
+    struct Summary
+    {
+        size_t Rendered = 0;
+        size_t Skipped = 0;
+        size_t Failed = 0;
+    };
+
+    // Reports the progress of each line, on the thread that rendered or wrote it. 'error' is empty on success.
+    using ProgressHandler = std::function<void(const std::string& outputFileName, const std::string& error)>;
+
+    SynthesisBatchRenderer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const Options& options)
+        : m_config(std::move(config)), m_options(options)
+    {
+        if (m_config == nullptr)
+        {
+            throw std::invalid_argument("Config is null");
+        }
+        if (options.Concurrency == 0 || options.RequestsPerSecond <= 0)
+        {
+            throw std::invalid_argument("Concurrency and requests per second must be positive");
+        }
+    }
+
+    SynthesisBatchRenderer(const SynthesisBatchRenderer&) = delete;
+    SynthesisBatchRenderer& operator=(const SynthesisBatchRenderer&) = delete;
+
+    // Renders all lines of the manifest that are not in the checkpoint, and returns when all files are written.
+    Summary Run(const std::string& manifestFileName, ProgressHandler onProgress = nullptr)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        std::vector<Job> jobs = ReadManifest(manifestFileName);
+        const std::set<std::string> done = ReadCheckpoint();
+
+        m_jobs.clear();
+        m_summary = Summary();
+        for (auto& job : jobs)
+        {
+            if (done.count(job.OutputFileName) != 0)
+            {
+                m_summary.Skipped++;
+            }
+            else
+            {
+                m_jobs.push_back(std::move(job));
+            }
+        }
+        m_onProgress = std::move(onProgress);
+        m_nextJob = 0;
+        m_nextStart = std::chrono::steady_clock::now();
+        m_writerDone = false;
+
+        if (!m_options.CheckpointFileName.empty())
+        {
+            m_checkpoint.open(m_options.CheckpointFileName, std::ios::app);
+            if (!m_checkpoint)
+            {
+                throw std::runtime_error("Cannot open checkpoint file " + m_options.CheckpointFileName);
+            }
+        }
+
+        // Synthesizers are created here rather than by the workers, and write to no device, the audio is taken from the results.
+        std::vector<std::shared_ptr<SpeechSynthesizer>> synthesizers;
+        for (size_t i = 0; i < std::min(m_options.Concurrency, m_jobs.size()); i++)
+        {
+            synthesizers.push_back(SpeechSynthesizer::FromConfig(m_config, nullptr));
+        }
+
+        std::thread writer(&SynthesisBatchRenderer::WriteFiles, this);
+        std::vector<std::thread> workers;
+        for (auto& synthesizer : synthesizers)
+        {
+            workers.emplace_back(&SynthesisBatchRenderer::Render, this, synthesizer);
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writerDone = true;
+        }
+        m_changed.notify_all();
+        writer.join();
+        m_checkpoint.close();
+        return m_summary;
+    }
+
+private:
+    struct Job
+    {
+        std::string Voice;
+        std::string OutputFileName;
+        std::string Text;
+    };
+
+    struct RenderedFile
+    {
+        std::string OutputFileName;
+        std::shared_ptr<std::vector<uint8_t>> Audio;
+    };
+
+    static std::vector<Job> ReadManifest(const std::string& manifestFileName)
+    {
+        std::ifstream manifest(manifestFileName);
+        if (!manifest)
+        {
+            throw std::runtime_error("Cannot open manifest " + manifestFileName);
+        }
+        std::vector<Job> jobs;
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(manifest, line))
+        {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            const size_t first = line.find('\t');
+            const size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+            if (second == std::string::npos)
+            {
+                throw std::runtime_error("Line " + std::to_string(lineNumber) + " of " + manifestFileName + " is not voice<TAB>output file<TAB>text");
+            }
+            jobs.push_back(Job{ line.substr(0, first), line.substr(first + 1, second - first - 1), line.substr(second + 1) });
+        }
+        return jobs;
+    }
+
+    std::set<std::string> ReadCheckpoint() const
+    {
+        std::set<std::string> done;
+        if (m_options.CheckpointFileName.empty())
+        {
+            return done;
+        }
+        std::ifstream checkpoint(m_options.CheckpointFileName);
+        std::string line;
+        while (std::getline(checkpoint, line))
+        {
+            // A file is only done if it still exists, a line cut short by a crash names no file.
+            if (std::ifstream(line).good())
+            {
+                done.insert(line);
+            }
+        }
+        return done;
+    }
+
+    static std::string ToSsml(const Job& job)
+    {
+        if (job.Text.compare(0, 6, "<speak") == 0)
+        {
+            return job.Text;
+        }
+        std::string escaped;
+        for (char c : job.Text)
+        {
+            switch (c)
+            {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            case '\'': escaped += "&apos;"; break;
+            default: escaped += c; break;
+            }
+        }
+        // The language of the voice is part of its name, e.g. en-US-AriaNeural.
+        const std::string language = job.Voice.size() >= 5 ? job.Voice.substr(0, 5) : "en-US";
+        return "<speak version='1.0' xmlns='http://www.w3.org/2001/10/synthesis' xml:lang='" + language + "'><voice name='" + job.Voice + "'>" + escaped + "</voice></speak>";
+    }
+
+    // Waits for the next request slot of the rate limit.
+    void WaitForStart()
+    {
+        std::chrono::steady_clock::time_point start;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            start = std::max(m_nextStart, std::chrono::steady_clock::now());
+            m_nextStart = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / m_options.RequestsPerSecond));
+        }
+        std::this_thread::sleep_until(start);
+    }
+
+    void Render(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        while (true)
+        {
+            const size_t index = m_nextJob++;
+            if (index >= m_jobs.size())
+            {
+                return;
+            }
+            const Job& job = m_jobs[index];
+            const std::string ssml = ToSsml(job);
+
+            std::string error;
+            std::shared_ptr<std::vector<uint8_t>> audio;
+            auto backoff = std::chrono::milliseconds(500);
+            for (uint32_t attempt = 0; attempt <= m_options.MaxRetries; attempt++)
+            {
+                WaitForStart();
+                auto result = synthesizer->SpeakSsmlAsync(ssml).get();
+                if (result->Reason == ResultReason::SynthesizingAudioCompleted)
+                {
+                    audio = result->GetAudioData();
+                    error.clear();
+                    break;
+                }
+                auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+                error = cancellation->ErrorDetails;
+                const bool retry = cancellation->ErrorCode == CancellationErrorCode::TooManyRequests
+                    || cancellation->ErrorCode == CancellationErrorCode::ServiceUnavailable
+                    || cancellation->ErrorCode == CancellationErrorCode::ConnectionFailure;
+                if (!retry)
+                {
+                    break;
+                }
+                std::this_thread::sleep_for(backoff);
+                backoff *= 2;
+            }
+
+            if (audio == nullptr)
+            {
+                Report(job.OutputFileName, error.empty() ? "Synthesis failed" : error);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this]() { return m_written.size() < 2 * m_options.Concurrency; });
+            m_written.push_back(RenderedFile{ job.OutputFileName, audio });
+            m_changed.notify_all();
+        }
+    }
+
+    void WriteFiles()
+    {
+        while (true)
+        {
+            RenderedFile file;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this]() { return m_writerDone || !m_written.empty(); });
+                if (m_written.empty())
+                {
+                    return;
+                }
+                file = std::move(m_written.front());
+                m_written.pop_front();
+            }
+            m_changed.notify_all();
+
+            const std::string partFileName = file.OutputFileName + ".part";
+            {
+                std::ofstream output(partFileName, std::ios::binary | std::ios::trunc);
+                output.write(reinterpret_cast<const char*>(file.Audio->data()), (std::streamsize)file.Audio->size());
+                output.close();
+                if (!output)
+                {
+                    Report(file.OutputFileName, "Cannot write " + partFileName);
+                    continue;
+                }
+            }
+            std::remove(file.OutputFileName.c_str());
+            if (std::rename(partFileName.c_str(), file.OutputFileName.c_str()) != 0)
+            {
+                Report(file.OutputFileName, "Cannot rename " + partFileName);
+                continue;
+            }
+            if (m_checkpoint.is_open())
+            {
+                m_checkpoint << file.OutputFileName << std::endl;
+            }
+            Report(file.OutputFileName, "");
+        }
+    }
+
+    void Report(const std::string& outputFileName, const std::string& error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            (error.empty() ? m_summary.Rendered : m_summary.Failed)++;
+        }
+        if (m_onProgress)
+        {
+            m_onProgress(outputFileName, error);
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    Options m_options;
+
+    std::vector<Job> m_jobs;
+    std::atomic<size_t> m_nextJob{ 0 };
+    ProgressHandler m_onProgress;
+    std::ofstream m_checkpoint;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::chrono::steady_clock::time_point m_nextStart;
+    // Rendered audio waiting to be written, at most two files per synthesizer so that memory stays bounded.
+    std::deque<RenderedFile> m_written;
+    bool m_writerDone = false;
+    Summary m_summary;
+};
@@ -0,0 +1,377 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Synthesized audio served from a SynthesisCache. Reads like an AudioDataStream, but from memory that is
+// shared with the cache, so a hit neither calls the service nor copies the audio.
+class CachedAudioStream final
+{
+public:
+    explicit CachedAudioStream(std::shared_ptr<const std::vector<uint8_t>> audioData, bool fromCache)
+        : m_audioData(std::move(audioData)), m_fromCache(fromCache)
+    {
+    }
+
+    // Reads up to 'size' bytes from the current position, returns 0 at the end of the audio.
+    uint32_t ReadData(uint8_t* buffer, uint32_t size)
+    {
+        const uint32_t count = (uint32_t)std::min<size_t>(size, m_audioData->size() - m_position);
+        memcpy(buffer, m_audioData->data() + m_position, count);
+        m_position += count;
+        return count;
+    }
+
+    bool CanReadData(uint32_t bytesRequested) const
+    {
+        return m_audioData->size() - m_position >= bytesRequested;
+    }
+
+    uint32_t GetPosition() const
+    {
+        return (uint32_t)m_position;
+    }
+
+    void SetPosition(uint32_t position)
+    {
+        m_position = std::min<size_t>(position, m_audioData->size());
+    }
+
+    // Returns all of the audio, in the output format of the synthesizer.
+    const std::vector<uint8_t>& GetAudioData() const
+    {
+        return *m_audioData;
+    }
+
+    // Returns true if the audio was not synthesized for this request.
+    bool FromCache() const
+    {
+        return m_fromCache;
+    }
+
+private:
+    std::shared_ptr<const std::vector<uint8_t>> m_audioData;
+    bool m_fromCache;
+    size_t m_position = 0;
+};
+
+// Cache in front of a SpeechSynthesizer for prompts that are spoken over and over, e.g. by an IVR.
+// Audio is keyed by the normalized text or SSML, the voice and the output format of the synthesizer. Recent
+// audio is kept in memory up to a byte limit and evicted least recently used first. If a directory is given,
+// all audio is also written there, one file per key in the output format, so it survives restarts and can be
+// shared by processes. Concurrent requests for the same key wait for a single synthesis.
+class SynthesisCache final
+{
+public:
+    struct Options
+    {
+        size_t MemoryLimitBytes = 64 * 1024 * 1024;
+        // Directory of the disk tier, empty to keep audio in memory only.
+        std::string Directory;
+    };
+
+    struct Statistics
+    {
+        uint64_t MemoryHits = 0;
+        uint64_t DiskHits = 0;
+        uint64_t Misses = 0;
+        // Audio held in memory, and audio written to the disk tier or synthesized by this process.
+        uint64_t MemoryBytes = 0;
+        uint64_t DiskBytesWritten = 0;
+        uint64_t SynthesizedBytes = 0;
+        // Audio served without synthesis.
+        uint64_t HitBytes = 0;
+
+        double HitRate() const
+        {
+            const uint64_t requests = MemoryHits + DiskHits + Misses;
+            return requests == 0 ? 0 : (double)(MemoryHits + DiskHits) / requests;
+        }
+    };
+
+    SynthesisCache(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer, const Options& options)
+        : m_synthesizer(std::move(synthesizer)), m_options(options)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        if (m_synthesizer == nullptr)
+        {
+            throw std::invalid_argument("Synthesizer is null");
+        }
+        m_voice = m_synthesizer->Properties.GetProperty(PropertyId::SpeechServiceConnection_SynthVoice);
+        m_outputFormat = m_synthesizer->Properties.GetProperty(PropertyId::SpeechServiceConnection_SynthOutputFormat);
+        if (!m_options.Directory.empty())
+        {
+#ifdef _WIN32
+            _mkdir(m_options.Directory.c_str());
+#else
+            mkdir(m_options.Directory.c_str(), 0755);
+#endif
+        }
+    }
+
+    SynthesisCache(const SynthesisCache&) = delete;
+    SynthesisCache& operator=(const SynthesisCache&) = delete;
+
+    // Returns the audio for the text. Throws std::runtime_error if it is not cached and synthesis fails.
+    std::shared_ptr<CachedAudioStream> SpeakText(const std::string& text)
+    {
+        return Speak(text, false);
+    }
+
+    std::shared_ptr<CachedAudioStream> SpeakSsml(const std::string& ssml)
+    {
+        return Speak(ssml, true);
+    }
+
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Statistics statistics = m_statistics;
+        statistics.MemoryBytes = m_memoryBytes;
+        return statistics;
+    }
+
+private:
+    using AudioData = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Entry
+    {
+        std::string Key;
+        AudioData Audio;
+    };
+
+    std::shared_ptr<CachedAudioStream> Speak(const std::string& input, bool ssml)
+    {
+        const std::string key = MakeKey(input, ssml);
+
+        std::promise<AudioData> synthesis;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto it = m_index.find(key);
+            if (it != m_index.end())
+            {
+                // Moves the entry to the front of the list, the end is evicted first.
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+                m_statistics.MemoryHits++;
+                m_statistics.HitBytes += it->second->Audio->size();
+                return std::make_shared<CachedAudioStream>(it->second->Audio, true);
+            }
+            auto pending = m_pending.find(key);
+            if (pending != m_pending.end())
+            {
+                auto pendingAudio = pending->second;
+                lock.unlock();
+                auto audio = pendingAudio.get();
+                lock.lock();
+                m_statistics.MemoryHits++;
+                m_statistics.HitBytes += audio->size();
+                return std::make_shared<CachedAudioStream>(audio, true);
+            }
+            m_pending.emplace(key, synthesis.get_future().share());
+        }
+
+        AudioData audio;
+        bool fromDisk = false;
+        bool saved = false;
+        try
+        {
+            audio = LoadFromDisk(key);
+            fromDisk = audio != nullptr;
+            if (!fromDisk)
+            {
+                audio = Synthesize(input, ssml);
+                saved = SaveToDisk(key, *audio);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.erase(key);
+            synthesis.set_exception(std::current_exception());
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.erase(key);
+            if (fromDisk)
+            {
+                m_statistics.DiskHits++;
+                m_statistics.HitBytes += audio->size();
+            }
+            else
+            {
+                m_statistics.Misses++;
+                m_statistics.SynthesizedBytes += audio->size();
+                m_statistics.DiskBytesWritten += saved ? audio->size() : 0;
+            }
+            Insert(key, audio);
+        }
+        synthesis.set_value(audio);
+        return std::make_shared<CachedAudioStream>(audio, fromDisk);
+    }
+
+    AudioData Synthesize(const std::string& input, bool ssml)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto result = ssml ? m_synthesizer->SpeakSsmlAsync(input).get() : m_synthesizer->SpeakTextAsync(input).get();
+        if (result->Reason != ResultReason::SynthesizingAudioCompleted)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            throw std::runtime_error("Synthesis canceled: " + cancellation->ErrorDetails);
+        }
+        return result->GetAudioData();
+    }
+
+    // Memory tier, called with the lock held.
+    void Insert(const std::string& key, const AudioData& audio)
+    {
+        if (audio->size() > m_options.MemoryLimitBytes)
+        {
+            return;
+        }
+        m_entries.push_front(Entry{ key, audio });
+        m_index[key] = m_entries.begin();
+        m_memoryBytes += audio->size();
+        while (m_memoryBytes > m_options.MemoryLimitBytes)
+        {
+            m_memoryBytes -= m_entries.back().Audio->size();
+            m_index.erase(m_entries.back().Key);
+            m_entries.pop_back();
+        }
+    }
+
+    // Disk tier. Each key has an audio file named by the hash of the key, which plays like the output of
+    // AudioDataStream::SaveToWavFile(), and a file with the key itself, which guards against hash collisions.
+    // The key file is removed before the audio file is written and written again after it, so that an audio file
+    // that was cut short, e.g. by a crash or a full disk, never has a key file that matches.
+    AudioData LoadFromDisk(const std::string& key) const
+    {
+        if (m_options.Directory.empty())
+        {
+            return nullptr;
+        }
+        const std::string path = PathFor(key);
+        std::ifstream keyFile(path + ".key", std::ios::binary);
+        const std::string storedKey((std::istreambuf_iterator<char>(keyFile)), std::istreambuf_iterator<char>());
+        if (!keyFile.is_open() || storedKey != key)
+        {
+            return nullptr;
+        }
+        std::ifstream audioFile(path + AudioExtension(), std::ios::binary);
+        if (!audioFile)
+        {
+            return nullptr;
+        }
+        return std::make_shared<const std::vector<uint8_t>>((std::istreambuf_iterator<char>(audioFile)), std::istreambuf_iterator<char>());
+    }
+
+    // Returns false if the cache is not on disk, or the audio could not be written.
+    bool SaveToDisk(const std::string& key, const std::vector<uint8_t>& audio) const
+    {
+        if (m_options.Directory.empty())
+        {
+            return false;
+        }
+        const std::string path = PathFor(key);
+        // A key file from an earlier run may still stand for the audio file that is about to be truncated.
+        std::remove((path + ".key").c_str());
+        {
+            std::ofstream audioFile(path + AudioExtension(), std::ios::binary | std::ios::trunc);
+            audioFile.write(reinterpret_cast<const char*>(audio.data()), (std::streamsize)audio.size());
+            audioFile.close();
+            if (!audioFile)
+            {
+                // The cache still works from memory if the disk is full or read-only.
+                std::remove((path + AudioExtension()).c_str());
+                return false;
+            }
+        }
+        std::ofstream keyFile(path + ".key", std::ios::binary | std::ios::trunc);
+        keyFile << key;
+        return (bool)keyFile;
+    }
+
+    std::string PathFor(const std::string& key) const
+    {
+        // 64-bit FNV-1a.
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : key)
+        {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+        return m_options.Directory + "/" + name;
+    }
+
+    std::string AudioExtension() const
+    {
+        // Formats are named like "riff-24khz-16bit-mono-pcm", the default output format is riff as well.
+        if (m_outputFormat.empty() || m_outputFormat.compare(0, 4, "riff") == 0)
+        {
+            return ".wav";
+        }
+        return m_outputFormat.find("mp3") != std::string::npos ? ".mp3" : ".audio";
+    }
+
+    // Whitespace is collapsed and trimmed, so that prompts built from templates hit the same entry.
+    std::string MakeKey(const std::string& input, bool ssml) const
+    {
+        std::string normalized;
+        normalized.reserve(input.size());
+        bool space = false;
+        for (unsigned char c : input)
+        {
+            if (std::isspace(c))
+            {
+                space = !normalized.empty();
+                continue;
+            }
+            if (space)
+            {
+                normalized += ' ';
+                space = false;
+            }
+            normalized += (char)c;
+        }
+        return (ssml ? "ssml\n" : "text\n") + m_voice + "\n" + m_outputFormat + "\n" + normalized;
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> m_synthesizer;
+    Options m_options;
+    std::string m_voice;
+    std::string m_outputFormat;
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    size_t m_memoryBytes = 0;
+    // Syntheses in flight, so that concurrent requests for the same key wait for the first one.
+    std::unordered_map<std::string, std::shared_future<AudioData>> m_pending;
+    Statistics m_statistics;
+};
@@ -0,0 +1,258 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "memory_mapped_file.h"
+
+enum class SynthesisEventKind : uint8_t
+{
+    WordBoundary = 1,
+    Viseme = 2,
+    Bookmark = 3
+};
+
+// Layout of a saved event log. Each array holds 'Count' values and starts at its offset from the start of the
+// file, which is a multiple of 8, so that a mapped file can be read in place.
+struct SynthesisEventLogHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint64_t Count;
+    uint64_t StringBytes;
+    uint64_t AudioOffsetsAt;
+    uint64_t TextOffsetsAt;
+    uint64_t LengthsAt;
+    uint64_t VisemeIdsAt;
+    uint64_t KindsAt;
+    uint64_t StringsAt;
+};
+
+// Records word boundary, viseme and bookmark events in fixed-size records, one array per field, in memory
+// that is allocated up front. Recording an event stores four numbers and does no allocation and no I/O, so
+// it can keep up with viseme events on the synthesizer thread.
+//
+// For word boundaries, the text offset and length are those of the word in the input text. For bookmarks,
+// they point to the bookmark text in the string area of the log. Audio offsets are in ticks.
+// Events are recorded by one thread, e.g. the event handlers of one synthesizer. Events that do not fit are
+// counted as dropped.
+class SynthesisEventLog final
+{
+public:
+    explicit SynthesisEventLog(size_t capacity, size_t stringCapacity = 64 * 1024)
+        : m_capacity(capacity), m_stringCapacity(stringCapacity),
+        m_audioOffsets(new uint64_t[capacity]), m_textOffsets(new uint32_t[capacity]), m_lengths(new uint32_t[capacity]),
+        m_visemeIds(new uint32_t[capacity]), m_kinds(new SynthesisEventKind[capacity]), m_strings(new char[stringCapacity])
+    {
+    }
+
+    SynthesisEventLog(const SynthesisEventLog&) = delete;
+    SynthesisEventLog& operator=(const SynthesisEventLog&) = delete;
+
+    void AddWordBoundary(uint64_t audioOffset, uint32_t textOffset, uint32_t wordLength)
+    {
+        Add(SynthesisEventKind::WordBoundary, audioOffset, textOffset, wordLength, 0);
+    }
+
+    void AddViseme(uint64_t audioOffset, uint32_t visemeId)
+    {
+        Add(SynthesisEventKind::Viseme, audioOffset, 0, 0, visemeId);
+    }
+
+    void AddBookmark(uint64_t audioOffset, const std::string& text)
+    {
+        if (m_stringBytes + text.size() > m_stringCapacity)
+        {
+            m_dropped++;
+            return;
+        }
+        if (Add(SynthesisEventKind::Bookmark, audioOffset, (uint32_t)m_stringBytes, (uint32_t)text.size(), 0))
+        {
+            memcpy(m_strings.get() + m_stringBytes, text.data(), text.size());
+            m_stringBytes += text.size();
+        }
+    }
+
+    // Returns the number of events recorded so far. Events below the count can be read from other threads.
+    size_t Count() const
+    {
+        return m_count.load(std::memory_order_acquire);
+    }
+
+    size_t Dropped() const
+    {
+        return m_dropped.load();
+    }
+
+    // Removes all events, the memory is kept.
+    void Clear()
+    {
+        m_count.store(0, std::memory_order_release);
+        m_stringBytes = 0;
+        m_dropped = 0;
+    }
+
+    // Writes the events in the layout of SynthesisEventLogHeader, to be read with SynthesisEventLogView.
+    void Save(const std::string& fileName) const
+    {
+        const uint64_t count = Count();
+        SynthesisEventLogHeader header;
+        memcpy(header.Magic, "SEVL", 4);
+        header.Version = 1;
+        header.Count = count;
+        header.StringBytes = m_stringBytes;
+        header.AudioOffsetsAt = Align(sizeof(header));
+        header.TextOffsetsAt = Align(header.AudioOffsetsAt + count * sizeof(uint64_t));
+        header.LengthsAt = Align(header.TextOffsetsAt + count * sizeof(uint32_t));
+        header.VisemeIdsAt = Align(header.LengthsAt + count * sizeof(uint32_t));
+        header.KindsAt = Align(header.VisemeIdsAt + count * sizeof(uint32_t));
+        header.StringsAt = Align(header.KindsAt + count * sizeof(SynthesisEventKind));
+
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        uint64_t position = 0;
+        auto write = [&file, &position](uint64_t at, const void* data, uint64_t size)
+        {
+            static const char padding[8] = {};
+            file.write(padding, (std::streamsize)(at - position));
+            file.write(static_cast<const char*>(data), (std::streamsize)size);
+            position = at + size;
+        };
+        write(0, &header, sizeof(header));
+        write(header.AudioOffsetsAt, m_audioOffsets.get(), count * sizeof(uint64_t));
+        write(header.TextOffsetsAt, m_textOffsets.get(), count * sizeof(uint32_t));
+        write(header.LengthsAt, m_lengths.get(), count * sizeof(uint32_t));
+        write(header.VisemeIdsAt, m_visemeIds.get(), count * sizeof(uint32_t));
+        write(header.KindsAt, m_kinds.get(), count * sizeof(SynthesisEventKind));
+        write(header.StringsAt, m_strings.get(), header.StringBytes);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot write event log " + fileName);
+        }
+    }
+
+private:
+    static uint64_t Align(uint64_t offset)
+    {
+        return (offset + 7) & ~(uint64_t)7;
+    }
+
+    bool Add(SynthesisEventKind kind, uint64_t audioOffset, uint32_t textOffset, uint32_t length, uint32_t visemeId)
+    {
+        const size_t index = m_count.load(std::memory_order_relaxed);
+        if (index == m_capacity)
+        {
+            m_dropped++;
+            return false;
+        }
+        m_audioOffsets[index] = audioOffset;
+        m_textOffsets[index] = textOffset;
+        m_lengths[index] = length;
+        m_visemeIds[index] = visemeId;
+        m_kinds[index] = kind;
+        // Publishes the record to readers of Count().
+        m_count.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    const size_t m_capacity;
+    const size_t m_stringCapacity;
+    std::unique_ptr<uint64_t[]> m_audioOffsets;
+    std::unique_ptr<uint32_t[]> m_textOffsets;
+    std::unique_ptr<uint32_t[]> m_lengths;
+    std::unique_ptr<uint32_t[]> m_visemeIds;
+    std::unique_ptr<SynthesisEventKind[]> m_kinds;
+    std::unique_ptr<char[]> m_strings;
+    std::atomic<size_t> m_count{ 0 };
+    size_t m_stringBytes = 0;
+    std::atomic<size_t> m_dropped{ 0 };
+};
+
+// Reads a saved event log in place from a memory-mapped file, e.g. in the process that renders the animation.
+class SynthesisEventLogView final
+{
+public:
+    // Maps the file. Returns false if it cannot be mapped or is not a valid event log.
+    bool Open(const std::string& fileName)
+    {
+        if (!m_file.Open(fileName) || m_file.Size() < sizeof(SynthesisEventLogHeader))
+        {
+            m_file.Close();
+            return false;
+        }
+        m_header = reinterpret_cast<const SynthesisEventLogHeader*>(m_file.Data());
+        const uint64_t count = m_header->Count;
+        const bool valid = memcmp(m_header->Magic, "SEVL", 4) == 0 && m_header->Version == 1
+            && Fits(m_header->AudioOffsetsAt, count * sizeof(uint64_t)) && Fits(m_header->TextOffsetsAt, count * sizeof(uint32_t))
+            && Fits(m_header->LengthsAt, count * sizeof(uint32_t)) && Fits(m_header->VisemeIdsAt, count * sizeof(uint32_t))
+            && Fits(m_header->KindsAt, count) && Fits(m_header->StringsAt, m_header->StringBytes);
+        if (!valid)
+        {
+            m_file.Close();
+            m_header = nullptr;
+        }
+        return valid;
+    }
+
+    size_t Count() const
+    {
+        return m_header == nullptr ? 0 : (size_t)m_header->Count;
+    }
+
+    const uint64_t* AudioOffsets() const
+    {
+        return At<uint64_t>(m_header->AudioOffsetsAt);
+    }
+
+    const uint32_t* TextOffsets() const
+    {
+        return At<uint32_t>(m_header->TextOffsetsAt);
+    }
+
+    const uint32_t* Lengths() const
+    {
+        return At<uint32_t>(m_header->LengthsAt);
+    }
+
+    const uint32_t* VisemeIds() const
+    {
+        return At<uint32_t>(m_header->VisemeIdsAt);
+    }
+
+    const SynthesisEventKind* Kinds() const
+    {
+        return At<SynthesisEventKind>(m_header->KindsAt);
+    }
+
+    // Returns the text of a bookmark event.
+    std::string BookmarkText(size_t index) const
+    {
+        if (Kinds()[index] != SynthesisEventKind::Bookmark)
+        {
+            return std::string();
+        }
+        return std::string(At<char>(m_header->StringsAt) + TextOffsets()[index], Lengths()[index]);
+    }
+
+private:
+    bool Fits(uint64_t at, uint64_t size) const
+    {
+        return at % 8 == 0 && at <= m_file.Size() && size <= m_file.Size() - at;
+    }
+
+    template <class T>
+    const T* At(uint64_t offset) const
+    {
+        return reinterpret_cast<const T*>(m_file.Data() + offset);
+    }
+
+    MemoryMappedFile m_file;
+    const SynthesisEventLogHeader* m_header = nullptr;
+};
@@ -0,0 +1,283 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Records when each stage of the audio path runs, e.g. reading the file, converting the format, writing to the
+// push stream, and the events of the recognizer, and writes them as a Chrome trace that chrome://tracing or
+// https://ui.perfetto.dev show as a timeline per thread. With the recognizer's events next to the reads of its
+// input, the latency of an utterance can be split into the time spent in the application and in the service.
+//
+// Each thread records into its own ring buffer, which keeps the most recent events, so recording takes no lock
+// that another thread holds, and memory does not grow with the length of the trace. Recording does nothing until
+// Enable() is called. Names, categories and argument names must be string literals, they are stored as pointers.
+class TraceRecorder final
+{
+public:
+    // Starts recording. Threads that record their first event afterwards keep the last 'eventsPerThread' events.
+    static void Enable(size_t eventsPerThread = 65536)
+    {
+        auto& state = Global();
+        {
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            state.EventsPerThread = eventsPerThread == 0 ? 1 : eventsPerThread;
+        }
+        state.Enabled.store(true, std::memory_order_release);
+    }
+
+    static void Disable()
+    {
+        Global().Enabled.store(false, std::memory_order_release);
+    }
+
+    static bool IsEnabled()
+    {
+        return Global().Enabled.load(std::memory_order_relaxed);
+    }
+
+    // Names the calling thread in the trace, e.g. "pump" or "recognizer events".
+    static void SetThreadName(const std::string& name)
+    {
+        auto& buffer = Local();
+        std::lock_guard<std::mutex> lock(buffer.Mutex);
+        buffer.Name = name;
+    }
+
+    // Returns the time used for events, in nanoseconds since the first use of the recorder.
+    static uint64_t Now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Global().Epoch).count();
+    }
+
+    // Records that something happened, e.g. a recognizer event, with an optional argument such as its offset.
+    static void Instant(const char* category, const char* name, const char* argName = nullptr, int64_t argValue = 0)
+    {
+        if (IsEnabled())
+        {
+            Record(Event{ category, name, argName, argValue, Now(), 0, 'i' });
+        }
+    }
+
+    // Records that something ran from 'start' to 'end', times as returned by Now().
+    static void Complete(const char* category, const char* name, uint64_t start, uint64_t end, const char* argName = nullptr, int64_t argValue = 0)
+    {
+        if (IsEnabled())
+        {
+            Record(Event{ category, name, argName, argValue, start, end > start ? end - start : 0, 'X' });
+        }
+    }
+
+    // Writes the recorded events of all threads in the Chrome trace event format, {"traceEvents":[...]}.
+    // Threads may keep recording meanwhile.
+    static void WriteChromeJson(std::ostream& os)
+    {
+        auto& state = Global();
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            buffers = state.Buffers;
+        }
+
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto& buffer : buffers)
+        {
+            std::lock_guard<std::mutex> lock(buffer->Mutex);
+            if (!buffer->Name.empty())
+            {
+                os << (first ? "" : ",") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->Id << ",\"args\":{\"name\":";
+                WriteString(os, buffer->Name.c_str());
+                os << "}}";
+                first = false;
+            }
+            // The oldest event is the next one to be overwritten once the ring has wrapped.
+            const size_t capacity = buffer->Capacity;
+            const uint64_t count = buffer->Events.size();
+            for (uint64_t i = buffer->Written - count; i < buffer->Written; i++)
+            {
+                const Event& event = buffer->Events[(size_t)(i % capacity)];
+                os << (first ? "" : ",") << "{\"ph\":\"" << event.Phase << "\",\"cat\":";
+                WriteString(os, event.Category);
+                os << ",\"name\":";
+                WriteString(os, event.Name);
+                os << ",\"pid\":1,\"tid\":" << buffer->Id << ",\"ts\":" << event.Start / 1000 << "." << Fraction(event.Start);
+                if (event.Phase == 'X')
+                {
+                    os << ",\"dur\":" << event.Duration / 1000 << "." << Fraction(event.Duration);
+                }
+                else
+                {
+                    // Instant events are drawn across their thread.
+                    os << ",\"s\":\"t\"";
+                }
+                if (event.ArgName != nullptr)
+                {
+                    os << ",\"args\":{";
+                    WriteString(os, event.ArgName);
+                    os << ":" << event.ArgValue << "}";
+                }
+                os << "}";
+                first = false;
+            }
+        }
+        os << "]}";
+    }
+
+    // Returns the number of events that were overwritten before they were written out.
+    static uint64_t Dropped()
+    {
+        auto& state = Global();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        uint64_t dropped = 0;
+        for (const auto& buffer : state.Buffers)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->Mutex);
+            dropped += buffer->Written - buffer->Events.size();
+        }
+        return dropped;
+    }
+
+private:
+    struct Event
+    {
+        const char* Category;
+        const char* Name;
+        const char* ArgName;
+        int64_t ArgValue;
+        uint64_t Start;
+        uint64_t Duration;
+        char Phase;
+    };
+
+    struct ThreadBuffer
+    {
+        // Only contended while the trace is written out.
+        std::mutex Mutex;
+        uint64_t Id = 0;
+        std::string Name;
+        // Grows up to the capacity, then wraps around.
+        std::vector<Event> Events;
+        size_t Capacity = 0;
+        uint64_t Written = 0;
+    };
+
+    struct State
+    {
+        std::atomic<bool> Enabled{ false };
+        const std::chrono::steady_clock::time_point Epoch = std::chrono::steady_clock::now();
+        std::mutex Mutex;
+        size_t EventsPerThread = 65536;
+        // Buffers of threads that have ended are kept, so that their events are still written out.
+        std::vector<std::shared_ptr<ThreadBuffer>> Buffers;
+    };
+
+    static State& Global()
+    {
+        static State state;
+        return state;
+    }
+
+    static ThreadBuffer& Local()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = Register();
+        return *buffer;
+    }
+
+    static std::shared_ptr<ThreadBuffer> Register()
+    {
+        auto& state = Global();
+        auto buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        buffer->Id = state.Buffers.size() + 1;
+        buffer->Capacity = state.EventsPerThread;
+        state.Buffers.push_back(buffer);
+        return buffer;
+    }
+
+    static void Record(const Event& event)
+    {
+        auto& buffer = Local();
+        std::lock_guard<std::mutex> lock(buffer.Mutex);
+        if (buffer.Events.size() < buffer.Capacity)
+        {
+            buffer.Events.push_back(event);
+        }
+        else
+        {
+            buffer.Events[(size_t)(buffer.Written % buffer.Capacity)] = event;
+        }
+        buffer.Written++;
+    }
+
+    // The microseconds of trace times are written with three decimals.
+    static std::string Fraction(uint64_t nanoseconds)
+    {
+        const unsigned fraction = (unsigned)(nanoseconds % 1000);
+        return std::string(1, (char)('0' + fraction / 100)) + (char)('0' + fraction / 10 % 10) + (char)('0' + fraction % 10);
+    }
+
+    static void WriteString(std::ostream& os, const char* text)
+    {
+        os << '"';
+        for (const char* c = text; *c != '\0'; c++)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                os << '\\';
+            }
+            if ((unsigned char)*c >= 0x20)
+            {
+                os << *c;
+            }
+        }
+        os << '"';
+    }
+};
+
+// Records the time from its construction to its destruction as one span of the calling thread, e.g.
+//   TraceSpan span("disk", "WavFileReader::Read", "size", size);
+class TraceSpan final
+{
+public:
+    TraceSpan(const char* category, const char* name, const char* argName = nullptr, int64_t argValue = 0)
+        : m_category(category), m_name(name), m_argName(argName), m_argValue(argValue),
+          m_recording(TraceRecorder::IsEnabled()), m_start(m_recording ? TraceRecorder::Now() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (m_recording)
+        {
+            TraceRecorder::Complete(m_category, m_name, m_start, TraceRecorder::Now(), m_argName, m_argValue);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // Replaces the argument of the span, e.g. with the number of bytes that were actually read.
+    void SetArg(const char* argName, int64_t argValue)
+    {
+        m_argName = argName;
+        m_argValue = argValue;
+    }
+
+private:
+    const char* const m_category;
+    const char* const m_name;
+    const char* m_argName;
+    int64_t m_argValue;
+    const bool m_recording;
+    const uint64_t m_start;
+};
@@ -0,0 +1,479 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "memory_mapped_file.h"
+
+// A recognized phrase of a call, with offset and duration in ticks (100 ns) from the start of the call's audio, as
+// reported by RecognitionResult::Offset() and Duration(), or by the segments of a batch transcription.
+struct TranscriptSegment
+{
+    uint64_t Offset = 0;
+    uint64_t Duration = 0;
+    std::string Text;
+};
+
+// The on-disk layout of a transcript store, shared by TranscriptStoreWriter and TranscriptStore. A store is a pair
+// of files, all numbers are little-endian:
+//
+//   <name>.log  "TLOG", version, then one block per call, only ever appended to:
+//               "CALL", call id length, segment count, text size, the call id, the segments sorted by offset as
+//               { offset, duration, text offset, text length }, and the text of all segments.
+//   <name>.idx  "TIDX", version, entry count, then { hash of the call id, position of the block in the log }
+//               sorted by hash and position.
+//
+// A time within a call is found with a binary search of the index for the call, then one of its segments, so
+// a lookup reads a few pages of the mapped files no matter how many calls the store holds.
+namespace TranscriptStoreFormat
+{
+    const char logMagic[4] = { 'T', 'L', 'O', 'G' };
+    const char blockMagic[4] = { 'C', 'A', 'L', 'L' };
+    const char indexMagic[4] = { 'T', 'I', 'D', 'X' };
+    constexpr uint32_t version = 1;
+    constexpr size_t logHeaderSize = 8;
+    constexpr size_t blockHeaderSize = 16;
+    constexpr size_t segmentSize = 24;
+    constexpr size_t indexHeaderSize = 16;
+    constexpr size_t indexEntrySize = 16;
+
+    struct IndexEntry
+    {
+        uint64_t Hash;
+        uint64_t Position;
+
+        bool operator<(const IndexEntry& other) const
+        {
+            return Hash != other.Hash ? Hash < other.Hash : Position < other.Position;
+        }
+    };
+
+    // FNV-1a, stable across runs and platforms unlike std::hash.
+    inline uint64_t HashOf(const std::string& callId)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : callId)
+        {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Appends the little-endian bytes of a number. Windows targets are little-endian, so they are copied.
+    template <class T>
+    void Append(std::string& out, T value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Reads a number from mapped memory, which need not be aligned for it.
+    template <class T>
+    T Read(const uint8_t* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+}
+
+// Appends the transcripts of calls to a store. Each call is written as one block at the end of the log, and the
+// index is rewritten when the writer is closed, so readers that open the store meanwhile see the calls of the
+// last close. Writing a call again adds a new block that takes the place of the old one in lookups.
+class TranscriptStoreWriter final
+{
+public:
+    // Opens the store 'name', or creates it. Throws std::runtime_error if its files cannot be opened.
+    explicit TranscriptStoreWriter(const std::string& name)
+        : m_name(name), m_log(name + ".log", std::ios::binary | std::ios::app)
+    {
+        using namespace TranscriptStoreFormat;
+
+        if (!m_log)
+        {
+            throw std::runtime_error("Cannot open transcript log " + name + ".log");
+        }
+        m_log.seekp(0, std::ios::end);
+        m_position = (uint64_t)m_log.tellp();
+        if (m_position == 0)
+        {
+            std::string header(logMagic, sizeof(logMagic));
+            Append(header, version);
+            WriteLog(header);
+        }
+    }
+
+    ~TranscriptStoreWriter()
+    {
+        try
+        {
+            Close();
+        }
+        catch (const std::exception&)
+        {
+            // Errors are reported by an explicit Close().
+        }
+    }
+
+    TranscriptStoreWriter(const TranscriptStoreWriter&) = delete;
+    TranscriptStoreWriter& operator=(const TranscriptStoreWriter&) = delete;
+
+    // Appends the transcript of a call, e.g. the recognized phrases of a session or the segments of an audio file
+    // of a batch transcription. Segments may be given in any order. Can be called from any thread.
+    void Write(const std::string& callId, std::vector<TranscriptSegment> segments)
+    {
+        using namespace TranscriptStoreFormat;
+
+        std::stable_sort(segments.begin(), segments.end(), [](const TranscriptSegment& a, const TranscriptSegment& b)
+        {
+            return a.Offset < b.Offset;
+        });
+        std::string block(blockMagic, sizeof(blockMagic));
+        Append(block, (uint32_t)callId.size());
+        Append(block, (uint32_t)segments.size());
+        size_t textSize = 0;
+        for (const auto& segment : segments)
+        {
+            textSize += segment.Text.size();
+        }
+        if (callId.size() > UINT32_MAX || textSize > UINT32_MAX)
+        {
+            throw std::invalid_argument("Transcript of call " + callId + " is too large");
+        }
+        Append(block, (uint32_t)textSize);
+        block += callId;
+        uint32_t textOffset = 0;
+        for (const auto& segment : segments)
+        {
+            Append(block, segment.Offset);
+            Append(block, segment.Duration);
+            Append(block, textOffset);
+            Append(block, (uint32_t)segment.Text.size());
+            textOffset += (uint32_t)segment.Text.size();
+        }
+        for (const auto& segment : segments)
+        {
+            block += segment.Text;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_log.is_open())
+        {
+            throw std::runtime_error("Transcript store is closed");
+        }
+        m_entries.push_back(IndexEntry{ HashOf(callId), m_position });
+        WriteLog(block);
+    }
+
+    // Flushes the log and writes the index of all calls, the old ones and the ones written since the store was opened.
+    // Throws std::runtime_error if a file could not be written.
+    void Close()
+    {
+        using namespace TranscriptStoreFormat;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_log.is_open())
+        {
+            return;
+        }
+        m_log.close();
+        if (m_failed || !m_log)
+        {
+            throw std::runtime_error("Cannot write to transcript log " + m_name + ".log");
+        }
+
+        // The entries of the old index are sorted, and the new ones are after them in the log.
+        std::sort(m_entries.begin(), m_entries.end());
+        std::vector<IndexEntry> entries;
+        {
+            MemoryMappedFile oldIndex;
+            if (oldIndex.Open(m_name + ".idx") && oldIndex.Size() >= indexHeaderSize
+                && std::memcmp(oldIndex.Data(), indexMagic, sizeof(indexMagic)) == 0)
+            {
+                const uint64_t count = std::min<uint64_t>(Read<uint64_t>(oldIndex.Data() + 8), (oldIndex.Size() - indexHeaderSize) / indexEntrySize);
+                entries.reserve((size_t)count + m_entries.size());
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    const uint8_t* entry = oldIndex.Data() + indexHeaderSize + i * indexEntrySize;
+                    entries.push_back(IndexEntry{ Read<uint64_t>(entry), Read<uint64_t>(entry + 8) });
+                }
+            }
+        }
+        const size_t oldCount = entries.size();
+        entries.insert(entries.end(), m_entries.begin(), m_entries.end());
+        std::inplace_merge(entries.begin(), entries.begin() + oldCount, entries.end());
+
+        std::string index(indexMagic, sizeof(indexMagic));
+        Append(index, version);
+        Append(index, (uint64_t)entries.size());
+        index.reserve(indexHeaderSize + entries.size() * indexEntrySize);
+        for (const auto& entry : entries)
+        {
+            Append(index, entry.Hash);
+            Append(index, entry.Position);
+        }
+
+        // Written next to the old index and moved over it, so that a reader never sees a partial index.
+        const std::string indexName = m_name + ".idx";
+        const std::string tempName = indexName + ".tmp";
+        {
+            std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+            file.write(index.data(), (std::streamsize)index.size());
+            file.close();
+            if (!file)
+            {
+                throw std::runtime_error("Cannot write transcript index " + tempName);
+            }
+        }
+        std::remove(indexName.c_str());
+        if (std::rename(tempName.c_str(), indexName.c_str()) != 0)
+        {
+            throw std::runtime_error("Cannot replace transcript index " + indexName);
+        }
+        m_entries.clear();
+    }
+
+private:
+    void WriteLog(const std::string& data)
+    {
+        m_log.write(data.data(), (std::streamsize)data.size());
+        m_position += data.size();
+        m_failed = m_failed || !m_log;
+    }
+
+    const std::string m_name;
+    std::mutex m_mutex;
+    std::ofstream m_log;
+    uint64_t m_position = 0;
+    bool m_failed = false;
+    std::vector<TranscriptStoreFormat::IndexEntry> m_entries;
+};
+
+// Looks up what was said at a time of a call in a store written by TranscriptStoreWriter. Both files are mapped
+// into memory, lookups take O(log n) in the number of calls and of segments of the call, and can run on any number
+// of threads. The store is read as it was when it was opened.
+class TranscriptStore final
+{
+public:
+    // Opens the store 'name'. Throws std::runtime_error if it does not exist or is not a transcript store.
+    explicit TranscriptStore(const std::string& name)
+    {
+        using namespace TranscriptStoreFormat;
+
+        if (!m_log.Open(name + ".log", MemoryMappedFile::Access::Random) || m_log.Size() < logHeaderSize
+            || std::memcmp(m_log.Data(), logMagic, sizeof(logMagic)) != 0)
+        {
+            throw std::runtime_error("Cannot open transcript log " + name + ".log");
+        }
+        if (!m_index.Open(name + ".idx", MemoryMappedFile::Access::Random) || m_index.Size() < indexHeaderSize
+            || std::memcmp(m_index.Data(), indexMagic, sizeof(indexMagic)) != 0)
+        {
+            throw std::runtime_error("Cannot open transcript index " + name + ".idx");
+        }
+        if (Read<uint32_t>(m_log.Data() + 4) != version || Read<uint32_t>(m_index.Data() + 4) != version)
+        {
+            throw std::runtime_error("Transcript store " + name + " has an unsupported version");
+        }
+        m_entryCount = (size_t)std::min<uint64_t>(Read<uint64_t>(m_index.Data() + 8), (m_index.Size() - indexHeaderSize) / indexEntrySize);
+    }
+
+    TranscriptStore(const TranscriptStore&) = delete;
+    TranscriptStore& operator=(const TranscriptStore&) = delete;
+
+    // Returns the number of call blocks in the index, including calls that were written more than once.
+    size_t BlockCount() const
+    {
+        return m_entryCount;
+    }
+
+    // Returns true if the store holds a transcript of the call.
+    bool Contains(const std::string& callId) const
+    {
+        Call call;
+        return FindCall(callId, call);
+    }
+
+    // Finds the segment that was being said at 'ticks' into the call. Returns false if the call is not in the store,
+    // or nothing was recognized at that time.
+    bool Find(const std::string& callId, uint64_t ticks, TranscriptSegment& segment) const
+    {
+        Call call;
+        if (!FindCall(callId, call))
+        {
+            return false;
+        }
+        // The last segment that starts at or before the time, segments are sorted by their offset.
+        const uint32_t next = UpperBound(call, ticks);
+        if (next == 0)
+        {
+            return false;
+        }
+        segment = SegmentAt(call, next - 1);
+        return ticks < segment.Offset + segment.Duration;
+    }
+
+    // Returns the segments of the call that overlap [from, to), in order.
+    std::vector<TranscriptSegment> Range(const std::string& callId, uint64_t from, uint64_t to) const
+    {
+        std::vector<TranscriptSegment> segments;
+        Call call;
+        if (!FindCall(callId, call) || from >= to)
+        {
+            return segments;
+        }
+        // Segments that start before 'from' may still overlap it.
+        uint32_t first = UpperBound(call, from);
+        while (first > 0 && call.EndAt(first - 1) > from)
+        {
+            first--;
+        }
+        for (uint32_t i = first; i < call.Count; i++)
+        {
+            auto segment = SegmentAt(call, i);
+            if (segment.Offset >= to)
+            {
+                break;
+            }
+            if (segment.Offset + segment.Duration > from || segment.Offset >= from)
+            {
+                segments.push_back(std::move(segment));
+            }
+        }
+        return segments;
+    }
+
+private:
+    // The block of a call in the mapped log.
+    struct Call
+    {
+        const uint8_t* Segments = nullptr;
+        uint32_t Count = 0;
+        const uint8_t* Text = nullptr;
+        uint32_t TextSize = 0;
+
+        uint64_t OffsetAt(uint32_t i) const
+        {
+            return TranscriptStoreFormat::Read<uint64_t>(Segments + (size_t)i * TranscriptStoreFormat::segmentSize);
+        }
+
+        uint64_t EndAt(uint32_t i) const
+        {
+            const uint8_t* segment = Segments + (size_t)i * TranscriptStoreFormat::segmentSize;
+            return TranscriptStoreFormat::Read<uint64_t>(segment) + TranscriptStoreFormat::Read<uint64_t>(segment + 8);
+        }
+    };
+
+    // Finds the newest block of the call. Blocks of other calls with the same hash are told apart by their call id.
+    bool FindCall(const std::string& callId, Call& call) const
+    {
+        using namespace TranscriptStoreFormat;
+
+        const uint64_t hash = HashOf(callId);
+        const uint8_t* entries = m_index.Data() + indexHeaderSize;
+        size_t low = 0;
+        size_t high = m_entryCount;
+        // The first entry after the ones with this hash.
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            if (Read<uint64_t>(entries + middle * indexEntrySize) <= hash)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        for (size_t i = low; i > 0 && Read<uint64_t>(entries + (i - 1) * indexEntrySize) == hash; i--)
+        {
+            if (ReadCall(Read<uint64_t>(entries + (i - 1) * indexEntrySize + 8), callId, call))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Reads the block at 'position' if it holds the call. Throws std::runtime_error if the block is not in the log.
+    bool ReadCall(uint64_t position, const std::string& callId, Call& call) const
+    {
+        using namespace TranscriptStoreFormat;
+
+        const uint64_t size = m_log.Size();
+        if (position < logHeaderSize || position > size || size - position < blockHeaderSize
+            || std::memcmp(m_log.Data() + position, blockMagic, sizeof(blockMagic)) != 0)
+        {
+            throw std::runtime_error("Transcript store is corrupt, the index refers past the log");
+        }
+        const uint8_t* block = m_log.Data() + position;
+        const uint32_t idLength = Read<uint32_t>(block + 4);
+        const uint32_t count = Read<uint32_t>(block + 8);
+        const uint32_t textSize = Read<uint32_t>(block + 12);
+        if (size - position - blockHeaderSize < (uint64_t)idLength + (uint64_t)count * segmentSize + textSize)
+        {
+            throw std::runtime_error("Transcript store is corrupt, a call block is truncated");
+        }
+        if (idLength != callId.size() || std::memcmp(block + blockHeaderSize, callId.data(), idLength) != 0)
+        {
+            return false;
+        }
+        call.Segments = block + blockHeaderSize + idLength;
+        call.Count = count;
+        call.Text = call.Segments + (size_t)count * segmentSize;
+        call.TextSize = textSize;
+        return true;
+    }
+
+    // Returns the index of the first segment that starts after 'ticks'.
+    static uint32_t UpperBound(const Call& call, uint64_t ticks)
+    {
+        uint32_t low = 0;
+        uint32_t high = call.Count;
+        while (low < high)
+        {
+            const uint32_t middle = low + (high - low) / 2;
+            if (call.OffsetAt(middle) <= ticks)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    static TranscriptSegment SegmentAt(const Call& call, uint32_t i)
+    {
+        using namespace TranscriptStoreFormat;
+
+        const uint8_t* entry = call.Segments + (size_t)i * segmentSize;
+        TranscriptSegment segment;
+        segment.Offset = Read<uint64_t>(entry);
+        segment.Duration = Read<uint64_t>(entry + 8);
+        const uint32_t textOffset = Read<uint32_t>(entry + 16);
+        const uint32_t textLength = Read<uint32_t>(entry + 20);
+        if ((uint64_t)textOffset + textLength > call.TextSize)
+        {
+            throw std::runtime_error("Transcript store is corrupt, a segment refers past its text");
+        }
+        segment.Text.assign(reinterpret_cast<const char*>(call.Text) + textOffset, textLength);
+        return segment;
+    }
+
+    MemoryMappedFile m_log;
+    MemoryMappedFile m_index;
+    size_t m_entryCount = 0;
+};
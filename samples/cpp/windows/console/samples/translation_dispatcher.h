@@ -0,0 +1,325 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hands the translations of a translation recognizer to one subscriber per target language, e.g. the caption
+// consumers of "de" and "fr". Each language has its own queues and its own subscriber thread, so a slow subscriber
+// only delays its own language and never the recognizer's event handlers.
+//
+// Dispatch() is called from the recognizer's event handlers and does not take a lock or wait:
+// - final translations go to a bounded lock-free queue, and are counted as dropped when it is full.
+// - partial translations go to a slot that holds only the latest one, so under load a subscriber skips the
+//   partials it could not keep up with. A partial that is older than the last final is never delivered.
+class TranslationDispatcher final
+{
+public:
+    struct Translation
+    {
+        std::string Language;
+        std::string Text;
+        // In ticks (100 nanoseconds) from the start of the audio.
+        uint64_t Offset = 0;
+        uint64_t Duration = 0;
+        // False for the partial translation of a Recognizing event.
+        bool Final = false;
+    };
+
+    using Subscriber = std::function<void(const Translation& translation)>;
+
+    // 'finalCapacity' is the number of final translations that can be queued per language, rounded up to a power of two.
+    explicit TranslationDispatcher(size_t finalCapacity = 64)
+        : m_finalCapacity(finalCapacity)
+    {
+        if (finalCapacity == 0)
+        {
+            throw std::invalid_argument("Final translation capacity must be at least 1");
+        }
+    }
+
+    ~TranslationDispatcher()
+    {
+        Close();
+    }
+
+    TranslationDispatcher(const TranslationDispatcher&) = delete;
+    TranslationDispatcher& operator=(const TranslationDispatcher&) = delete;
+
+    // Adds the subscriber of a target language. Subscribers must be added before the first Dispatch().
+    // Translations into languages without a subscriber are ignored.
+    void Subscribe(const std::string& language, Subscriber subscriber)
+    {
+        if (!subscriber)
+        {
+            throw std::invalid_argument("Subscriber of " + language + " is empty");
+        }
+        if (m_started || m_closing)
+        {
+            throw std::runtime_error("Subscribers must be added before the first dispatch");
+        }
+        if (m_channels.count(language) != 0)
+        {
+            throw std::invalid_argument("Language " + language + " already has a subscriber");
+        }
+        auto channel = std::unique_ptr<Channel>(new Channel(m_finalCapacity));
+        channel->OnTranslation = std::move(subscriber);
+        Channel* added = channel.get();
+        m_channels[language] = std::move(channel);
+        added->Thread = std::thread(&TranslationDispatcher::Run, this, added);
+    }
+
+    // Queues the translations of a result, 'final' is true for the Recognized event and false for Recognizing.
+    // Only one thread may call Dispatch() at a time, which holds for the events of one recognizer.
+    void Dispatch(const Microsoft::CognitiveServices::Speech::Translation::TranslationRecognitionResult& result, bool final)
+    {
+        if (m_closing)
+        {
+            return;
+        }
+        m_started = true;
+        const uint64_t sequence = ++m_sequence;
+        for (const auto& it : result.Translations)
+        {
+            auto channel = m_channels.find(it.first);
+            if (channel == m_channels.end())
+            {
+                continue;
+            }
+            Translation translation;
+            translation.Language = it.first;
+            translation.Text = it.second;
+            translation.Offset = result.Offset();
+            translation.Duration = result.Duration();
+            translation.Final = final;
+            if (final)
+            {
+                if (!channel->second->Finals.TryPush(sequence, std::move(translation)))
+                {
+                    m_dropped++;
+                }
+            }
+            else if (channel->second->Partial.Publish(sequence, std::move(translation)))
+            {
+                m_coalesced++;
+            }
+            // Notifying without the mutex does not block on the subscriber, a wakeup that is missed this way
+            // is made up by the subscriber's wait timeout.
+            channel->second->Changed.notify_one();
+        }
+    }
+
+    // Delivers the queued final translations, stops the subscriber threads and ignores later dispatches.
+    // Call it after the recognition has stopped.
+    void Close()
+    {
+        if (m_closing.exchange(true))
+        {
+            return;
+        }
+        for (auto& channel : m_channels)
+        {
+            channel.second->Changed.notify_one();
+            channel.second->Thread.join();
+        }
+    }
+
+    // Returns the number of final translations that were dropped because the queue of their language was full.
+    uint64_t Dropped() const
+    {
+        return m_dropped;
+    }
+
+    // Returns the number of partial translations that were replaced by a newer one before their subscriber took them.
+    uint64_t Coalesced() const
+    {
+        return m_coalesced;
+    }
+
+private:
+    // Lock-free queue for exactly one producer and one consumer, like SpscRingBuffer but of translations.
+    class FinalQueue final
+    {
+    public:
+        explicit FinalQueue(size_t capacity)
+        {
+            size_t size = 1;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            m_slots.resize(size);
+            m_mask = size - 1;
+        }
+
+        bool TryPush(uint64_t sequence, Translation&& translation)
+        {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == m_slots.size())
+            {
+                return false;
+            }
+            m_slots[head & m_mask].Sequence = sequence;
+            m_slots[head & m_mask].Value = std::move(translation);
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool TryPop(uint64_t& sequence, Translation& translation)
+        {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            sequence = m_slots[tail & m_mask].Sequence;
+            translation = std::move(m_slots[tail & m_mask].Value);
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Empty() const
+        {
+            return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct Slot
+        {
+            uint64_t Sequence = 0;
+            Translation Value;
+        };
+
+        std::vector<Slot> m_slots;
+        size_t m_mask = 0;
+        std::atomic<size_t> m_head{ 0 };
+        std::atomic<size_t> m_tail{ 0 };
+    };
+
+    // Holds the latest partial translation in a triple buffer: the producer writes one slot, the consumer reads
+    // another, and the third is swapped between them, so neither ever waits for the other.
+    class LatestSlot final
+    {
+    public:
+        // Returns true if this replaced a partial the consumer had not taken yet.
+        bool Publish(uint64_t sequence, Translation&& translation)
+        {
+            m_slots[m_back].Sequence = sequence;
+            m_slots[m_back].Value = std::move(translation);
+            const uint8_t previous = m_middle.exchange((uint8_t)(m_back | Fresh), std::memory_order_acq_rel);
+            m_back = (uint8_t)(previous & IndexMask);
+            return (previous & Fresh) != 0;
+        }
+
+        bool TryTake(uint64_t& sequence, Translation& translation)
+        {
+            if ((m_middle.load(std::memory_order_relaxed) & Fresh) == 0)
+            {
+                return false;
+            }
+            m_front = (uint8_t)(m_middle.exchange(m_front, std::memory_order_acq_rel) & IndexMask);
+            sequence = m_slots[m_front].Sequence;
+            translation = std::move(m_slots[m_front].Value);
+            return true;
+        }
+
+        bool HasFresh() const
+        {
+            return (m_middle.load(std::memory_order_relaxed) & Fresh) != 0;
+        }
+
+    private:
+        enum : uint8_t
+        {
+            IndexMask = 3,
+            Fresh = 4
+        };
+
+        struct Slot
+        {
+            uint64_t Sequence = 0;
+            Translation Value;
+        };
+
+        Slot m_slots[3];
+        // Only used by the producer.
+        uint8_t m_back = 0;
+        std::atomic<uint8_t> m_middle{ 1 };
+        // Only used by the consumer.
+        uint8_t m_front = 2;
+    };
+
+    struct Channel
+    {
+        explicit Channel(size_t finalCapacity)
+            : Finals(finalCapacity)
+        {
+        }
+
+        FinalQueue Finals;
+        LatestSlot Partial;
+        Subscriber OnTranslation;
+        // Only used to sleep while both queues are empty.
+        std::mutex Mutex;
+        std::condition_variable Changed;
+        std::thread Thread;
+    };
+
+    void Run(Channel* channel)
+    {
+        uint64_t lastFinal = 0;
+        uint64_t sequence = 0;
+        Translation translation;
+        while (true)
+        {
+            // Finals come first, a partial is stale once a final of the same or a later result has been delivered.
+            bool delivered = false;
+            while (channel->Finals.TryPop(sequence, translation))
+            {
+                lastFinal = sequence;
+                channel->OnTranslation(translation);
+                delivered = true;
+            }
+            if (channel->Partial.TryTake(sequence, translation) && sequence > lastFinal)
+            {
+                channel->OnTranslation(translation);
+                delivered = true;
+            }
+            if (delivered)
+            {
+                continue;
+            }
+            if (m_closing)
+            {
+                break;
+            }
+            std::unique_lock<std::mutex> lock(channel->Mutex);
+            channel->Changed.wait_for(lock, std::chrono::milliseconds(20), [this, channel]()
+            {
+                return m_closing || !channel->Finals.Empty() || channel->Partial.HasFresh();
+            });
+        }
+    }
+
+    const size_t m_finalCapacity;
+    std::map<std::string, std::unique_ptr<Channel>> m_channels;
+    std::atomic<bool> m_started{ false };
+    std::atomic<bool> m_closing{ false };
+    // Orders the results, only used by the dispatching thread.
+    uint64_t m_sequence = 0;
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::atomic<uint64_t> m_coalesced{ 0 };
+};
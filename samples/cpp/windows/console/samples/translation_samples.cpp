@@ -6,9 +6,21 @@
 #include "stdafx.h"
 
 // <toplevel>
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <speechapi_cxx.h>
+#include "result_sink.h"
+#include "translation_dispatcher.h"
+#include "audio_broadcaster.h"
+#include "batch_translator.h"
+#include "event_arena.h"
+#include "language_routed_translator.h"
+#include "push_stream_pump.h"
+#include "session_completion.h"
+#include "wav_file_list.h"
+#include "wav_file_reader.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -156,6 +168,405 @@ void TranslationContinuousRecognition()
     recognizer->StopContinuousRecognitionAsync().get();
 }
 
+// Translation continuous recognition, with a separate subscriber for each target language.
+void TranslationContinuousRecognitionWithLanguageSubscribers()
+{
+    // Creates an instance of a speech translation config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Sets source and target languages
+    config->SetSpeechRecognitionLanguage("en-US");
+    config->AddTargetLanguage("de");
+    config->AddTargetLanguage("fr");
+
+    AsyncResultSink sink(unique_ptr<ResultSinkBackend>(new TextResultBackend(cout)));
+
+    // Each subscriber stands for the consumer of one language, e.g. a caption stream. A subscriber runs on its own
+    // thread, if it is slow it skips partial translations, but it does not delay the recognizer or the other language.
+    TranslationDispatcher dispatcher;
+    for (const string language : { "de", "fr" })
+    {
+        dispatcher.Subscribe(language, [&sink](const TranslationDispatcher::Translation& translation)
+        {
+            sink.Post(ResultRecord{ (translation.Final ? "TRANSLATED into " : "Translating into ") + translation.Language, translation.Text }
+                .Add("Offset", translation.Offset));
+        });
+    }
+
+    // Creates a translation recognizer using microphone as audio input.
+    auto recognizer = TranslationRecognizer::FromConfig(config);
+
+    // Subscribes to events.
+    recognizer->Recognizing.Connect([&dispatcher](const TranslationRecognitionEventArgs& e)
+    {
+        dispatcher.Dispatch(*e.Result, false);
+    });
+
+    recognizer->Recognized.Connect([&dispatcher, &sink](const TranslationRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::TranslatedSpeech)
+        {
+            dispatcher.Dispatch(*e.Result, true);
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            sink.Post(ResultRecord{ "NOMATCH", "" }.Add("Details", "Speech could not be recognized."));
+        }
+    });
+
+    recognizer->Canceled.Connect([&sink](const TranslationRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            sink.Post(ResultRecord{ "CANCELED", "" }
+                .Add("ErrorCode", (uint64_t)e.ErrorCode)
+                .Add("ErrorDetails", e.ErrorDetails)
+                .Add("Details", "Did you update the subscription info?"));
+        }
+    });
+
+    cout << "Say something...\n";
+
+    // Starts continuos recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    cout << "Press any key to stop\n";
+    string s;
+    getline(cin, s);
+
+    // Stops recognition, then delivers the remaining translations.
+    recognizer->StopContinuousRecognitionAsync().get();
+    dispatcher.Close();
+    cout << "Partial translations skipped: " << dispatcher.Coalesced() << ", final translations dropped: " << dispatcher.Dropped() << "\n";
+}
+
+// Translation of a directory of recordings into several languages, written as a subtitle file per language.
+void TranslationBatchOfFilesToSubtitles()
+{
+    // Creates an instance of a speech translation config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetSpeechRecognitionLanguage("en-US");
+
+    cout << "Enter the directory of the recordings (16 kHz, 16 bits per sample, mono):" << endl;
+    string directory;
+    getline(cin, directory);
+    auto fileNames = ListWavFiles(directory.empty() ? "." : directory);
+    if (fileNames.empty())
+    {
+        cout << "No .wav files found." << endl;
+        return;
+    }
+
+    // Up to 4 files at a time, each into 5 languages, with the subtitles next to the recordings.
+    BatchTranslator::Options options;
+    options.OutputDirectory = directory.empty() ? "." : directory;
+    BatchTranslator translator(config, { "de", "fr", "es", "it", "ja" }, options);
+    cout << "Translating " << fileNames.size() << " files..." << endl;
+    auto summary = translator.Run(fileNames);
+    for (const auto& file : summary.Files)
+    {
+        if (!file.Error.empty())
+        {
+            cout << "CANCELED: " << file.File << ": " << file.Error << endl;
+        }
+    }
+    cout << summary.Translated << " files translated, " << summary.Failed << " failed. The subtitles of the first file are in ["
+         << translator.SubtitleFileName(fileNames[0], "de") << "] and its other languages." << endl;
+}
+
+// Translation continuous recognition, with the payloads of the events copied into an arena of the session.
+void TranslationContinuousRecognitionWithEventArena()
+{
+    // Creates an instance of a speech translation config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetSpeechRecognitionLanguage("en-US");
+    config->AddTargetLanguage("de");
+    config->AddTargetLanguage("fr");
+
+    auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+    auto recognizer = TranslationRecognizer::FromConfig(config, audioInput);
+    auto recognitionEnd = SessionCompletion::Track(*recognizer);
+
+    // Partial results come several times a second, each with the text and all its translations. Their payloads are
+    // copied into blocks that are reused from utterance to utterance, instead of into strings of their own.
+    // Declared before the recognizer's event handlers are connected, so that it outlives them.
+    SessionEventPayloads payloads;
+    size_t largestUtterance = 0;
+
+    auto print = [](const char* label, const RecognitionPayload& payload)
+    {
+        cout << label << ": Text=" << payload.Text << std::endl;
+        for (const auto& translation : payload.Translations)
+        {
+            cout << "  Translated into '" << translation.Language << "': " << translation.Text << std::endl;
+        }
+    };
+
+    recognizer->Recognizing.Connect([&payloads, print](const TranslationRecognitionEventArgs& e)
+    {
+        print("RECOGNIZING", payloads.Recognizing(*e.Result));
+    });
+
+    recognizer->Recognized.Connect([&payloads, &largestUtterance, print](const TranslationRecognitionEventArgs& e)
+    {
+        // Measured before the partial results of this utterance are released by Recognized().
+        largestUtterance = max(largestUtterance, payloads.Arena().BytesUsed());
+        if (e.Result->Reason == ResultReason::TranslatedSpeech)
+        {
+            print("RECOGNIZED", payloads.Recognized(*e.Result));
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([](const TranslationRecognitionCanceledEventArgs& e)
+    {
+        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+
+    // Starts continuos recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    // Waits for recognition end.
+    recognitionEnd.Wait();
+
+    // Stops recognition.
+    recognizer->StopContinuousRecognitionAsync().get();
+    cout << "Largest utterance payloads: " << largestUtterance << " bytes, arena blocks: " << payloads.Arena().Capacity() << " bytes\n";
+}
+
+// Recognition, translation and language detection of the same audio, which is read from the file only once.
+void TranslationRecognitionAndLanguageIdOfSharedAudio()
+{
+    // Creates instances of a speech translation config and a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto translationConfig = SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    translationConfig->SetSpeechRecognitionLanguage("en-US");
+    translationConfig->AddTargetLanguage("de");
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+    config->SetProperty(PropertyId::SpeechServiceConnection_ContinuousLanguageIdPriority, "Latency");
+
+    // Replace with your own audio file name.
+    unique_ptr<WavFileReader> reader;
+    try
+    {
+        reader.reset(new WavFileReader("whatstheweatherlike.wav"));
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+    const auto& format = reader->Format();
+    auto streamFormat = AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels);
+
+    // Every recognizer gets its own push stream, the broadcaster queues the same chunks of 100 ms to all of them.
+    AudioBroadcaster broadcaster(PushStreamPump::ChunkSizeFor(format.SamplesPerSec, format.BlockAlign, 100));
+    vector<shared_ptr<AudioConfig>> audioInputs;
+    for (int i = 0; i < 3; i++)
+    {
+        auto pushStream = AudioInputStream::CreatePushStream(streamFormat);
+        broadcaster.AddStream(pushStream);
+        audioInputs.push_back(AudioConfig::FromStreamInput(pushStream));
+    }
+
+    // The sink is declared before the recognizers, so it outlives the recognizers' event handlers.
+    AsyncResultSink sink(unique_ptr<ResultSinkBackend>(new TextResultBackend(cout)));
+
+    // Set when all three recognizers have stopped.
+    SessionCompletion recognitionEnd;
+    atomic<int> running{ 3 };
+    auto onStopped = [&recognitionEnd, &running](const SessionEventArgs&)
+    {
+        if (--running == 0)
+        {
+            recognitionEnd.Complete();
+        }
+    };
+
+    auto speechRecognizer = SpeechRecognizer::FromConfig(config, audioInputs[0]);
+    speechRecognizer->Recognized.Connect([&sink](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            sink.Post(ResultRecord{ "RECOGNIZED", e.Result->Text });
+        }
+    });
+    speechRecognizer->SessionStopped.Connect(onStopped);
+
+    auto translationRecognizer = TranslationRecognizer::FromConfig(translationConfig, audioInputs[1]);
+    translationRecognizer->Recognized.Connect([&sink](const TranslationRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::TranslatedSpeech)
+        {
+            ResultRecord record{ "TRANSLATED", e.Result->Text };
+            for (const auto& it : e.Result->Translations)
+            {
+                record.Add("Translation." + it.first, it.second);
+            }
+            sink.Post(move(record));
+        }
+    });
+    translationRecognizer->SessionStopped.Connect(onStopped);
+
+    auto languageRecognizer = SourceLanguageRecognizer::FromConfig(config, AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "de-DE" }), audioInputs[2]);
+    languageRecognizer->Recognized.Connect([&sink](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            sink.Post(ResultRecord{ "LANGUAGE DETECTED", AutoDetectSourceLanguageResult::FromResult(e.Result)->Language }.Add("Offset", e.Result->Offset()));
+        }
+    });
+    languageRecognizer->SessionStopped.Connect(onStopped);
+
+    speechRecognizer->StartContinuousRecognitionAsync().get();
+    translationRecognizer->StartContinuousRecognitionAsync().get();
+    languageRecognizer->StartContinuousRecognitionAsync().get();
+
+    // Reads the file once. Writing waits whenever the slowest recognizer falls 16 chunks behind.
+    vector<uint8_t> buffer(64 * 1024);
+    int count = 0;
+    while ((count = reader->Read(buffer.data(), (uint32_t)buffer.size())) > 0)
+    {
+        broadcaster.Write(buffer.data(), (size_t)count);
+    }
+    broadcaster.Close();
+
+    recognitionEnd.Wait();
+    speechRecognizer->StopContinuousRecognitionAsync().get();
+    translationRecognizer->StopContinuousRecognitionAsync().get();
+    languageRecognizer->StopContinuousRecognitionAsync().get();
+}
+
+// Translation of only the segments of a multi-lingual file whose detected language needs it, in a single pass.
+void TranslationOfDetectedLanguageSegmentsWithMultiLingualFile()
+{
+    // Keeps the audio that is streamed to the recognizer, so that the translator can cut out the segments it translates.
+    class TappedAudioInputCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        TappedAudioInputCallback(const string& audioFileName, LanguageRoutedTranslator*& translator)
+            : m_reader(audioFileName), m_translator(translator)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            int count = m_reader.Read(dataBuffer, size);
+            if (count > 0 && m_translator != nullptr)
+            {
+                m_translator->AddAudio(dataBuffer, (size_t)count);
+            }
+            return count;
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+        const WavFileReader::WAVEFORMAT& Format() const
+        {
+            return m_reader.Format();
+        }
+
+    private:
+        WavFileReader m_reader;
+        LanguageRoutedTranslator*& m_translator;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Note: For multi-lingual speech recognition with language id, it only works with speech v2 endpoint, you must use FromEndpoint api in order to use the speech v2 endpoint.
+    // Replace the region with your service region
+    string speechv2Endpoint = "wss://YourServiceRegion.stt.speech.microsoft.com/speech/universal/v2";
+    auto config = SpeechConfig::FromEndpoint(speechv2Endpoint, "YourSubscriptionKey");
+    config->SetProperty(PropertyId::SpeechServiceConnection_ContinuousLanguageIdPriority, "Latency");
+    auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "zh-CN" });
+
+    LanguageRoutedTranslator* translator = nullptr;
+    shared_ptr<TappedAudioInputCallback> callback;
+    try
+    {
+        // Replace with your own audio file name.
+        callback = make_shared<TappedAudioInputCallback>("en-us_zh-cn.wav", translator);
+    }
+    catch (const exception& e)
+    {
+        cout << "Exit due to exception: " << e.what() << endl;
+        return;
+    }
+
+    // The sink is declared before the translator and the recognizer, so it outlives their handlers.
+    AsyncResultSink sink(unique_ptr<ResultSinkBackend>(new TextResultBackend(cout)));
+
+    // Only Chinese speech is translated, into English. English speech is only recognized.
+    LanguageRoutedTranslator routedTranslator(
+        []() { return SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion"); },
+        { { "zh-CN", { "en" } } },
+        callback->Format(),
+        [&sink](const LanguageRoutedTranslator::Segment& segment)
+        {
+            ResultRecord record{ "RECOGNIZED in " + segment.Language, segment.Text };
+            record.Add("Offset", segment.Offset).Add("Duration", segment.Duration);
+            for (const auto& it : segment.Translations)
+            {
+                record.Add("Translation." + it.first, it.second);
+            }
+            if (!segment.Error.empty())
+            {
+                record.Add("TranslationError", segment.Error);
+            }
+            sink.Post(move(record));
+        });
+    translator = &routedTranslator;
+
+    const auto& format = callback->Format();
+    auto pullStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(format.SamplesPerSec, (uint8_t)format.BitsPerSample, (uint8_t)format.Channels), callback);
+    auto recognizer = SpeechRecognizer::FromConfig(config, autoDetectSourceLanguageConfig, AudioConfig::FromStreamInput(pullStream));
+
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
+
+    recognizer->Recognized.Connect([&routedTranslator](const SpeechRecognitionEventArgs& e)
+    {
+        routedTranslator.OnRecognized(e.Result);
+    });
+
+    recognizer->Canceled.Connect([&sink](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            sink.Post(ResultRecord{ "CANCELED", "" }
+                .Add("ErrorCode", (uint64_t)e.ErrorCode)
+                .Add("ErrorDetails", e.ErrorDetails)
+                .Add("Details", "Did you update the subscription info?"));
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.Complete();
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    recognitionEnd.Wait();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    // Waits for the translations of the last segments.
+    routedTranslator.Finish();
+}
+
 #pragma region Language Detection related samples
 
 // Translation with microphone input.
@@ -238,8 +649,8 @@ void TranslationRecognitionAndLanguageIdWithMultiLingualFile()
     config->SetProperty(PropertyId::SpeechServiceConnection_ContinuousLanguageIdPriority, "Latency");
     auto autoDetectSourceLanguageConfig = AutoDetectSourceLanguageConfig::FromLanguages({ "en-US", "zh-CN" });
 
-    // promise for synchronization of recognition end.
-    promise<void> recognitionEnd;
+    // Completes at the end of the session, from Canceled or SessionStopped, whichever comes first.
+    SessionCompletion recognitionEnd;
 
     // Sets source and target languages
     // The source language will be detected by the language detection feature. 
@@ -297,7 +708,7 @@ void TranslationRecognitionAndLanguageIdWithMultiLingualFile()
                 cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
                 cout << "CANCELED: Did you update the subscription info?" << std::endl;
 
-                recognitionEnd.set_value(); // Notify to stop recognition.
+                recognitionEnd.Complete(); // Notify to stop recognition.
             }
         });
 
@@ -311,14 +722,14 @@ void TranslationRecognitionAndLanguageIdWithMultiLingualFile()
     recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
         {
             cout << "Session stopped.";
-            recognitionEnd.set_value(); // Notify to stop recognition.
+            recognitionEnd.Complete(); // Notify to stop recognition.
         });
 
     // Starts continuos recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
     recognizer->StartContinuousRecognitionAsync().get();
 
     // Waits for recognition end.
-    recognitionEnd.get_future().get();
+    recognitionEnd.Wait();
 
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
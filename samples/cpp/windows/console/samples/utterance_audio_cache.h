@@ -0,0 +1,112 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Keeps the audio that is streamed to a recognizer until its utterances are recognized, so that the audio of an
+// utterance can be cut out by the result's offset and duration, e.g. to recognize it again with another recognizer,
+// without reading the input a second time. Audio before the end of a taken utterance is released.
+//
+// For long sessions the cache can be bounded: it then keeps only the latest audio, as a ring, and drops the oldest
+// when the bound is exceeded, e.g. while no speech is recognized for a long time. Utterances that start in dropped
+// audio are returned empty.
+class UtteranceAudioCache final
+{
+public:
+    // 'format' is the format of the audio passed to Add(), 'maxRetainedBytes' the most audio kept, 0 for no limit.
+    explicit UtteranceAudioCache(const WavFileReader::WAVEFORMAT& format, size_t maxRetainedBytes = 0)
+        : m_format(format), m_maxRetainedBytes(maxRetainedBytes)
+    {
+        if (format.AvgBytesPerSec == 0 || format.BlockAlign == 0)
+        {
+            throw std::invalid_argument("Audio format has no byte rate");
+        }
+    }
+
+    UtteranceAudioCache(const UtteranceAudioCache&) = delete;
+    UtteranceAudioCache& operator=(const UtteranceAudioCache&) = delete;
+
+    const WavFileReader::WAVEFORMAT& Format() const
+    {
+        return m_format;
+    }
+
+    // Keeps audio that is being streamed to the recognizer, e.g. from its pull stream callback.
+    void Add(const uint8_t* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_audio.insert(m_audio.end(), data, data + size);
+        if (m_maxRetainedBytes != 0 && m_audio.size() > m_maxRetainedBytes)
+        {
+            // Drops whole sample frames, so that the positions of later utterances stay aligned.
+            size_t drop = m_audio.size() - m_maxRetainedBytes;
+            drop = std::min(m_audio.size(), (drop + m_format.BlockAlign - 1) / m_format.BlockAlign * m_format.BlockAlign);
+            m_audio.erase(m_audio.begin(), m_audio.begin() + drop);
+            m_audioStart += drop;
+            m_droppedBytes += drop;
+        }
+    }
+
+    // Returns the audio of an utterance, 'offset' and 'duration' in ticks as in the recognition result, and releases
+    // the audio up to its end. With 'keep' false the audio is only released. Utterances must be taken in order.
+    // Returns an empty buffer if the audio has already been released.
+    std::vector<uint8_t> Take(uint64_t offset, uint64_t duration, bool keep = true)
+    {
+        std::vector<uint8_t> audio;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint64_t begin = BytesAt(offset);
+        const uint64_t end = BytesAt(offset + duration);
+        if (keep && begin >= m_audioStart)
+        {
+            const uint64_t last = std::min<uint64_t>(end, m_audioStart + m_audio.size());
+            if (last > begin)
+            {
+                audio.assign(m_audio.begin() + (size_t)(begin - m_audioStart), m_audio.begin() + (size_t)(last - m_audioStart));
+            }
+        }
+        // Audio before the end of a recognized utterance is not needed by any later utterance.
+        const uint64_t drop = std::min<uint64_t>(end > m_audioStart ? end - m_audioStart : 0, m_audio.size());
+        m_audio.erase(m_audio.begin(), m_audio.begin() + (size_t)drop);
+        m_audioStart += drop;
+        return audio;
+    }
+
+    // Returns the bytes of audio kept, and the bytes dropped to stay within the bound.
+    size_t RetainedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_audio.size();
+    }
+
+    uint64_t DroppedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_droppedBytes;
+    }
+
+private:
+    // Returns the position of a time in the audio, in bytes rounded down to whole sample frames.
+    uint64_t BytesAt(uint64_t ticks) const
+    {
+        const uint64_t bytes = ticks / 10000 * m_format.AvgBytesPerSec / 1000;
+        return bytes - bytes % m_format.BlockAlign;
+    }
+
+    const WavFileReader::WAVEFORMAT m_format;
+    const size_t m_maxRetainedBytes;
+    mutable std::mutex m_mutex;
+    // Audio that has been streamed but not yet recognized, starting at byte m_audioStart of the stream. A deque
+    // releases audio from the front without moving the rest.
+    std::deque<uint8_t> m_audio;
+    uint64_t m_audioStart = 0;
+    uint64_t m_droppedBytes = 0;
+};
@@ -0,0 +1,285 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// A voice of the catalog. The SDK's VoiceInfo cannot be created from a file, so the catalog keeps its own copy.
+struct CatalogVoice
+{
+    std::string ShortName;
+    std::string Name;
+    std::string Locale;
+    std::string LocalName;
+    // "Female", "Male" or "Unknown".
+    std::string Gender;
+    std::vector<std::string> Styles;
+};
+
+// The list of voices of the service, fetched once with GetVoicesAsync() and then looked up without a network call.
+// Voices are indexed by short name, locale, locale and gender, and style. The list is refreshed in the background
+// when it is older than the time to live, and saved to a file, so that the next process starts from the file
+// and does not wait for the service. Lookups read an immutable snapshot that is swapped on refresh, so they
+// never wait for a refresh either.
+class VoiceCatalog final
+{
+public:
+    using Voices = std::vector<std::shared_ptr<const CatalogVoice>>;
+    // Points into the catalog it was looked up in, and keeps it alive while the catalog is refreshed.
+    using VoiceList = std::shared_ptr<const Voices>;
+
+    struct Options
+    {
+        std::chrono::seconds TimeToLive = std::chrono::hours(24);
+        // Retry interval after a failed refresh.
+        std::chrono::seconds RetryInterval = std::chrono::minutes(1);
+        // File the catalog is saved to and loaded from, empty to always fetch it on start.
+        std::string CacheFileName;
+    };
+
+    // Loads the catalog from the cache file, or fetches it if there is no usable file.
+    // Throws std::runtime_error if the catalog can neither be loaded nor fetched.
+    VoiceCatalog(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> synthesizer, const Options& options)
+        : m_synthesizer(std::move(synthesizer)), m_options(options)
+    {
+        if (m_synthesizer == nullptr)
+        {
+            throw std::invalid_argument("Synthesizer is null");
+        }
+        m_snapshot = Load();
+        if (m_snapshot == nullptr)
+        {
+            m_snapshot = Fetch();
+            Save(*m_snapshot);
+        }
+        m_refresher = std::thread(&VoiceCatalog::Refresh, this);
+    }
+
+    ~VoiceCatalog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_stop.notify_all();
+        m_refresher.join();
+    }
+
+    VoiceCatalog(const VoiceCatalog&) = delete;
+    VoiceCatalog& operator=(const VoiceCatalog&) = delete;
+
+    // Returns the voice with the short name, e.g. "en-US-AriaNeural", or nullptr.
+    std::shared_ptr<const CatalogVoice> FindByShortName(const std::string& shortName) const
+    {
+        auto snapshot = Snapshot();
+        auto it = snapshot->ByShortName.find(shortName);
+        return it == snapshot->ByShortName.end() ? nullptr : it->second;
+    }
+
+    // Returns the voices of a locale, e.g. "en-US", optionally only those of a gender.
+    VoiceList FindByLocale(const std::string& locale, const std::string& gender = "") const
+    {
+        auto snapshot = Snapshot();
+        return Find(snapshot, snapshot->ByLocale, gender.empty() ? locale : locale + "|" + gender);
+    }
+
+    // Returns the voices that support a speaking style, e.g. "cheerful".
+    VoiceList FindByStyle(const std::string& style) const
+    {
+        auto snapshot = Snapshot();
+        return Find(snapshot, snapshot->ByStyle, style);
+    }
+
+    size_t Count() const
+    {
+        return Snapshot()->All.size();
+    }
+
+    // Returns the time the voices were fetched from the service.
+    std::chrono::system_clock::time_point FetchedAt() const
+    {
+        return Snapshot()->FetchedAt;
+    }
+
+private:
+    struct Index
+    {
+        std::chrono::system_clock::time_point FetchedAt;
+        Voices All;
+        std::unordered_map<std::string, std::shared_ptr<const CatalogVoice>> ByShortName;
+        // Keyed by locale, and by locale and gender as "locale|gender".
+        std::unordered_map<std::string, Voices> ByLocale;
+        std::unordered_map<std::string, Voices> ByStyle;
+    };
+
+    static VoiceList Find(const std::shared_ptr<const Index>& snapshot, const std::unordered_map<std::string, Voices>& index, const std::string& key)
+    {
+        static const Voices none;
+        auto it = index.find(key);
+        return VoiceList(snapshot, it == index.end() ? &none : &it->second);
+    }
+
+    std::shared_ptr<const Index> Snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_snapshot;
+    }
+
+    static std::shared_ptr<const Index> Build(std::vector<CatalogVoice> voices, std::chrono::system_clock::time_point fetchedAt)
+    {
+        auto index = std::make_shared<Index>();
+        index->FetchedAt = fetchedAt;
+        for (auto& voice : voices)
+        {
+            auto entry = std::make_shared<CatalogVoice>(std::move(voice));
+            index->All.push_back(entry);
+            index->ByShortName[entry->ShortName] = entry;
+            index->ByLocale[entry->Locale].push_back(entry);
+            index->ByLocale[entry->Locale + "|" + entry->Gender].push_back(entry);
+            for (const auto& style : entry->Styles)
+            {
+                index->ByStyle[style].push_back(entry);
+            }
+        }
+        return index;
+    }
+
+    std::shared_ptr<const Index> Fetch() const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        auto result = m_synthesizer->GetVoicesAsync().get();
+        if (result->Reason != ResultReason::VoicesListRetrieved)
+        {
+            throw std::runtime_error("Cannot get the list of voices: " + result->ErrorDetails);
+        }
+        std::vector<CatalogVoice> voices;
+        for (const auto& info : result->Voices)
+        {
+            const char* gender = info->Gender == SynthesisVoiceGender::Female ? "Female" : info->Gender == SynthesisVoiceGender::Male ? "Male" : "Unknown";
+            voices.push_back(CatalogVoice{ info->ShortName, info->Name, info->Locale, info->LocalName, gender, info->StyleList });
+        }
+        return Build(std::move(voices), std::chrono::system_clock::now());
+    }
+
+    // The file has the fetch time in seconds since the epoch on its first line, then one voice per line:
+    // short name, name, locale, local name, gender and comma-separated styles, separated by tabs.
+    std::shared_ptr<const Index> Load() const
+    {
+        std::ifstream file(m_options.CacheFileName);
+        long long fetchedAt = 0;
+        if (m_options.CacheFileName.empty() || !(file >> fetchedAt))
+        {
+            return nullptr;
+        }
+        std::vector<CatalogVoice> voices;
+        std::string line;
+        std::getline(file, line);
+        while (std::getline(file, line))
+        {
+            std::vector<std::string> fields;
+            std::istringstream lineStream(line);
+            std::string field;
+            while (std::getline(lineStream, field, '\t'))
+            {
+                fields.push_back(field);
+            }
+            if (fields.size() < 5)
+            {
+                // A damaged file is ignored as a whole, the catalog is fetched instead.
+                return nullptr;
+            }
+            CatalogVoice voice{ fields[0], fields[1], fields[2], fields[3], fields[4], {} };
+            std::istringstream styles(fields.size() > 5 ? fields[5] : "");
+            while (std::getline(styles, field, ','))
+            {
+                voice.Styles.push_back(field);
+            }
+            voices.push_back(std::move(voice));
+        }
+        return Build(std::move(voices), std::chrono::system_clock::time_point(std::chrono::seconds(fetchedAt)));
+    }
+
+    // Writes a new file and renames it, so that other processes never read a partly written catalog.
+    void Save(const Index& index) const
+    {
+        if (m_options.CacheFileName.empty())
+        {
+            return;
+        }
+        const std::string temporaryFileName = m_options.CacheFileName + ".tmp";
+        {
+            std::ofstream file(temporaryFileName, std::ios::trunc);
+            file << std::chrono::duration_cast<std::chrono::seconds>(index.FetchedAt.time_since_epoch()).count() << "\n";
+            for (const auto& voice : index.All)
+            {
+                file << voice->ShortName << '\t' << voice->Name << '\t' << voice->Locale << '\t' << voice->LocalName << '\t' << voice->Gender << '\t';
+                for (size_t i = 0; i < voice->Styles.size(); i++)
+                {
+                    file << (i == 0 ? "" : ",") << voice->Styles[i];
+                }
+                file << "\n";
+            }
+            if (!file)
+            {
+                return;
+            }
+        }
+        std::remove(m_options.CacheFileName.c_str());
+        std::rename(temporaryFileName.c_str(), m_options.CacheFileName.c_str());
+    }
+
+    void Refresh()
+    {
+        auto due = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            Snapshot()->FetchedAt + m_options.TimeToLive - std::chrono::system_clock::now());
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_stop.wait_until(lock, due, [this]() { return m_stopping; }))
+                {
+                    return;
+                }
+            }
+            try
+            {
+                auto snapshot = Fetch();
+                Save(*snapshot);
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_snapshot = snapshot;
+                }
+                due = std::chrono::steady_clock::now() + m_options.TimeToLive;
+            }
+            catch (const std::exception&)
+            {
+                // Lookups keep using the old catalog.
+                due = std::chrono::steady_clock::now() + m_options.RetryInterval;
+            }
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> m_synthesizer;
+    Options m_options;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_stop;
+    std::shared_ptr<const Index> m_snapshot;
+    bool m_stopping = false;
+    std::thread m_refresher;
+};
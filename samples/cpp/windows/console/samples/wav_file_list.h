@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+// Returns the paths of the .wav files in a directory, sorted by name.
+inline std::vector<std::string> ListWavFiles(const std::string& directory)
+{
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "\\*.wav").c_str(), &data);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            {
+                names.push_back(directory + "\\" + data.cFileName);
+            }
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (dir != nullptr)
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            const std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".wav") == 0)
+            {
+                names.push_back(directory + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+#endif
+    std::sort(names.begin(), names.end());
+    return names;
+}
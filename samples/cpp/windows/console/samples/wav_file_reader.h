@@ -6,20 +6,49 @@
 
 #include <speechapi_cxx.h>
 #include <fstream>
+#include "memory_mapped_file.h"
+#include "trace_recorder.h"
 
 // Helper functions
 class WavFileReader final
 {
 public:
+    // Defines how the audio file is accessed.
+    enum class Backend
+    {
+        // Reads the file through std::fstream.
+        Stream,
+        // Maps the file into memory and serves reads straight out of the mapping.
+        // Falls back to Stream if the file cannot be mapped.
+        MemoryMapped
+    };
+
+    // The format structure expected in wav files.
+    struct WAVEFORMAT
+    {
+        uint16_t FormatTag;        // format type.
+        uint16_t Channels;         // number of channels (i.e. mono, stereo...).
+        uint32_t SamplesPerSec;    // sample rate.
+        uint32_t AvgBytesPerSec;   // for buffer estimation.
+        uint16_t BlockAlign;       // block size of data.
+        uint16_t BitsPerSample;    // Number of bits per sample of mono data.
+    };
 
     // Constructor that creates an input stream from a file.
-    WavFileReader(const std::string& audioFileName)
+    WavFileReader(const std::string& audioFileName, Backend backend = Backend::MemoryMapped)
     {
         if (audioFileName.empty())
         {
             throw std::invalid_argument("Audio filename is empty");
         }
 
+        if (backend == Backend::MemoryMapped && m_mappedFile.Open(audioFileName))
+        {
+            // Get audio format from the mapped file header.
+            GetFormatFromMappedWavFile();
+            return;
+        }
+
         std::ios_base::openmode mode = std::ios_base::binary | std::ios_base::in;
         m_fs.open(audioFileName, mode);
         if (!m_fs.good())
@@ -33,7 +62,23 @@ public:
 
     int Read(uint8_t* dataBuffer, uint32_t size)
     {
-        if (m_fs.eof())
+        TraceSpan span("disk", "WavFileReader::Read", "size", size);
+        if (m_mappedFile.IsOpen())
+        {
+            const uint8_t* data = nullptr;
+            uint32_t available = ReadSpan(&data, size);
+            if (available > 0)
+            {
+                memcpy(dataBuffer, data, available);
+            }
+            // returns the number of bytes that have been read, 0 indicates that the stream reaches end.
+            return (int)available;
+        }
+
+        uint64_t remaining = m_dataSize - m_dataPosition;
+        if (remaining < size)
+            size = (uint32_t)remaining;
+        if (size == 0 || m_fs.eof())
             // returns 0 to indicate that the stream reaches end.
             return 0;
         m_fs.read((char*)dataBuffer, size);
@@ -41,13 +86,153 @@ public:
             // returns 0 to close the stream on read error.
             return 0;
         else
+        {
             // returns the number of bytes that have been read.
+            m_dataPosition += (uint64_t)m_fs.gcount();
             return (int)m_fs.gcount();
+        }
+    }
+
+    // Zero-copy variant of Read(), only available with the memory mapped backend.
+    // Points 'data' at the next audio bytes inside the mapping, no more than 'size' bytes, and advances the read position.
+    // The pointer remains valid until Close() is called.
+    // Returns the number of bytes available at 'data', 0 indicates that the stream reaches end.
+    uint32_t ReadSpan(const uint8_t** data, uint32_t size)
+    {
+        if (!m_mappedFile.IsOpen())
+        {
+            throw std::logic_error("ReadSpan requires the memory mapped backend.");
+        }
+
+        uint64_t remaining = m_dataSize - m_dataPosition;
+        uint32_t available = remaining < size ? (uint32_t)remaining : size;
+        *data = m_mappedFile.Data() + m_dataOffset + m_dataPosition;
+        m_dataPosition += available;
+        return available;
+    }
+
+    // Moves the read position to the specified sample frame, counted from the start of the audio data.
+    // A sample frame holds one sample of every channel, i.e. BlockAlign bytes.
+    void Seek(uint64_t sampleIndex)
+    {
+        if (sampleIndex > SampleCount())
+        {
+            throw std::out_of_range("Sample index is beyond the end of the audio data.");
+        }
+
+        m_dataPosition = sampleIndex * m_formatHeader.BlockAlign;
+        if (!m_mappedFile.IsOpen())
+        {
+            // Clears a previous end of file before repositioning.
+            m_fs.clear();
+            m_fs.seekg((std::streamoff)(m_dataOffset + m_dataPosition), std::ios_base::beg);
+        }
+    }
+
+    // Returns the number of sample frames in the data chunk.
+    uint64_t SampleCount() const
+    {
+        return m_formatHeader.BlockAlign == 0 ? 0 : m_dataSize / m_formatHeader.BlockAlign;
+    }
+
+    // Returns the duration of the audio data in ticks (100 nanoseconds), the unit used for result offsets and durations.
+    uint64_t DurationTicks() const
+    {
+        if (m_formatHeader.SamplesPerSec == 0)
+        {
+            return 0;
+        }
+        // Splits into whole seconds and remainder so that long files do not overflow.
+        uint64_t samples = SampleCount();
+        uint64_t seconds = samples / m_formatHeader.SamplesPerSec;
+        uint64_t rest = samples % m_formatHeader.SamplesPerSec;
+        return seconds * ticksPerSecond + rest * ticksPerSecond / m_formatHeader.SamplesPerSec;
+    }
+
+    // Returns the format read from the 'fmt ' chunk.
+    const WAVEFORMAT& Format() const
+    {
+        return m_formatHeader;
+    }
+
+    // Returns true if the file is served from a memory mapping.
+    bool IsMemoryMapped() const
+    {
+        return m_mappedFile.IsOpen();
     }
 
     void Close()
     {
-        m_fs.close();
+        if (m_mappedFile.IsOpen())
+        {
+            m_mappedFile.Close();
+        }
+        else
+        {
+            m_fs.close();
+        }
+        m_dataPosition = 0;
+    }
+
+    // Parses the header of a wav file from its first 'size' bytes, e.g. from a buffer or a download, and returns
+    // the offset of the audio data, with the format and the size of the 'data' chunk. Returns 0 if the header
+    // does not end within 'size' bytes. Throws std::runtime_error if it is not a wav header.
+    static size_t ParseHeader(const uint8_t* data, size_t size, WAVEFORMAT& format, uint32_t& dataChunkSize)
+    {
+        size_t position = 0;
+
+        // Checks the RIFF tag, skips the RIFF chunk size and checks the 'WAVE' tag in the wave header.
+        if (size < tagBufferSize)
+        {
+            return 0;
+        }
+        if (memcmp(data, "RIFF", tagBufferSize) != 0)
+        {
+            throw std::runtime_error("Invalid file header, tag 'RIFF' is expected.");
+        }
+        position += tagBufferSize + chunkSizeBufferSize;
+        if (size < position + chunkTypeBufferSize)
+        {
+            return 0;
+        }
+        if (memcmp(data + position, "WAVE", chunkTypeBufferSize) != 0)
+        {
+            throw std::runtime_error("Invalid file header, tag 'WAVE' is expected.");
+        }
+        position += chunkTypeBufferSize;
+
+        while (true)
+        {
+            if (size < position + chunkTypeBufferSize + chunkSizeBufferSize)
+            {
+                return 0;
+            }
+            const uint8_t* chunkType = data + position;
+            const uint32_t chunkSize = ParseChunkSize(data + position + chunkTypeBufferSize);
+            position += chunkTypeBufferSize + chunkSizeBufferSize;
+
+            if (memcmp(chunkType, "fmt ", chunkTypeBufferSize) == 0)
+            {
+                // Reads format data.
+                if (size < position + sizeof(format))
+                {
+                    return 0;
+                }
+                memcpy(&format, data + position, sizeof(format));
+
+                // Skips the rest of format data.
+                position += chunkSize > sizeof(format) ? chunkSize : sizeof(format);
+            }
+            else if (memcmp(chunkType, "data", chunkTypeBufferSize) == 0)
+            {
+                dataChunkSize = chunkSize;
+                return position;
+            }
+            else
+            {
+                position += chunkSize;
+            }
+        }
     }
 
 private:
@@ -55,6 +240,7 @@ private:
     static constexpr uint16_t tagBufferSize = 4;
     static constexpr uint16_t chunkTypeBufferSize = 4;
     static constexpr uint16_t chunkSizeBufferSize = 4;
+    static constexpr uint64_t ticksPerSecond = 10000000;
 
     // Get format data from a wav file.
     void GetFormatFromWavFile()
@@ -116,10 +302,18 @@ private:
             {
                 throw std::runtime_error("Did not find data chunk.");
             }
-            if (m_fs.eof() && chunkSize > 0)
+
+            // Remembers where the audio data starts, then finds the file size to bound the data chunk.
+            uint64_t dataOffset = (uint64_t)m_fs.tellg();
+            m_fs.seekg(0, std::ios_base::end);
+            uint64_t fileSize = (uint64_t)m_fs.tellg();
+            m_fs.seekg((std::streamoff)dataOffset, std::ios_base::beg);
+
+            if (dataOffset >= fileSize && chunkSize > 0)
             {
                 throw std::runtime_error("Unexpected end of file, before any audio data can be read.");
             }
+            SetDataChunk(dataOffset, chunkSize, fileSize);
         }
         catch (std::ifstream::failure e)
         {
@@ -129,6 +323,33 @@ private:
         m_fs.exceptions(std::ifstream::goodbit);
     }
 
+    // Get format data from the header of a memory mapped wav file, without copying the file.
+    void GetFormatFromMappedWavFile()
+    {
+        const size_t size = m_mappedFile.Size();
+        uint32_t chunkSize = 0;
+        const size_t position = ParseHeader(m_mappedFile.Data(), size, m_formatHeader, chunkSize);
+        if (position == 0)
+        {
+            throw std::runtime_error("Unexpected end of file or error when reading audio file.");
+        }
+        if (position >= size && chunkSize > 0)
+        {
+            throw std::runtime_error("Unexpected end of file, before any audio data can be read.");
+        }
+        SetDataChunk(position, chunkSize, size);
+    }
+
+    // Records the location of the audio data. The chunk size is clamped to the file size, which covers
+    // truncated files and streaming writers that leave the size as 0xFFFFFFFF.
+    void SetDataChunk(uint64_t dataOffset, uint32_t chunkSize, uint64_t fileSize)
+    {
+        uint64_t available = dataOffset < fileSize ? fileSize - dataOffset : 0;
+        m_dataOffset = dataOffset;
+        m_dataSize = chunkSize < available ? chunkSize : available;
+        m_dataPosition = 0;
+    }
+
     void ReadChunkTypeAndSize(char* chunkType, uint32_t* chunkSize)
     {
         // Read the chunk type
@@ -138,25 +359,30 @@ private:
         uint8_t chunkSizeBuffer[chunkSizeBufferSize];
         m_fs.read((char*)chunkSizeBuffer, chunkSizeBufferSize);
 
+        *chunkSize = ParseChunkSize(chunkSizeBuffer);
+    }
+
+    static uint32_t ParseChunkSize(const uint8_t* chunkSizeBuffer)
+    {
         // chunk size is little endian
-        *chunkSize = ((uint32_t)chunkSizeBuffer[3] << 24) |
+        return ((uint32_t)chunkSizeBuffer[3] << 24) |
             ((uint32_t)chunkSizeBuffer[2] << 16) |
             ((uint32_t)chunkSizeBuffer[1] << 8) |
             (uint32_t)chunkSizeBuffer[0];
     }
 
-    // The format structure expected in wav files.
-    struct WAVEFORMAT
-    {
-        uint16_t FormatTag;        // format type.
-        uint16_t Channels;         // number of channels (i.e. mono, stereo...).
-        uint32_t SamplesPerSec;    // sample rate.
-        uint32_t AvgBytesPerSec;   // for buffer estimation.
-        uint16_t BlockAlign;       // block size of data.
-        uint16_t BitsPerSample;    // Number of bits per sample of mono data.
-    } m_formatHeader;
+    WAVEFORMAT m_formatHeader;
     static_assert(sizeof(m_formatHeader) == 16, "unexpected size of m_formatHeader");
 
+    // Location of the audio data in the file, taken from the 'data' chunk header.
+    // m_dataPosition is the number of audio bytes consumed so far, reads never go past m_dataSize.
+    uint64_t m_dataOffset = 0;
+    uint64_t m_dataSize = 0;
+    uint64_t m_dataPosition = 0;
+
 private:
     std::fstream m_fs;
+
+    // Used by the memory mapped backend.
+    MemoryMappedFile m_mappedFile;
 };
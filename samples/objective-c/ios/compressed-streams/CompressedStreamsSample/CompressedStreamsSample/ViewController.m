@@ -7,6 +7,10 @@
 #import <AVFoundation/AVFoundation.h>
 #import <MicrosoftCognitiveServicesSpeech/SPXSpeechApi.h>
 
+// Exported by GStreamerWrapper.framework, see gstreamer_modules.h.
+extern void spx_gst_request_container_format(int format);
+extern size_t spx_gst_registration_report(char* buffer, size_t size);
+
 
 @interface ViewController () {
     NSString *speechKey;
@@ -65,6 +69,8 @@
 
     // <setup-stream>
     SPXAudioStreamContainerFormat compressedStreamFormat = SPXAudioStreamContainerFormat_MP3;
+    // Only the plugins of the formats requested are registered, instead of all codecs at launch.
+    spx_gst_request_container_format((int)compressedStreamFormat);
     SPXAudioStreamFormat *audioFormat = [[SPXAudioStreamFormat alloc] initUsingCompressedFormat:compressedStreamFormat];
     SPXPushAudioInputStream* stream = [[SPXPushAudioInputStream alloc] initWithAudioFormat:audioFormat];
 
@@ -149,6 +155,11 @@
 
     [speechRecognizer stopContinuousRecognition];
     // </push-compressed-stream>
+
+    // The GStreamer plugins registered so far, with the milliseconds each took.
+    char report[1024];
+    spx_gst_registration_report(report, sizeof(report));
+    NSLog(@"GStreamer plugin registration:\n%s", report);
 }
 
 - (void)updateRecognitionResultText:(NSString *) resultText {
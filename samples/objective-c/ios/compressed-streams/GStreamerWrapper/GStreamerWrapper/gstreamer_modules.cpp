@@ -7,33 +7,154 @@
 
 #include "gstreamer_modules.h"
 
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace {
+
+// The values of SPXAudioStreamContainerFormat.
+enum ContainerFormat {
+    OggOpus = 0x101,
+    Mp3 = 0x102,
+    Flac = 0x103,
+    Alaw = 0x104,
+    Mulaw = 0x105,
+    Any = 0x108
+};
+
+// The statically linked plugins, in the order of the table below.
+enum Plugin {
+    CoreElements,
+    App,
+    AudioConvert,
+    AudioResample,
+    AudioParsers,
+    Mpg123,
+    Ogg,
+    OpusParse,
+    Opus,
+    WavParse,
+    AlawPlugin,
+    MulawPlugin,
+    FlacPlugin,
+    Playback,
+    PluginCount
+};
+
+const unsigned CorePlugins = 1u << CoreElements | 1u << App | 1u << AudioConvert | 1u << AudioResample;
+const unsigned AllPlugins = (1u << PluginCount) - 1;
+
+struct PluginRegistration {
+    const char* name;
+    void (*registerPlugin)();
+};
+
+#if defined(TARGET_OS_IPHONE)
+const PluginRegistration plugins[PluginCount] = {
+    { "coreelements", [] { GST_PLUGIN_STATIC_REGISTER(coreelements); } },
+    { "app", [] { GST_PLUGIN_STATIC_REGISTER(app); } },
+    { "audioconvert", [] { GST_PLUGIN_STATIC_REGISTER(audioconvert); } },
+    { "audioresample", [] { GST_PLUGIN_STATIC_REGISTER(audioresample); } },
+    { "audioparsers", [] { GST_PLUGIN_STATIC_REGISTER(audioparsers); } },
+    { "mpg123", [] { GST_PLUGIN_STATIC_REGISTER(mpg123); } },
+    { "ogg", [] { GST_PLUGIN_STATIC_REGISTER(ogg); } },
+    { "opusparse", [] { GST_PLUGIN_STATIC_REGISTER(opusparse); } },
+    { "opus", [] { GST_PLUGIN_STATIC_REGISTER(opus); } },
+    { "wavparse", [] { GST_PLUGIN_STATIC_REGISTER(wavparse); } },
+    { "alaw", [] { GST_PLUGIN_STATIC_REGISTER(alaw); } },
+    { "mulaw", [] { GST_PLUGIN_STATIC_REGISTER(mulaw); } },
+    { "flac", [] { GST_PLUGIN_STATIC_REGISTER(flac); } },
+    { "playback", [] { GST_PLUGIN_STATIC_REGISTER(playback); } },
+};
+#endif
+
+// Returns the codec plugins that decode a container format, 0 for unknown formats.
+unsigned PluginsOf(int format) {
+    switch (format) {
+        case Mp3:
+            return 1u << AudioParsers | 1u << Mpg123;
+        case OggOpus:
+            return 1u << Ogg | 1u << OpusParse | 1u << Opus;
+        case Flac:
+            return 1u << AudioParsers | 1u << FlacPlugin;
+        case Alaw:
+            return 1u << WavParse | 1u << AlawPlugin;
+        case Mulaw:
+            return 1u << WavParse | 1u << MulawPlugin;
+        case Any:
+            // decodebin, which finds the decoder among all plugins.
+            return AllPlugins & ~CorePlugins;
+        default:
+            return 0;
+    }
+}
+
+// The plugins requested and registered, each registered once with the time it took kept for the report. Codec
+// plugins are only registered for the formats in use, registering all of them up front slows down the app launch.
+struct Registry {
+    std::mutex mutex;
+    // Set once the Speech SDK has initialized GStreamer, plugins cannot be registered before.
+    bool initialized = false;
+    unsigned requested = 0;
+    unsigned registered = 0;
+    std::string report;
+
+    // Registers the requested plugins that are not registered yet, called with the lock held.
+    void RegisterPending(unsigned allowed) {
+#if defined(TARGET_OS_IPHONE)
+        for (int plugin = 0; plugin < PluginCount; plugin++) {
+            const unsigned bit = 1u << plugin;
+            if ((requested & allowed & bit) == 0 || (registered & bit) != 0) {
+                continue;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            plugins[plugin].registerPlugin();
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            registered |= bit;
+
+            char line[64];
+            snprintf(line, sizeof(line), "%s %.3f\n", plugins[plugin].name, elapsed.count());
+            report += line;
+            GST_INFO("Registered plugin %s in %.3f ms", plugins[plugin].name, elapsed.count());
+        }
+#else
+        (void)allowed;
+#endif
+    }
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+} // namespace
+
 namespace Microsoft {
 namespace CognitiveServices {
 namespace Speech {
 namespace Impl {
 
 void spx_gst_init_base() {
-#if defined(TARGET_OS_IPHONE)
-    GST_PLUGIN_STATIC_REGISTER(coreelements);
-    GST_PLUGIN_STATIC_REGISTER(app);
-    GST_PLUGIN_STATIC_REGISTER(audioconvert);
-    GST_PLUGIN_STATIC_REGISTER(mpg123);
-    GST_PLUGIN_STATIC_REGISTER(audioresample);
-    GST_PLUGIN_STATIC_REGISTER(audioparsers);
-    GST_PLUGIN_STATIC_REGISTER(ogg);
-    GST_PLUGIN_STATIC_REGISTER(opusparse);
-    GST_PLUGIN_STATIC_REGISTER(opus);
-    GST_PLUGIN_STATIC_REGISTER(wavparse);
-    GST_PLUGIN_STATIC_REGISTER(alaw);
-    GST_PLUGIN_STATIC_REGISTER(mulaw);
-    GST_PLUGIN_STATIC_REGISTER(flac);
-#endif
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.requested == 0) {
+        // The app does not request its formats, every plugin is needed as before.
+        registry.requested = AllPlugins;
+    }
+    registry.requested |= CorePlugins;
+    registry.initialized = true;
+    // playback is left to spx_gst_init_extra(), as before.
+    registry.RegisterPending(~(1u << Playback));
 }
 
 void spx_gst_init_extra() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.RegisterPending(AllPlugins);
 #if defined(TARGET_OS_IPHONE)
-    GST_PLUGIN_STATIC_REGISTER(playback);
-
     //TODO: Need to enable the following on 1.16.0. Blocked on mac device
 /*
     GST_PLUGIN_STATIC_REGISTER(adder);
@@ -127,3 +248,25 @@ void spx_gst_init_extra() {
 }
 
 } } } } // Microsoft::CognitiveServices::Speech::Impl
+
+void spx_gst_request_container_format(int format) {
+    const unsigned plugins = PluginsOf(format);
+    if (plugins == 0) {
+        return;
+    }
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.requested |= plugins;
+    if (registry.initialized) {
+        registry.RegisterPending(AllPlugins);
+    }
+}
+
+size_t spx_gst_registration_report(char* buffer, size_t size) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (buffer != nullptr && size > 0) {
+        snprintf(buffer, size, "%s", registry.report.c_str());
+    }
+    return registry.report.size();
+}
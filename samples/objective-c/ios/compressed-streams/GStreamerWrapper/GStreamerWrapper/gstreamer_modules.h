@@ -134,7 +134,21 @@ namespace CognitiveServices {
 namespace Speech {
 namespace Impl {
 
+// Called by the Speech SDK once GStreamer is initialized. They register the core plugins and the codec plugins of
+// the container formats requested so far, or, if the app has not requested any, all plugins.
 __attribute__((visibility ("default"))) void spx_gst_init_base();
 __attribute__((visibility ("default"))) void spx_gst_init_extra();
 
 } } } } // Microsoft::CognitiveServices::Speech::Impl
+
+extern "C"
+{
+// Requests the plugins of a container format, a value of SPXAudioStreamContainerFormat, e.g. before the first
+// stream of that format is created. They are registered at most once: right away if GStreamer is already
+// initialized, otherwise when the Speech SDK initializes it. Unknown formats are ignored.
+__attribute__((visibility ("default"))) void spx_gst_request_container_format(int format);
+
+// Writes a line "<plugin> <milliseconds>" per plugin registered so far, in the order of registration, to 'buffer'
+// and returns the length of the report, which is truncated if it is 'size' or more.
+__attribute__((visibility ("default"))) size_t spx_gst_registration_report(char* buffer, size_t size);
+}